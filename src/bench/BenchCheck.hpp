@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+
+// Shared by the benches that double as checks: each check prints what it
+// expected when it fails, and main() returns finish() so a failed run
+// exits with 1.
+namespace bench
+{
+    inline bool expect( bool condition, const char* pWhat )
+    {
+        if ( !condition )
+        {
+            printf( "             expected %s\n", pWhat );
+        }
+        return condition;
+    }
+
+    inline int finish( bool ok )
+    {
+        if ( !ok )
+        {
+            printf( "FAILED\n" );
+            return 1;
+        }
+        return 0;
+    }
+}
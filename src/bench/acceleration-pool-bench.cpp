@@ -0,0 +1,196 @@
+/*
+ * Exercises the planning half of util::AccelerationStructurePool without a
+ * device:
+ *
+ *   - HeapAllocator under random allocate/free traffic: no two live
+ *     allocations overlap, alignment holds, and freeing everything merges
+ *     each heap back into one range,
+ *   - planScratch: every wave fits the budget on disjoint aligned ranges,
+ *     and the shared buffer is compared with one scratch buffer per build,
+ *   - planCompaction followed by moving the chosen structures into new
+ *     allocations, as encodeCompaction() does.
+ *
+ * Exits with 1 on any violation.
+ *
+ * Usage: acceleration-pool-bench [operations]
+ */
+
+#include <common/AccelerationStructurePlanner.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    static constexpr uint64_t kHeapSize = 64ull << 20;
+
+    uint64_t randomSize( std::mt19937_64& rng, uint64_t lo, uint64_t hi )
+    {
+        std::uniform_real_distribution< double > u( std::log( (double)lo ), std::log( (double)hi ) );
+        return (uint64_t)std::exp( u( rng ) );
+    }
+
+    // Sorts by heap and offset and checks neighbours do not overlap.
+    bool disjoint( std::vector< util::HeapAllocation > live )
+    {
+        std::sort( live.begin(), live.end(), []( const util::HeapAllocation& a, const util::HeapAllocation& b ){
+            return a.heap != b.heap ? a.heap < b.heap : a.offset < b.offset;
+        } );
+        for ( size_t i = 1; i < live.size(); ++i )
+        {
+            if ( live[ i ].heap == live[ i - 1 ].heap && live[ i - 1 ].offset + live[ i - 1 ].size > live[ i ].offset )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double mb( uint64_t bytes ) { return bytes / ( 1024.0 * 1024.0 ); }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t operations = argc > 1 ? (size_t)atol( argv[ 1 ] ) : 200000;
+    bool ok = true;
+    std::mt19937_64 rng( 7 );
+
+    // Allocator traffic around 2000 live structures.
+    {
+        util::HeapAllocator allocator( kHeapSize );
+        std::vector< util::HeapAllocation > live;
+        const uint64_t alignments[] = { 256, 4096, 65536 };
+        uint64_t liveBytes = 0;
+        uint64_t peakReserved = 0;
+        bool aligned = true;
+        bool accounted = true;
+
+        auto start = std::chrono::steady_clock::now();
+        for ( size_t op = 0; op < operations; ++op )
+        {
+            bool grow = live.size() < 1000 || ( live.size() < 3000 && rng() % 2 );
+            if ( grow )
+            {
+                uint64_t alignment = alignments[ rng() % 3 ];
+                util::HeapAllocation a = allocator.allocate( randomSize( rng, 4096, 4 << 20 ), alignment );
+                aligned = aligned && a.offset % alignment == 0 && a.offset + a.size <= allocator.heapSize( a.heap );
+                live.push_back( a );
+                liveBytes += a.size;
+            }
+            else
+            {
+                size_t i = rng() % live.size();
+                allocator.free( live[ i ] );
+                liveBytes -= live[ i ].size;
+                live[ i ] = live.back();
+                live.pop_back();
+            }
+            accounted = accounted && allocator.usedSize() == liveBytes;
+            peakReserved = std::max( peakReserved, allocator.reservedSize() );
+        }
+        double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+
+        double use = (double)allocator.usedSize() / allocator.reservedSize();
+        bool noOverlap = disjoint( live );
+        for ( const util::HeapAllocation& a : live )
+        {
+            allocator.free( a );
+        }
+        bool merged = allocator.usedSize() == 0;
+        for ( uint32_t heap = 0; heap < allocator.heapCount(); ++heap )
+        {
+            merged = merged && allocator.freeRangeCount( heap ) == 1;
+        }
+
+        printf( "allocator: %zu ops in %.1f ms (%.2f Mops/s), %zu heaps, peak %.0f MB reserved, %.0f%% in use at the end\n",
+                operations, seconds * 1e3, operations / seconds * 1e-6, allocator.heapCount(), mb( peakReserved ), use * 100.0 );
+        printf( "           aligned %s, accounted %s, disjoint %s, merged back %s\n", aligned ? "ok" : "FAIL",
+                accounted ? "ok" : "FAIL", noOverlap ? "ok" : "FAIL", merged ? "ok" : "FAIL" );
+        ok = ok && aligned && accounted && noOverlap && merged;
+    }
+
+    // Scratch plans for a batch of 1000 builds.
+    {
+        std::vector< uint64_t > scratch( 1000 );
+        uint64_t separate = 0;
+        uint64_t largest = 0;
+        for ( uint64_t& s : scratch )
+        {
+            s = randomSize( rng, 16 << 10, 8 << 20 );
+            separate += s;
+            largest = std::max( largest, s );
+        }
+
+        for ( uint64_t budget : { 0ull, 16ull << 20, 64ull << 20 } )
+        {
+            util::ScratchPlan plan = util::planScratch( scratch.data(), scratch.size(), budget );
+            uint64_t capacity = std::max< uint64_t >( budget, ( largest + util::kScratchAlignment - 1 ) / util::kScratchAlignment
+                                                                  * util::kScratchAlignment );
+            bool valid = plan.size <= capacity;
+            std::vector< util::HeapAllocation > ranges;
+            for ( size_t i = 0; i < scratch.size(); ++i )
+            {
+                valid = valid && plan.waves[ i ] < plan.waveCount && plan.offsets[ i ] % util::kScratchAlignment == 0
+                        && plan.offsets[ i ] + scratch[ i ] <= plan.size;
+                ranges.push_back( { plan.waves[ i ], plan.offsets[ i ], scratch[ i ] } );
+            }
+            valid = valid && disjoint( ranges ) && ( budget || plan.size == capacity );
+            printf( "scratch budget %3.0f MB: %4u waves, one %6.2f MB buffer against %7.1f MB for one per build  %s\n", mb( budget ),
+                    plan.waveCount, mb( plan.size ), mb( separate ), valid ? "" : "FAIL" );
+            ok = ok && valid;
+        }
+    }
+
+    // Compaction of 1000 freshly built structures.
+    {
+        util::HeapAllocator allocator( kHeapSize );
+        std::vector< uint64_t > sizes( 1000 ), compacted( 1000 );
+        std::vector< util::HeapAllocation > storage( 1000 );
+        std::uniform_real_distribution< double > ratio( 0.4, 1.0 );
+        for ( size_t i = 0; i < sizes.size(); ++i )
+        {
+            sizes[ i ] = randomSize( rng, 64 << 10, 4 << 20 ) / 256 * 256;
+            compacted[ i ] = (uint64_t)( sizes[ i ] * ratio( rng ) ) / 256 * 256;
+            storage[ i ] = allocator.allocate( sizes[ i ], 256 );
+        }
+        uint64_t before = allocator.usedSize();
+        size_t heapsBefore = allocator.heapCount();
+
+        std::vector< uint32_t > chosen;
+        uint64_t saved = util::planCompaction( sizes.data(), compacted.data(), sizes.size(), 0.1f, &chosen );
+        std::vector< util::HeapAllocation > old;
+        for ( uint32_t i : chosen )
+        {
+            old.push_back( storage[ i ] );
+            storage[ i ] = allocator.allocate( compacted[ i ], 256 );
+        }
+        uint64_t during = allocator.usedSize();
+        for ( const util::HeapAllocation& a : old )
+        {
+            allocator.free( a );
+        }
+
+        uint64_t expected = 0;
+        bool worthIt = true;
+        for ( size_t i = 0; i < sizes.size(); ++i )
+        {
+            bool moved = std::find( chosen.begin(), chosen.end(), (uint32_t)i ) != chosen.end();
+            expected += moved ? compacted[ i ] : sizes[ i ];
+            worthIt = worthIt && moved == ( sizes[ i ] - compacted[ i ] >= sizes[ i ] / 10 );
+        }
+        bool valid = allocator.usedSize() == expected && before - allocator.usedSize() == saved && worthIt && disjoint( storage );
+        printf( "compaction: %zu of %zu compacted, %.1f MB -> %.1f MB (%.1f MB while copying), heaps %zu -> %zu  %s\n", chosen.size(),
+                sizes.size(), mb( before ), mb( allocator.usedSize() ), mb( during ), heapsBefore, allocator.heapCount(),
+                valid ? "" : "FAIL" );
+        ok = ok && valid;
+    }
+
+    return bench::finish( ok );
+}
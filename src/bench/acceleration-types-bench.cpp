@@ -0,0 +1,179 @@
+/*
+ * Checks the vectorized acceleration structure kernels of
+ * util/AccelerationStructureTypes against scalar references and reports
+ * their throughput:
+ *
+ *   - packTransforms: float4x4 to PackedFloat4x3 (must match bit for bit),
+ *   - transformBounds: Arvo's method against transforming all 8 corners,
+ *   - mergeBounds, computeBounds and minMax against scalar loops.
+ *
+ * Exits with 1 on any mismatch.
+ *
+ * Usage: acceleration-types-bench [count]
+ */
+
+#include <common/AccelerationStructureTypes.hpp>
+#include <common/Math.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace math = util::math;
+
+namespace
+{
+    static constexpr int kRepeats = 5;
+
+    template< typename Fn >
+    double bestSeconds( Fn&& fn )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+        }
+        return best;
+    }
+
+    util::BoundingBox referenceTransform( const util::BoundingBox& box, const util::PackedTransform& t )
+    {
+        util::BoundingBox r = util::emptyBounds();
+        for ( int corner = 0; corner < 8; ++corner )
+        {
+            float p[ 3 ] = { corner & 1 ? box.max[ 0 ] : box.min[ 0 ],
+                             corner & 2 ? box.max[ 1 ] : box.min[ 1 ],
+                             corner & 4 ? box.max[ 2 ] : box.min[ 2 ] };
+            float q[ 3 ];
+            for ( int row = 0; row < 3; ++row )
+            {
+                q[ row ] = t.columns[ 0 ][ row ] * p[ 0 ] + t.columns[ 1 ][ row ] * p[ 1 ]
+                         + t.columns[ 2 ][ row ] * p[ 2 ] + t.columns[ 3 ][ row ];
+            }
+            r = util::expand( r, q );
+        }
+        return r;
+    }
+
+    // Both round differently, so compare relative to the size of the
+    // terms summed: a transformed coordinate of the box's far corner.
+    bool sameBounds( const util::BoundingBox& a, const util::BoundingBox& b, float scale, float tolerance )
+    {
+        for ( int i = 0; i < 3; ++i )
+        {
+            if ( fabsf( a.min[ i ] - b.min[ i ] ) > tolerance * scale || fabsf( a.max[ i ] - b.max[ i ] ) > tolerance * scale )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report( const char* name, size_t count, double seconds, size_t bytes )
+    {
+        printf( "%-16s %8.2f ms  %7.1f M/s  %6.2f GB/s\n", name, seconds * 1e3, count / seconds * 1e-6, bytes / seconds * 1e-9 );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t count = argc > 1 ? (size_t)atol( argv[ 1 ] ) : ( 1u << 20 );
+    count = std::max< size_t >( count, 1 );
+    bool ok = true;
+
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution< float > unit( -1.0f, 1.0f );
+
+    std::vector< math::float4x4 > matrices( count );
+    std::vector< util::BoundingBox > boxes( count );
+    std::vector< float > values( count * 3 );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        matrices[ i ] = math::makeTranslate( { unit( rng ) * 10.0f, unit( rng ) * 10.0f, unit( rng ) * 10.0f } )
+                      * math::makeYRotate( unit( rng ) * 3.0f ) * math::makeXRotate( unit( rng ) * 3.0f )
+                      * math::makeScale( { 1.0f + unit( rng ) * 0.5f, 1.0f + unit( rng ) * 0.5f, 1.0f + unit( rng ) * 0.5f } );
+        for ( int a = 0; a < 3; ++a )
+        {
+            float c = unit( rng ) * 100.0f;
+            float e = fabsf( unit( rng ) );
+            boxes[ i ].min[ a ] = c - e;
+            boxes[ i ].max[ a ] = c + e;
+            values[ i * 3 + a ] = c;
+        }
+    }
+    // An empty box must pass through transformBounds unchanged.
+    boxes[ count / 2 ] = util::emptyBounds();
+    const float* pMatrices = reinterpret_cast< const float* >( matrices.data() );
+
+    // float4x4 -> PackedFloat4x3
+    std::vector< util::PackedTransform > packed( count ), expectedPacked( count );
+    double packSeconds = bestSeconds( [&]{ util::packTransforms( pMatrices, count, packed.data() ); } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        for ( int c = 0; c < 4; ++c )
+        {
+            memcpy( expectedPacked[ i ].columns[ c ], pMatrices + i * 16 + c * 4, 3 * sizeof( float ) );
+        }
+    }
+    bool packOk = memcmp( packed.data(), expectedPacked.data(), count * sizeof( util::PackedTransform ) ) == 0;
+    report( "packTransforms", count, packSeconds, count * ( sizeof( math::float4x4 ) + sizeof( util::PackedTransform ) ) );
+    ok = ok && packOk;
+
+    // AABB transform
+    std::vector< util::BoundingBox > transformed( count );
+    double transformSeconds = bestSeconds( [&]{ util::transformBounds( boxes.data(), packed.data(), count, transformed.data() ); } );
+    size_t transformMismatches = 0;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        bool same = util::isEmpty( boxes[ i ] ) ? util::isEmpty( transformed[ i ] )
+                                                : sameBounds( transformed[ i ], referenceTransform( boxes[ i ], packed[ i ] ), 1000.0f, 1e-6f );
+        transformMismatches += !same;
+    }
+    report( "transformBounds", count, transformSeconds,
+            count * ( 2 * sizeof( util::BoundingBox ) + sizeof( util::PackedTransform ) ) );
+    ok = ok && transformMismatches == 0;
+
+    // Reductions, which only reorder min/max and so must be exact.
+    util::BoundingBox merged;
+    double mergeSeconds = bestSeconds( [&]{ merged = util::mergeBounds( boxes.data(), count ); } );
+    util::BoundingBox expectedMerged = util::emptyBounds();
+    for ( const util::BoundingBox& box : boxes )
+    {
+        expectedMerged = util::merge( expectedMerged, box );
+    }
+    bool mergeOk = memcmp( &merged, &expectedMerged, sizeof( merged ) ) == 0;
+    report( "mergeBounds", count, mergeSeconds, count * sizeof( util::BoundingBox ) );
+    ok = ok && mergeOk;
+
+    util::BoundingBox pointBounds;
+    double boundsSeconds = bestSeconds( [&]{ pointBounds = util::computeBounds( values.data(), count, 3 * sizeof( float ) ); } );
+    util::BoundingBox expectedPointBounds = util::emptyBounds();
+    for ( size_t i = 0; i < count; ++i )
+    {
+        expectedPointBounds = util::expand( expectedPointBounds, &values[ i * 3 ] );
+    }
+    bool boundsOk = memcmp( &pointBounds, &expectedPointBounds, sizeof( pointBounds ) ) == 0;
+    report( "computeBounds", count, boundsSeconds, count * 3 * sizeof( float ) );
+    ok = ok && boundsOk;
+
+    float lo = 0.0f, hi = 0.0f;
+    double minMaxSeconds = bestSeconds( [&]{ util::minMax( values.data(), values.size(), &lo, &hi ); } );
+    auto expectedMinMax = std::minmax_element( values.begin(), values.end() );
+    bool minMaxOk = lo == *expectedMinMax.first && hi == *expectedMinMax.second;
+    report( "minMax", values.size(), minMaxSeconds, values.size() * sizeof( float ) );
+    ok = ok && minMaxOk;
+
+    printf( "checks: pack %s, transform %zu mismatches, merge %s, bounds %s, minMax %s\n", packOk ? "ok" : "MISMATCH",
+            transformMismatches, mergeOk ? "ok" : "MISMATCH", boundsOk ? "ok" : "MISMATCH", minMaxOk ? "ok" : "MISMATCH" );
+
+    return bench::finish( ok );
+}
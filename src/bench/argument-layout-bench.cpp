@@ -0,0 +1,154 @@
+/*
+ * Checks util::ArgumentBufferLayout on any platform:
+ *
+ *   - offsets: constants and resource handles mixed in one struct, given
+ *              out of [[id]] order, get their MSL offsets, and the table's
+ *              alignment and stride follow its widest member,
+ *   - arrays:  array members cover a range of ids; every element has an
+ *              offset, ids inside the range are not members of their own,
+ *   - rejects: overlapping id ranges, zero sizes and alignments that are
+ *              not powers of two give an invalid layout,
+ *   - writes:  writeConstant() and writeHandle() land at offsetOf().
+ *
+ * Also reports the cost of offsetOf(). Exits with 1 on any failed check.
+ *
+ * Usage: argument-layout-bench [lookups]
+ */
+
+#include <common/ArgumentLayout.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+    using util::ArgumentBufferLayout;
+    using util::ArgumentField;
+    using util::ArgumentKind;
+
+    ArgumentField constant( uint32_t index, uint32_t size, uint32_t alignment, uint32_t arrayLength = 1 )
+    {
+        ArgumentField f;
+        f.index = index;
+        f.kind = ArgumentKind::Constant;
+        f.size = size;
+        f.alignment = alignment;
+        f.arrayLength = arrayLength;
+        return f;
+    }
+
+    ArgumentField resource( uint32_t index, uint32_t arrayLength = 1 )
+    {
+        ArgumentField f;
+        f.index = index;
+        f.arrayLength = arrayLength;
+        return f;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t lookups = argc > 1 ? std::max( 1000, atoi( argv[ 1 ] ) ) : 10000000;
+    bool ok = true;
+
+    // struct Table {
+    //     float scale                 [[id(0)]];   //  0
+    //     device float3* positions    [[id(1)]];   //  8
+    //     float4 tint                 [[id(2)]];   // 16
+    //     uchar mode                  [[id(3)]];   // 32
+    //     array<texture2d<float>, 4>  [[id(4)]];   // 40, ids 4-7
+    //     float bias                  [[id(8)]];   // 72
+    // };                                           // size 76, stride 80
+    const ArgumentField fields[] = {
+        resource( 4, 4 ), constant( 8, 4, 4 ), constant( 2, 16, 16 ), constant( 0, 4, 4 ), resource( 1 ), constant( 3, 1, 1 ),
+    };
+    ArgumentBufferLayout layout = ArgumentBufferLayout::compile( fields, std::size( fields ) );
+
+    {
+        const uint32_t expected[][ 2 ] = { { 0, 0 }, { 1, 8 }, { 2, 16 }, { 3, 32 }, { 4, 40 }, { 8, 72 } };
+        int wrong = 0;
+        for ( const uint32_t* pExpected : expected )
+        {
+            wrong += layout.offsetOf( pExpected[ 0 ] ) != pExpected[ 1 ];
+        }
+        printf( "offsets      size %zu, alignment %zu, stride %zu, %d wrong offsets\n", layout.size(), layout.alignment(),
+                layout.stride(), wrong );
+        ok &= bench::expect( layout.valid() && wrong == 0, "MSL offsets for every member" );
+        ok &= bench::expect( layout.size() == 76 && layout.alignment() == 16 && layout.stride() == 80,
+                             "size 76 padded to a stride of 80" );
+        ok &= bench::expect( layout.fields().size() == 6 && layout.fields().front().index == 0 && layout.fields().back().index == 8,
+                             "members in [[id]] order" );
+    }
+
+    {
+        const util::ArgumentFieldLayout* pTextures = layout.field( 4 );
+        printf( "arrays       elements at %u %u %u %u\n", layout.offsetOf( 4, 0 ), layout.offsetOf( 4, 1 ), layout.offsetOf( 4, 2 ),
+                layout.offsetOf( 4, 3 ) );
+        ok &= bench::expect( pTextures && pTextures->arrayLength == 4 && pTextures->elementSize == 8, "a four element handle array" );
+        ok &= bench::expect( layout.offsetOf( 4, 3 ) == 64 && layout.offsetOf( 4, 4 ) == ArgumentBufferLayout::kInvalidOffset,
+                             "the last element at 64 and none past it" );
+        ok &= bench::expect( !layout.field( 5 ) && layout.offsetOf( 7 ) == ArgumentBufferLayout::kInvalidOffset &&
+                             layout.offsetOf( 9 ) == ArgumentBufferLayout::kInvalidOffset, "no members inside the range or past the end" );
+    }
+
+    {
+        const ArgumentField overlap[] = { resource( 0, 4 ), constant( 3, 4, 4 ) };
+        const ArgumentField duplicate[] = { constant( 2, 4, 4 ), resource( 2 ) };
+        const ArgumentField empty[] = { constant( 0, 0, 4 ) };
+        const ArgumentField noElements[] = { resource( 0, 0 ) };
+        const ArgumentField badAlignment[] = { constant( 0, 12, 12 ) };
+        const ArgumentField adjacent[] = { resource( 0, 4 ), constant( 4, 4, 4 ) };
+        int rejected = 0;
+        rejected += !ArgumentBufferLayout::compile( overlap, std::size( overlap ) ).valid();
+        rejected += !ArgumentBufferLayout::compile( duplicate, std::size( duplicate ) ).valid();
+        rejected += !ArgumentBufferLayout::compile( empty, std::size( empty ) ).valid();
+        rejected += !ArgumentBufferLayout::compile( noElements, std::size( noElements ) ).valid();
+        rejected += !ArgumentBufferLayout::compile( badAlignment, std::size( badAlignment ) ).valid();
+        bool adjacentValid = ArgumentBufferLayout::compile( adjacent, std::size( adjacent ) ).valid();
+        printf( "rejects      %d of 5 invalid structs rejected\n", rejected );
+        ok &= bench::expect( rejected == 5, "overlaps, empty members and bad alignments rejected" );
+        ok &= bench::expect( adjacentValid, "an array followed by the next free id accepted" );
+    }
+
+    {
+        std::vector< uint8_t > table( layout.stride(), 0 );
+        float tint[ 4 ] = { 1.f, 0.5f, 0.25f, 1.f };
+        uint8_t mode = 3;
+        layout.writeConstant( table.data(), 2, tint, sizeof( tint ) );
+        layout.writeConstant( table.data(), 3, &mode, sizeof( mode ) );
+        layout.writeHandle( table.data(), 4, 0x1234, 2 );
+
+        float readTint[ 4 ];
+        uint64_t readHandle;
+        memcpy( readTint, table.data() + 16, sizeof( readTint ) );
+        memcpy( &readHandle, table.data() + 56, sizeof( readHandle ) );
+        printf( "writes       mode %u, handle 0x%llx\n", table[ 32 ], (unsigned long long)readHandle );
+        ok &= bench::expect( !memcmp( readTint, tint, sizeof( tint ) ) && table[ 32 ] == 3 && readHandle == 0x1234,
+                             "stores at the computed offsets" );
+    }
+
+    {
+        uint64_t sum = 0;
+        double start = seconds();
+        for ( size_t i = 0; i < lookups; ++i )
+        {
+            sum += layout.offsetOf( (uint32_t)( i % 9 ), (uint32_t)( i & 1 ) );
+        }
+        double elapsed = seconds() - start;
+        printf( "offsetOf     %.2f ns per lookup (checksum %llu)\n", elapsed * 1e9 / lookups, (unsigned long long)sum );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,265 @@
+/*
+ * Builds util::SceneBvh for the instancing samples' 10x10x10 grid, with
+ * spheres and cubes as meshes, and reports:
+ *
+ *   - binned SAH build time of a large mesh on 1 and N threads (the trees
+ *     must be identical),
+ *   - primary-ray throughput of the CPU ray-query fallback in Mrays/s,
+ *   - agreement with brute-force intersection of every triangle.
+ *
+ * Exits with 1 on any mismatch.
+ *
+ * Usage: bvh-bench [threads]
+ */
+
+#include <common/Math.hpp>
+#include <common/SceneBvh.hpp>
+#include <common/WorkStealingPool.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace math = util::math;
+
+namespace
+{
+    static constexpr int kRepeats = 3;
+
+    template< typename Fn >
+    double bestSeconds( Fn&& fn )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+        }
+        return best;
+    }
+
+    struct Mesh
+    {
+        std::vector< float > positions;  // xyz
+        std::vector< uint32_t > indices;
+
+        size_t triangleCount() const { return indices.size() / 3; }
+    };
+
+    Mesh makeSphere( uint32_t rings, uint32_t segments, float radius )
+    {
+        Mesh m;
+        for ( uint32_t r = 0; r <= rings; ++r )
+        {
+            float theta = (float)M_PI * r / rings;
+            for ( uint32_t s = 0; s <= segments; ++s )
+            {
+                float phi = 2.0f * (float)M_PI * s / segments;
+                m.positions.insert( m.positions.end(), { radius * sinf( theta ) * cosf( phi ), radius * cosf( theta ),
+                                                         radius * sinf( theta ) * sinf( phi ) } );
+            }
+        }
+        for ( uint32_t r = 0; r < rings; ++r )
+        {
+            for ( uint32_t s = 0; s < segments; ++s )
+            {
+                uint32_t a = r * ( segments + 1 ) + s;
+                uint32_t b = a + segments + 1;
+                m.indices.insert( m.indices.end(), { a, b, a + 1, a + 1, b, b + 1 } );
+            }
+        }
+        return m;
+    }
+
+    Mesh makeCube( float s )
+    {
+        Mesh m;
+        for ( int i = 0; i < 8; ++i )
+        {
+            m.positions.insert( m.positions.end(), { i & 1 ? s : -s, i & 2 ? s : -s, i & 4 ? s : -s } );
+        }
+        m.indices = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                      2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+        return m;
+    }
+
+    // Brute force: every triangle of every instance.
+    bool bruteForce( const util::SceneBvh& scene, const std::vector< const Mesh* >& meshes, const util::Ray& ray, float* pDistance )
+    {
+        float best = ray.maxDistance;
+        bool found = false;
+        for ( const util::InstanceDescriptor& d : scene.instanceDescriptors() )
+        {
+            const Mesh& mesh = *meshes[ d.accelerationStructureIndex ];
+            const util::PackedTransform& t = d.transformationMatrix;
+            for ( size_t tri = 0; tri < mesh.triangleCount(); ++tri )
+            {
+                math::float3 p[ 3 ];
+                for ( int k = 0; k < 3; ++k )
+                {
+                    const float* v = &mesh.positions[ mesh.indices[ tri * 3 + k ] * 3 ];
+                    for ( int row = 0; row < 3; ++row )
+                    {
+                        ( &p[ k ].x )[ row ] = t.columns[ 0 ][ row ] * v[ 0 ] + t.columns[ 1 ][ row ] * v[ 1 ]
+                                             + t.columns[ 2 ][ row ] * v[ 2 ] + t.columns[ 3 ][ row ];
+                    }
+                }
+                math::float3 o = { ray.origin[ 0 ], ray.origin[ 1 ], ray.origin[ 2 ] };
+                math::float3 dir = { ray.direction[ 0 ], ray.direction[ 1 ], ray.direction[ 2 ] };
+                math::float3 e1 = p[ 1 ] - p[ 0 ];
+                math::float3 e2 = p[ 2 ] - p[ 0 ];
+                math::float3 q = math::cross( dir, e2 );
+                float det = math::dot( e1, q );
+                if ( det == 0.0f )
+                {
+                    continue;
+                }
+                math::float3 s = o - p[ 0 ];
+                float u = math::dot( s, q ) / det;
+                math::float3 r = math::cross( s, e1 );
+                float v = math::dot( dir, r ) / det;
+                float dist = math::dot( e2, r ) / det;
+                if ( u >= 0.0f && v >= 0.0f && u + v <= 1.0f && dist > ray.minDistance && dist < best )
+                {
+                    best = dist;
+                    found = true;
+                }
+            }
+        }
+        *pDistance = best;
+        return found;
+    }
+
+    util::Ray cameraRay( uint32_t x, uint32_t y, uint32_t width, uint32_t height )
+    {
+        util::Ray ray;
+        ray.origin[ 0 ] = 0.0f;
+        ray.origin[ 1 ] = 0.0f;
+        ray.origin[ 2 ] = 0.0f;
+        float dx = ( ( x + 0.5f ) / width * 2.0f - 1.0f ) * 0.45f;
+        float dy = ( ( y + 0.5f ) / height * 2.0f - 1.0f ) * 0.45f;
+        float invLength = 1.0f / sqrtf( dx * dx + dy * dy + 1.0f );
+        ray.direction[ 0 ] = dx * invLength;
+        ray.direction[ 1 ] = dy * invLength;
+        ray.direction[ 2 ] = -invLength;
+        ray.minDistance = 0.0f;
+        ray.maxDistance = INFINITY;
+        return ray;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    unsigned threads = argc > 1 ? (unsigned)atoi( argv[ 1 ] ) : std::thread::hardware_concurrency();
+    threads = std::max( threads, 1u );
+    bool ok = true;
+
+    // Large mesh build: serial against parallel.
+    Mesh big = makeSphere( 256, 512, 1.0f );
+    std::vector< util::BoundingBox > triangleBounds( big.triangleCount(), util::emptyBounds() );
+    for ( size_t t = 0; t < big.triangleCount(); ++t )
+    {
+        for ( int k = 0; k < 3; ++k )
+        {
+            const float* v = &big.positions[ big.indices[ t * 3 + k ] * 3 ];
+            for ( int a = 0; a < 3; ++a )
+            {
+                triangleBounds[ t ].min[ a ] = std::min( triangleBounds[ t ].min[ a ], v[ a ] );
+                triangleBounds[ t ].max[ a ] = std::max( triangleBounds[ t ].max[ a ], v[ a ] );
+            }
+        }
+    }
+
+    util::WorkStealingPool pool( threads );
+    util::Bvh serial, parallel;
+    double serialSeconds = bestSeconds( [&]{ serial.build( triangleBounds.data(), triangleBounds.size() ); } );
+    double parallelSeconds = bestSeconds( [&]{ parallel.build( triangleBounds.data(), triangleBounds.size(), &pool ); } );
+    bool identical = serial.nodes().size() == parallel.nodes().size()
+                     && memcmp( serial.nodes().data(), parallel.nodes().data(), serial.nodes().size() * sizeof( util::BvhNode ) ) == 0
+                     && serial.primitiveIndices() == parallel.primitiveIndices();
+    printf( "build %zu triangles: %.2f ms (1 thread), %.2f ms (%u threads), %zu nodes, SAH cost %.1f%s\n",
+            big.triangleCount(), serialSeconds * 1e3, parallelSeconds * 1e3, threads, serial.nodes().size(),
+            serial.sahCost(), identical ? "" : "  MISMATCH" );
+    ok = ok && identical;
+
+    // The root must enclose exactly the vertices.
+    util::BoundingBox meshBounds = util::computeBounds( big.positions.data(), big.positions.size() / 3, 3 * sizeof( float ) );
+    ok = ok && memcmp( &meshBounds, &serial.nodes()[ 0 ].bounds, sizeof( meshBounds ) ) == 0;
+
+    // The samples' instance grid, alternating spheres and cubes.
+    Mesh sphere = makeSphere( 16, 32, 0.1f );
+    Mesh cube = makeCube( 0.1f );
+    std::vector< const Mesh* > meshes = { &sphere, &cube };
+
+    util::SceneBvh scene;
+    for ( const Mesh* pMesh : meshes )
+    {
+        scene.addMesh( pMesh->positions.data(), 3 * sizeof( float ), pMesh->indices.data(), pMesh->triangleCount() );
+    }
+    for ( int i = 0; i < 1000; ++i )
+    {
+        int ix = i % 10, iy = ( i / 10 ) % 10, iz = i / 100;
+        math::float4x4 m = math::makeTranslate( { ( ix - 4.5f ) * 0.4f, ( iy - 4.5f ) * 0.4f, ( iz - 4.5f ) * 0.4f - 10.0f } )
+                         * math::makeYRotate( cosf( (float)iy ) ) * math::makeZRotate( sinf( (float)ix ) )
+                         * math::makeScale( { 1.5f, 1.5f, 1.5f } );
+        scene.addInstance( reinterpret_cast< const float* >( &m ), (uint32_t)( i & 1 ) );
+    }
+
+    double sceneSeconds = bestSeconds( [&]{ scene.build( &pool ); } );
+    printf( "scene: %zu instances, %zu meshes, built in %.2f ms, instance SAH cost %.1f\n",
+            scene.instanceCount(), scene.meshCount(), sceneSeconds * 1e3, scene.instanceBvh().sahCost() );
+
+    const uint32_t width = 256, height = 256;
+    size_t hits = 0;
+    double singleSeconds = bestSeconds( [&]{
+        hits = 0;
+        for ( uint32_t y = 0; y < height; ++y )
+        {
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                util::RayHit hit;
+                hits += scene.intersect( cameraRay( x, y, width, height ), 0xFF, &hit );
+            }
+        }
+    } );
+    double pooledSeconds = bestSeconds( [&]{
+        pool.parallelFor( height, [&]( size_t y, unsigned ){
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                util::RayHit hit;
+                scene.intersect( cameraRay( x, (uint32_t)y, width, height ), 0xFF, &hit );
+            }
+        } );
+    } );
+    double rays = (double)width * height;
+    printf( "primary rays %ux%u: %.2f Mrays/s (1 thread), %.2f Mrays/s (%u threads), %.1f%% hit\n",
+            width, height, rays / singleSeconds * 1e-6, rays / pooledSeconds * 1e-6, threads, 100.0 * hits / rays );
+
+    // Every 512th pixel against brute force.
+    int checked = 0, mismatches = 0;
+    for ( uint32_t p = 0; p < width * height; p += 512 )
+    {
+        util::Ray ray = cameraRay( p % width, p / width, width, height );
+        util::RayHit hit;
+        float expected;
+        bool expectedHit = bruteForce( scene, meshes, ray, &expected );
+        bool gotHit = scene.intersect( ray, 0xFF, &hit );
+        if ( expectedHit != gotHit || ( gotHit && fabsf( hit.distance - expected ) > 1e-4f * expected ) )
+        {
+            ++mismatches;
+        }
+        ++checked;
+    }
+    printf( "brute force check: %d rays, %d mismatches\n", checked, mismatches );
+    ok = ok && mismatches == 0;
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,209 @@
+/*
+ * Drives util::CaptureTrigger with synthetic GPU frame times at 60 fps
+ * and checks its decisions:
+ *
+ *   - percentile: FrameTimeWindow percentiles match a full sort,
+ *   - steady:     noisy 1 ms frames never trigger,
+ *   - regression: frames jump to 6 ms; the p50 limit triggers a one-frame
+ *                 capture, the cooldown holds off the next one, and the
+ *                 budget stops captures after the second,
+ *   - stutter:    3% of frames take 12 ms; p99 triggers but p50 does not,
+ *   - spike:      one 20 ms frame among 1 ms frames trips the spike factor,
+ *   - failure:    a capture that cannot start still uses up the budget.
+ *
+ * Also reports the trigger's CPU time per frame. Exits with 1 on any
+ * unexpected decision.
+ *
+ * Usage: capture-trigger-bench [frames]
+ */
+
+#include <common/CaptureTrigger.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    static constexpr double kFrameSeconds = 1.0 / 60.0;
+
+    util::CapturePolicy testPolicy()
+    {
+        util::CapturePolicy policy;
+        policy.windowFrames = 120;
+        policy.p50LimitMs = 4.0;
+        policy.p99LimitMs = 8.0;
+        policy.cooldownSeconds = 10.0;
+        policy.maxCaptures = 2;
+        return policy;
+    }
+
+    struct Run
+    {
+        std::vector< int > starts;
+        std::vector< int > stops;
+        std::string firstReason;
+    };
+
+    // Frame times arrive three frames late, as completed handlers do.
+    template< typename FrameMs >
+    Run run( util::CaptureTrigger& trigger, int frames, FrameMs frameMs )
+    {
+        static constexpr int kLatency = 3;
+        Run r;
+        for ( int frame = 0; frame < frames; ++frame )
+        {
+            double now = frame * kFrameSeconds;
+            if ( frame >= kLatency )
+            {
+                trigger.addFrameTime( frameMs( frame - kLatency ) );
+            }
+            if ( trigger.beginFrame( now ) )
+            {
+                r.starts.push_back( frame );
+                if ( r.firstReason.empty() )
+                {
+                    r.firstReason = trigger.reason();
+                }
+            }
+            if ( trigger.endFrame( now ) )
+            {
+                r.stops.push_back( frame );
+            }
+        }
+        return r;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    int frames = argc > 1 ? std::max( 2000, atoi( argv[ 1 ] ) ) : 4000;
+    bool ok = true;
+    std::mt19937 rng( 47 );
+    std::normal_distribution< double > noise( 1.0, 0.1 );
+
+    {
+        std::uniform_real_distribution< double > any( 0.0, 50.0 );
+        util::FrameTimeWindow window( 120 );
+        std::vector< double > all;
+        int mismatches = 0;
+        for ( int i = 0; i < 1000; ++i )
+        {
+            double ms = any( rng );
+            window.add( ms );
+            all.push_back( ms );
+            std::vector< double > recent( all.end() - std::min< size_t >( all.size(), 120 ), all.end() );
+            std::sort( recent.begin(), recent.end() );
+            for ( double q : { 0.0, 0.5, 0.9, 0.99, 1.0 } )
+            {
+                size_t rank = (size_t)std::ceil( q * recent.size() );
+                double expected = recent[ rank > 0 ? rank - 1 : 0 ];
+                mismatches += window.percentile( q ) != expected;
+            }
+        }
+        printf( "percentile   %d mismatches\n", mismatches );
+        ok &= bench::expect( mismatches == 0 && window.count() == 120, "percentiles of the last 120 frames" );
+    }
+
+    {
+        util::CaptureTrigger trigger( testPolicy() );
+        Run r = run( trigger, frames, [&]( int ){ return std::max( 0.1, noise( rng ) ); } );
+        printf( "steady       %zu captures, state %s, p99 %.2f ms\n", r.starts.size(), util::captureStateName( trigger.state() ),
+                trigger.window().percentile( 0.99 ) );
+        ok &= bench::expect( r.starts.empty() && trigger.state() == util::CaptureState::Armed, "no capture and an armed trigger" );
+    }
+
+    {
+        util::CaptureTrigger trigger( testPolicy() );
+        Run r = run( trigger, frames, [&]( int frame ){ return frame < 300 ? noise( rng ) : 6.0 * noise( rng ); } );
+        printf( "regression   captures at frames" );
+        for ( int f : r.starts )
+        {
+            printf( " %d", f );
+        }
+        printf( ", state %s\n             %s\n", util::captureStateName( trigger.state() ), r.firstReason.c_str() );
+        // The median passes 4 ms once over half the window is slow; the
+        // cooldown and a fresh window separate the second capture.
+        int cooldownFrames = (int)( 10.0 / kFrameSeconds );
+        ok &= bench::expect( r.starts.size() == 2 && r.stops.size() == 2, "two captures" );
+        ok &= bench::expect( r.starts.size() == 2 && r.starts[ 0 ] > 300 + 60 && r.starts[ 0 ] < 300 + 70,
+                             "the first capture once the median regresses" );
+        ok &= bench::expect( r.starts.size() == 2 && r.starts[ 1 ] >= r.starts[ 0 ] + cooldownFrames + 120,
+                             "the second capture after the cooldown and a new window" );
+        ok &= bench::expect( r.starts.size() == 2 && r.stops[ 0 ] == r.starts[ 0 ] && r.stops[ 1 ] == r.starts[ 1 ],
+                             "one-frame captures" );
+        ok &= bench::expect( r.firstReason.find( "p50" ) == 0, "a p50 reason" );
+        ok &= bench::expect( trigger.state() == util::CaptureState::Exhausted, "an exhausted budget" );
+    }
+
+    {
+        util::CaptureTrigger trigger( testPolicy() );
+        std::uniform_real_distribution< double > chance( 0.0, 1.0 );
+        Run r = run( trigger, 1000, [&]( int frame ){ return frame >= 400 && chance( rng ) < 0.03 ? 12.0 : noise( rng ); } );
+        printf( "stutter      %zu captures, first at %d: %s\n", r.starts.size(), r.starts.empty() ? -1 : r.starts[ 0 ],
+                r.firstReason.c_str() );
+        ok &= bench::expect( !r.starts.empty() && r.starts[ 0 ] > 400 && r.firstReason.find( "p99" ) == 0, "a p99 capture" );
+    }
+
+    {
+        util::CapturePolicy policy = testPolicy();
+        policy.spikeFactor = 10.0;
+        util::CaptureTrigger trigger( policy );
+        Run r = run( trigger, 600, [&]( int frame ){ return frame == 500 ? 20.0 : noise( rng ); } );
+        printf( "spike        %zu captures, first at %d: %s\n", r.starts.size(), r.starts.empty() ? -1 : r.starts[ 0 ],
+                r.firstReason.c_str() );
+        ok &= bench::expect( r.starts.size() == 1 && r.starts[ 0 ] == 503 && r.firstReason.find( "frame of 20.00" ) == 0,
+                             "one capture on the frame the spike arrives" );
+    }
+
+    {
+        util::CaptureTrigger trigger( testPolicy() );
+        int attempts = 0;
+        for ( int frame = 0; frame < frames; ++frame )
+        {
+            double now = frame * kFrameSeconds;
+            trigger.addFrameTime( 6.0 );
+            if ( trigger.beginFrame( now ) )
+            {
+                ++attempts;
+                trigger.captureFailed( now );
+            }
+            trigger.endFrame( now );
+        }
+        printf( "failure      %d attempts, state %s\n", attempts, util::captureStateName( trigger.state() ) );
+        ok &= bench::expect( attempts == 2 && trigger.state() == util::CaptureState::Exhausted, "two failed attempts" );
+    }
+
+    {
+        util::CapturePolicy policy = testPolicy();
+        policy.maxCaptures = 0;
+        policy.windowFrames = 240;
+        util::CaptureTrigger idle( policy );
+        policy.maxCaptures = 2;
+        util::CaptureTrigger trigger( policy );
+        double start = seconds();
+        for ( int frame = 0; frame < frames; ++frame )
+        {
+            trigger.addFrameTime( noise( rng ) );
+            trigger.beginFrame( frame * kFrameSeconds );
+            trigger.endFrame( frame * kFrameSeconds );
+        }
+        double elapsed = seconds() - start;
+        printf( "cost         %.2f us per frame with a %zu-frame window\n", elapsed * 1e6 / frames, policy.windowFrames );
+        ok &= bench::expect( idle.state() == util::CaptureState::Exhausted, "no budget to leave the trigger exhausted" );
+    }
+
+    return bench::finish( ok );
+}
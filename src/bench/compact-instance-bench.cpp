@@ -0,0 +1,132 @@
+/*
+ * Times util::encodeCompactInstances() against the packed 96-byte build at
+ * 1K, 100K and 1M instances, decodes every compact record the way the
+ * shaders do and checks the round trip against the full-precision
+ * reference transforms. Exits with 1 if an error bound is exceeded.
+ *
+ * Usage: compact-instance-bench [count...]
+ */
+
+#include <common/InstanceTransforms.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    static constexpr int kRepeats = 5;
+
+    // Rotation matrix elements, relative to the scale: four snorm16 values
+    // are each off by at most 1 / 65534, and the matrix is quadratic in q.
+    static constexpr float kMaxRotationError = 2e-4f;
+    static constexpr float kMaxColorError = 0.5f / 255.0f + 1e-6f;
+
+    template< typename Fn >
+    double bestSeconds( Fn&& fn )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+        }
+        return best;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::vector< size_t > counts = { 1000, 100000, 1000000 };
+    if ( argc > 1 )
+    {
+        counts.clear();
+        for ( int i = 1; i < argc; ++i )
+        {
+            counts.push_back( (size_t)atoll( argv[ i ] ) );
+        }
+    }
+
+    bool ok = true;
+    printf( "%10s %12s %12s %14s %14s %12s\n", "instances", "packed ns", "compact ns", "position err", "rotation err", "color err" );
+    for ( size_t count : counts )
+    {
+        std::vector< float > arrays[ 10 ];
+        for ( int a = 0; a < 10; ++a )
+        {
+            arrays[ a ].resize( count );
+            for ( size_t i = 0; i < count; ++i )
+            {
+                float v = sinf( (float)( i * ( a + 3 ) ) );
+                arrays[ a ][ i ] = a < 3 ? v * 10.0f : a < 6 ? v * 7.0f : a < 7 ? 0.1f + v * v : v * 0.5f + 0.5f;
+            }
+        }
+
+        util::InstanceTransformInputs inputs;
+        inputs.pPositionX = arrays[ 0 ].data();
+        inputs.pPositionY = arrays[ 1 ].data();
+        inputs.pPositionZ = arrays[ 2 ].data();
+        inputs.pRotationX = arrays[ 3 ].data();
+        inputs.pRotationY = arrays[ 4 ].data();
+        inputs.pRotationZ = arrays[ 5 ].data();
+        inputs.pScaleX = arrays[ 6 ].data();
+        inputs.pScaleY = arrays[ 6 ].data();
+        inputs.pScaleZ = arrays[ 6 ].data();
+        inputs.pColorR = arrays[ 7 ].data();
+        inputs.pColorG = arrays[ 8 ].data();
+        inputs.pColorB = arrays[ 9 ].data();
+
+        std::vector< util::InstanceRecord > reference( count );
+        std::vector< util::PackedInstanceRecord > packed( count );
+        std::vector< util::CompactInstanceRecord > compact( count );
+
+        util::buildInstanceTransformsReference( inputs, 0, count, nullptr, reference.data() );
+        double packedSeconds = bestSeconds( [&]{
+            util::buildInstanceTransforms( inputs, 0, count, nullptr, packed.data() );
+        } );
+        double compactSeconds = bestSeconds( [&]{
+            util::encodeCompactInstances( inputs, 0, count, compact.data() );
+        } );
+
+        float positionError = 0.0f;
+        float rotationError = 0.0f;
+        float colorError = 0.0f;
+        for ( size_t i = 0; i < count; ++i )
+        {
+            util::InstanceRecord decoded;
+            util::decodeCompactInstance( compact[ i ], &decoded );
+            const util::InstanceRecord& r = reference[ i ];
+            float scale = arrays[ 6 ][ i ];
+            for ( int c = 0; c < 3; ++c )
+            {
+                for ( int row = 0; row < 3; ++row )
+                {
+                    rotationError = std::max( rotationError, fabsf( r.transform[ c * 4 + row ] - decoded.transform[ c * 4 + row ] ) / scale );
+                }
+                positionError = std::max( positionError, fabsf( r.transform[ 12 + c ] - decoded.transform[ 12 + c ] ) );
+            }
+            for ( int k = 0; k < 4; ++k )
+            {
+                colorError = std::max( colorError, fabsf( r.color[ k ] - decoded.color[ k ] ) );
+            }
+        }
+
+        printf( "%10zu %12.2f %12.2f %14.3g %14.3g %12.3g\n", count,
+                packedSeconds * 1e9 / count, compactSeconds * 1e9 / count,
+                positionError, rotationError, colorError );
+        ok = ok && positionError == 0.0f && rotationError <= kMaxRotationError && colorError <= kMaxColorError;
+    }
+
+    printf( "record size: %zu bytes compact, %zu packed, %zu full\n", sizeof( util::CompactInstanceRecord ),
+            sizeof( util::PackedInstanceRecord ), sizeof( util::InstanceRecord ) );
+    if ( !ok )
+    {
+        printf( "FAILED: round-trip error above bounds\n" );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Drives util::CompileScheduler with fake compile jobs that finish on
+ * their own threads after a configurable delay, shaped like a sample's
+ * startup (libraries, then functions, then pipeline states), and checks:
+ *
+ *   - order:    no job starts before all of its dependencies finished,
+ *               and independent jobs overlap,
+ *   - sync:     a job completing inside start() still releases its
+ *               dependents,
+ *   - failure:  a failed job marks everything depending on it skipped
+ *               without starting it, while other branches still run,
+ *   - critical: the reported critical path follows the slowest chain.
+ *
+ * Exits with 1 on any failed check.
+ *
+ * Usage: compile-scheduler-bench [unit-ms]
+ */
+
+#include <common/CompileScheduler.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using util::CompileScheduler;
+
+    // Hands out fake jobs and keeps their threads so they can be joined
+    // once the scheduler is done.
+    class FakeJobs
+    {
+        public:
+            static constexpr int kMaxJobs = 16;
+
+            explicit FakeJobs( double unitMs )
+            : _unitMs( unitMs )
+            {
+                for ( int i = 0; i < kMaxJobs; ++i )
+                {
+                    _starts[ i ] = -1;
+                    _ends[ i ] = -1;
+                }
+            }
+
+            ~FakeJobs()
+            {
+                for ( std::thread& thread : _threads )
+                {
+                    thread.join();
+                }
+            }
+
+            // Takes delay units to finish; zero completes inside start().
+            CompileScheduler::StartFunction job( int units, bool success = true )
+            {
+                int index = _count++;
+                assert( index < kMaxJobs );
+                return [this, index, units, success]( CompileScheduler::Completion done ){
+                    _starts[ index ] = _sequence.fetch_add( 1 );
+                    if ( units == 0 )
+                    {
+                        _ends[ index ] = _sequence.fetch_add( 1 );
+                        done( success );
+                        return;
+                    }
+                    std::lock_guard< std::mutex > lock( _mutex );
+                    _threads.emplace_back( [this, index, units, success, done](){
+                        std::this_thread::sleep_for( std::chrono::duration< double, std::milli >( units * _unitMs ) );
+                        _ends[ index ] = _sequence.fetch_add( 1 );
+                        done( success );
+                    } );
+                };
+            }
+
+            int started( size_t index ) const { return _starts[ index ]; }
+            int ended( size_t index ) const { return _ends[ index ]; }
+
+        private:
+            double _unitMs;
+            int _count = 0;
+            std::atomic< int > _sequence { 0 };
+            // Sequence numbers at which each job started and ended, or -1
+            std::atomic< int > _starts[ kMaxJobs ];
+            std::atomic< int > _ends[ kMaxJobs ];
+            std::mutex _mutex;
+            std::vector< std::thread > _threads;
+    };
+
+}
+
+int main( int argc, char* argv[] )
+{
+    double unitMs = argc > 1 ? std::max( 1.0, atof( argv[ 1 ] ) ) : 2.0;
+    bool ok = true;
+
+    {
+        // Declared first so the job threads are joined before it goes
+        CompileScheduler scheduler;
+        FakeJobs jobs( unitMs );
+        std::vector< std::vector< CompileScheduler::JobId > > dependencies;
+        auto add = [&]( const char* pName, int units, std::vector< CompileScheduler::JobId > deps ){
+            dependencies.push_back( deps );
+            return scheduler.add( pName, jobs.job( units ), deps );
+        };
+
+        CompileScheduler::JobId shapes = add( "library shapes", 10, {} );
+        CompileScheduler::JobId kernel = add( "library kernel", 3, {} );
+        CompileScheduler::JobId vertex = add( "function vertexMain", 2, { shapes } );
+        CompileScheduler::JobId fragment = add( "function fragmentMain", 5, { shapes } );
+        CompileScheduler::JobId mandelbrot = add( "function mandelbrot_set", 0, { kernel } );
+        CompileScheduler::JobId render = add( "render pipeline", 15, { vertex, fragment } );
+        CompileScheduler::JobId compute = add( "compute pipeline", 4, { mandelbrot } );
+        CompileScheduler::JobId depth = add( "depth stencil state", 0, {} );
+
+        scheduler.run();
+        bool succeeded = scheduler.wait();
+
+        const std::vector< CompileScheduler::JobTiming >& timings = scheduler.timings();
+        int early = 0;
+        for ( size_t id = 0; id < dependencies.size(); ++id )
+        {
+            for ( CompileScheduler::JobId dep : dependencies[ id ] )
+            {
+                early += jobs.started( id ) < jobs.ended( dep ) || timings[ id ].startMs < timings[ dep ].endMs;
+            }
+        }
+        printf( "order        %zu jobs, %d started early, %.1f ms wall, %.1f ms if serial\n", timings.size(), early,
+                scheduler.wallTimeMs(), scheduler.serialTimeMs() );
+        ok &= bench::expect( succeeded && early == 0, "every job after its dependencies" );
+        ok &= bench::expect( scheduler.wallTimeMs() < scheduler.serialTimeMs(), "independent jobs overlapping" );
+
+        bool released = timings[ mandelbrot ].success && timings[ compute ].success && timings[ depth ].success &&
+                        jobs.started( compute ) > jobs.ended( mandelbrot );
+        printf( "sync         compute pipeline %s after a synchronous function\n", released ? "ran" : "did not run" );
+        ok &= bench::expect( released, "synchronous completions releasing dependents" );
+
+        std::vector< CompileScheduler::JobId > path = scheduler.criticalPath();
+        printf( "critical     " );
+        for ( CompileScheduler::JobId id : path )
+        {
+            printf( "%s%s", id == path.front() ? "" : " -> ", timings[ id ].name.c_str() );
+        }
+        printf( "\n" );
+        ok &= bench::expect( path == std::vector< CompileScheduler::JobId >( { shapes, fragment, render } ),
+                             "shapes, the slower function and the render pipeline" );
+        ok &= bench::expect( timings[ render ].gatedBy == fragment && timings[ fragment ].gatedBy == shapes &&
+                             timings[ shapes ].gatedBy == CompileScheduler::kNoJob, "each job gated by its last dependency" );
+    }
+
+    {
+        // Declared first so the job threads are joined before it goes
+        CompileScheduler scheduler;
+        FakeJobs jobs( unitMs );
+        CompileScheduler::JobId broken = scheduler.add( "library broken", jobs.job( 2, false ) );
+        CompileScheduler::JobId function = scheduler.add( "function main", jobs.job( 1 ), { broken } );
+        CompileScheduler::JobId pipeline = scheduler.add( "render pipeline", jobs.job( 1 ), { function } );
+        CompileScheduler::JobId other = scheduler.add( "library other", jobs.job( 3 ) );
+        CompileScheduler::JobId otherPipeline = scheduler.add( "compute pipeline", jobs.job( 1 ), { other } );
+        CompileScheduler::JobId mixed = scheduler.add( "mixed pipeline", jobs.job( 1 ), { other, function } );
+
+        scheduler.run();
+        bool succeeded = scheduler.wait();
+
+        const std::vector< CompileScheduler::JobTiming >& timings = scheduler.timings();
+        int skipped = 0;
+        int started = 0;
+        for ( CompileScheduler::JobId id : { function, pipeline, mixed } )
+        {
+            skipped += timings[ id ].skipped && !timings[ id ].success;
+            started += jobs.started( id ) >= 0;
+        }
+        printf( "failure      %d of 3 dependents skipped, %d started\n", skipped, started );
+        ok &= bench::expect( !succeeded && !timings[ broken ].success && !timings[ broken ].skipped, "the failed job reported" );
+        ok &= bench::expect( skipped == 3 && started == 0, "dependents skipped without starting" );
+        ok &= bench::expect( timings[ other ].success && timings[ otherPipeline ].success, "the other branch compiled" );
+    }
+
+    return bench::finish( ok );
+}
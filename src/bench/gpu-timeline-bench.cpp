@@ -0,0 +1,329 @@
+/*
+ * Checks the Metal-free half of util::GpuProfiler with synthetic clocks:
+ *
+ *   - correlation: a GPU clock with its own offset, a 300 ppm drift and
+ *                  up to 3 us of latency on every sampleTimestamps() read
+ *                  is calibrated on the profiler's schedule, and each
+ *                  frame's pass times are mapped back to the CPU clock when
+ *                  its ring slot comes round; they must land within 5 us
+ *                  of where they really were,
+ *   - passes:      passes with an unwritten, error or reversed sample are
+ *                  left out of the trace,
+ *   - export:      the JSON parses, holds one "X" event per pass plus the
+ *                  track names, and escapes awkward pass names.
+ *
+ * Also reports the export throughput. Exits with 1 on any failed check.
+ *
+ * Usage: gpu-timeline-bench [frames]
+ */
+
+#include <common/ChromeTrace.hpp>
+#include <common/GpuTimeline.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    static constexpr uint64_t kFrameNs = 16666667;
+
+    // Frames in flight plus one, as the samples size the profiler's ring.
+    static constexpr int kRingSize = 4;
+
+    // The GPU counts its own ticks from its own epoch, slightly fast.
+    struct GpuClock
+    {
+        uint64_t cpuEpoch = 5000000000ull;
+        uint64_t gpuEpoch = 987654321987ull;
+        double ticksPerNs = 1.0003;
+
+        uint64_t ticks( uint64_t cpuNs ) const
+        {
+            return gpuEpoch + (uint64_t)llround( (double)( cpuNs - cpuEpoch ) * ticksPerNs );
+        }
+    };
+
+    // Just enough of a JSON reader to tell whether the export is valid.
+    struct JsonReader
+    {
+        const char* p;
+        const char* pEnd;
+
+        void skipSpace()
+        {
+            while ( p < pEnd && ( *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' ) )
+            {
+                ++p;
+            }
+        }
+
+        bool string()
+        {
+            if ( p >= pEnd || *p != '"' )
+            {
+                return false;
+            }
+            for ( ++p; p < pEnd && *p != '"'; ++p )
+            {
+                if ( (unsigned char)*p < 0x20 )
+                {
+                    return false;
+                }
+                if ( *p == '\\' )
+                {
+                    ++p;
+                    if ( p < pEnd && *p == 'u' )
+                    {
+                        for ( int i = 0; i < 4; ++i )
+                        {
+                            if ( ++p >= pEnd || !isxdigit( (unsigned char)*p ) )
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                    else if ( p >= pEnd || !strchr( "\"\\/bfnrt", *p ) )
+                    {
+                        return false;
+                    }
+                }
+            }
+            return p++ < pEnd;
+        }
+
+        bool number()
+        {
+            const char* pStart = p;
+            while ( p < pEnd && strchr( "-+.eE0123456789", *p ) )
+            {
+                ++p;
+            }
+            return p > pStart;
+        }
+
+        bool value()
+        {
+            skipSpace();
+            if ( p >= pEnd )
+            {
+                return false;
+            }
+            if ( *p == '"' )
+            {
+                return string();
+            }
+            if ( *p == '{' || *p == '[' )
+            {
+                char close = *p == '{' ? '}' : ']';
+                bool object = *p == '{';
+                ++p;
+                skipSpace();
+                if ( p < pEnd && *p == close )
+                {
+                    ++p;
+                    return true;
+                }
+                for ( ;; )
+                {
+                    skipSpace();
+                    if ( object )
+                    {
+                        if ( !string() )
+                        {
+                            return false;
+                        }
+                        skipSpace();
+                        if ( p >= pEnd || *p++ != ':' )
+                        {
+                            return false;
+                        }
+                    }
+                    if ( !value() )
+                    {
+                        return false;
+                    }
+                    skipSpace();
+                    if ( p < pEnd && *p == ',' )
+                    {
+                        ++p;
+                        continue;
+                    }
+                    return p < pEnd && *p++ == close;
+                }
+            }
+            return number();
+        }
+
+        bool document()
+        {
+            bool ok = value();
+            skipSpace();
+            return ok && p == pEnd;
+        }
+    };
+
+    size_t countOf( const std::string& s, const char* pNeedle )
+    {
+        size_t count = 0;
+        for ( size_t at = s.find( pNeedle ); at != std::string::npos; at = s.find( pNeedle, at + 1 ) )
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    int frames = argc > 1 ? std::max( kRingSize + 1, atoi( argv[ 1 ] ) ) : 3600;
+    bool ok = true;
+
+    // Correlation: every frame has a compute and a render pass whose true
+    // CPU-clock times are known; the GPU half of each calibration pair is
+    // read up to 3 us late, as a real sampleTimestamps() call can be.
+    {
+        std::mt19937 rng( 45 );
+        std::uniform_int_distribution< uint64_t > readLatency( 0, 3000 );
+        std::uniform_int_distribution< uint64_t > passNs( 500000, 4000000 );
+        GpuClock gpu;
+        util::ClockCorrelator clock;
+        util::ChromeTrace trace;
+        double worstNs = 0.0, sumNs = 0.0;
+        size_t mapped = 0;
+
+        std::vector< uint64_t > truth( 4 * frames );
+        std::vector< uint64_t > samples( 4 * frames );
+        util::GpuPassRange passes[ 2 ] = { { "compute", 0, 1 }, { "render", 2, 3 } };
+        for ( int frame = 0; frame < frames; ++frame )
+        {
+            uint64_t frameStart = gpu.cpuEpoch + 1000000000ull + (uint64_t)frame * kFrameNs;
+            if ( util::calibrationDue( frame ) )
+            {
+                clock.addSample( frameStart, gpu.ticks( frameStart + readLatency( rng ) ) );
+            }
+
+            // The GPU runs the frame a little later than the CPU encodes it.
+            uint64_t* pTruth = &truth[ 4 * frame ];
+            pTruth[ 0 ] = frameStart + 2000000;
+            pTruth[ 1 ] = pTruth[ 0 ] + passNs( rng );
+            pTruth[ 2 ] = pTruth[ 1 ] + 20000;
+            pTruth[ 3 ] = pTruth[ 2 ] + passNs( rng );
+            for ( int i = 0; i < 4; ++i )
+            {
+                samples[ 4 * frame + i ] = gpu.ticks( pTruth[ i ] );
+            }
+
+            // The profiler reads a frame's samples when its ring slot comes
+            // round again.
+            int resolved = frame - kRingSize;
+            if ( resolved < 0 )
+            {
+                continue;
+            }
+            size_t before = trace.eventCount();
+            util::appendGpuPasses( passes, 2, &samples[ 4 * resolved ], 4, clock, 1, &trace );
+            if ( trace.eventCount() != before + 2 )
+            {
+                printf( "frame %d: expected 2 events, got %zu\n", resolved, trace.eventCount() - before );
+                ok = false;
+                continue;
+            }
+            for ( int i = 0; i < 2; ++i )
+            {
+                const util::TraceEvent& e = trace.events()[ before + i ];
+                double beginError = fabs( (double)(int64_t)( e.startNs - truth[ 4 * resolved + 2 * i ] ) );
+                double endError = fabs( (double)(int64_t)( e.startNs + e.durationNs - truth[ 4 * resolved + 2 * i + 1 ] ) );
+                worstNs = std::max( worstNs, std::max( beginError, endError ) );
+                sumNs += beginError + endError;
+                mapped += 2;
+            }
+        }
+
+        printf( "correlation  %d frames, %zu pairs, %.6f ns/tick (true %.6f)\n", frames, clock.sampleCount(),
+                clock.nsPerTick(), 1.0 / gpu.ticksPerNs );
+        printf( "             mean error %.0f ns, worst %.0f ns\n", mapped ? sumNs / mapped : 0.0, worstNs );
+        if ( worstNs > 5000.0 )
+        {
+            printf( "             error above 5 us\n" );
+            ok = false;
+        }
+    }
+
+    // Passes: only the first has usable samples.
+    {
+        util::ClockCorrelator clock;
+        clock.addSample( 1000, 5000 );
+        clock.addSample( 2000, 6000 );
+        uint64_t samples[] = { 7000, 8000, 0, 9000, 9000, util::kCounterErrorValue, 9500, 9400 };
+        util::GpuPassRange passes[] = {
+            { "good", 0, 1 }, { "unwritten", 2, 3 }, { "error", 4, 5 }, { "reversed", 6, 7 }, { "out of range", 8, 9 } };
+        util::ChromeTrace trace;
+        size_t added = util::appendGpuPasses( passes, 5, samples, 8, clock, 1, &trace );
+        bool passOk = added == 1 && trace.eventCount() == 1 && trace.events()[ 0 ].name == "good" &&
+                      trace.events()[ 0 ].startNs == 3000 && trace.events()[ 0 ].durationNs == 1000;
+        printf( "passes       %zu of 5 kept\n", added );
+        if ( !passOk )
+        {
+            printf( "             expected only \"good\" at 3000 ns for 1000 ns\n" );
+            ok = false;
+        }
+    }
+
+    // Export: awkward names, and throughput on a long capture.
+    {
+        util::ChromeTrace trace;
+        trace.nameTrack( 0, "CPU" );
+        trace.nameTrack( 1, "GPU \"main\"" );
+        trace.add( "say \"hi\"", "cpu", 1000, 2000, 0 );
+        trace.add( "C:\\path\\to\\shader", "gpu", 1500, 1800, 1 );
+        trace.add( "tab\tnew\nline", "gpu", 1900, 1950, 1 );
+
+        std::string json;
+        trace.write( &json );
+        JsonReader reader{ json.data(), json.data() + json.size() };
+        bool exportOk = reader.document() && countOf( json, "\"ph\":\"X\"" ) == 3 && countOf( json, "\"ph\":\"M\"" ) == 2 &&
+                        json.find( "say \\\"hi\\\"" ) != std::string::npos &&
+                        json.find( "C:\\\\path" ) != std::string::npos &&
+                        json.find( "tab\\u0009new\\u000aline" ) != std::string::npos &&
+                        json.find( "\"ts\":0.000,\"dur\":1.000" ) != std::string::npos;
+        if ( !exportOk )
+        {
+            printf( "export       malformed JSON:\n%s", json.c_str() );
+            ok = false;
+        }
+
+        static constexpr size_t kEvents = 200000;
+        for ( size_t i = 0; i < kEvents; ++i )
+        {
+            trace.add( i & 1 ? "render" : "compute", i & 1 ? "gpu" : "cpu", i * 8333, i * 8333 + 4000, (uint32_t)( i & 1 ) );
+        }
+        double start = seconds();
+        trace.write( &json );
+        double elapsed = seconds() - start;
+        JsonReader large{ json.data(), json.data() + json.size() };
+        if ( !large.document() || countOf( json, "\"ph\":\"X\"" ) != kEvents + 3 )
+        {
+            printf( "export       large trace is malformed\n" );
+            ok = false;
+        }
+        printf( "export       %zu events, %.1f MB in %.1f ms, %.0f ns/event\n", trace.eventCount(), json.size() / 1e6,
+                elapsed * 1e3, elapsed * 1e9 / trace.eventCount() );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,191 @@
+/*
+ * Runs 08-compute's frame loop headless on any platform, with
+ * util::SoftwareTarget standing in for the Metal device: the Mandelbrot
+ * texture comes from the CPU kernel, each frame rebuilds the instance
+ * transforms as the sample does, and every cube is drawn as a
+ * depth-tested square at its projected centre, tinted by the texture.
+ * Checks:
+ *
+ *   - frames:        every frame is timed,
+ *   - coverage:      the last frame shows both cubes and clear colour,
+ *   - deterministic: a second run gives the same image.
+ *
+ * Writes the last frame as a PPM when given a path. Exits with 1 on any
+ * failed check.
+ *
+ * Usage: headless-bench [frames] [size] [image.ppm]
+ */
+
+#include <common/HeadlessRunner.hpp>
+#include <common/InstanceTransforms.hpp>
+#include <common/MandelbrotCpu.hpp>
+#include <common/Math.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    namespace math = util::math;
+
+    static constexpr size_t kInstanceRows = 10;
+    static constexpr size_t kNumInstances = kInstanceRows * kInstanceRows * kInstanceRows;
+    static constexpr float kInstanceScale = 0.2f;
+    static constexpr uint32_t kTextureSize = 128;
+
+    // The CPU side of 08-compute: fixed instance inputs, the Mandelbrot
+    // texture and the per-frame angle.
+    class StandInRenderer
+    {
+        public:
+            explicit StandInRenderer( util::SoftwareTarget* pTarget )
+            : _pTarget( pTarget )
+            , _records( kNumInstances )
+            , _angle( 0.f )
+            {
+                const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+                const float scl = kInstanceScale;
+                for ( std::vector< float >* pArray : { &_position[0], &_position[1], &_position[2], &_spin[0], &_spin[1],
+                                                       &_rotation[0], &_rotation[1], &_color[0], &_color[1], &_color[2] } )
+                {
+                    pArray->resize( kNumInstances );
+                }
+                for ( size_t i = 0; i < kNumInstances; ++i )
+                {
+                    size_t ix = i % kInstanceRows;
+                    size_t iy = ( i / kInstanceRows ) % kInstanceRows;
+                    size_t iz = i / ( kInstanceRows * kInstanceRows );
+                    _position[0][i] = objectPosition.x + ( (float)ix - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                    _position[1][i] = objectPosition.y + ( (float)iy - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                    _position[2][i] = objectPosition.z + ( (float)iz - (float)kInstanceRows / 2.f ) * ( 2.f * scl );
+                    _spin[0][i] = cosf( (float)iy );
+                    _spin[1][i] = sinf( (float)ix );
+                    float t = i / (float)kNumInstances;
+                    _color[0][i] = t;
+                    _color[1][i] = 1.0f - t;
+                    _color[2][i] = sinf( (float)M_PI * 2.0f * t );
+                }
+
+                std::vector< uint32_t > iterations( kTextureSize * kTextureSize );
+                util::mandelbrotImage( util::MandelbrotParams(), kTextureSize, kTextureSize, iterations.data(), nullptr,
+                                       util::bestMandelbrotPath() );
+                _texture.resize( iterations.size() * 4 );
+                util::mandelbrotColors( iterations.data(), iterations.size(), _texture.data() );
+            }
+
+            void draw()
+            {
+                _angle += 0.002f;
+                const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+                math::float4x4 fullObjectRot = math::makeTranslate( objectPosition ) * math::makeYRotate( -_angle ) *
+                                               math::makeXRotate( _angle * 0.5f ) *
+                                               math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
+                for ( size_t i = 0; i < kNumInstances; ++i )
+                {
+                    _rotation[0][i] = _angle * _spin[0][i];
+                    _rotation[1][i] = _angle * _spin[1][i];
+                }
+                util::InstanceTransformInputs inputs;
+                inputs.pPositionX = _position[0].data();
+                inputs.pPositionY = _position[1].data();
+                inputs.pPositionZ = _position[2].data();
+                inputs.pRotationY = _rotation[0].data();
+                inputs.pRotationZ = _rotation[1].data();
+                inputs.uniformScale = kInstanceScale;
+                inputs.pColorR = _color[0].data();
+                inputs.pColorG = _color[1].data();
+                inputs.pColorB = _color[2].data();
+                util::buildInstanceTransforms( inputs, 0, kNumInstances, reinterpret_cast< const float* >( &fullObjectRot ),
+                                               _records.data() );
+
+                _pTarget->clear( 0.1f, 0.1f, 0.1f, 1.0f, 1.0f );
+                math::float4x4 projection = math::makePerspective( 45.f * (float)M_PI / 180.f, 1.f, 0.03f, 500.0f );
+                float width = (float)_pTarget->width();
+                float height = (float)_pTarget->height();
+                for ( const util::InstanceRecord& r : _records )
+                {
+                    math::float4 clip = projection * math::float4{ r.transform[12], r.transform[13], r.transform[14], 1.f };
+                    if ( clip.w <= 0.f )
+                    {
+                        continue;
+                    }
+                    float x = ( clip.x / clip.w * 0.5f + 0.5f ) * width;
+                    float y = ( 0.5f - clip.y / clip.w * 0.5f ) * height;
+                    // Half the cube's edge, 0.5 * scale, projected
+                    float half = 0.5f * kInstanceScale * projection.columns[1].y / clip.w * 0.5f * height;
+
+                    // The texel at the middle of a face, as the shader would sample
+                    const uint8_t* pTexel = &_texture[ ( kTextureSize / 2 * kTextureSize + kTextureSize / 2 ) * 4 ];
+                    uint8_t rgba[4];
+                    for ( int c = 0; c < 3; ++c )
+                    {
+                        rgba[c] = (uint8_t)( std::min( std::max( r.color[c], 0.f ), 1.f ) * ( 64 + pTexel[c] * 3 / 4 ) );
+                    }
+                    rgba[3] = 255;
+                    _pTarget->fillRect( (int)( x - half ), (int)( y - half ), (int)( x + half ) + 1, (int)( y + half ) + 1,
+                                        clip.z / clip.w, rgba );
+                }
+            }
+
+        private:
+            util::SoftwareTarget* _pTarget;
+            std::vector< float > _position[3];
+            std::vector< float > _spin[2];
+            std::vector< float > _rotation[2];
+            std::vector< float > _color[3];
+            std::vector< uint8_t > _texture;
+            std::vector< util::InstanceRecord > _records;
+            float _angle;
+    };
+
+    void run( uint32_t frames, uint32_t size, util::Image* pImage, util::HeadlessStats* pStats )
+    {
+        util::SoftwareTarget target( size, size );
+        StandInRenderer renderer( &target );
+        util::runHeadlessFrames( frames, [&]( uint32_t ){ renderer.draw(); }, [](){}, pStats );
+        target.readback( pImage );
+    }
+
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t frames = argc > 1 ? (uint32_t)std::max( 1, atoi( argv[ 1 ] ) ) : 300;
+    uint32_t size = argc > 2 ? (uint32_t)std::max( 16, atoi( argv[ 2 ] ) ) : 512;
+    const char* pImagePath = argc > 3 ? argv[ 3 ] : nullptr;
+    bool ok = true;
+
+    util::Image image;
+    util::HeadlessStats stats;
+    run( frames, size, &image, &stats );
+    util::printHeadlessStats( "frames", stats );
+    ok &= bench::expect( stats.frames == frames && stats.frameNs.count == frames, "every frame timed" );
+
+    size_t background = 0;
+    for ( size_t i = 0; i < image.rgba.size(); i += 4 )
+    {
+        background += image.rgba[ i ] == 26 && image.rgba[ i + 1 ] == 26 && image.rgba[ i + 2 ] == 26;
+    }
+    size_t pixels = (size_t)size * size;
+    printf( "coverage     %.1f%% of %ux%u covered by cubes\n", 100.0 * ( pixels - background ) / pixels, size, size );
+    ok &= bench::expect( background > 0 && background < pixels, "cubes over a cleared background" );
+
+    util::Image again;
+    util::HeadlessStats againStats;
+    run( frames, size, &again, &againStats );
+    printf( "deterministic image %016llx, second run %016llx\n", (unsigned long long)image.hash(), (unsigned long long)again.hash() );
+    ok &= bench::expect( image.hash() == again.hash() && image.rgba == again.rgba, "identical images" );
+
+    if ( pImagePath )
+    {
+        ok &= bench::expect( image.writePpm( pImagePath ), "the image written" );
+        printf( "wrote        %s\n", pImagePath );
+    }
+
+    return bench::finish( ok );
+}
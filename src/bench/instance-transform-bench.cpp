@@ -0,0 +1,128 @@
+/*
+ * Compares util::buildInstanceTransforms() against the per-instance
+ * sinf/cosf and 4x4 multiply path the samples used, at 1K, 100K and 1M
+ * instances, for both the 128-byte and the packed 96-byte record layouts,
+ * and reports the largest difference from the reference.
+ *
+ * Usage: instance-transform-bench [count...]
+ */
+
+#include <common/InstanceTransforms.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    static constexpr int kRepeats = 5;
+
+    template< typename Fn >
+    double bestSeconds( Fn&& fn )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+        }
+        return best;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::vector< size_t > counts = { 1000, 100000, 1000000 };
+    if ( argc > 1 )
+    {
+        counts.clear();
+        for ( int i = 1; i < argc; ++i )
+        {
+            counts.push_back( (size_t)atoll( argv[ i ] ) );
+        }
+    }
+
+    // Parent transform as in the samples: a rotation about the object centre.
+    const float parent[ 16 ] = {
+        0.98f, 0.0f, -0.2f, 0.0f,
+        0.02f, 0.99f, 0.1f, 0.0f,
+        0.2f, -0.1f, 0.97f, 0.0f,
+        -2.0f, 1.0f, -10.0f, 1.0f,
+    };
+
+    printf( "%10s %14s %14s %9s %14s %12s\n", "instances", "reference ns", "batch ns", "speedup", "packed ns", "max error" );
+    for ( size_t count : counts )
+    {
+        std::vector< float > arrays[ 8 ];
+        for ( int a = 0; a < 8; ++a )
+        {
+            arrays[ a ].resize( count );
+            for ( size_t i = 0; i < count; ++i )
+            {
+                arrays[ a ][ i ] = sinf( (float)( i * ( a + 3 ) ) ) * ( a < 3 ? 10.0f : 3.0f );
+            }
+        }
+
+        util::InstanceTransformInputs inputs;
+        inputs.pPositionX = arrays[ 0 ].data();
+        inputs.pPositionY = arrays[ 1 ].data();
+        inputs.pPositionZ = arrays[ 2 ].data();
+        inputs.pRotationY = arrays[ 3 ].data();
+        inputs.pRotationZ = arrays[ 4 ].data();
+        inputs.uniformScale = 0.2f;
+        inputs.pColorR = arrays[ 5 ].data();
+        inputs.pColorG = arrays[ 6 ].data();
+        inputs.pColorB = arrays[ 7 ].data();
+
+        std::vector< util::InstanceRecord > reference( count );
+        std::vector< util::InstanceRecord > batch( count );
+        std::vector< util::PackedInstanceRecord > packed( count );
+
+        double referenceSeconds = bestSeconds( [&]{
+            util::buildInstanceTransformsReference( inputs, 0, count, parent, reference.data() );
+        } );
+        double batchSeconds = bestSeconds( [&]{
+            util::buildInstanceTransforms( inputs, 0, count, parent, batch.data() );
+        } );
+        double packedSeconds = bestSeconds( [&]{
+            util::buildInstanceTransforms( inputs, 0, count, parent, packed.data() );
+        } );
+
+        float maxError = 0.0f;
+        for ( size_t i = 0; i < count; ++i )
+        {
+            const float* a = reinterpret_cast< const float* >( &reference[ i ] );
+            const float* b = reinterpret_cast< const float* >( &batch[ i ] );
+            for ( size_t k = 0; k < sizeof( util::InstanceRecord ) / sizeof( float ); ++k )
+            {
+                maxError = std::max( maxError, fabsf( a[ k ] - b[ k ] ) );
+            }
+
+            // Packed columns are the first three rows of the full ones.
+            const util::InstanceRecord& r = reference[ i ];
+            const util::PackedInstanceRecord& p = packed[ i ];
+            for ( int row = 0; row < 3; ++row )
+            {
+                for ( int c = 0; c < 4; ++c )
+                {
+                    maxError = std::max( maxError, fabsf( r.transform[ c * 4 + row ] - p.transform[ c * 3 + row ] ) );
+                }
+                for ( int c = 0; c < 3; ++c )
+                {
+                    maxError = std::max( maxError, fabsf( r.normalTransform[ c * 4 + row ] - p.normalTransform[ c * 3 + row ] ) );
+                }
+                maxError = std::max( maxError, fabsf( r.color[ row ] - p.color[ row ] ) );
+            }
+        }
+
+        printf( "%10zu %14.2f %14.2f %9.2f %14.2f %12.3g\n", count,
+                referenceSeconds * 1e9 / count, batchSeconds * 1e9 / count,
+                referenceSeconds / batchSeconds, packedSeconds * 1e9 / count, maxError );
+    }
+
+    return 0;
+}
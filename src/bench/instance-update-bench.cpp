@@ -0,0 +1,133 @@
+/*
+ * Measures util::ParallelInstanceUpdater scaling from 1 to N threads on the
+ * 08-compute instance update (per-instance angles + batch transform build),
+ * at the sample's 1K instances and at 500K. Every run's output is compared
+ * with the single-thread result, which must match bit for bit.
+ *
+ * Usage: instance-update-bench [maxThreads] [count...]
+ */
+
+#include <common/InstanceTransforms.hpp>
+#include <common/ParallelInstanceUpdater.hpp>
+#include <common/WorkStealingPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    static constexpr int kRepeats = 5;
+
+    struct Scene
+    {
+        std::vector< float > position[ 3 ];
+        std::vector< float > spin[ 2 ];
+        std::vector< float > rotation[ 2 ];
+        std::vector< float > color[ 3 ];
+
+        explicit Scene( size_t count )
+        {
+            for ( std::vector< float >* pArray : { &position[ 0 ], &position[ 1 ], &position[ 2 ], &spin[ 0 ], &spin[ 1 ],
+                                                   &rotation[ 0 ], &rotation[ 1 ], &color[ 0 ], &color[ 1 ], &color[ 2 ] } )
+            {
+                pArray->resize( count );
+            }
+            for ( size_t i = 0; i < count; ++i )
+            {
+                position[ 0 ][ i ] = (float)( i % 10 ) * 0.4f;
+                position[ 1 ][ i ] = (float)( ( i / 10 ) % 10 ) * 0.4f;
+                position[ 2 ][ i ] = (float)( i / 100 ) * 0.4f - 10.0f;
+                spin[ 0 ][ i ] = cosf( (float)( ( i / 10 ) % 10 ) );
+                spin[ 1 ][ i ] = sinf( (float)( i % 10 ) );
+                color[ 0 ][ i ] = i / (float)count;
+                color[ 1 ][ i ] = 1.0f - color[ 0 ][ i ];
+                color[ 2 ][ i ] = sinf( 6.2831853f * color[ 0 ][ i ] );
+            }
+        }
+
+        void update( util::ParallelInstanceUpdater& updater, float angle, util::InstanceRecord* pOut )
+        {
+            util::InstanceTransformInputs inputs;
+            inputs.pPositionX = position[ 0 ].data();
+            inputs.pPositionY = position[ 1 ].data();
+            inputs.pPositionZ = position[ 2 ].data();
+            inputs.pRotationY = rotation[ 0 ].data();
+            inputs.pRotationZ = rotation[ 1 ].data();
+            inputs.uniformScale = 0.2f;
+            inputs.pColorR = color[ 0 ].data();
+            inputs.pColorG = color[ 1 ].data();
+            inputs.pColorB = color[ 2 ].data();
+
+            updater.update( position[ 0 ].size(), [&]( size_t first, size_t count, unsigned ){
+                for ( size_t i = first; i < first + count; ++i )
+                {
+                    rotation[ 0 ][ i ] = angle * spin[ 0 ][ i ];
+                    rotation[ 1 ][ i ] = angle * spin[ 1 ][ i ];
+                }
+                util::buildInstanceTransforms( inputs, first, count, nullptr, pOut );
+                return true;
+            });
+        }
+    };
+}
+
+int main( int argc, char* argv[] )
+{
+    unsigned maxThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector< size_t > counts = { 1000, 500000 };
+    if ( argc > 1 )
+    {
+        maxThreads = std::max( 1, atoi( argv[ 1 ] ) );
+    }
+    if ( argc > 2 )
+    {
+        counts.clear();
+        for ( int i = 2; i < argc; ++i )
+        {
+            counts.push_back( (size_t)atoll( argv[ i ] ) );
+        }
+    }
+
+    bool allMatch = true;
+    printf( "%10s %8s %7s %12s %9s %8s %7s\n", "instances", "threads", "chunks", "ms/update", "speedup", "steals", "match" );
+    for ( size_t count : counts )
+    {
+        Scene scene( count );
+        std::vector< util::InstanceRecord > expected( count );
+        std::vector< util::InstanceRecord > records( count );
+        double singleThreadSeconds = 0.0;
+
+        for ( unsigned threads = 1; threads <= maxThreads; ++threads )
+        {
+            util::WorkStealingPool pool( threads );
+            util::ParallelInstanceUpdater updater( &pool, sizeof( util::InstanceRecord ) );
+
+            double best = 1e30;
+            for ( int r = 0; r < kRepeats; ++r )
+            {
+                auto start = std::chrono::steady_clock::now();
+                scene.update( updater, 1.25f, records.data() );
+                best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+            }
+
+            if ( threads == 1 )
+            {
+                singleThreadSeconds = best;
+                expected = records;
+            }
+            bool match = memcmp( expected.data(), records.data(), count * sizeof( util::InstanceRecord ) ) == 0;
+            allMatch = allMatch && match;
+
+            printf( "%10zu %8u %7zu %12.3f %9.2f %8llu %7s\n", count, threads, updater.chunkCount( count ), best * 1e3,
+                    singleThreadSeconds / best, (unsigned long long)pool.steals(), match ? "yes" : "NO" );
+        }
+    }
+
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * Checks util::LatencyHistogram and util::CommandBufferStats on any
+ * platform:
+ *
+ *   - buckets:     every bucket's value range joins the next, and a value
+ *                  lands in the bucket whose range holds it,
+ *   - percentiles: against a full sort of log-normal latencies, every
+ *                  percentile is within 1/32 above the exact value,
+ *   - concurrent:  four threads recording at once lose no counts or sums,
+ *   - reset:       a resetting snapshot empties the histogram,
+ *   - stats:       command buffer times convert to ns, a start before
+ *                  submission counts as no delay, and errors are counted
+ *                  by code.
+ *
+ * Also reports the cost of record(). Exits with 1 on any failed check.
+ *
+ * Usage: latency-histogram-bench [values]
+ */
+
+#include <common/CommandBufferStats.hpp>
+#include <common/LatencyHistogram.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t values = argc > 1 ? std::max( 10000, atoi( argv[ 1 ] ) ) : 1000000;
+    bool ok = true;
+    std::mt19937_64 rng( 48 );
+
+    {
+        using H = util::LatencyHistogram;
+        int gaps = 0;
+        int misplaced = 0;
+        for ( size_t b = 0; b + 1 < H::kBucketCount; ++b )
+        {
+            gaps += H::highestValue( b ) + 1 != H::lowestValue( b + 1 );
+            misplaced += H::bucketOf( H::lowestValue( b ) ) != b || H::bucketOf( H::highestValue( b ) ) != b;
+        }
+        std::uniform_int_distribution< int > bits( 0, 63 );
+        for ( int i = 0; i < 100000; ++i )
+        {
+            uint64_t v = rng() >> bits( rng );
+            size_t b = H::bucketOf( v );
+            misplaced += b >= H::kBucketCount || v < H::lowestValue( b ) || v > H::highestValue( b );
+        }
+        printf( "buckets      %zu buckets, %d gaps, %d misplaced values, last holds %llu\n", H::kBucketCount, gaps, misplaced,
+                (unsigned long long)H::lowestValue( H::bucketOf( UINT64_MAX ) ) );
+        ok &= bench::expect( gaps == 0 && misplaced == 0 && H::bucketOf( UINT64_MAX ) == H::kBucketCount - 1,
+                             "contiguous buckets covering every value" );
+    }
+
+    {
+        // GPU times around 2 ms with a long tail
+        std::lognormal_distribution< double > latency( std::log( 2e6 ), 0.6 );
+        util::LatencyHistogram histogram;
+        std::vector< uint64_t > all( values );
+        for ( uint64_t& v : all )
+        {
+            v = (uint64_t)latency( rng );
+            histogram.record( v );
+        }
+        util::HistogramSnapshot snapshot;
+        histogram.snapshot( &snapshot );
+        std::sort( all.begin(), all.end() );
+
+        double worst = 0.0;
+        bool below = false;
+        for ( double q : { 0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0 } )
+        {
+            size_t rank = (size_t)std::ceil( q * all.size() );
+            uint64_t exact = all[ rank > 0 ? rank - 1 : 0 ];
+            uint64_t estimate = snapshot.percentile( q );
+            below |= estimate < exact;
+            worst = std::max( worst, (double)( estimate - exact ) / exact );
+        }
+        uint64_t sum = 0;
+        for ( uint64_t v : all )
+        {
+            sum += v;
+        }
+        printf( "percentiles  p50 %.3f ms, p99 %.3f ms, worst error %.3f%%\n", snapshot.percentile( 0.5 ) * 1e-6,
+                snapshot.percentile( 0.99 ) * 1e-6, worst * 100.0 );
+        ok &= bench::expect( !below && worst <= 1.0 / 32.0, "percentiles within 1/32 above the exact values" );
+        ok &= bench::expect( snapshot.count == values && snapshot.sum == sum && snapshot.min == all.front() && snapshot.max == all.back(),
+                             "exact count, sum, min and max" );
+    }
+
+    {
+        static constexpr int kThreads = 4;
+        util::LatencyHistogram histogram;
+        size_t perThread = values / kThreads;
+        std::vector< std::thread > threads;
+        double start = seconds();
+        for ( int t = 0; t < kThreads; ++t )
+        {
+            threads.emplace_back( [&histogram, perThread, t](){
+                for ( size_t i = 0; i < perThread; ++i )
+                {
+                    histogram.record( 1000 * ( t + 1 ) + i % 7 );
+                }
+            } );
+        }
+        for ( std::thread& thread : threads )
+        {
+            thread.join();
+        }
+        double elapsed = seconds() - start;
+
+        util::HistogramSnapshot snapshot;
+        histogram.snapshot( &snapshot );
+        uint64_t sum = 0;
+        for ( int t = 0; t < kThreads; ++t )
+        {
+            for ( size_t i = 0; i < perThread; ++i )
+            {
+                sum += 1000 * ( t + 1 ) + i % 7;
+            }
+        }
+        printf( "concurrent   %llu values from %d threads, %.1f ns per record\n", (unsigned long long)snapshot.count, kThreads,
+                elapsed * 1e9 / perThread );
+        ok &= bench::expect( snapshot.count == perThread * kThreads && snapshot.sum == sum && snapshot.min == 1000 &&
+                             snapshot.max == 1000 * kThreads + 6, "no lost records" );
+
+        histogram.snapshot( &snapshot, true );
+        util::HistogramSnapshot empty;
+        histogram.snapshot( &empty );
+        histogram.record( 5 );
+        util::HistogramSnapshot after;
+        histogram.snapshot( &after );
+        printf( "reset        %llu after reset, then min %llu max %llu\n", (unsigned long long)empty.count,
+                (unsigned long long)after.min, (unsigned long long)after.max );
+        ok &= bench::expect( snapshot.count == perThread * kThreads && empty.count == 0 && empty.sum == 0 &&
+                             empty.percentile( 0.5 ) == 0, "an empty histogram after a reset" );
+        ok &= bench::expect( after.count == 1 && after.min == 5 && after.max == 5, "min and max restarted by the reset" );
+    }
+
+    {
+        util::LatencyHistogram single;
+        double start = seconds();
+        for ( size_t i = 0; i < values; ++i )
+        {
+            single.record( ( i * 2654435761u ) & 0xffffff );
+        }
+        double elapsed = seconds() - start;
+        util::HistogramSnapshot snapshot;
+        single.snapshot( &snapshot );
+        printf( "record       %.1f ns per value on one thread\n", elapsed * 1e9 / values );
+        ok &= bench::expect( snapshot.count == values, "every value recorded" );
+    }
+
+    {
+        util::CommandBufferStats stats;
+        // Submitted at 10 s, started 150 us later and ran for 2 ms
+        stats.recordCompleted( 10.0, 10.00015, 10.00215 );
+        // GPUStartTime slightly before kernelStartTime
+        stats.recordCompleted( 20.0, 19.99999, 20.001 );
+        stats.recordFailed( 2 );
+        stats.recordFailed( 2 );
+        stats.recordFailed( 11 );
+        stats.recordFailed( 1000 );
+
+        util::CommandBufferStatsSnapshot snapshot;
+        stats.snapshot( &snapshot, true );
+        util::CommandBufferStatsSnapshot empty;
+        stats.snapshot( &empty );
+        int last = util::CommandBufferStatsSnapshot::kErrorCodes - 1;
+        printf( "stats        %llu completed, %llu failed, queue max %.1f us, gpu max %.1f us\n",
+                (unsigned long long)snapshot.completed, (unsigned long long)snapshot.failed, snapshot.queueDelay.max * 1e-3,
+                snapshot.gpuTime.max * 1e-3 );
+        ok &= bench::expect( snapshot.completed == 2 && snapshot.queueDelay.min == 0 &&
+                             std::llabs( (long long)snapshot.queueDelay.max - 150000 ) <= 1000, "a clamped and a 150 us delay" );
+        ok &= bench::expect( std::llabs( (long long)snapshot.gpuTime.max - 2000000 ) <= 1000, "a 2 ms GPU time" );
+        ok &= bench::expect( snapshot.failed == 4 && snapshot.errors[ 2 ] == 2 && snapshot.errors[ 11 ] == 1 && snapshot.errors[ last ] == 1,
+                             "errors counted by code" );
+        ok &= bench::expect( empty.completed == 0 && empty.failed == 0, "no buffers after a reset" );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,134 @@
+/*
+ * Measures the CPU mandelbrot_set implementation against its scalar
+ * baseline across SIMD paths and thread counts, and checks that every path
+ * produces the same iteration counts.
+ *
+ * Usage: mandelbrot-bench [width height [maxIterations]] [--golden out.pgm]
+ *
+ * --golden writes the image as a binary PGM, for headless reference images.
+ */
+
+#include <common/MandelbrotCpu.hpp>
+#include <common/WorkStealingPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    static constexpr int kRepeats = 3;
+
+    double bestSeconds( const util::MandelbrotParams& params, uint32_t width, uint32_t height,
+                        uint32_t* pIterations, util::WorkStealingPool* pPool, util::MandelbrotPath path )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            util::mandelbrotImage( params, width, height, pIterations, pPool, path );
+            double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+            best = std::min( best, seconds );
+        }
+        return best;
+    }
+
+    bool writeGolden( const char* pPath, const std::vector< uint32_t >& iterations, uint32_t width, uint32_t height )
+    {
+        std::vector< uint8_t > rgba( iterations.size() * 4 );
+        util::mandelbrotColors( iterations.data(), iterations.size(), rgba.data() );
+
+        FILE* pFile = fopen( pPath, "wb" );
+        if ( !pFile )
+        {
+            return false;
+        }
+        fprintf( pFile, "P5\n%u %u\n255\n", width, height );
+        for ( size_t i = 0; i < iterations.size(); ++i )
+        {
+            fputc( rgba[ 4 * i ], pFile );
+        }
+        fclose( pFile );
+        return true;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t width = 1024;
+    uint32_t height = 1024;
+    util::MandelbrotParams params;
+    const char* pGoldenPath = nullptr;
+
+    std::vector< const char* > positional;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[ i ], "--golden" ) == 0 && i + 1 < argc )
+        {
+            pGoldenPath = argv[ ++i ];
+        }
+        else
+        {
+            positional.push_back( argv[ i ] );
+        }
+    }
+    if ( positional.size() >= 2 )
+    {
+        width = (uint32_t)atoi( positional[ 0 ] );
+        height = (uint32_t)atoi( positional[ 1 ] );
+    }
+    if ( positional.size() >= 3 )
+    {
+        params.maxIterations = (uint32_t)atoi( positional[ 2 ] );
+    }
+
+    size_t pixels = (size_t)width * height;
+    std::vector< uint32_t > reference( pixels );
+    std::vector< uint32_t > iterations( pixels );
+
+    double scalarSeconds = bestSeconds( params, width, height, reference.data(), nullptr, util::MandelbrotPath::Scalar );
+    double scalarRate = pixels / scalarSeconds * 1e-6;
+    printf( "%ux%u, %u iterations\n", width, height, params.maxIterations );
+    printf( "%-8s %7s %12s %9s %8s\n", "path", "threads", "Mpixels/s", "speedup", "match" );
+    printf( "%-8s %7u %12.2f %9.2f %8s\n", "scalar", 1u, scalarRate, 1.0, "ref" );
+
+    unsigned hardwareThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector< unsigned > threadCounts;
+    for ( unsigned t = 1; t < hardwareThreads; t *= 2 )
+    {
+        threadCounts.push_back( t );
+    }
+    threadCounts.push_back( hardwareThreads );
+
+    bool allMatch = true;
+    for ( util::MandelbrotPath path : { util::MandelbrotPath::Scalar, util::MandelbrotPath::Neon,
+                                        util::MandelbrotPath::Avx2, util::MandelbrotPath::Avx512 } )
+    {
+        if ( !util::isMandelbrotPathSupported( path ) )
+        {
+            continue;
+        }
+
+        for ( unsigned threads : threadCounts )
+        {
+            util::WorkStealingPool pool( threads );
+            double seconds = bestSeconds( params, width, height, iterations.data(), &pool, path );
+            bool match = iterations == reference;
+            allMatch = allMatch && match;
+            printf( "%-8s %7u %12.2f %9.2f %8s\n", util::mandelbrotPathName( path ), threads,
+                    pixels / seconds * 1e-6, scalarSeconds / seconds, match ? "yes" : "NO" );
+        }
+    }
+
+    if ( pGoldenPath && !writeGolden( pGoldenPath, reference, width, height ) )
+    {
+        fprintf( stderr, "Could not write %s\n", pGoldenPath );
+        return 1;
+    }
+
+    return allMatch ? 0 : 1;
+}
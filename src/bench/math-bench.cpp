@@ -0,0 +1,154 @@
+/*
+ * Times the util::math matrix routines on a batch of random affine
+ * transforms and checks them against straightforward scalar versions:
+ * products against a triple loop, inverse() and inverseAffine() by
+ * multiplying back to identity, and normalMatrix() against the transposed
+ * inverse. Exits nonzero if any result is off by more than a small
+ * tolerance.
+ *
+ * Usage: math-bench [count]
+ */
+
+#include <common/Math.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using util::math::float3;
+using util::math::float3x3;
+using util::math::float4;
+using util::math::float4x4;
+
+// Construction is usable in constant expressions.
+static_assert( util::math::makeTranslate( { 1.f, 2.f, 3.f } ).columns[ 3 ].y == 2.f, "makeTranslate" );
+static_assert( util::math::transpose( util::math::makeTranslate( { 1.f, 2.f, 3.f } ) ).columns[ 2 ].w == 3.f, "transpose" );
+static_assert( util::math::discardTranslation( util::math::makeScale( { 4.f, 5.f, 6.f } ) ).columns[ 1 ].y == 5.f, "discardTranslation" );
+
+namespace
+{
+    static constexpr int kRepeats = 5;
+    static constexpr float kTolerance = 1e-4f;
+
+    float element( const float4x4& m, int column, int row )
+    {
+        return reinterpret_cast< const float* >( &m.columns[ column ] )[ row ];
+    }
+
+    float4x4 multiplyReference( const float4x4& a, const float4x4& b )
+    {
+        float4x4 r = {};
+        float* out = reinterpret_cast< float* >( &r );
+        for ( int c = 0; c < 4; ++c )
+        {
+            for ( int row = 0; row < 4; ++row )
+            {
+                float sum = 0.0f;
+                for ( int k = 0; k < 4; ++k )
+                {
+                    sum += element( a, k, row ) * element( b, c, k );
+                }
+                out[ c * 4 + row ] = sum;
+            }
+        }
+        return r;
+    }
+
+    float maxDifference( const float4x4& a, const float4x4& b )
+    {
+        float d = 0.0f;
+        for ( int c = 0; c < 4; ++c )
+        {
+            for ( int row = 0; row < 4; ++row )
+            {
+                d = std::max( d, fabsf( element( a, c, row ) - element( b, c, row ) ) );
+            }
+        }
+        return d;
+    }
+
+    template< typename Fn >
+    double bestNanoseconds( size_t count, Fn&& fn )
+    {
+        double best = 1e30;
+        for ( int r = 0; r < kRepeats; ++r )
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min( best, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+        }
+        return best * 1e9 / count;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t count = argc > 1 ? (size_t)atoll( argv[ 1 ] ) : 100000;
+
+    // Random TRS transforms with non-uniform scale, like the samples build.
+    std::mt19937 rng( 1234 );
+    std::uniform_real_distribution< float > angle( -3.14159f, 3.14159f );
+    std::uniform_real_distribution< float > offset( -20.0f, 20.0f );
+    std::uniform_real_distribution< float > scale( 0.25f, 4.0f );
+    std::vector< float4x4 > a( count ), b( count ), out( count );
+    std::vector< float3x3 > normals( count );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        using namespace util::math;
+        a[ i ] = makeTranslate( { offset( rng ), offset( rng ), offset( rng ) } ) * makeXRotate( angle( rng ) )
+               * makeYRotate( angle( rng ) ) * makeScale( { scale( rng ), scale( rng ), scale( rng ) } );
+        b[ i ] = makeZRotate( angle( rng ) ) * makeTranslate( { offset( rng ), offset( rng ), offset( rng ) } );
+    }
+
+    const float4x4 identity = util::math::makeIdentity();
+    float productError = 0.0f;
+    float inverseError = 0.0f;
+    float affineError = 0.0f;
+    float normalError = 0.0f;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        productError = std::max( productError, maxDifference( a[ i ] * b[ i ], multiplyReference( a[ i ], b[ i ] ) ) );
+        inverseError = std::max( inverseError, maxDifference( a[ i ] * util::math::inverse( a[ i ] ), identity ) );
+        affineError = std::max( affineError, maxDifference( a[ i ] * util::math::inverseAffine( a[ i ] ), identity ) );
+
+        float4x4 expected = util::math::transpose( util::math::inverse( a[ i ] ) );
+        float3x3 n = util::math::normalMatrix( a[ i ] );
+        for ( int c = 0; c < 3; ++c )
+        {
+            const float3& v = n.columns[ c ];
+            normalError = std::max( { normalError, fabsf( v.x - element( expected, c, 0 ) ),
+                                      fabsf( v.y - element( expected, c, 1 ) ), fabsf( v.z - element( expected, c, 2 ) ) } );
+        }
+    }
+
+    printf( "%-22s %10s %12s\n", "operation", "ns/op", "max error" );
+    printf( "%-22s %10.2f %12s\n", "multiply (scalar)", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) out[ i ] = multiplyReference( a[ i ], b[ i ] );
+    } ), "-" );
+    printf( "%-22s %10.2f %12.3g\n", "multiply", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) out[ i ] = a[ i ] * b[ i ];
+    } ), productError );
+    printf( "%-22s %10.2f %12.3g\n", "inverse", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) out[ i ] = util::math::inverse( a[ i ] );
+    } ), inverseError );
+    printf( "%-22s %10.2f %12.3g\n", "inverseAffine", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) out[ i ] = util::math::inverseAffine( a[ i ] );
+    } ), affineError );
+    printf( "%-22s %10.2f %12.3g\n", "normalMatrix", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) normals[ i ] = util::math::normalMatrix( a[ i ] );
+    } ), normalError );
+    printf( "%-22s %10.2f %12s\n", "inverse + transpose", bestNanoseconds( count, [&]{
+        for ( size_t i = 0; i < count; ++i ) out[ i ] = util::math::transpose( util::math::inverse( a[ i ] ) );
+    } ), "-" );
+
+    bool ok = productError <= kTolerance && inverseError <= kTolerance && affineError <= kTolerance && normalError <= kTolerance;
+    if ( !ok )
+    {
+        printf( "error exceeds %g\n", kTolerance );
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,906 @@
+/*
+ * Measures the CPU work of one frame of every learn-metal sample, with the
+ * GPU stubbed out so it runs on any platform. Each sample's draw() is
+ * reproduced against a stand-in command buffer and encoder that only
+ * count calls, and stand-in buffers backed by host memory, so a frame
+ * costs what the sample itself computes and writes: the instance update
+ * loop, the buffer writes and the encoder calls. The 07/08 texture
+ * generation runs as separate cases. Metal's own cost of each call is not
+ * included.
+ *
+ * For each case it reports the median time per frame over several batches,
+ * the encoder calls per frame and the bytes written to buffers. Instance
+ * counts and texture sizes are parameters; instanced samples default to
+ * their own count and to 10K and 100K instances, textures to 128 and 1024.
+ *
+ * Checks that each frame issues the sample's calls and writes every
+ * instance. Exits with 1 on any failed check.
+ *
+ * Usage: metal-cpp-bench [--filter=text] [--instances=n,...] [--texture=n,...] [--min-time=seconds]
+ */
+
+#include <common/InstanceTransforms.hpp>
+#include <common/MandelbrotCpu.hpp>
+#include <common/Math.hpp>
+#include <common/ParallelInstanceUpdater.hpp>
+#include <common/ResidencyTracker.hpp>
+#include <common/WorkStealingPool.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    namespace math = util::math;
+
+    static constexpr int kMaxFramesInFlight = 3;
+    static constexpr size_t kInstanceRows = 10;
+    static constexpr size_t kSetBytesLimit = 4096;
+
+    // What one frame asked of the stand-in device.
+    struct FrameCounts
+    {
+        uint32_t renderPasses = 0;
+        uint32_t computePasses = 0;
+        uint32_t pipelines = 0;
+        uint32_t states = 0;
+        uint32_t bufferBinds = 0;
+        uint32_t bytesBinds = 0;
+        uint32_t textureBinds = 0;
+        uint32_t residency = 0;
+        uint32_t draws = 0;
+        uint32_t dispatches = 0;
+        uint32_t presents = 0;
+        uint32_t commits = 0;
+        uint32_t modifiedRanges = 0;
+        uint64_t bytesWritten = 0;
+
+        uint32_t calls() const
+        {
+            return pipelines + states + bufferBinds + bytesBinds + textureBinds + residency + draws + dispatches;
+        }
+    };
+
+    // Host memory in place of a managed MTL::Buffer.
+    class StubBuffer
+    {
+        public:
+            StubBuffer( size_t length, FrameCounts* pCounts )
+            : _storage( ( length + 15 ) / 16 )
+            , _length( length )
+            , _pCounts( pCounts )
+            {
+            }
+
+            void* contents() { return _storage.data(); }
+            size_t length() const { return _length; }
+            void didModifyRange( size_t offset, size_t length )
+            {
+                (void)offset;
+                _pCounts->modifiedRanges += 1;
+                _pCounts->bytesWritten += length;
+            }
+
+        private:
+            std::vector< math::float4 > _storage;
+            size_t _length;
+            FrameCounts* _pCounts;
+    };
+
+    // Render and compute encoder in one; every call is counted and the
+    // bytes of setVertexBytes() are copied as the driver would.
+    class StubEncoder
+    {
+        public:
+            explicit StubEncoder( FrameCounts* pCounts ) : _pCounts( pCounts ) {}
+
+            void setRenderPipelineState( const void* ) { _pCounts->pipelines += 1; }
+            void setComputePipelineState( const void* ) { _pCounts->pipelines += 1; }
+            void setDepthStencilState( const void* ) { _pCounts->states += 1; }
+            void setCullMode( int ) { _pCounts->states += 1; }
+            void setFrontFacingWinding( int ) { _pCounts->states += 1; }
+            void setVertexBuffer( StubBuffer*, size_t, uint32_t ) { _pCounts->bufferBinds += 1; }
+            void setVertexBytes( const void* pData, size_t size, uint32_t )
+            {
+                memcpy( _bytes, pData, std::min( size, kSetBytesLimit ) );
+                _pCounts->bytesBinds += 1;
+            }
+            void setTexture( const void*, uint32_t ) { _pCounts->textureBinds += 1; }
+            void setFragmentTexture( const void*, uint32_t ) { _pCounts->textureBinds += 1; }
+            void useResources( void**, size_t, uint32_t ) { _pCounts->residency += 1; }
+            void drawPrimitives( uint32_t, uint32_t ) { _pCounts->draws += 1; }
+            void drawIndexedPrimitives( uint32_t, StubBuffer*, size_t ) { _pCounts->draws += 1; }
+            void dispatchThreads( uint32_t, uint32_t ) { _pCounts->dispatches += 1; }
+            void endEncoding() {}
+
+        private:
+            FrameCounts* _pCounts;
+            alignas( 16 ) uint8_t _bytes[ kSetBytesLimit ];
+    };
+
+    class StubCommandBuffer
+    {
+        public:
+            explicit StubCommandBuffer( FrameCounts* pCounts ) : _pCounts( pCounts ), _encoder( pCounts ) {}
+
+            StubEncoder* renderCommandEncoder() { _pCounts->renderPasses += 1; return &_encoder; }
+            StubEncoder* computeCommandEncoder() { _pCounts->computePasses += 1; return &_encoder; }
+            void presentDrawable() { _pCounts->presents += 1; }
+            void commit() { _pCounts->commits += 1; }
+
+        private:
+            FrameCounts* _pCounts;
+            StubEncoder _encoder;
+    };
+
+    // Stand-in objects only need distinct addresses.
+    static int sPipeline;
+    static int sComputePipeline;
+    static int sDepthState;
+    static int sTexture;
+
+    class SampleFrame
+    {
+        public:
+            explicit SampleFrame( size_t instances )
+            : _instances( instances )
+            , _frame( 0 )
+            , _angle( 0.f )
+            {
+            }
+            virtual ~SampleFrame() = default;
+
+            virtual void draw( StubCommandBuffer* pCmd ) = 0;
+
+            // Bytes of instance data each frame writes.
+            virtual size_t instanceBytes() const { return 0; }
+
+            FrameCounts counts;
+
+        protected:
+            StubBuffer* nextFrameBuffer()
+            {
+                _frame = ( _frame + 1 ) % kMaxFramesInFlight;
+                return _buffers[ _frame ].get();
+            }
+
+            void allocateFrameBuffers( size_t length )
+            {
+                for ( std::unique_ptr< StubBuffer >& pBuffer : _buffers )
+                {
+                    pBuffer.reset( new StubBuffer( length, &counts ) );
+                }
+            }
+
+            size_t _instances;
+            int _frame;
+            float _angle;
+            std::unique_ptr< StubBuffer > _buffers[ kMaxFramesInFlight ];
+    };
+
+    struct CameraData
+    {
+        math::float4x4 perspectiveTransform;
+        math::float4x4 worldTransform;
+        math::float3x3 worldNormalTransform;
+    };
+
+    math::float4x4 objectRotation( const math::float3& objectPosition, float angle, bool tilt )
+    {
+        math::float4x4 rt = math::makeTranslate( objectPosition );
+        math::float4x4 rr1 = math::makeYRotate( -angle );
+        math::float4x4 rtInv = math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
+        return tilt ? rt * rr1 * math::makeXRotate( angle * 0.5f ) * rtInv : rt * rr1 * rtInv;
+    }
+
+    // 00-window: a cleared pass.
+    class WindowFrame : public SampleFrame
+    {
+        public:
+            WindowFrame() : SampleFrame( 0 ) {}
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubEncoder* pEnc = pCmd->renderCommandEncoder();
+                pEnc->endEncoding();
+                pCmd->presentDrawable();
+                pCmd->commit();
+            }
+    };
+
+    // 01-primitive: one triangle from two vertex buffers.
+    class PrimitiveFrame : public SampleFrame
+    {
+        public:
+            PrimitiveFrame()
+            : SampleFrame( 0 )
+            , _positions( 3 * sizeof( math::float3 ), &counts )
+            , _colors( 3 * sizeof( math::float3 ), &counts )
+            {
+            }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubEncoder* pEnc = pCmd->renderCommandEncoder();
+                pEnc->setRenderPipelineState( &sPipeline );
+                pEnc->setVertexBuffer( &_positions, 0, 0 );
+                pEnc->setVertexBuffer( &_colors, 0, 1 );
+                pEnc->drawPrimitives( 0, 3 );
+                pEnc->endEncoding();
+                pCmd->presentDrawable();
+                pCmd->commit();
+            }
+
+        private:
+            StubBuffer _positions;
+            StubBuffer _colors;
+    };
+
+    // 02-argbuffers and 03-animation: an argument buffer whose resources go
+    // through the residency tracker, plus 03's per-frame angle.
+    class ArgumentBufferFrame : public SampleFrame
+    {
+        public:
+            explicit ArgumentBufferFrame( bool animate )
+            : SampleFrame( 0 )
+            , _argBuffer( 16, &counts )
+            , _positions( 3 * sizeof( math::float3 ), &counts )
+            , _colors( 3 * sizeof( math::float3 ), &counts )
+            , _animate( animate )
+            {
+                _residency.add( &_positions, nullptr, 1 );
+                _residency.add( &_colors, nullptr, 1 );
+            }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                // 03 passes FrameData inline through its UniformUploader
+                float angle = _animate ? ( _angle += 0.01f ) : 0.f;
+
+                StubEncoder* pEnc = pCmd->renderCommandEncoder();
+                pEnc->setRenderPipelineState( &sPipeline );
+                pEnc->setVertexBuffer( &_argBuffer, 0, 0 );
+                _residency.resolve( pEnc, 1,
+                    []( void* ){},
+                    [pEnc]( void** ppResources, size_t count, uint32_t usage ){ pEnc->useResources( ppResources, count, usage ); } );
+                if ( _animate )
+                {
+                    pEnc->setVertexBytes( &angle, sizeof( angle ), 1 );
+                }
+                pEnc->drawPrimitives( 0, 3 );
+                pEnc->endEncoding();
+                _residency.resetEncoder();
+                pCmd->presentDrawable();
+                pCmd->commit();
+            }
+
+        private:
+            StubBuffer _argBuffer;
+            StubBuffer _positions;
+            StubBuffer _colors;
+            util::ResidencyTracker _residency;
+            bool _animate;
+    };
+
+    // 04-instancing and 05-perspective: a row of instances with a full
+    // transform and colour each; 05 adds the camera and 3D rotations.
+    class RowInstancesFrame : public SampleFrame
+    {
+        public:
+            struct InstanceData
+            {
+                math::float4x4 instanceTransform;
+                math::float4 instanceColor;
+            };
+
+            RowInstancesFrame( size_t instances, bool perspective )
+            : SampleFrame( instances )
+            , _vertices( 4 * 32, &counts )
+            , _indices( 6 * sizeof( uint16_t ), &counts )
+            , _perspective( perspective )
+            {
+                allocateFrameBuffers( instances * sizeof( InstanceData ) );
+            }
+
+            size_t instanceBytes() const override { return _instances * sizeof( InstanceData ); }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubBuffer* pInstanceDataBuffer = nextFrameBuffer();
+                _angle += 0.01f;
+                const float scl = 0.1f;
+                InstanceData* pInstanceData = reinterpret_cast< InstanceData* >( pInstanceDataBuffer->contents() );
+                const math::float3 objectPosition = { 0.f, 0.f, -5.f };
+                math::float4x4 fullObjectRot = objectRotation( objectPosition, _angle, false );
+
+                for ( size_t i = 0; i < _instances; ++i )
+                {
+                    float iDivNumInstances = i / (float)_instances;
+                    float xoff = ( iDivNumInstances * 2.0f - 1.0f ) + ( 1.f / _instances );
+                    float yoff = sin( ( iDivNumInstances + _angle ) * 2.0f * M_PI );
+                    if ( _perspective )
+                    {
+                        math::float4x4 scale = math::makeScale( { scl, scl, scl } );
+                        math::float4x4 zrot = math::makeZRotate( _angle );
+                        math::float4x4 yrot = math::makeYRotate( _angle );
+                        math::float4x4 translate = math::makeTranslate( math::add( objectPosition, { xoff, yoff, 0.f } ) );
+                        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
+                    }
+                    else
+                    {
+                        pInstanceData[ i ].instanceTransform = { { { scl * sinf( _angle ), scl * cosf( _angle ), 0.f, 0.f },
+                                                                   { scl * cosf( _angle ), scl * -sinf( _angle ), 0.f, 0.f },
+                                                                   { 0.f, 0.f, scl, 0.f },
+                                                                   { xoff, yoff, 0.f, 1.f } } };
+                    }
+                    float r = iDivNumInstances;
+                    pInstanceData[ i ].instanceColor = { r, 1.0f - r, sinf( M_PI * 2.0f * iDivNumInstances ), 1.0f };
+                }
+                pInstanceDataBuffer->didModifyRange( 0, pInstanceDataBuffer->length() );
+
+                StubEncoder* pEnc = pCmd->renderCommandEncoder();
+                pEnc->setRenderPipelineState( &sPipeline );
+                if ( _perspective )
+                {
+                    CameraData cameraData;
+                    cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f );
+                    cameraData.worldTransform = math::makeIdentity();
+                    pEnc->setDepthStencilState( &sDepthState );
+                    pEnc->setVertexBuffer( &_vertices, 0, 0 );
+                    pEnc->setVertexBuffer( pInstanceDataBuffer, 0, 1 );
+                    pEnc->setVertexBytes( &cameraData, 2 * sizeof( math::float4x4 ), 2 );
+                    pEnc->setCullMode( 0 );
+                    pEnc->setFrontFacingWinding( 0 );
+                }
+                else
+                {
+                    pEnc->setVertexBuffer( &_vertices, 0, 0 );
+                    pEnc->setVertexBuffer( pInstanceDataBuffer, 0, 1 );
+                }
+                pEnc->drawIndexedPrimitives( _perspective ? 36 : 6, &_indices, _instances );
+                pEnc->endEncoding();
+                pCmd->presentDrawable();
+                pCmd->commit();
+            }
+
+        private:
+            StubBuffer _vertices;
+            StubBuffer _indices;
+            bool _perspective;
+    };
+
+    // Everything the cube-grid samples draw after updating instances.
+    void encodeCubes( StubCommandBuffer* pCmd, StubBuffer* pVertices, StubBuffer* pIndices, StubBuffer* pInstanceDataBuffer,
+                      size_t instances, const math::float4x4& worldTransform, bool textured )
+    {
+        CameraData cameraData;
+        cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f );
+        cameraData.worldTransform = worldTransform;
+        cameraData.worldNormalTransform = math::discardTranslation( cameraData.worldTransform );
+
+        StubEncoder* pEnc = pCmd->renderCommandEncoder();
+        pEnc->setRenderPipelineState( &sPipeline );
+        pEnc->setDepthStencilState( &sDepthState );
+        pEnc->setVertexBuffer( pVertices, 0, 0 );
+        pEnc->setVertexBuffer( pInstanceDataBuffer, 0, 1 );
+        pEnc->setVertexBytes( &cameraData, sizeof( cameraData ), 2 );
+        if ( textured )
+        {
+            pEnc->setFragmentTexture( &sTexture, 0 );
+        }
+        pEnc->setCullMode( 0 );
+        pEnc->setFrontFacingWinding( 0 );
+        pEnc->drawIndexedPrimitives( 36, pIndices, instances );
+        pEnc->endEncoding();
+        pCmd->presentDrawable();
+        pCmd->commit();
+    }
+
+    void encodeMandelbrot( StubCommandBuffer* pCmd, uint32_t textureSize )
+    {
+        StubEncoder* pEnc = pCmd->computeCommandEncoder();
+        pEnc->setComputePipelineState( &sComputePipeline );
+        pEnc->setTexture( &sTexture, 0 );
+        pEnc->dispatchThreads( textureSize * textureSize, 1024 );
+        pEnc->endEncoding();
+    }
+
+    // 06-lighting, 07-texturing and 10-frame-debugging: a grid of cubes
+    // rebuilt with full matrix products each frame; 07 and 10 bind the
+    // texture and 10 regenerates it with a compute pass.
+    class GridInstancesFrame : public SampleFrame
+    {
+        public:
+            struct InstanceData
+            {
+                math::float4x4 instanceTransform;
+                math::float3x3 instanceNormalTransform;
+                math::float4 instanceColor;
+            };
+
+            GridInstancesFrame( size_t instances, bool textured, bool compute )
+            : SampleFrame( instances )
+            , _vertices( 24 * 48, &counts )
+            , _indices( 36 * sizeof( uint16_t ), &counts )
+            , _textured( textured )
+            , _compute( compute )
+            {
+                allocateFrameBuffers( instances * sizeof( InstanceData ) );
+            }
+
+            size_t instanceBytes() const override { return _instances * sizeof( InstanceData ); }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubBuffer* pInstanceDataBuffer = nextFrameBuffer();
+                _angle += 0.002f;
+                const float scl = 0.2f;
+                InstanceData* pInstanceData = reinterpret_cast< InstanceData* >( pInstanceDataBuffer->contents() );
+                const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+                math::float4x4 fullObjectRot = objectRotation( objectPosition, _angle, true );
+
+                size_t ix = 0;
+                size_t iy = 0;
+                size_t iz = 0;
+                for ( size_t i = 0; i < _instances; ++i )
+                {
+                    if ( ix == kInstanceRows )
+                    {
+                        ix = 0;
+                        iy += 1;
+                    }
+                    if ( iy == kInstanceRows )
+                    {
+                        iy = 0;
+                        iz += 1;
+                    }
+                    math::float4x4 scale = math::makeScale( { scl, scl, scl } );
+                    math::float4x4 zrot = math::makeZRotate( _angle * sinf( (float)ix ) );
+                    math::float4x4 yrot = math::makeYRotate( _angle * cosf( (float)iy ) );
+                    float x = ( (float)ix - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                    float y = ( (float)iy - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                    float z = ( (float)iz - (float)kInstanceRows / 2.f ) * ( 2.f * scl );
+                    math::float4x4 translate = math::makeTranslate( math::add( objectPosition, { x, y, z } ) );
+                    pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
+                    pInstanceData[ i ].instanceNormalTransform = math::discardTranslation( pInstanceData[ i ].instanceTransform );
+                    float r = i / (float)_instances;
+                    pInstanceData[ i ].instanceColor = { r, 1.0f - r, sinf( M_PI * 2.0f * r ), 1.0f };
+                    ix += 1;
+                }
+                pInstanceDataBuffer->didModifyRange( 0, pInstanceDataBuffer->length() );
+
+                if ( _compute )
+                {
+                    encodeMandelbrot( pCmd, 128 );
+                }
+                encodeCubes( pCmd, &_vertices, &_indices, pInstanceDataBuffer, _instances, math::makeIdentity(), _textured );
+            }
+
+        private:
+            StubBuffer _vertices;
+            StubBuffer _indices;
+            bool _textured;
+            bool _compute;
+    };
+
+    // The structure-of-arrays inputs 08 and 09 keep for their instances.
+    struct InstanceArrays
+    {
+        std::vector< float > position[3];
+        std::vector< float > spin[2];
+        std::vector< float > rotation[2];
+        std::vector< float > color[3];
+
+        explicit InstanceArrays( size_t instances )
+        {
+            const float scl = 0.2f;
+            const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+            for ( std::vector< float >* pArray : { &position[0], &position[1], &position[2], &spin[0], &spin[1],
+                                                   &rotation[0], &rotation[1], &color[0], &color[1], &color[2] } )
+            {
+                pArray->resize( instances );
+            }
+            for ( size_t i = 0; i < instances; ++i )
+            {
+                size_t ix = i % kInstanceRows;
+                size_t iy = ( i / kInstanceRows ) % kInstanceRows;
+                size_t iz = i / ( kInstanceRows * kInstanceRows );
+                position[0][i] = objectPosition.x + ( (float)ix - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                position[1][i] = objectPosition.y + ( (float)iy - (float)kInstanceRows / 2.f ) * ( 2.f * scl ) + scl;
+                position[2][i] = objectPosition.z + ( (float)iz - (float)kInstanceRows / 2.f ) * ( 2.f * scl );
+                spin[0][i] = cosf( (float)iy );
+                spin[1][i] = sinf( (float)ix );
+                float t = i / (float)instances;
+                color[0][i] = t;
+                color[1][i] = 1.0f - t;
+                color[2][i] = sinf( M_PI * 2.0f * t );
+            }
+        }
+
+        util::InstanceTransformInputs inputs() const
+        {
+            util::InstanceTransformInputs in;
+            in.pPositionX = position[0].data();
+            in.pPositionY = position[1].data();
+            in.pPositionZ = position[2].data();
+            in.pRotationY = rotation[0].data();
+            in.pRotationZ = rotation[1].data();
+            in.uniformScale = 0.2f;
+            in.pColorR = color[0].data();
+            in.pColorG = color[1].data();
+            in.pColorB = color[2].data();
+            return in;
+        }
+    };
+
+    // 08-compute: packed instances built in parallel chunks, each chunk's
+    // dirty range flushed separately.
+    class ComputeFrame : public SampleFrame
+    {
+        public:
+            ComputeFrame( size_t instances, util::WorkStealingPool* pPool )
+            : SampleFrame( instances )
+            , _arrays( instances )
+            , _updater( pPool, sizeof( util::PackedInstanceRecord ) )
+            , _vertices( 24 * 48, &counts )
+            , _indices( 36 * sizeof( uint16_t ), &counts )
+            {
+                allocateFrameBuffers( instances * sizeof( util::PackedInstanceRecord ) );
+            }
+
+            size_t instanceBytes() const override { return _instances * sizeof( util::PackedInstanceRecord ); }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubBuffer* pInstanceDataBuffer = nextFrameBuffer();
+                _angle += 0.002f;
+                math::float4x4 fullObjectRot = objectRotation( { 0.f, 0.f, -10.f }, _angle, true );
+                util::InstanceTransformInputs inputs = _arrays.inputs();
+                util::PackedInstanceRecord* pInstanceData = reinterpret_cast< util::PackedInstanceRecord* >( pInstanceDataBuffer->contents() );
+                _updater.update( _instances, [&]( size_t first, size_t count, unsigned ){
+                    for ( size_t i = first; i < first + count; ++i )
+                    {
+                        _arrays.rotation[0][i] = _angle * _arrays.spin[0][i];
+                        _arrays.rotation[1][i] = _angle * _arrays.spin[1][i];
+                    }
+                    util::buildInstanceTransforms( inputs, first, count, reinterpret_cast< const float* >( &fullObjectRot ), pInstanceData );
+                    return true;
+                });
+                for ( const util::DirtyRange& range : _updater.dirtyRanges() )
+                {
+                    pInstanceDataBuffer->didModifyRange( range.offset, range.length );
+                }
+                encodeCubes( pCmd, &_vertices, &_indices, pInstanceDataBuffer, _instances, math::makeIdentity(), true );
+            }
+
+        private:
+            InstanceArrays _arrays;
+            util::ParallelInstanceUpdater _updater;
+            StubBuffer _vertices;
+            StubBuffer _indices;
+    };
+
+    // 09-compute-to-render: compact instances, the object rotation in the
+    // camera, and the texture regenerated by a compute pass every frame.
+    class ComputeToRenderFrame : public SampleFrame
+    {
+        public:
+            explicit ComputeToRenderFrame( size_t instances )
+            : SampleFrame( instances )
+            , _arrays( instances )
+            , _vertices( 24 * 48, &counts )
+            , _indices( 36 * sizeof( uint16_t ), &counts )
+            {
+                allocateFrameBuffers( instances * sizeof( util::CompactInstanceRecord ) );
+            }
+
+            size_t instanceBytes() const override { return _instances * sizeof( util::CompactInstanceRecord ); }
+
+            void draw( StubCommandBuffer* pCmd ) override
+            {
+                StubBuffer* pInstanceDataBuffer = nextFrameBuffer();
+                _angle += 0.002f;
+                math::float4x4 fullObjectRot = objectRotation( { 0.f, 0.f, -10.f }, _angle, true );
+                for ( size_t i = 0; i < _instances; ++i )
+                {
+                    _arrays.rotation[0][i] = _angle * _arrays.spin[0][i];
+                    _arrays.rotation[1][i] = _angle * _arrays.spin[1][i];
+                }
+                util::encodeCompactInstances( _arrays.inputs(), 0, _instances,
+                                              reinterpret_cast< util::CompactInstanceRecord* >( pInstanceDataBuffer->contents() ) );
+                pInstanceDataBuffer->didModifyRange( 0, _instances * sizeof( util::CompactInstanceRecord ) );
+
+                encodeMandelbrot( pCmd, 128 );
+                encodeCubes( pCmd, &_vertices, &_indices, pInstanceDataBuffer, _instances, fullObjectRot, true );
+            }
+
+        private:
+            InstanceArrays _arrays;
+            StubBuffer _vertices;
+            StubBuffer _indices;
+    };
+
+    // 07-texturing's buildTextures() at size x size.
+    class CheckerboardTexture : public SampleFrame
+    {
+        public:
+            explicit CheckerboardTexture( uint32_t size )
+            : SampleFrame( 0 )
+            , _size( size )
+            , _texels( (size_t)size * size * 4 )
+            {
+            }
+
+            void draw( StubCommandBuffer* ) override
+            {
+                uint8_t* pTextureData = _texels.data();
+                for ( size_t y = 0; y < _size; ++y )
+                {
+                    for ( size_t x = 0; x < _size; ++x )
+                    {
+                        bool isWhite = ( x ^ y ) & 0b1000000;
+                        uint8_t c = isWhite ? 0xFF : 0xA;
+                        size_t i = y * _size + x;
+                        pTextureData[ i * 4 + 0 ] = c;
+                        pTextureData[ i * 4 + 1 ] = c;
+                        pTextureData[ i * 4 + 2 ] = c;
+                        pTextureData[ i * 4 + 3 ] = 0xFF;
+                    }
+                }
+                // replaceRegion() copies the texels into the texture
+                counts.bytesWritten += _texels.size();
+            }
+
+            const std::vector< uint8_t >& texels() const { return _texels; }
+
+        private:
+            uint32_t _size;
+            std::vector< uint8_t > _texels;
+    };
+
+    // 08-compute's mandelbrot_set kernel on the CPU at size x size, the work
+    // the GPU takes off the CPU.
+    class MandelbrotTexture : public SampleFrame
+    {
+        public:
+            MandelbrotTexture( uint32_t size, util::WorkStealingPool* pPool )
+            : SampleFrame( 0 )
+            , _size( size )
+            , _pPool( pPool )
+            , _iterations( (size_t)size * size )
+            , _texels( (size_t)size * size * 4 )
+            {
+            }
+
+            void draw( StubCommandBuffer* ) override
+            {
+                util::mandelbrotImage( util::MandelbrotParams(), _size, _size, _iterations.data(), _pPool,
+                                       util::bestMandelbrotPath() );
+                util::mandelbrotColors( _iterations.data(), _iterations.size(), _texels.data() );
+                counts.bytesWritten += _texels.size();
+            }
+
+            const std::vector< uint8_t >& texels() const { return _texels; }
+
+        private:
+            uint32_t _size;
+            util::WorkStealingPool* _pPool;
+            std::vector< uint32_t > _iterations;
+            std::vector< uint8_t > _texels;
+    };
+
+    // The calls each sample must issue per frame, beside what it writes.
+    struct Expected
+    {
+        uint32_t renderPasses;
+        uint32_t computePasses;
+        uint32_t calls;
+    };
+
+    struct Case
+    {
+        std::string name;
+        std::string size;
+        std::unique_ptr< SampleFrame > pFrame;
+        Expected expected;
+    };
+
+    std::vector< size_t > parseList( const char* pText )
+    {
+        std::vector< size_t > values;
+        while ( *pText )
+        {
+            char* pEnd = nullptr;
+            unsigned long long v = strtoull( pText, &pEnd, 10 );
+            if ( pEnd == pText )
+            {
+                break;
+            }
+            if ( v > 0 )
+            {
+                values.push_back( (size_t)v );
+            }
+            pText = *pEnd == ',' ? pEnd + 1 : pEnd;
+        }
+        return values;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // Median seconds per frame over kBatches batches of at least
+    // minTime / kBatches each.
+    double timeFrames( SampleFrame* pFrame, double minTime, uint64_t* pFrames )
+    {
+        static constexpr int kBatches = 5;
+        StubCommandBuffer cmd( &pFrame->counts );
+
+        uint64_t perBatch = 1;
+        for ( ;; )
+        {
+            double start = seconds();
+            for ( uint64_t i = 0; i < perBatch; ++i )
+            {
+                pFrame->draw( &cmd );
+            }
+            if ( seconds() - start >= minTime / kBatches || perBatch >= ( 1ull << 30 ) )
+            {
+                break;
+            }
+            perBatch *= 2;
+        }
+
+        std::vector< double > batches;
+        for ( int b = 0; b < kBatches; ++b )
+        {
+            double start = seconds();
+            for ( uint64_t i = 0; i < perBatch; ++i )
+            {
+                pFrame->draw( &cmd );
+            }
+            batches.push_back( ( seconds() - start ) / perBatch );
+        }
+        std::sort( batches.begin(), batches.end() );
+        *pFrames = perBatch;
+        return batches[ kBatches / 2 ];
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string filter;
+    std::vector< size_t > instanceCounts;
+    std::vector< size_t > textureSizes = { 128, 1024 };
+    double minTime = 0.25;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strncmp( argv[ i ], "--filter=", 9 ) == 0 )
+        {
+            filter = argv[ i ] + 9;
+        }
+        else if ( strncmp( argv[ i ], "--instances=", 12 ) == 0 )
+        {
+            instanceCounts = parseList( argv[ i ] + 12 );
+        }
+        else if ( strncmp( argv[ i ], "--texture=", 10 ) == 0 )
+        {
+            textureSizes = parseList( argv[ i ] + 10 );
+        }
+        else if ( strncmp( argv[ i ], "--min-time=", 11 ) == 0 )
+        {
+            minTime = std::max( 0.001, atof( argv[ i ] + 11 ) );
+        }
+        else
+        {
+            printf( "Usage: metal-cpp-bench [--filter=text] [--instances=n,...] [--texture=n,...] [--min-time=seconds]\n" );
+            return 1;
+        }
+    }
+
+    util::WorkStealingPool pool;
+    std::vector< Case > cases;
+    auto add = [&]( const char* pName, std::string size, SampleFrame* pFrame, Expected expected ){
+        std::unique_ptr< SampleFrame > pOwned( pFrame );
+        if ( std::string( pName ).find( filter ) != std::string::npos )
+        {
+            cases.push_back( { pName, size, std::move( pOwned ), expected } );
+        }
+    };
+    // Each sample's own count comes first unless --instances replaces them
+    auto counts = [&]( size_t sampleCount ){
+        return instanceCounts.empty() ? std::vector< size_t >{ sampleCount, 10000, 100000 } : instanceCounts;
+    };
+
+    add( "00-window", "", new WindowFrame(), { 1, 0, 0 } );
+    add( "01-primitive", "", new PrimitiveFrame(), { 1, 0, 4 } );
+    add( "02-argbuffers", "", new ArgumentBufferFrame( false ), { 1, 0, 4 } );
+    add( "03-animation", "", new ArgumentBufferFrame( true ), { 1, 0, 5 } );
+    for ( size_t n : counts( 32 ) )
+    {
+        add( "04-instancing", std::to_string( n ) + " instances", new RowInstancesFrame( n, false ), { 1, 0, 4 } );
+    }
+    for ( size_t n : counts( 32 ) )
+    {
+        add( "05-perspective", std::to_string( n ) + " instances", new RowInstancesFrame( n, true ), { 1, 0, 8 } );
+    }
+    for ( size_t n : counts( 1000 ) )
+    {
+        add( "06-lighting", std::to_string( n ) + " instances", new GridInstancesFrame( n, false, false ), { 1, 0, 8 } );
+        add( "07-texturing", std::to_string( n ) + " instances", new GridInstancesFrame( n, true, false ), { 1, 0, 9 } );
+        add( "08-compute", std::to_string( n ) + " instances", new ComputeFrame( n, &pool ), { 1, 0, 9 } );
+        add( "09-compute-to-render", std::to_string( n ) + " instances", new ComputeToRenderFrame( n ), { 1, 1, 12 } );
+        add( "10-frame-debugging", std::to_string( n ) + " instances", new GridInstancesFrame( n, true, true ), { 1, 1, 12 } );
+    }
+    for ( size_t size : textureSizes )
+    {
+        std::string label = std::to_string( size ) + "x" + std::to_string( size ) + " texture";
+        add( "07-texturing/checkerboard", label, new CheckerboardTexture( (uint32_t)size ), { 0, 0, 0 } );
+        add( "08-compute/mandelbrot-cpu", label, new MandelbrotTexture( (uint32_t)size, &pool ), { 0, 0, 0 } );
+    }
+
+    bool ok = true;
+    printf( "%-26s %-18s %12s %10s %8s %12s\n", "sample", "size", "us/frame", "frames", "calls", "bytes" );
+    for ( Case& c : cases )
+    {
+        // One frame on its own to check the calls and writes
+        SampleFrame* pFrame = c.pFrame.get();
+        pFrame->counts = FrameCounts();
+        StubCommandBuffer cmd( &pFrame->counts );
+        pFrame->draw( &cmd );
+        FrameCounts one = pFrame->counts;
+
+        uint64_t frames = 0;
+        double perFrame = timeFrames( pFrame, minTime, &frames );
+        printf( "%-26s %-18s %12.3f %10llu %8u %12llu\n", c.name.c_str(), c.size.c_str(), perFrame * 1e6,
+                (unsigned long long)frames * 5, one.calls(), (unsigned long long)one.bytesWritten );
+
+        bool frameOk = one.renderPasses == c.expected.renderPasses && one.computePasses == c.expected.computePasses &&
+                       one.calls() == c.expected.calls &&
+                       one.presents == c.expected.renderPasses && one.commits == c.expected.renderPasses;
+        if ( pFrame->instanceBytes() )
+        {
+            frameOk = frameOk && one.bytesWritten == pFrame->instanceBytes();
+        }
+        if ( !frameOk )
+        {
+            printf( "             expected %u render and %u compute passes with %u calls, got %u, %u and %u\n",
+                    c.expected.renderPasses, c.expected.computePasses, c.expected.calls,
+                    one.renderPasses, one.computePasses, one.calls() );
+            ok = false;
+        }
+        if ( CheckerboardTexture* pTexture = dynamic_cast< CheckerboardTexture* >( pFrame ) )
+        {
+            // Squares are 64 texels wide: dark at the origin, white next to it
+            const std::vector< uint8_t >& t = pTexture->texels();
+            if ( t.size() > 64 * 4 && ( t[ 0 ] != 0xA || t[ 64 * 4 ] != 0xFF ) )
+            {
+                printf( "             expected a checkerboard\n" );
+                ok = false;
+            }
+        }
+        if ( MandelbrotTexture* pTexture = dynamic_cast< MandelbrotTexture* >( pFrame ) )
+        {
+            const std::vector< uint8_t >& t = pTexture->texels();
+            bool varied = std::any_of( t.begin(), t.end(), [&]( uint8_t v ){ return v != t.front(); } );
+            if ( !varied )
+            {
+                printf( "             expected a Mandelbrot image\n" );
+                ok = false;
+            }
+        }
+    }
+
+    return bench::finish( ok );
+}
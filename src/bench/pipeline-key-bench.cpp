@@ -0,0 +1,180 @@
+/*
+ * Checks the pipeline cache's content keys, util::RenderPipelineSummary
+ * and util::ComputePipelineSummary, on any platform:
+ *
+ *   - equal:   summaries filled in the same way get the same key,
+ *   - state:   every member that changes the compiled pipeline changes
+ *              the key, including which slot an attribute sits in,
+ *   - unused:  state Metal ignores (the rest of an attachment without a
+ *              format, blend factors with blending off, attributes and
+ *              layouts that are not set) leaves the key alone,
+ *   - compute: function and threadgroup limits change the key.
+ *
+ * Also reports the cost of a render pipeline key. Exits with 1 on any
+ * failed check.
+ *
+ * Usage: pipeline-key-bench [keys]
+ */
+
+#include <common/PipelineKey.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace
+{
+    using util::RenderPipelineSummary;
+
+    // Raw values of the MTL enums the samples use.
+    static constexpr uint32_t kBGRA8Unorm_sRGB = 81;
+    static constexpr uint32_t kDepth16Unorm = 250;
+    static constexpr uint32_t kColorWriteMaskAll = 15;
+    static constexpr uint32_t kBlendFactorSourceAlpha = 4;
+    static constexpr uint32_t kBlendFactorOneMinusSourceAlpha = 5;
+    static constexpr uint32_t kVertexFormatFloat3 = 30;
+    static constexpr uint32_t kVertexStepFunctionPerVertex = 1;
+
+    // 08-compute's cube pipeline
+    RenderPipelineSummary makeSummary()
+    {
+        RenderPipelineSummary s;
+        s.vertexFunction = util::PipelineKeyBuilder( 1 ).addString( "vertexMain" ).key();
+        s.fragmentFunction = util::PipelineKeyBuilder( 1 ).addString( "fragmentMain" ).key();
+        s.color[ 0 ].pixelFormat = kBGRA8Unorm_sRGB;
+        s.color[ 0 ].writeMask = kColorWriteMaskAll;
+        s.depthAttachmentPixelFormat = kDepth16Unorm;
+        s.hasVertexDescriptor = true;
+        s.attributes[ 0 ].format = kVertexFormatFloat3;
+        s.attributes[ 1 ].format = kVertexFormatFloat3;
+        s.attributes[ 1 ].offset = 16;
+        s.layouts[ 0 ].stride = 32;
+        s.layouts[ 0 ].stepFunction = kVertexStepFunctionPerVertex;
+        s.layouts[ 0 ].stepRate = 1;
+        return s;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t keys = argc > 1 ? std::max( 1000, atoi( argv[ 1 ] ) ) : 1000000;
+    bool ok = true;
+    uint64_t base = makeSummary().key();
+
+    {
+        printf( "equal        key %016llx\n", (unsigned long long)base );
+        ok &= bench::expect( makeSummary().key() == base, "equal summaries with equal keys" );
+    }
+
+    {
+        const std::vector< std::function< void( RenderPipelineSummary& ) > > changes = {
+            []( RenderPipelineSummary& s ){ s.vertexFunction += 1; },
+            []( RenderPipelineSummary& s ){ s.fragmentFunction += 1; },
+            []( RenderPipelineSummary& s ){ s.color[ 0 ].pixelFormat = 80; },
+            []( RenderPipelineSummary& s ){ s.color[ 0 ].writeMask = 0; },
+            []( RenderPipelineSummary& s ){ s.color[ 0 ].blendingEnabled = true; },
+            []( RenderPipelineSummary& s ){ s.color[ 1 ].pixelFormat = kBGRA8Unorm_sRGB; },
+            []( RenderPipelineSummary& s ){ s.depthAttachmentPixelFormat = 0; },
+            []( RenderPipelineSummary& s ){ s.stencilAttachmentPixelFormat = 253; },
+            []( RenderPipelineSummary& s ){ s.rasterSampleCount = 4; },
+            []( RenderPipelineSummary& s ){ s.alphaToCoverageEnabled = true; },
+            []( RenderPipelineSummary& s ){ s.alphaToOneEnabled = true; },
+            []( RenderPipelineSummary& s ){ s.rasterizationEnabled = false; },
+            []( RenderPipelineSummary& s ){ s.inputPrimitiveTopology = 3; },
+            []( RenderPipelineSummary& s ){ s.hasVertexDescriptor = false; },
+            []( RenderPipelineSummary& s ){ s.attributes[ 1 ].offset = 12; },
+            []( RenderPipelineSummary& s ){ s.attributes[ 1 ].bufferIndex = 1; },
+            []( RenderPipelineSummary& s ){ std::swap( s.attributes[ 1 ], s.attributes[ 2 ] ); },
+            []( RenderPipelineSummary& s ){ s.layouts[ 0 ].stride = 48; },
+            []( RenderPipelineSummary& s ){ s.layouts[ 0 ].stepFunction = 2; },
+            []( RenderPipelineSummary& s ){ std::swap( s.layouts[ 0 ], s.layouts[ 1 ] ); },
+        };
+        std::vector< uint64_t > seen = { base };
+        int unchanged = 0;
+        for ( const auto& change : changes )
+        {
+            RenderPipelineSummary s = makeSummary();
+            change( s );
+            uint64_t key = s.key();
+            unchanged += std::find( seen.begin(), seen.end(), key ) != seen.end();
+            seen.push_back( key );
+        }
+        printf( "state        %zu changes, %d kept an earlier key\n", changes.size(), unchanged );
+        ok &= bench::expect( unchanged == 0, "a distinct key for every change" );
+    }
+
+    {
+        const std::vector< std::function< void( RenderPipelineSummary& ) > > ignored = {
+            []( RenderPipelineSummary& s ){ s.color[ 1 ].writeMask = kColorWriteMaskAll; },
+            []( RenderPipelineSummary& s ){ s.color[ 2 ].blendingEnabled = true; },
+            []( RenderPipelineSummary& s ){ s.color[ 0 ].sourceRGBBlendFactor = kBlendFactorSourceAlpha; },
+            []( RenderPipelineSummary& s ){ s.color[ 0 ].destinationAlphaBlendFactor = kBlendFactorOneMinusSourceAlpha; },
+            []( RenderPipelineSummary& s ){ s.attributes[ 5 ].offset = 64; },
+            []( RenderPipelineSummary& s ){ s.layouts[ 3 ].stepRate = 2; },
+            []( RenderPipelineSummary& s ){ s.hasVertexDescriptor = false; s.attributes[ 0 ].offset = 4; },
+        };
+        int changed = 0;
+        for ( size_t i = 0; i < ignored.size(); ++i )
+        {
+            RenderPipelineSummary s = makeSummary();
+            RenderPipelineSummary reference = makeSummary();
+            // The last case compares against a summary without a vertex descriptor
+            if ( i + 1 == ignored.size() )
+            {
+                reference.hasVertexDescriptor = false;
+            }
+            ignored[ i ]( s );
+            changed += s.key() != reference.key();
+        }
+        printf( "unused       %zu unused members set, %d changed the key\n", ignored.size(), changed );
+        ok &= bench::expect( changed == 0, "unused state left out of the key" );
+
+        RenderPipelineSummary blended = makeSummary();
+        blended.color[ 0 ].blendingEnabled = true;
+        RenderPipelineSummary factors = blended;
+        factors.color[ 0 ].sourceRGBBlendFactor = kBlendFactorSourceAlpha;
+        ok &= bench::expect( blended.key() != factors.key(), "blend factors keyed once blending is on" );
+    }
+
+    {
+        util::ComputePipelineSummary a;
+        a.computeFunction = util::PipelineKeyBuilder( 2 ).addString( "mandelbrot_set" ).key();
+        util::ComputePipelineSummary b = a;
+        util::ComputePipelineSummary function = a;
+        function.computeFunction += 1;
+        util::ComputePipelineSummary multiple = a;
+        multiple.threadGroupSizeIsMultipleOfThreadExecutionWidth = true;
+        util::ComputePipelineSummary threads = a;
+        threads.maxTotalThreadsPerThreadgroup = 256;
+        printf( "compute      key %016llx\n", (unsigned long long)a.key() );
+        ok &= bench::expect( a.key() == b.key(), "equal compute summaries with equal keys" );
+        ok &= bench::expect( function.key() != a.key() && multiple.key() != a.key() && threads.key() != a.key() &&
+                             multiple.key() != threads.key(), "a distinct key for every compute change" );
+    }
+
+    {
+        RenderPipelineSummary s = makeSummary();
+        uint64_t sum = 0;
+        double start = seconds();
+        for ( size_t i = 0; i < keys; ++i )
+        {
+            s.layouts[ 0 ].stride = 16 + ( i & 255 );
+            sum += s.key();
+        }
+        double elapsed = seconds() - start;
+        printf( "key          %.1f ns per render pipeline (checksum %llu)\n", elapsed * 1e9 / keys,
+                (unsigned long long)( sum & 0xffff ) );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,285 @@
+/*
+ * Drives util::RefitScheduler with synthetic animation traces of the
+ * instancing samples' 10x10x10 grid and checks its decisions:
+ *
+ *   - static:     nothing moves, so nothing is refit or rebuilt,
+ *   - spin:       the grid spins and drifts as one; the tree stays good
+ *                 and, after the first frame moves it in front of the
+ *                 camera, every frame is a refit,
+ *   - random walk: instances wander apart, so the refitted tree degrades
+ *                 and is rebuilt whenever it passes the cost ratio,
+ *   - teleport:   one instance jumps across the grid and forces a rebuild,
+ *   - resize:     adding an instance forces a rebuild,
+ *   - budget:     eight wandering structures share a rebuild budget and
+ *                 are partially rebuilt, worst first.
+ *
+ * Also reports the SAH cost of always refitting against the scheduled
+ * trees, and the scheduler's CPU time per frame. Exits with 1 on any
+ * unexpected decision.
+ *
+ * Usage: refit-scheduler-bench [frames]
+ */
+
+#include <common/Math.hpp>
+#include <common/RefitScheduler.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace math = util::math;
+
+namespace
+{
+    static constexpr float kHalfSize = 0.1f;
+
+    struct Trace
+    {
+        std::vector< math::float3 > positions;
+        std::vector< math::float3 > velocities;
+    };
+
+    Trace makeGrid( int side, float spacing )
+    {
+        Trace t;
+        for ( int i = 0; i < side * side * side; ++i )
+        {
+            int ix = i % side, iy = ( i / side ) % side, iz = i / ( side * side );
+            float offset = ( side - 1 ) * 0.5f;
+            t.positions.push_back( { ( ix - offset ) * spacing, ( iy - offset ) * spacing, ( iz - offset ) * spacing } );
+            t.velocities.push_back( { 0.0f, 0.0f, 0.0f } );
+        }
+        return t;
+    }
+
+    // Instance cubes spinning about y by angle, as in the samples.
+    void instanceBounds( const Trace& t, const math::float4x4& world, float spin, std::vector< util::BoundingBox >* pOut )
+    {
+        pOut->resize( t.positions.size() );
+        float extent = kHalfSize * ( fabsf( cosf( spin ) ) + fabsf( sinf( spin ) ) );
+        for ( size_t i = 0; i < t.positions.size(); ++i )
+        {
+            math::float4 p = world * math::float4{ t.positions[ i ].x, t.positions[ i ].y, t.positions[ i ].z, 1.0f };
+            ( *pOut )[ i ] = { { p.x - extent, p.y - kHalfSize, p.z - extent }, { p.x + extent, p.y + kHalfSize, p.z + extent } };
+        }
+    }
+
+    void randomWalk( Trace* pTrace, std::mt19937& rng, float speed )
+    {
+        std::normal_distribution< float > kick( 0.0f, speed * 0.2f );
+        for ( size_t i = 0; i < pTrace->positions.size(); ++i )
+        {
+            math::float3& v = pTrace->velocities[ i ];
+            v = v * 0.98f + math::float3{ kick( rng ), kick( rng ), kick( rng ) };
+            pTrace->positions[ i ] = pTrace->positions[ i ] + v;
+        }
+    }
+
+    struct Counts
+    {
+        int idle = 0;
+        int refit = 0;
+        int partial = 0;
+        int full = 0;
+
+        void add( util::RefitPlan plan )
+        {
+            switch ( plan )
+            {
+                case util::RefitPlan::Idle: ++idle; break;
+                case util::RefitPlan::Refit: ++refit; break;
+                case util::RefitPlan::PartialRebuild: ++partial; break;
+                case util::RefitPlan::FullRebuild: ++full; break;
+            }
+        }
+    };
+
+    void report( const char* name, const Counts& c, double seconds, int frames )
+    {
+        printf( "%-12s idle %3d  refit %3d  partial %3d  full %3d  %7.1f us/frame\n", name, c.idle, c.refit, c.partial, c.full,
+                seconds / frames * 1e6 );
+    }
+
+    double now()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    int frames = argc > 1 ? atoi( argv[ 1 ] ) : 240;
+    frames = std::max( frames, 60 );
+    bool ok = true;
+    std::vector< util::BoundingBox > bounds;
+    std::mt19937 rng( 42 );
+
+    // Static
+    {
+        Trace t = makeGrid( 10, 0.4f );
+        instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+        util::RefitScheduler scheduler;
+        uint32_t s = scheduler.addStructure( bounds.data(), bounds.size() );
+        Counts c;
+        double start = now();
+        for ( int f = 0; f < frames; ++f )
+        {
+            instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+            scheduler.update( s, bounds.data(), bounds.size() );
+            c.add( scheduler.schedule() );
+        }
+        report( "static", c, now() - start, frames );
+        ok = ok && c.idle == frames;
+    }
+
+    // Rigid spin and drift of the whole grid, instances spinning in place.
+    {
+        Trace t = makeGrid( 10, 0.4f );
+        instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+        util::RefitScheduler scheduler;
+        uint32_t s = scheduler.addStructure( bounds.data(), bounds.size() );
+        Counts c;
+        float worst = 1.0f;
+        double start = now();
+        for ( int f = 1; f <= frames; ++f )
+        {
+            float angle = f * 0.01f;
+            math::float4x4 world = math::makeTranslate( { 0.0f, sinf( angle ), -10.0f + angle } ) * math::makeYRotate( angle );
+            instanceBounds( t, world, angle * 3.0f, &bounds );
+            scheduler.update( s, bounds.data(), bounds.size() );
+            c.add( scheduler.schedule() );
+            worst = std::max( worst, scheduler.stats( s ).cost / scheduler.stats( s ).builtCost );
+        }
+        report( "spin", c, now() - start, frames );
+        printf( "             worst cost ratio %.3f\n", worst );
+        ok = ok && c.refit + c.full == frames && c.full <= frames / 20;
+    }
+
+    // Random walk, against refitting forever.
+    {
+        Trace t = makeGrid( 10, 0.4f );
+        instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+        util::RefitPolicy policy;
+        util::RefitScheduler scheduler( policy );
+        util::RefitPolicy never;
+        never.rebuildCostRatio = INFINITY;
+        never.teleportFraction = INFINITY;
+        util::RefitScheduler refitOnly( never );
+        uint32_t s = scheduler.addStructure( bounds.data(), bounds.size() );
+        uint32_t r = refitOnly.addStructure( bounds.data(), bounds.size() );
+        Counts c;
+        float worst = 1.0f;
+        double seconds = 0.0;
+        for ( int f = 0; f < frames; ++f )
+        {
+            randomWalk( &t, rng, 0.01f );
+            instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+            double start = now();
+            scheduler.update( s, bounds.data(), bounds.size() );
+            util::RefitPlan plan = scheduler.schedule();
+            seconds += now() - start;
+            c.add( plan );
+            refitOnly.update( r, bounds.data(), bounds.size() );
+            refitOnly.schedule();
+
+            // A refit tree only ever moves past the ratio by one frame's
+            // worth before the next schedule() rebuilds it.
+            if ( plan == util::RefitPlan::Refit )
+            {
+                worst = std::max( worst, scheduler.stats( s ).cost / scheduler.stats( s ).builtCost );
+            }
+        }
+
+        util::Bvh fresh;
+        fresh.build( bounds.data(), bounds.size() );
+        report( "random walk", c, seconds, frames );
+        printf( "             final SAH cost: refit only %.1f, scheduled %.1f, fresh build %.1f; worst refit ratio %.3f\n",
+                refitOnly.stats( r ).cost, scheduler.stats( s ).cost, fresh.sahCost(), worst );
+        ok = ok && c.full > 0 && c.refit > c.full && worst <= policy.rebuildCostRatio
+             && scheduler.stats( s ).cost < refitOnly.stats( r ).cost;
+    }
+
+    // Teleport, then resize.
+    {
+        Trace t = makeGrid( 10, 0.4f );
+        instanceBounds( t, math::makeIdentity(), 0.0f, &bounds );
+        util::RefitScheduler scheduler;
+        uint32_t s = scheduler.addStructure( bounds.data(), bounds.size() );
+        Counts c;
+        bool teleportRebuilt = false;
+        bool resizeRebuilt = false;
+        double start = now();
+        for ( int f = 1; f <= frames; ++f )
+        {
+            float angle = f * 0.01f;
+            if ( f == frames / 2 )
+            {
+                t.positions[ 0 ] = t.positions[ 0 ] + math::float3{ 3.0f, 3.0f, 3.0f };
+            }
+            if ( f == frames - 1 )
+            {
+                t.positions.push_back( { 0.0f, 0.0f, 0.0f } );
+                t.velocities.push_back( { 0.0f, 0.0f, 0.0f } );
+            }
+            instanceBounds( t, math::makeIdentity(), angle, &bounds );
+            scheduler.update( s, bounds.data(), bounds.size() );
+            util::RefitPlan plan = scheduler.schedule();
+            c.add( plan );
+            teleportRebuilt = teleportRebuilt || ( f == frames / 2 && plan == util::RefitPlan::FullRebuild );
+            resizeRebuilt = resizeRebuilt || ( f == frames - 1 && plan == util::RefitPlan::FullRebuild );
+        }
+        report( "teleport", c, now() - start, frames );
+        ok = ok && teleportRebuilt && resizeRebuilt && c.full == 2;
+    }
+
+    // Eight structures of 4096 wandering at different speeds, with room to
+    // rebuild two of them a frame.
+    {
+        static constexpr int kStructures = 8;
+        util::RefitPolicy policy;
+        policy.rebuildBudget = 2 * 4096;
+        util::RefitScheduler scheduler( policy );
+        std::vector< Trace > traces;
+        for ( int i = 0; i < kStructures; ++i )
+        {
+            traces.push_back( makeGrid( 16, 0.4f ) );
+            instanceBounds( traces.back(), math::makeIdentity(), 0.0f, &bounds );
+            scheduler.addStructure( bounds.data(), bounds.size() );
+        }
+        std::vector< std::vector< util::BoundingBox > > frameBounds( kStructures );
+        Counts c;
+        float worst = 1.0f;
+        double seconds = 0.0;
+        for ( int f = 0; f < frames; ++f )
+        {
+            for ( int i = 0; i < kStructures; ++i )
+            {
+                randomWalk( &traces[ i ], rng, 0.004f * ( i + 1 ) );
+                instanceBounds( traces[ i ], math::makeIdentity(), 0.0f, &frameBounds[ i ] );
+            }
+            double start = now();
+            for ( int i = 0; i < kStructures; ++i )
+            {
+                scheduler.update( i, frameBounds[ i ].data(), frameBounds[ i ].size() );
+            }
+            c.add( scheduler.schedule() );
+            seconds += now() - start;
+            for ( int i = 0; i < kStructures; ++i )
+            {
+                worst = std::max( worst, scheduler.stats( i ).cost / scheduler.stats( i ).builtCost );
+            }
+        }
+        report( "budget", c, seconds, frames );
+        printf( "             %llu refits, %llu rebuilds, worst cost ratio %.3f\n", (unsigned long long)scheduler.refits(),
+                (unsigned long long)scheduler.rebuilds(), worst );
+        ok = ok && c.partial > 0 && worst < 2.0f * policy.rebuildCostRatio;
+    }
+
+    return bench::finish( ok );
+}
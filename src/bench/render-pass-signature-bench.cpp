@@ -0,0 +1,141 @@
+/*
+ * Checks util::RenderPassSignature, the key of the render pass descriptor
+ * pool, on any platform:
+ *
+ *   - equal:   signatures built the same way compare and hash equal, and
+ *              a changed attachment, size or sample count does not,
+ *   - unused:  color slots past colorCount are ignored,
+ *   - zero:    -0.0 and +0.0 clear values compare and hash the same,
+ *   - nan:     NaN clear values compare equal to each other, so a pool
+ *              keyed on them keeps a single entry.
+ *
+ * Also reports the cost of hash(). Exits with 1 on any failed check.
+ *
+ * Usage: render-pass-signature-bench [hashes]
+ */
+
+#include <common/RenderPassSignature.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+    // Raw values of MTL::PixelFormatBGRA8Unorm_sRGB, MTL::PixelFormatDepth16Unorm,
+    // MTL::LoadActionClear and MTL::StoreActionStore.
+    static constexpr uint32_t kColorFormat = 81;
+    static constexpr uint32_t kDepthFormat = 250;
+    static constexpr uint8_t kLoadClear = 2;
+    static constexpr uint8_t kStore = 1;
+
+    util::RenderPassSignature makeSignature( double red = 0.1 )
+    {
+        util::RenderPassSignature s;
+        s.colorCount = 1;
+        s.color[ 0 ].pixelFormat = kColorFormat;
+        s.color[ 0 ].loadAction = kLoadClear;
+        s.color[ 0 ].storeAction = kStore;
+        s.color[ 0 ].clearValue[ 0 ] = red;
+        s.color[ 0 ].clearValue[ 3 ] = 1.0;
+        s.depth.pixelFormat = kDepthFormat;
+        s.depth.loadAction = kLoadClear;
+        s.depth.clearValue[ 0 ] = 1.0;
+        s.width = 1024;
+        s.height = 1024;
+        return s;
+    }
+
+    bool same( const util::RenderPassSignature& a, const util::RenderPassSignature& b )
+    {
+        return a == b && a.hash() == b.hash();
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t hashes = argc > 1 ? std::max( 1000, atoi( argv[ 1 ] ) ) : 1000000;
+    bool ok = true;
+
+    {
+        util::RenderPassSignature a = makeSignature();
+        util::RenderPassSignature b = makeSignature();
+        util::RenderPassSignature format = makeSignature();
+        format.color[ 0 ].pixelFormat = kColorFormat + 1;
+        util::RenderPassSignature clear = makeSignature( 0.2 );
+        util::RenderPassSignature depth = makeSignature();
+        depth.depth.storeAction = kStore;
+        util::RenderPassSignature size = makeSignature();
+        size.height = 512;
+        util::RenderPassSignature samples = makeSignature();
+        samples.sampleCount = 4;
+        int collisions = 0;
+        for ( const util::RenderPassSignature* pOther : { &format, &clear, &depth, &size, &samples } )
+        {
+            collisions += a == *pOther || a.hash() == pOther->hash();
+        }
+        printf( "equal        hash %016llx, %d of 5 variants collide\n", (unsigned long long)a.hash(), collisions );
+        ok &= bench::expect( same( a, b ), "equal signatures with equal hashes" );
+        ok &= bench::expect( collisions == 0, "every variant distinct" );
+    }
+
+    {
+        util::RenderPassSignature a = makeSignature();
+        util::RenderPassSignature b = makeSignature();
+        b.color[ 1 ].pixelFormat = kColorFormat;
+        b.color[ 7 ].clearValue[ 2 ] = 0.5;
+        util::RenderPassSignature c = b;
+        c.colorCount = 2;
+        printf( "unused       slots past colorCount %s\n", same( a, b ) ? "ignored" : "compared" );
+        ok &= bench::expect( same( a, b ), "unused color slots ignored" );
+        ok &= bench::expect( a != c, "a second attachment compared once counted" );
+    }
+
+    {
+        util::RenderPassSignature a = makeSignature( 0.0 );
+        util::RenderPassSignature b = makeSignature( -0.0 );
+        b.depth.clearValue[ 1 ] = -0.0;
+        printf( "zero         -0.0 and +0.0 %s\n", same( a, b ) ? "match" : "differ" );
+        ok &= bench::expect( same( a, b ), "-0.0 and +0.0 clear values alike" );
+    }
+
+    {
+        util::RenderPassSignature a = makeSignature( std::numeric_limits< double >::quiet_NaN() );
+        util::RenderPassSignature b = makeSignature( -std::nan( "1" ) );
+        std::unordered_map< util::RenderPassSignature, int, util::RenderPassSignatureHash > pool;
+        for ( int frame = 0; frame < 100; ++frame )
+        {
+            pool.emplace( frame & 1 ? a : b, frame );
+        }
+        printf( "nan          %zu pool entries after 100 lookups\n", pool.size() );
+        ok &= bench::expect( same( a, b ), "NaN clear values alike" );
+        ok &= bench::expect( pool.size() == 1, "a single pool entry" );
+        ok &= bench::expect( a != makeSignature(), "NaN distinct from a number" );
+    }
+
+    {
+        util::RenderPassSignature s = makeSignature();
+        uint64_t sum = 0;
+        double start = seconds();
+        for ( size_t i = 0; i < hashes; ++i )
+        {
+            s.width = (uint32_t)( i & 1023 );
+            sum += s.hash();
+        }
+        double elapsed = seconds() - start;
+        printf( "hash         %.1f ns per signature (checksum %llu)\n", elapsed * 1e9 / hashes, (unsigned long long)( sum & 0xffff ) );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,136 @@
+/*
+ * Checks the pieces of util::SpecializationCache that do not need Metal:
+ *
+ *   - key:      util::FunctionConstantSet::key() does not depend on the
+ *               order constants were set in or on the sign of a float
+ *               zero, and does depend on every index, type and value,
+ *   - eviction: util::LruCache evicts the least recently used entry, and
+ *               find() counts as a use,
+ *   - callback: onEvict sees every value that leaves the cache, whether
+ *               evicted, replaced or cleared,
+ *   - capacity: the cache never holds more than its capacity.
+ *
+ * Also reports the cost of key(). Exits with 1 on any failed check.
+ *
+ * Usage: specialization-key-bench [keys]
+ */
+
+#include <common/FunctionConstantSet.hpp>
+#include <common/LruCache.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    // 10-frame-debugging's kernel constants
+    util::FunctionConstantSet makeConstants( float scale = 1.5f )
+    {
+        util::FunctionConstantSet s;
+        s.setInt( 0, 256 ).setBool( 1, true ).setFloat( 2, scale ).setInt( 3, -1 );
+        return s;
+    }
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t keys = argc > 1 ? std::max( 1000, atoi( argv[ 1 ] ) ) : 1000000;
+    bool ok = true;
+
+    {
+        uint64_t base = makeConstants().key();
+        util::FunctionConstantSet reversed;
+        reversed.setInt( 3, -1 ).setFloat( 2, 1.5f ).setBool( 1, true ).setInt( 0, 256 );
+        util::FunctionConstantSet shuffled;
+        shuffled.setFloat( 2, 1.5f ).setInt( 0, 256 ).setInt( 3, -1 ).setBool( 1, true );
+        util::FunctionConstantSet overwritten;
+        overwritten.setInt( 0, 1 ).setBool( 1, true ).setFloat( 2, 0.f ).setInt( 3, -1 ).setFloat( 2, 1.5f ).setInt( 0, 256 );
+        printf( "key          %016llx for 4 constants\n", (unsigned long long)base );
+        ok &= bench::expect( reversed.key() == base && shuffled.key() == base && overwritten.key() == base,
+                             "the same key in any order" );
+        ok &= bench::expect( makeConstants( 0.f ).key() == makeConstants( -0.f ).key(), "-0.0 and +0.0 alike" );
+
+        util::FunctionConstantSet value = makeConstants();
+        value.setInt( 0, 512 );
+        util::FunctionConstantSet type = makeConstants();
+        type.setInt( 1, 1 );
+        util::FunctionConstantSet index = makeConstants();
+        index.setInt( 4, -1 );
+        util::FunctionConstantSet flag = makeConstants();
+        flag.setBool( 1, false );
+        std::vector< uint64_t > variants = { base, value.key(), type.key(), index.key(), flag.key(), makeConstants( 2.f ).key(),
+                                             util::FunctionConstantSet().key() };
+        std::sort( variants.begin(), variants.end() );
+        ok &= bench::expect( std::unique( variants.begin(), variants.end() ) == variants.end(), "a distinct key for every change" );
+    }
+
+    {
+        std::vector< int > evicted;
+        auto onEvict = [&evicted]( int value ){ evicted.push_back( value ); };
+        util::LruCache< int > cache( 3 );
+        cache.insert( 1, 10, onEvict );
+        cache.insert( 2, 20, onEvict );
+        cache.insert( 3, 30, onEvict );
+        bool hit = cache.find( 1 ) && *cache.find( 1 ) == 10;
+        cache.insert( 4, 40, onEvict );
+        cache.insert( 5, 50, onEvict );
+
+        std::vector< uint64_t > order;
+        cache.forEach( [&order]( uint64_t key, int ){ order.push_back( key ); } );
+        printf( "eviction     order %llu %llu %llu, evicted %d %d\n", (unsigned long long)order[ 0 ], (unsigned long long)order[ 1 ],
+                (unsigned long long)order[ 2 ], evicted[ 0 ], evicted[ 1 ] );
+        ok &= bench::expect( hit && !cache.find( 2 ) && !cache.find( 3 ), "the least recently used entries evicted" );
+        ok &= bench::expect( order == std::vector< uint64_t >( { 5, 4, 1 } ), "entries from most to least recently used" );
+        ok &= bench::expect( evicted == std::vector< int >( { 20, 30 } ) && cache.evictions() == 2, "values handed to onEvict" );
+
+        cache.insert( 4, 41, onEvict );
+        bool replaced = evicted.back() == 40 && *cache.find( 4 ) == 41 && cache.size() == 3 && cache.evictions() == 2;
+        cache.clear( onEvict );
+        printf( "callback     %zu values released, %llu hits, %llu misses\n", evicted.size(), (unsigned long long)cache.hits(),
+                (unsigned long long)cache.misses() );
+        ok &= bench::expect( replaced, "a replaced value released without an eviction" );
+        ok &= bench::expect( evicted.size() == 6 && cache.size() == 0, "every value released by clear()" );
+    }
+
+    {
+        int released = 0;
+        auto onEvict = [&released]( int ){ ++released; };
+        util::LruCache< int > cache( 4 );
+        util::LruCache< int > single( 0 );
+        size_t largest = 0;
+        for ( uint64_t key = 0; key < 1000; ++key )
+        {
+            cache.insert( key % 37, (int)key, onEvict );
+            single.insert( key, (int)key, onEvict );
+            largest = std::max( largest, cache.size() );
+        }
+        printf( "capacity     at most %zu of %zu entries, %d released\n", largest, cache.capacity(), released );
+        ok &= bench::expect( largest == 4 && single.capacity() == 1 && single.size() == 1, "the capacity never exceeded" );
+        ok &= bench::expect( released == 1000 - 4 + 1000 - 1, "a release for every entry pushed out" );
+    }
+
+    {
+        util::FunctionConstantSet s = makeConstants();
+        uint64_t sum = 0;
+        double start = seconds();
+        for ( size_t i = 0; i < keys; ++i )
+        {
+            s.setInt( 0, (int32_t)( i & 1023 ) );
+            sum += s.key();
+        }
+        double elapsed = seconds() - start;
+        printf( "key cost     %.1f ns per set of 4 (checksum %llu)\n", elapsed * 1e9 / keys, (unsigned long long)( sum & 0xffff ) );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,252 @@
+/*
+ * Drives util::ProgressiveTileScheduler the way 09-compute-to-render does
+ * and checks on any platform:
+ *
+ *   - budget:      no frame evaluates more pixels than the budget, unless
+ *                  a single tile alone exceeds it, and every frame makes
+ *                  progress,
+ *   - order:       no tile is refined before every tile had its coarse
+ *                  pass, a tile only ever gets finer, and the centre tile
+ *                  goes first,
+ *   - convergence: every pixel is evaluated at full resolution, after
+ *                  which nothing is dispatched until the view changes,
+ *   - view:        an unchanged view keeps the progress, a new one or an
+ *                  invalidated region starts over,
+ *   - moving:      with the view changing every frame, each frame still
+ *                  covers the whole image and sharpens the centre tiles to
+ *                  full resolution within the budget.
+ *
+ * Exits with 1 on any failed check.
+ *
+ * Usage: tile-scheduler-bench [width height [tile-size]]
+ */
+
+#include <common/ProgressiveTileScheduler.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    using util::ProgressiveTileScheduler;
+    using util::TileDispatch;
+
+    uint64_t cost( const TileDispatch& d )
+    {
+        return (uint64_t)( ( d.width + d.stride - 1 ) / d.stride ) * ( ( d.height + d.stride - 1 ) / d.stride );
+    }
+
+    uint32_t levelOf( uint32_t stride )
+    {
+        uint32_t level = 0;
+        while ( ProgressiveTileScheduler::kLevelStrides[ level ] != stride )
+        {
+            ++level;
+        }
+        return level;
+    }
+
+    // Replays frames until convergence and checks every frame on the way.
+    struct Replay
+    {
+        uint32_t frames = 0;
+        uint64_t pixels = 0;
+        int overBudget = 0;
+        int outOfOrder = 0;
+        int coarsened = 0;
+        int stalled = 0;
+        std::vector< uint32_t > fullResolution;
+
+        Replay( ProgressiveTileScheduler* pScheduler, uint32_t width, uint32_t height, uint32_t tileSize )
+        : fullResolution( (size_t)width * height, 0 )
+        {
+            uint32_t tilesX = ( width + tileSize - 1 ) / tileSize;
+            std::vector< uint32_t > levels( pScheduler->tileCount() );
+            for ( uint32_t tile = 0; tile < levels.size(); ++tile )
+            {
+                levels[ tile ] = pScheduler->tileLevel( tile );
+            }
+            std::vector< TileDispatch > dispatches;
+            while ( !pScheduler->converged() && frames < 10000 )
+            {
+                uint64_t spent = pScheduler->nextFrame( &dispatches );
+                ++frames;
+                pixels += spent;
+
+                uint64_t sum = 0;
+                for ( const TileDispatch& d : dispatches )
+                {
+                    uint32_t tile = ( d.y / tileSize ) * tilesX + d.x / tileSize;
+                    uint32_t level = levelOf( d.stride );
+                    coarsened += level < levels[ tile ];
+                    outOfOrder += level > 0 && *std::min_element( levels.begin(), levels.end() ) == 0;
+                    levels[ tile ] = level + 1;
+                    sum += cost( d );
+
+                    if ( d.stride == 1 )
+                    {
+                        for ( uint32_t y = d.y; y < d.y + d.height; ++y )
+                        {
+                            for ( uint32_t x = d.x; x < d.x + d.width; ++x )
+                            {
+                                fullResolution[ (size_t)y * width + x ] += 1;
+                            }
+                        }
+                    }
+                }
+                overBudget += sum != spent || ( spent > pScheduler->pixelBudget() && dispatches.size() > 1 );
+                stalled += dispatches.empty();
+            }
+        }
+    };
+
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t width = argc > 2 ? (uint32_t)std::max( 1, atoi( argv[ 1 ] ) ) : 128;
+    uint32_t height = argc > 2 ? (uint32_t)std::max( 1, atoi( argv[ 2 ] ) ) : 128;
+    uint32_t tileSize = argc > 3 ? (uint32_t)std::max( 1, atoi( argv[ 3 ] ) ) : 32;
+    bool ok = true;
+
+    util::MandelbrotView view;
+    view.zoom = 0.5f;
+    view.centerX = -1.2f;
+    view.centerY = -0.32f;
+
+    // 09-compute-to-render's budget, and one smaller than a tile
+    for ( uint64_t budget : { (uint64_t)width * height / 4, (uint64_t)tileSize * tileSize / 2 } )
+    {
+        ProgressiveTileScheduler scheduler( width, height, tileSize, budget );
+        bool changed = scheduler.setView( view );
+
+        std::vector< TileDispatch > first;
+        ProgressiveTileScheduler probe( width, height, tileSize, budget );
+        probe.nextFrame( &first );
+        // The first tile touches the image centre
+        bool centreFirst = !first.empty() && first[ 0 ].stride == ProgressiveTileScheduler::kLevelStrides[ 0 ] &&
+                           first[ 0 ].x <= width / 2 && first[ 0 ].x + first[ 0 ].width >= width / 2 &&
+                           first[ 0 ].y <= height / 2 && first[ 0 ].y + first[ 0 ].height >= height / 2;
+
+        Replay replay( &scheduler, width, height, tileSize );
+        // Every level of every tile, the most convergence may cost
+        uint64_t expectedPixels = 0;
+        for ( uint32_t stride : ProgressiveTileScheduler::kLevelStrides )
+        {
+            for ( uint32_t tile = 0; tile < scheduler.tileCount(); ++tile )
+            {
+                uint32_t tx = ( tile % ( ( width + tileSize - 1 ) / tileSize ) ) * tileSize;
+                uint32_t ty = ( tile / ( ( width + tileSize - 1 ) / tileSize ) ) * tileSize;
+                expectedPixels += cost( { tx, ty, std::min( tileSize, width - tx ), std::min( tileSize, height - ty ), stride } );
+            }
+        }
+        int uncovered = (int)std::count_if( replay.fullResolution.begin(), replay.fullResolution.end(), []( uint32_t n ){
+            return n != 1;
+        } );
+
+        std::vector< TileDispatch > after;
+        uint64_t idle = scheduler.nextFrame( &after );
+
+        printf( "budget       %llu pixels, %u frames, %llu evaluated, %d over budget, %d stalled\n",
+                (unsigned long long)budget, replay.frames, (unsigned long long)replay.pixels, replay.overBudget, replay.stalled );
+        printf( "order        %d out of order, %d coarsened, centre %s\n", replay.outOfOrder, replay.coarsened,
+                centreFirst ? "first" : "not first" );
+        printf( "convergence  %d pixels not evaluated exactly once at full resolution, %llu of %llu pixels\n", uncovered,
+                (unsigned long long)replay.pixels, (unsigned long long)expectedPixels );
+        ok &= bench::expect( changed && replay.overBudget == 0 && replay.stalled == 0, "progress within the budget every frame" );
+        ok &= bench::expect( replay.outOfOrder == 0 && replay.coarsened == 0, "the coarse pass first, then only finer" );
+        ok &= bench::expect( centreFirst, "the centre tile first" );
+        ok &= bench::expect( scheduler.converged() && replay.pixels <= expectedPixels && uncovered == 0,
+                             "every pixel once at full resolution, no more work than level by level" );
+        ok &= bench::expect( idle == 0 && after.empty(), "no work once converged" );
+    }
+
+    {
+        ProgressiveTileScheduler scheduler( width, height, tileSize, (uint64_t)width * height );
+        scheduler.setView( view );
+        Replay( &scheduler, width, height, tileSize );
+
+        bool same = scheduler.setView( view );
+        bool stillConverged = scheduler.converged();
+
+        scheduler.invalidate( 0, 0, 1, 1 );
+        uint32_t reset = 0;
+        for ( uint32_t tile = 0; tile < scheduler.tileCount(); ++tile )
+        {
+            reset += scheduler.tileLevel( tile ) == 0;
+        }
+        Replay partial( &scheduler, width, height, tileSize );
+        bool refined = scheduler.converged();
+
+        util::MandelbrotView zoomed = view;
+        zoomed.zoom *= 0.99f;
+        bool moved = scheduler.setView( zoomed );
+        bool restarted = !scheduler.converged() && scheduler.tileLevel( 0 ) == 0 &&
+                         scheduler.tileLevel( scheduler.tileCount() - 1 ) == 0;
+
+        printf( "view         unchanged %s, invalidate reset %u tile, new view %s\n", same ? "restarted" : "kept",
+                reset, restarted ? "restarted" : "kept" );
+        ok &= bench::expect( !same && stillConverged, "an unchanged view kept" );
+        ok &= bench::expect( reset == 1 && partial.frames >= 1 && partial.outOfOrder == 0 && partial.coarsened == 0 && refined,
+                             "one invalidated tile refined again" );
+        ok &= bench::expect( moved && restarted, "a new view restarting every tile" );
+    }
+
+    {
+        // 09-compute-to-render zooms a little every frame
+        uint64_t budget = (uint64_t)width * height / 4;
+        ProgressiveTileScheduler scheduler( width, height, tileSize, budget );
+        util::MandelbrotView moving = view;
+        uint32_t frames = 60;
+        uint32_t overBudget = 0;
+        uint32_t partial = 0;
+        uint32_t blurred = 0;
+        uint64_t sharpPixels = 0;
+        std::vector< TileDispatch > dispatches;
+        for ( uint32_t frame = 0; frame < frames; ++frame )
+        {
+            moving.zoom *= 0.99f;
+            scheduler.setView( moving );
+            uint64_t spent = scheduler.nextFrame( &dispatches );
+
+            std::vector< bool > covered( scheduler.tileCount(), false );
+            bool centreSharp = false;
+            for ( const TileDispatch& d : dispatches )
+            {
+                covered[ ( d.y / tileSize ) * ( ( width + tileSize - 1 ) / tileSize ) + d.x / tileSize ] = true;
+                if ( d.stride == 1 )
+                {
+                    sharpPixels += (uint64_t)d.width * d.height;
+                    centreSharp |= d.x <= width / 2 && d.x + d.width >= width / 2 && d.y <= height / 2 &&
+                                   d.y + d.height >= height / 2;
+                }
+            }
+            overBudget += spent > budget;
+            partial += std::count( covered.begin(), covered.end(), false ) != 0;
+            blurred += !centreSharp;
+        }
+
+        // The coarse pass over the whole image and the centre tile at full
+        // resolution, the least a frame needs to afford to sharpen anything
+        uint64_t coarse = 0;
+        for ( uint32_t tile = 0; tile < scheduler.tileCount(); ++tile )
+        {
+            uint32_t tx = ( tile % ( ( width + tileSize - 1 ) / tileSize ) ) * tileSize;
+            uint32_t ty = ( tile / ( ( width + tileSize - 1 ) / tileSize ) ) * tileSize;
+            coarse += cost( { tx, ty, std::min( tileSize, width - tx ), std::min( tileSize, height - ty ),
+                              ProgressiveTileScheduler::kLevelStrides[ 0 ] } );
+        }
+        bool affordable = coarse + (uint64_t)std::min( tileSize, width ) * std::min( tileSize, height ) <= budget;
+
+        printf( "moving       %u frames, %u over budget, %u partly covered, %u without a sharp centre, %llu sharp pixels a frame\n",
+                frames, overBudget, partial, blurred, (unsigned long long)( sharpPixels / frames ) );
+        ok &= bench::expect( overBudget == 0 && partial == 0, "the whole image within the budget every frame" );
+        ok &= bench::expect( !affordable || ( blurred == 0 && sharpPixels > 0 ), "full-resolution centre tiles every frame" );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,182 @@
+/*
+ * Sweeps util::UniformUploadPolicy's inline threshold over a range of
+ * payload sizes and reports, per threshold, how uploads split between
+ * inline copies and the ring, what routing and copying cost on the CPU,
+ * and how many buffers and flushes the ring saved. Also checks on any
+ * platform:
+ *
+ *   - overflow: a payload that does not fit the frame's segment gets a
+ *               dedicated buffer, and the next beginFrame() grows the
+ *               segment so it fits in the ring,
+ *   - slots:    vertex, fragment and compute bindings with the same index
+ *               count as separate buffers,
+ *   - stats:    byte counts and flush counts over a run of frames.
+ *
+ * Exits with 1 on any failed check.
+ *
+ * Usage: uniform-upload-bench [frames]
+ */
+
+#include <common/UniformRing.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+    using Policy = util::UniformUploadPolicy;
+
+    static constexpr size_t kFramesInFlight = 3;
+
+    // What a frame of the samples binds: per-frame constants, a camera,
+    // a light block and a few larger per-draw tables.
+    static constexpr size_t kPayloadSizes[] = { 4, 16, 64, 144, 256, 512, 1024, 2048, 4096 };
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t frames = argc > 1 ? std::max( 100, atoi( argv[ 1 ] ) ) : 20000;
+    bool ok = true;
+
+    {
+        // Stand-ins for the ring and the encoder's inline copy
+        std::vector< uint8_t > source( Policy::kMaxInlineBytes, 1 );
+        std::vector< uint8_t > ring( 64 * 1024 * kFramesInFlight );
+        std::vector< uint8_t > inlineBytes( Policy::kMaxInlineBytes );
+        size_t segment = ring.size() / kFramesInFlight;
+
+        printf( "threshold    inline   ring    ns/frame  buffers saved  flushes saved\n" );
+        for ( size_t threshold : { (size_t)0, (size_t)64, (size_t)256, (size_t)1024, (size_t)4096 } )
+        {
+            Policy policy( segment, kFramesInFlight, threshold );
+            double start = seconds();
+            for ( size_t f = 0; f < frames; ++f )
+            {
+                policy.beginFrame( f );
+                uint32_t index = 0;
+                for ( size_t size : kPayloadSizes )
+                {
+                    size_t offset;
+                    if ( policy.route( size, util::kUniformSlotVertex + index++, &offset ) == Policy::Route::Ring )
+                    {
+                        memcpy( ring.data() + offset, source.data(), size );
+                    }
+                    else
+                    {
+                        memcpy( inlineBytes.data(), source.data(), size );
+                    }
+                }
+                size_t flushOffset, flushLength;
+                policy.endFrame( &flushOffset, &flushLength );
+            }
+            double elapsed = seconds() - start;
+
+            const util::UniformUploadStats& stats = policy.stats();
+            printf( "%9zu  %7llu %7llu  %8.1f  %13llu  %13llu\n", threshold, (unsigned long long)stats.inlineUploads,
+                    (unsigned long long)stats.ringUploads, elapsed * 1e9 / frames, (unsigned long long)stats.buffersSaved,
+                    (unsigned long long)stats.flushesSaved );
+            ok &= bench::expect( stats.inlineUploads + stats.ringUploads == frames * std::size( kPayloadSizes ) &&
+                                 stats.dedicatedUploads == 0, "every upload inline or in the ring" );
+        }
+    }
+
+    {
+        // One 256 byte segment, then a 1 KB payload that cannot fit
+        Policy policy( 256, kFramesInFlight, 64 );
+        size_t offset;
+        bool grewFirst = policy.beginFrame( 0 );
+        Policy::Route small = policy.route( 128, util::kUniformSlotVertex + 1, &offset );
+        size_t smallOffset = offset;
+        Policy::Route large = policy.route( 1024, util::kUniformSlotVertex + 2, &offset );
+        size_t largeOffset = offset;
+        size_t flushOffset, flushLength;
+        bool flushed = policy.endFrame( &flushOffset, &flushLength );
+        size_t firstFlush = flushLength;
+
+        bool grew = policy.beginFrame( 1 );
+        Policy::Route again = policy.route( 128, util::kUniformSlotVertex + 1, &offset );
+        Policy::Route after = policy.route( 1024, util::kUniformSlotVertex + 2, &offset );
+        size_t afterOffset = offset;
+        policy.endFrame( &flushOffset, &flushLength );
+        bool grewAgain = policy.beginFrame( 2 );
+
+        const util::UniformUploadStats& stats = policy.stats();
+        printf( "overflow     segment %zu after growth, %llu dedicated, %llu growths\n", policy.segmentSize(),
+                (unsigned long long)stats.dedicatedUploads, (unsigned long long)stats.ringGrowths );
+        ok &= bench::expect( !grewFirst && small == Policy::Route::Ring && smallOffset == 0, "the first payload in the ring" );
+        ok &= bench::expect( large == Policy::Route::Dedicated && largeOffset == Policy::kInvalidOffset,
+                             "a dedicated buffer for a payload past the segment" );
+        ok &= bench::expect( flushed && firstFlush == 128, "only the ring's bytes flushed" );
+        ok &= bench::expect( grew && policy.segmentSize() >= 256 + 1024 && policy.segmentSize() % Policy::kRingAlignment == 0,
+                             "the segment grown at the next frame" );
+        ok &= bench::expect( again == Policy::Route::Ring && after == Policy::Route::Ring &&
+                             afterOffset + 1024 <= 2 * policy.segmentSize() && afterOffset >= policy.segmentSize(),
+                             "both payloads in the grown frame's segment" );
+        ok &= bench::expect( !grewAgain && stats.ringGrowths == 1 && stats.dedicatedUploads == 1 && stats.dedicatedBytes == 1024,
+                             "a single growth" );
+    }
+
+    {
+        Policy policy( 4096, kFramesInFlight, 64 );
+        size_t offset;
+        policy.beginFrame( 0 );
+        policy.route( 256, util::kUniformSlotVertex + 1, &offset );
+        policy.route( 256, util::kUniformSlotFragment + 1, &offset );
+        policy.route( 256, util::kUniformSlotCompute + 1, &offset );
+        policy.route( 256, util::kUniformSlotCompute + 1, &offset );
+        size_t flushOffset, flushLength;
+        policy.endFrame( &flushOffset, &flushLength );
+
+        const util::UniformUploadStats& stats = policy.stats();
+        printf( "slots        %llu buffers saved over 3 bindings\n", (unsigned long long)stats.buffersSaved );
+        ok &= bench::expect( stats.buffersAllocated == 1 && stats.buffersSaved == 3 * kFramesInFlight - 1,
+                             "vertex, fragment and compute bindings counted apart" );
+    }
+
+    {
+        static constexpr size_t kFrames = 10;
+        Policy policy( 4096, kFramesInFlight, 256 );
+        size_t ringFrames = 0;
+        for ( size_t f = 0; f < kFrames; ++f )
+        {
+            size_t offset;
+            policy.beginFrame( f );
+            policy.route( 16, util::kUniformSlotVertex + 0, &offset );
+            policy.route( 64, util::kUniformSlotFragment + 0, &offset );
+            // Every other frame also uploads a per-draw table
+            if ( f % 2 == 0 )
+            {
+                policy.route( 1024, util::kUniformSlotVertex + 3, &offset );
+                policy.route( 512, util::kUniformSlotVertex + 4, &offset );
+            }
+            size_t flushOffset, flushLength;
+            ringFrames += policy.endFrame( &flushOffset, &flushLength );
+        }
+
+        const util::UniformUploadStats& stats = policy.stats();
+        printf( "stats        %llu inline bytes, %llu ring bytes, %llu flushes issued, %llu saved\n",
+                (unsigned long long)stats.inlineBytes, (unsigned long long)stats.ringBytes,
+                (unsigned long long)stats.flushesIssued, (unsigned long long)stats.flushesSaved );
+        ok &= bench::expect( stats.inlineUploads == 2 * kFrames && stats.inlineBytes == 80 * kFrames, "inline counts" );
+        ok &= bench::expect( stats.ringUploads == kFrames && stats.ringBytes == 1536 * kFrames / 2, "ring counts" );
+        ok &= bench::expect( ringFrames == kFrames / 2 && stats.flushesIssued == kFrames / 2, "one flush per frame using the ring" );
+        ok &= bench::expect( stats.flushesSaved == 3 * kFrames / 2 + 2 * kFrames / 2, "a flush saved per other upload" );
+
+        policy.resetStats();
+        ok &= bench::expect( policy.stats().ringUploads == 0 && policy.stats().buffersAllocated == 1, "stats reset, ring kept" );
+    }
+
+    return bench::finish( ok );
+}
@@ -0,0 +1,235 @@
+/*
+ * Measures what a util::ScopedZone costs on the thread that records it:
+ *
+ *   - clock:     one zoneTicks() read, against one traceClockNs() read,
+ *   - zone:      one flat zone, drained between batches so none is dropped,
+ *   - nested:    zones four deep, per zone,
+ *   - threads:   four threads recording flat out while a ZoneWriter
+ *                drains in the background every millisecond; the rings
+ *                fill faster than that, so this also shows how many zones
+ *                a full ring drops.
+ *
+ * Zones are recorded through util::ScopedZone directly, so the numbers do
+ * not depend on the LEARN_METAL_ZONES option; with it off,
+ * LEARN_METAL_ZONE() call sites cost nothing at all. Checks that every
+ * zone is either in the written trace or counted as dropped, and that
+ * converted zones nest and have sane durations. Exits with 1 on failure.
+ *
+ * Usage: zone-overhead-bench [zones]
+ */
+
+#include <common/ChromeTrace.hpp>
+#include <common/CpuZones.hpp>
+
+#include "BenchCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    static constexpr size_t kBatch = 1024;
+    static constexpr unsigned kThreads = 4;
+
+    double seconds()
+    {
+        return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // Keeps the compiler from dropping otherwise unused reads.
+    volatile uint64_t sink;
+
+    size_t countOf( const std::string& s, const char* pNeedle )
+    {
+        size_t count = 0;
+        for ( size_t at = s.find( pNeedle ); at != std::string::npos; at = s.find( pNeedle, at + 1 ) )
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    bool readFile( const char* path, std::string* pOut )
+    {
+        FILE* pFile = fopen( path, "rb" );
+        if ( !pFile )
+        {
+            return false;
+        }
+        char buffer[ 65536 ];
+        size_t n;
+        while ( ( n = fread( buffer, 1, sizeof( buffer ), pFile ) ) > 0 )
+        {
+            pOut->append( buffer, n );
+        }
+        fclose( pFile );
+        return true;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t zones = argc > 1 ? std::max( kBatch, (size_t)atoll( argv[ 1 ] ) ) : 1 << 20;
+    zones -= zones % kBatch;
+    bool ok = true;
+
+    {
+        double start = seconds();
+        uint64_t sum = 0;
+        for ( size_t i = 0; i < zones; ++i )
+        {
+            sum += util::zoneTicks();
+        }
+        double ticksNs = ( seconds() - start ) * 1e9 / zones;
+        start = seconds();
+        for ( size_t i = 0; i < zones; ++i )
+        {
+            sum += util::traceClockNs();
+        }
+        double clockNs = ( seconds() - start ) * 1e9 / zones;
+        sink = sum;
+        printf( "clock        zoneTicks %.1f ns, traceClockNs %.1f ns\n", ticksNs, clockNs );
+    }
+
+    // Single thread: time only the recording, drain between batches.
+    {
+        util::ZoneWriter writer( "", 0, 2 * zones );
+        double flat = 0.0, nested = 0.0;
+        for ( size_t b = 0; b < zones / kBatch; ++b )
+        {
+            double start = seconds();
+            for ( size_t i = 0; i < kBatch; ++i )
+            {
+                util::ScopedZone zone( "flat" );
+            }
+            flat += seconds() - start;
+            writer.drain();
+
+            start = seconds();
+            for ( size_t i = 0; i < kBatch / 4; ++i )
+            {
+                util::ScopedZone a( "depth 0" );
+                util::ScopedZone b( "depth 1" );
+                util::ScopedZone c( "depth 2" );
+                util::ScopedZone d( "depth 3" );
+            }
+            nested += seconds() - start;
+            writer.drain();
+        }
+        printf( "zone         %.1f ns per zone\n", flat * 1e9 / zones );
+        printf( "nested       %.1f ns per zone\n", nested * 1e9 / zones );
+        if ( writer.eventCount() != 2 * zones || writer.dropped() != 0 )
+        {
+            printf( "             expected %zu events and none dropped, got %zu and %llu\n", 2 * zones, writer.eventCount(),
+                    (unsigned long long)writer.dropped() );
+            ok = false;
+        }
+    }
+
+    // Threads: the writer drains on its own and writes a trace.
+    {
+        char path[] = "/tmp/zone-overhead-bench-XXXXXX";
+        int fd = mkstemp( path );
+        if ( fd < 0 )
+        {
+            printf( "threads      cannot create a trace file\n" );
+            return 1;
+        }
+        close( fd );
+
+        size_t perThread = zones / kThreads;
+        std::vector< double > elapsed( kThreads );
+        uint64_t dropped = 0;
+        {
+            util::ZoneWriter writer( path, 1, 2 * zones );
+            std::vector< std::thread > threads;
+            for ( unsigned t = 0; t < kThreads; ++t )
+            {
+                threads.emplace_back( [t, perThread, &elapsed]{
+                    util::nameZoneThread( "bench" );
+                    double start = seconds();
+                    for ( size_t i = 0; i < perThread / 2; ++i )
+                    {
+                        util::ScopedZone outer( "outer" );
+                        util::ScopedZone inner( "inner" );
+                    }
+                    elapsed[ t ] = seconds() - start;
+                } );
+            }
+            for ( std::thread& thread : threads )
+            {
+                thread.join();
+            }
+            writer.drain();
+            dropped = writer.dropped();
+        }
+
+        std::string json;
+        size_t written = 0;
+        if ( readFile( path, &json ) )
+        {
+            written = countOf( json, "\"name\":\"outer\"" ) + countOf( json, "\"name\":\"inner\"" );
+        }
+        unlink( path );
+
+        double worst = *std::max_element( elapsed.begin(), elapsed.end() );
+        printf( "threads      %u threads, %.1f ns per zone, %zu written, %llu dropped\n", kThreads,
+                worst * 1e9 / perThread, written, (unsigned long long)dropped );
+        if ( written + dropped != kThreads * ( perThread / 2 ) * 2 )
+        {
+            printf( "             %zu zones recorded, %llu accounted for\n", kThreads * ( perThread / 2 ) * 2,
+                    (unsigned long long)( written + dropped ) );
+            ok = false;
+        }
+        if ( countOf( json, "\"name\":\"bench\"" ) != kThreads )
+        {
+            printf( "             thread names missing from the trace\n" );
+            ok = false;
+        }
+    }
+
+    // Conversion: a zone around a known sleep comes out about that long,
+    // and zones recorded inside it land inside it.
+    {
+        util::ZoneWriter writer( "", 0 );
+        uint64_t before = util::traceClockNs();
+        {
+            util::ScopedZone outer( "sleep" );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+            util::ScopedZone inner( "inner" );
+        }
+        uint64_t after = util::traceClockNs();
+        writer.drain();
+
+        util::ChromeTrace trace;
+        writer.snapshot( &trace );
+        const util::TraceEvent* pSleep = nullptr;
+        const util::TraceEvent* pInner = nullptr;
+        for ( const util::TraceEvent& e : trace.events() )
+        {
+            pSleep = e.name == "sleep" ? &e : pSleep;
+            pInner = e.name == "inner" ? &e : pInner;
+        }
+        // Allow for the calibration error and for a read either side of a
+        // preemption.
+        static constexpr uint64_t kSlackNs = 200000;
+        bool convertOk = pSleep && pInner && pSleep->durationNs >= 5000000 - kSlackNs &&
+                         pSleep->startNs + kSlackNs >= before && pSleep->startNs + pSleep->durationNs <= after + kSlackNs &&
+                         pInner->startNs + kSlackNs >= pSleep->startNs &&
+                         pInner->startNs + pInner->durationNs <= pSleep->startNs + pSleep->durationNs + kSlackNs;
+        printf( "conversion   5 ms sleep traced as %.3f ms\n", pSleep ? pSleep->durationNs / 1e6 : 0.0 );
+        if ( !convertOk )
+        {
+            printf( "             zones misplaced against the trace clock\n" );
+            ok = false;
+        }
+    }
+
+    return bench::finish( ok );
+}
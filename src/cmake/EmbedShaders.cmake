@@ -0,0 +1,151 @@
+# Extracts the MSL raw-string literals of one sample into .metal files,
+# compiles them to .metallib when the Metal toolchain is available and
+# writes a C++ file embedding both the source and the compiled library.
+#
+# Run in script mode:
+#   cmake -DSOURCE=<sample.cpp> -DNAME=<sample> -DOUTPUT_DIR=<dir>
+#         -DOUTPUT=<generated.cpp> [-DXCRUN=<path to xcrun>] -P EmbedShaders.cmake
+#
+# At runtime util::newShaderLibrary() matches a literal against the embedded
+# source and loads the precompiled library instead of compiling it. Without
+# a toolchain the metallib step is skipped and only the source is embedded,
+# so the sample compiles from source as before.
+
+cmake_minimum_required(VERSION 3.21)
+
+foreach(var SOURCE NAME OUTPUT_DIR OUTPUT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "EmbedShaders.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+file(READ ${SOURCE} contents)
+
+# Appends the bytes of a file to out_var as a C array initializer.
+function(hex_bytes file out_var)
+    file(READ ${file} hex HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," hex "${hex}")
+    string(REGEX REPLACE "(0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],0x[0-9a-f][0-9a-f],)" "\\1\n    " hex "${hex}")
+    set(${out_var} "${hex}" PARENT_SCOPE)
+endfunction()
+
+# MSL declarations of the structs the sample declares with
+# LEARN_METAL_SHADER_STRUCT, in source order, formatted exactly as
+# util::expandShaderTypes() emits them at runtime.
+set(shader_types "")
+string(REGEX MATCHALL "LEARN_METAL_SHADER_STRUCT\\( *[A-Za-z0-9_]+ *, *[A-Za-z0-9_]+ *\\)" structs "${contents}")
+foreach(struct IN LISTS structs)
+    string(REGEX REPLACE "^LEARN_METAL_SHADER_STRUCT\\( *([A-Za-z0-9_]+) *, *([A-Za-z0-9_]+) *\\)$" "\\1" struct_name "${struct}")
+    string(REGEX REPLACE "^LEARN_METAL_SHADER_STRUCT\\( *([A-Za-z0-9_]+) *, *([A-Za-z0-9_]+) *\\)$" "\\2" fields_macro "${struct}")
+    string(REGEX MATCH "#define ${fields_macro}\\( *FIELD *, *ARRAY *\\)([^\n]*\\\\\n)*[^\n]*" definition "${contents}")
+    if(NOT definition)
+        message(FATAL_ERROR "${SOURCE}: no field list ${fields_macro} for ${struct_name}")
+    endif()
+    string(REGEX MATCHALL "(FIELD|ARRAY)\\( *[A-Za-z0-9_]+ *, *[A-Za-z0-9_]+ *(, *[0-9]+ *)?\\)" fields "${definition}")
+    string(APPEND shader_types "struct ${struct_name}\n{\n")
+    foreach(field IN LISTS fields)
+        string(REGEX MATCH "^(FIELD|ARRAY)\\( *([A-Za-z0-9_]+) *, *([A-Za-z0-9_]+) *(, *([0-9]+) *)?\\)$" parsed "${field}")
+        if(CMAKE_MATCH_1 STREQUAL "ARRAY")
+            string(APPEND shader_types "    ${CMAKE_MATCH_2} ${CMAKE_MATCH_3}[${CMAKE_MATCH_5}];\n")
+        else()
+            string(APPEND shader_types "    ${CMAKE_MATCH_2} ${CMAKE_MATCH_3};\n")
+        endif()
+    endforeach()
+    string(APPEND shader_types "};\n\n")
+endforeach()
+
+# Kernels the samples compile with util::ShaderMath::Precise, because a CPU
+# reference must reproduce their results. A literal defining one of them is
+# compiled without fast math and recorded as such, so the runtime only loads
+# it for the same math mode.
+set(precise_kernels mandelbrot_set)
+
+set(arrays "")
+set(entries "")
+set(count 0)
+set(compiled 0)
+
+while(TRUE)
+    string(FIND "${contents}" "R\"(" begin)
+    if(begin EQUAL -1)
+        break()
+    endif()
+    math(EXPR begin "${begin} + 3")
+    string(SUBSTRING "${contents}" ${begin} -1 contents)
+    string(FIND "${contents}" ")\"" end)
+    if(end EQUAL -1)
+        message(FATAL_ERROR "${SOURCE}: unterminated raw string literal")
+    endif()
+    string(SUBSTRING "${contents}" 0 ${end} msl)
+    math(EXPR end "${end} + 2")
+    string(SUBSTRING "${contents}" ${end} -1 contents)
+
+    # Only Metal sources; other raw strings are left alone.
+    string(FIND "${msl}" "metal_stdlib" is_msl)
+    if(is_msl EQUAL -1)
+        continue()
+    endif()
+
+    set(stem ${OUTPUT_DIR}/${NAME}_${count})
+    # Embed the literal verbatim, without a trailing newline, so it compares
+    # equal to the string the sample passes at runtime. The compiler gets
+    # the source with the shared struct declarations expanded.
+    file(WRITE ${stem}.msl "${msl}")
+    hex_bytes(${stem}.msl source_hex)
+    string(REGEX REPLACE "[ \t]*#include \"shader_types.h\"[ \t\r]*\n" "${shader_types}" msl "${msl}")
+    file(WRITE ${stem}.metal "${msl}")
+    string(APPEND arrays "    const unsigned char kSource${count}[] = {\n    ${source_hex}\n    };\n\n")
+
+    set(math "Fast")
+    set(math_flags "")
+    foreach(kernel IN LISTS precise_kernels)
+        if(msl MATCHES "kernel[ \t\r\n]+void[ \t\r\n]+${kernel}[ \t\r\n]*\\(")
+            set(math "Precise")
+            set(math_flags -fno-fast-math)
+        endif()
+    endforeach()
+
+    set(library "nullptr, 0")
+    if(XCRUN)
+        execute_process(
+                COMMAND ${XCRUN} -sdk macosx metal -c ${math_flags} ${stem}.metal -o ${stem}.air
+                RESULT_VARIABLE result)
+        if(result EQUAL 0)
+            execute_process(
+                    COMMAND ${XCRUN} -sdk macosx metallib ${stem}.air -o ${stem}.metallib
+                    RESULT_VARIABLE result)
+        endif()
+        if(result EQUAL 0)
+            hex_bytes(${stem}.metallib library_hex)
+            string(APPEND arrays "    const unsigned char kLibrary${count}[] = {\n    ${library_hex}\n    };\n\n")
+            set(library "kLibrary${count}, sizeof( kLibrary${count} )")
+            math(EXPR compiled "${compiled} + 1")
+        else()
+            message(WARNING "${NAME}: could not compile ${stem}.metal, falling back to runtime compilation")
+        endif()
+    endif()
+
+    string(APPEND entries "        { kSource${count}, sizeof( kSource${count} ), ${library}, util::ShaderMath::${math} },\n")
+    math(EXPR count "${count} + 1")
+endwhile()
+
+set(generated "// Generated by EmbedShaders.cmake from ${SOURCE}. Do not edit.\n\n#include <common/EmbeddedShaders.hpp>\n")
+if(count GREATER 0)
+    string(APPEND generated "\nnamespace\n{\n${arrays}    const util::EmbeddedShader kShaders[] = {\n${entries}    };\n\n    const util::EmbeddedShaderRegistration kRegistration( kShaders, ${count} );\n}\n")
+endif()
+
+# Only touch the output when it changes to avoid needless recompiles.
+set(previous "")
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif()
+if(NOT previous STREQUAL generated)
+    file(WRITE ${OUTPUT} "${generated}")
+endif()
+
+if(NOT XCRUN AND count GREATER 0)
+    message(STATUS "${NAME}: extracted ${count} shader(s); no Metal toolchain, metallib step skipped")
+else()
+    message(STATUS "${NAME}: extracted ${count} shader(s), ${compiled} precompiled")
+endif()
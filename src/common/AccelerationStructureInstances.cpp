@@ -0,0 +1,46 @@
+#include "AccelerationStructureInstances.hpp"
+
+#include "AccelerationStructureMath.hpp"
+
+#include <cassert>
+#include <cstring>
+
+MTL::Buffer* util::newInstanceDescriptorBuffer( MTL::Device* pDevice, const SceneBvh& scene )
+{
+    const std::vector< InstanceDescriptor >& descriptors = scene.instanceDescriptors();
+    size_t size = descriptors.size() * sizeof( MTL::AccelerationStructureInstanceDescriptor );
+    MTL::Buffer* pBuffer = pDevice->newBuffer( size ? size : sizeof( MTL::AccelerationStructureInstanceDescriptor ), MTL::ResourceStorageModeShared );
+    memcpy( pBuffer->contents(), descriptors.data(), size );
+    return pBuffer;
+}
+
+MTL::InstanceAccelerationStructureDescriptor* util::newInstanceAccelerationStructureDescriptor( const SceneBvh& scene,
+                                                                                              MTL::Buffer* pInstanceBuffer,
+                                                                                              NS::Array* pMeshes )
+{
+    MTL::InstanceAccelerationStructureDescriptor* pDesc = MTL::InstanceAccelerationStructureDescriptor::alloc()->init();
+    pDesc->setInstanceDescriptorType( MTL::AccelerationStructureInstanceDescriptorTypeDefault );
+    pDesc->setInstanceDescriptorBuffer( pInstanceBuffer );
+    pDesc->setInstanceDescriptorStride( sizeof( MTL::AccelerationStructureInstanceDescriptor ) );
+    pDesc->setInstanceCount( scene.instanceCount() );
+    pDesc->setInstancedAccelerationStructures( pMeshes );
+    return pDesc;
+}
+
+void util::encodeAccelerationStructureUpdate( MTL::AccelerationStructureCommandEncoder* pEncoder, AccelerationStructureUpdate update,
+                                              MTL::AccelerationStructure* pStructure, MTL::AccelerationStructureDescriptor* pDescriptor,
+                                              MTL::Buffer* pScratch, NS::UInteger scratchOffset )
+{
+    switch ( update )
+    {
+        case AccelerationStructureUpdate::Keep:
+            break;
+        case AccelerationStructureUpdate::Refit:
+            assert( pDescriptor->usage() & MTL::AccelerationStructureUsageRefit );
+            pEncoder->refitAccelerationStructure( pStructure, pDescriptor, nullptr, pScratch, scratchOffset );
+            break;
+        case AccelerationStructureUpdate::Rebuild:
+            pEncoder->buildAccelerationStructure( pStructure, pDescriptor, pScratch, scratchOffset );
+            break;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "RefitScheduler.hpp"
+#include "SceneBvh.hpp"
+
+namespace util
+{
+    // Copies scene.instanceDescriptors() into a new shared buffer.
+    MTL::Buffer* newInstanceDescriptorBuffer( MTL::Device* pDevice, const SceneBvh& scene );
+
+    // Describes an instance acceleration structure over pInstanceBuffer, as
+    // filled by newInstanceDescriptorBuffer(). pMeshes holds one primitive
+    // acceleration structure per scene mesh, in addMesh() order.
+    MTL::InstanceAccelerationStructureDescriptor* newInstanceAccelerationStructureDescriptor( const SceneBvh& scene,
+                                                                                            MTL::Buffer* pInstanceBuffer,
+                                                                                            NS::Array* pMeshes );
+
+    // Encodes what RefitScheduler::action() chose for pStructure. Refits
+    // happen in place and need pDescriptor to include
+    // AccelerationStructureUsageRefit; pScratch must hold the larger of the
+    // build and refit scratch sizes from Device::accelerationStructureSizes().
+    void encodeAccelerationStructureUpdate( MTL::AccelerationStructureCommandEncoder* pEncoder, AccelerationStructureUpdate update,
+                                            MTL::AccelerationStructure* pStructure, MTL::AccelerationStructureDescriptor* pDescriptor,
+                                            MTL::Buffer* pScratch, NS::UInteger scratchOffset = 0 );
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "AccelerationStructureTypes.hpp"
+
+#include <cstddef>
+
+// Arithmetic for the packed types of MTLAccelerationStructureTypes.hpp,
+// which only come with constructors and operator[]. Single values use
+// plain inline code; the batch and reduction kernels forward to the
+// vectorized Metal-free versions in AccelerationStructureTypes.hpp, whose
+// structs share the Metal layouts.
+
+static_assert( sizeof( util::BoundingBox ) == sizeof( MTL::AxisAlignedBoundingBox ), "BoundingBox layout mismatch" );
+static_assert( offsetof( MTL::AxisAlignedBoundingBox, max ) == offsetof( util::BoundingBox, max ), "BoundingBox layout mismatch" );
+static_assert( sizeof( util::PackedTransform ) == sizeof( MTL::PackedFloat4x3 ), "PackedTransform layout mismatch" );
+static_assert( sizeof( util::InstanceDescriptor ) == sizeof( MTL::AccelerationStructureInstanceDescriptor ), "InstanceDescriptor layout mismatch" );
+static_assert( offsetof( util::InstanceDescriptor, options ) == offsetof( MTL::AccelerationStructureInstanceDescriptor, options ), "InstanceDescriptor layout mismatch" );
+static_assert( offsetof( util::InstanceDescriptor, mask ) == offsetof( MTL::AccelerationStructureInstanceDescriptor, mask ), "InstanceDescriptor layout mismatch" );
+static_assert( offsetof( util::InstanceDescriptor, intersectionFunctionTableOffset ) == offsetof( MTL::AccelerationStructureInstanceDescriptor, intersectionFunctionTableOffset ), "InstanceDescriptor layout mismatch" );
+static_assert( offsetof( util::InstanceDescriptor, accelerationStructureIndex ) == offsetof( MTL::AccelerationStructureInstanceDescriptor, accelerationStructureIndex ), "InstanceDescriptor layout mismatch" );
+
+namespace MTL
+{
+    inline PackedFloat3 operator+( const PackedFloat3& a, const PackedFloat3& b ) { return PackedFloat3( a.x + b.x, a.y + b.y, a.z + b.z ); }
+    inline PackedFloat3 operator-( const PackedFloat3& a, const PackedFloat3& b ) { return PackedFloat3( a.x - b.x, a.y - b.y, a.z - b.z ); }
+    inline PackedFloat3 operator-( const PackedFloat3& a ) { return PackedFloat3( -a.x, -a.y, -a.z ); }
+    inline PackedFloat3 operator*( const PackedFloat3& a, const PackedFloat3& b ) { return PackedFloat3( a.x * b.x, a.y * b.y, a.z * b.z ); }
+    inline PackedFloat3 operator*( const PackedFloat3& a, float s ) { return PackedFloat3( a.x * s, a.y * s, a.z * s ); }
+    inline PackedFloat3 operator*( float s, const PackedFloat3& a ) { return a * s; }
+    inline PackedFloat3& operator+=( PackedFloat3& a, const PackedFloat3& b ) { return a = a + b; }
+    inline PackedFloat3& operator-=( PackedFloat3& a, const PackedFloat3& b ) { return a = a - b; }
+    inline PackedFloat3& operator*=( PackedFloat3& a, float s ) { return a = a * s; }
+    inline bool operator==( const PackedFloat3& a, const PackedFloat3& b ) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    inline bool operator!=( const PackedFloat3& a, const PackedFloat3& b ) { return !( a == b ); }
+
+    // Affine transform of a point.
+    inline PackedFloat3 operator*( const PackedFloat4x3& m, const PackedFloat3& p )
+    {
+        return m[ 0 ] * p.x + m[ 1 ] * p.y + m[ 2 ] * p.z + m[ 3 ];
+    }
+}
+
+namespace util
+{
+    inline MTL::PackedFloat3 min( const MTL::PackedFloat3& a, const MTL::PackedFloat3& b )
+    {
+        return MTL::PackedFloat3( a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z );
+    }
+
+    inline MTL::PackedFloat3 max( const MTL::PackedFloat3& a, const MTL::PackedFloat3& b )
+    {
+        return MTL::PackedFloat3( a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z );
+    }
+
+    inline float dot( const MTL::PackedFloat3& a, const MTL::PackedFloat3& b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    inline const BoundingBox& asBounds( const MTL::AxisAlignedBoundingBox& box ) { return reinterpret_cast< const BoundingBox& >( box ); }
+    inline MTL::AxisAlignedBoundingBox asMtl( const BoundingBox& box ) { return reinterpret_cast< const MTL::AxisAlignedBoundingBox& >( box ); }
+    inline const PackedTransform& asTransform( const MTL::PackedFloat4x3& m ) { return reinterpret_cast< const PackedTransform& >( m ); }
+
+    inline bool isEmpty( const MTL::AxisAlignedBoundingBox& box ) { return isEmpty( asBounds( box ) ); }
+
+    inline MTL::AxisAlignedBoundingBox merge( const MTL::AxisAlignedBoundingBox& a, const MTL::AxisAlignedBoundingBox& b )
+    {
+        return MTL::AxisAlignedBoundingBox( min( a.min, b.min ), max( a.max, b.max ) );
+    }
+
+    inline MTL::AxisAlignedBoundingBox expand( const MTL::AxisAlignedBoundingBox& box, const MTL::PackedFloat3& p )
+    {
+        return MTL::AxisAlignedBoundingBox( min( box.min, p ), max( box.max, p ) );
+    }
+
+    inline MTL::AxisAlignedBoundingBox intersect( const MTL::AxisAlignedBoundingBox& a, const MTL::AxisAlignedBoundingBox& b )
+    {
+        return MTL::AxisAlignedBoundingBox( max( a.min, b.min ), min( a.max, b.max ) );
+    }
+
+    inline bool overlaps( const MTL::AxisAlignedBoundingBox& a, const MTL::AxisAlignedBoundingBox& b )
+    {
+        return !isEmpty( intersect( a, b ) );
+    }
+
+    inline MTL::AxisAlignedBoundingBox transformBounds( const MTL::AxisAlignedBoundingBox& box, const MTL::PackedFloat4x3& m )
+    {
+        return asMtl( transformBounds( asBounds( box ), asTransform( m ) ) );
+    }
+
+    inline void transformBounds( const MTL::AxisAlignedBoundingBox* pBoxes, const MTL::PackedFloat4x3* pTransforms, size_t count,
+                                 MTL::AxisAlignedBoundingBox* pOut )
+    {
+        transformBounds( reinterpret_cast< const BoundingBox* >( pBoxes ), reinterpret_cast< const PackedTransform* >( pTransforms ),
+                         count, reinterpret_cast< BoundingBox* >( pOut ) );
+    }
+
+    inline MTL::AxisAlignedBoundingBox mergeBounds( const MTL::AxisAlignedBoundingBox* pBoxes, size_t count )
+    {
+        return asMtl( mergeBounds( reinterpret_cast< const BoundingBox* >( pBoxes ), count ) );
+    }
+
+    inline MTL::AxisAlignedBoundingBox computeBounds( const MTL::PackedFloat3* pPoints, size_t count )
+    {
+        return asMtl( computeBounds( &pPoints->x, count, sizeof( MTL::PackedFloat3 ) ) );
+    }
+
+    // From column major float4x4s such as the samples' instance transforms
+    // (math::float4x4 or simd::float4x4).
+    inline void packTransforms( const float* pColumnMajor4x4, size_t count, MTL::PackedFloat4x3* pOut )
+    {
+        packTransforms( pColumnMajor4x4, count, reinterpret_cast< PackedTransform* >( pOut ) );
+    }
+}
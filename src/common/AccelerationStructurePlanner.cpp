@@ -0,0 +1,178 @@
+#include "AccelerationStructurePlanner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace
+{
+    inline uint64_t alignUp( uint64_t value, uint64_t alignment )
+    {
+        return ( value + alignment - 1 ) / alignment * alignment;
+    }
+}
+
+util::HeapAllocator::HeapAllocator( uint64_t heapSize )
+: _heapSize( heapSize )
+, _reservedSize( 0 )
+, _usedSize( 0 )
+{
+}
+
+bool util::HeapAllocator::allocateIn( uint32_t heap, uint64_t size, uint64_t alignment, HeapAllocation* pOut )
+{
+    std::vector< Range >& ranges = _heaps[ heap ].freeRanges;
+    for ( size_t i = 0; i < ranges.size(); ++i )
+    {
+        Range r = ranges[ i ];
+        uint64_t offset = alignUp( r.offset, alignment );
+        if ( offset + size > r.offset + r.size )
+        {
+            continue;
+        }
+
+        // What alignment skipped stays free in front, the rest behind.
+        Range before = { r.offset, offset - r.offset };
+        Range after = { offset + size, r.offset + r.size - offset - size };
+        if ( before.size && after.size )
+        {
+            ranges[ i ] = before;
+            ranges.insert( ranges.begin() + i + 1, after );
+        }
+        else if ( before.size || after.size )
+        {
+            ranges[ i ] = before.size ? before : after;
+        }
+        else
+        {
+            ranges.erase( ranges.begin() + i );
+        }
+
+        pOut->heap = heap;
+        pOut->offset = offset;
+        pOut->size = size;
+        _usedSize += size;
+        return true;
+    }
+    return false;
+}
+
+util::HeapAllocation util::HeapAllocator::allocate( uint64_t size, uint64_t alignment )
+{
+    assert( size > 0 && alignment > 0 );
+    HeapAllocation a;
+    for ( uint32_t heap = 0; heap < _heaps.size(); ++heap )
+    {
+        if ( allocateIn( heap, size, alignment, &a ) )
+        {
+            return a;
+        }
+    }
+
+    // Heaps start at offset 0, which satisfies any alignment.
+    uint64_t heapSize = std::max( _heapSize, size );
+    _heaps.push_back( { heapSize, { { 0, heapSize } } } );
+    _reservedSize += heapSize;
+    bool allocated = allocateIn( (uint32_t)_heaps.size() - 1, size, alignment, &a );
+    assert( allocated );
+    (void)allocated;
+    return a;
+}
+
+void util::HeapAllocator::free( const HeapAllocation& allocation )
+{
+    if ( allocation.heap == HeapAllocation::kNoHeap )
+    {
+        return;
+    }
+    assert( allocation.heap < _heaps.size() );
+    std::vector< Range >& ranges = _heaps[ allocation.heap ].freeRanges;
+    auto it = std::lower_bound( ranges.begin(), ranges.end(), allocation.offset, []( const Range& r, uint64_t offset ){
+        return r.offset < offset;
+    } );
+    assert( it == ranges.end() || allocation.offset + allocation.size <= it->offset );
+    assert( it == ranges.begin() || ( it - 1 )->offset + ( it - 1 )->size <= allocation.offset );
+
+    bool mergeBefore = it != ranges.begin() && ( it - 1 )->offset + ( it - 1 )->size == allocation.offset;
+    bool mergeAfter = it != ranges.end() && allocation.offset + allocation.size == it->offset;
+    if ( mergeBefore && mergeAfter )
+    {
+        ( it - 1 )->size += allocation.size + it->size;
+        ranges.erase( it );
+    }
+    else if ( mergeBefore )
+    {
+        ( it - 1 )->size += allocation.size;
+    }
+    else if ( mergeAfter )
+    {
+        it->offset = allocation.offset;
+        it->size += allocation.size;
+    }
+    else
+    {
+        ranges.insert( it, { allocation.offset, allocation.size } );
+    }
+    _usedSize -= allocation.size;
+}
+
+util::ScratchPlan util::planScratch( const uint64_t* pScratchSizes, size_t count, uint64_t scratchBudget )
+{
+    ScratchPlan plan;
+    plan.offsets.resize( count );
+    plan.waves.resize( count );
+    if ( count == 0 )
+    {
+        return plan;
+    }
+
+    std::vector< uint32_t > order( count );
+    std::iota( order.begin(), order.end(), 0u );
+    std::stable_sort( order.begin(), order.end(), [pScratchSizes]( uint32_t a, uint32_t b ){
+        return pScratchSizes[ a ] > pScratchSizes[ b ];
+    } );
+    uint64_t capacity = std::max( scratchBudget, alignUp( pScratchSizes[ order[ 0 ] ], kScratchAlignment ) );
+
+    // First fit decreasing; a wave's next free offset is its fill level.
+    std::vector< uint64_t > fill;
+    for ( uint32_t build : order )
+    {
+        uint64_t size = alignUp( pScratchSizes[ build ], kScratchAlignment );
+        uint32_t wave = 0;
+        while ( wave < fill.size() && fill[ wave ] + size > capacity )
+        {
+            ++wave;
+        }
+        if ( wave == fill.size() )
+        {
+            fill.push_back( 0 );
+        }
+        plan.offsets[ build ] = fill[ wave ];
+        plan.waves[ build ] = wave;
+        fill[ wave ] += size;
+    }
+
+    plan.waveCount = (uint32_t)fill.size();
+    plan.size = *std::max_element( fill.begin(), fill.end() );
+    return plan;
+}
+
+uint64_t util::planCompaction( const uint64_t* pSizes, const uint64_t* pCompactedSizes, size_t count, float minSaving,
+                               std::vector< uint32_t >* pOut )
+{
+    uint64_t saved = 0;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        if ( pCompactedSizes[ i ] == 0 || pCompactedSizes[ i ] >= pSizes[ i ] )
+        {
+            continue;
+        }
+        uint64_t saving = pSizes[ i ] - pCompactedSizes[ i ];
+        if ( (double)saving >= (double)minSaving * (double)pSizes[ i ] )
+        {
+            pOut->push_back( (uint32_t)i );
+            saved += saving;
+        }
+    }
+    return saved;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    struct HeapAllocation
+    {
+        static constexpr uint32_t kNoHeap = UINT32_MAX;
+
+        uint32_t heap = kNoHeap;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // Offsets inside placement heaps, the device independent half of
+    // AccelerationStructurePool. Heaps are identified by index and all have
+    // heapSize bytes except those made for a larger request, which get one
+    // of their own. Free ranges are kept sorted and merged with their
+    // neighbours, and allocations take the first range they fit in.
+    class HeapAllocator
+    {
+        public:
+            explicit HeapAllocator( uint64_t heapSize );
+
+            // When no heap has room a new one is appended; the caller
+            // creates it with heapSize( allocation.heap ) bytes.
+            HeapAllocation allocate( uint64_t size, uint64_t alignment );
+            void free( const HeapAllocation& allocation );
+
+            size_t heapCount() const { return _heaps.size(); }
+            uint64_t heapSize( uint32_t heap ) const { return _heaps[ heap ].size; }
+            uint64_t reservedSize() const { return _reservedSize; }
+            uint64_t usedSize() const { return _usedSize; }
+            size_t freeRangeCount( uint32_t heap ) const { return _heaps[ heap ].freeRanges.size(); }
+
+        private:
+            struct Range
+            {
+                uint64_t offset;
+                uint64_t size;
+            };
+
+            struct Heap
+            {
+                uint64_t size;
+                std::vector< Range > freeRanges;
+            };
+
+            bool allocateIn( uint32_t heap, uint64_t size, uint64_t alignment, HeapAllocation* pOut );
+
+            uint64_t _heapSize;
+            uint64_t _reservedSize;
+            uint64_t _usedSize;
+            std::vector< Heap > _heaps;
+    };
+
+    // Where each build of a batch puts its scratch memory. Builds are
+    // grouped into waves that run side by side on disjoint ranges of one
+    // scratch buffer; waves run one after another and reuse it.
+    struct ScratchPlan
+    {
+        std::vector< uint64_t > offsets;  // per build
+        std::vector< uint32_t > waves;    // per build
+        uint32_t waveCount = 0;
+        uint64_t size = 0;                // of the shared scratch buffer
+    };
+
+    // Scratch offsets must be aligned to this.
+    static constexpr uint64_t kScratchAlignment = 256;
+
+    // Packs the builds, largest first, into as few waves as fit
+    // max( scratchBudget, largest scratch size ). With a budget of 0 the
+    // buffer is exactly the size of the largest, and smaller builds share
+    // waves only where they fit beside each other in it.
+    ScratchPlan planScratch( const uint64_t* pScratchSizes, size_t count, uint64_t scratchBudget );
+
+    // Appends the builds worth compacting to pOut: those whose compacted
+    // size saves at least minSaving of their original size, since each
+    // compaction costs a copy and, until it finishes, both allocations.
+    // Returns the bytes saved.
+    uint64_t planCompaction( const uint64_t* pSizes, const uint64_t* pCompactedSizes, size_t count, float minSaving,
+                             std::vector< uint32_t >* pOut );
+}
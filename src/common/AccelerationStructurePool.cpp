@@ -0,0 +1,244 @@
+#include "AccelerationStructurePool.hpp"
+
+#include <objc/message.h>
+#include <objc/runtime.h>
+
+#include <algorithm>
+
+namespace
+{
+    // The metal-cpp in this tree predates placing acceleration structures
+    // in heaps (macOS 13), so these two go through the runtime directly.
+    // SizeAndAlign comes back in registers on both arm64 and x86_64.
+    MTL::SizeAndAlign heapAccelerationStructureSizeAndAlign( MTL::Device* pDevice, NS::UInteger size )
+    {
+        using Fn = MTL::SizeAndAlign (*)( const void*, SEL, NS::UInteger );
+        return reinterpret_cast< Fn >( &objc_msgSend )( pDevice, sel_registerName( "heapAccelerationStructureSizeAndAlignWithSize:" ), size );
+    }
+
+    MTL::AccelerationStructure* newAccelerationStructure( MTL::Heap* pHeap, NS::UInteger size, NS::UInteger offset )
+    {
+        using Fn = MTL::AccelerationStructure* (*)( const void*, SEL, NS::UInteger, NS::UInteger );
+        return reinterpret_cast< Fn >( &objc_msgSend )( pHeap, sel_registerName( "newAccelerationStructureWithSize:offset:" ), size, offset );
+    }
+
+    bool finished( MTL::CommandBuffer* pCommandBuffer )
+    {
+        MTL::CommandBufferStatus status = pCommandBuffer->status();
+        return status == MTL::CommandBufferStatusCompleted || status == MTL::CommandBufferStatusError;
+    }
+}
+
+util::AccelerationStructurePool::AccelerationStructurePool( MTL::Device* pDevice, NS::UInteger heapSize, NS::UInteger scratchBudget,
+                                                            float minCompactionSaving )
+: _pDevice( pDevice->retain() )
+, _scratchBudget( scratchBudget )
+, _minCompactionSaving( minCompactionSaving )
+, _allocator( heapSize )
+, _pScratch( nullptr )
+, _bytesCompacted( 0 )
+{
+}
+
+util::AccelerationStructurePool::~AccelerationStructurePool()
+{
+    for ( Retired& r : _retired )
+    {
+        for ( MTL::AccelerationStructure* pStructure : r.structures )
+        {
+            pStructure->release();
+        }
+        r.pCommandBuffer->release();
+    }
+    for ( Batch& b : _batches )
+    {
+        b.pCommandBuffer->release();
+        b.pSizes->release();
+    }
+    for ( Entry& e : _entries )
+    {
+        if ( e.pStructure )
+        {
+            e.pStructure->release();
+        }
+        e.pDescriptor->release();
+    }
+    for ( MTL::Heap* pHeap : _heaps )
+    {
+        pHeap->release();
+    }
+    if ( _pScratch )
+    {
+        _pScratch->release();
+    }
+    _pDevice->release();
+}
+
+uint32_t util::AccelerationStructurePool::add( MTL::AccelerationStructureDescriptor* pDescriptor, bool compact )
+{
+    _entries.push_back( { pDescriptor->retain(), nullptr, HeapAllocation(), compact } );
+    _pending.push_back( (uint32_t)_entries.size() - 1 );
+    return _pending.back();
+}
+
+MTL::AccelerationStructure* util::AccelerationStructurePool::place( NS::UInteger size, HeapAllocation* pStorage )
+{
+    MTL::SizeAndAlign sa = heapAccelerationStructureSizeAndAlign( _pDevice, size );
+    *pStorage = _allocator.allocate( sa.size, sa.align );
+    while ( _heaps.size() < _allocator.heapCount() )
+    {
+        MTL::HeapDescriptor* pDesc = MTL::HeapDescriptor::alloc()->init();
+        pDesc->setType( MTL::HeapTypePlacement );
+        pDesc->setStorageMode( MTL::StorageModePrivate );
+        pDesc->setHazardTrackingMode( MTL::HazardTrackingModeTracked );
+        pDesc->setSize( _allocator.heapSize( (uint32_t)_heaps.size() ) );
+        _heaps.push_back( _pDevice->newHeap( pDesc ) );
+        pDesc->release();
+    }
+    return newAccelerationStructure( _heaps[ pStorage->heap ], size, pStorage->offset );
+}
+
+void util::AccelerationStructurePool::collect()
+{
+    auto done = std::partition( _retired.begin(), _retired.end(), []( const Retired& r ){
+        return !finished( r.pCommandBuffer );
+    } );
+    for ( auto it = done; it != _retired.end(); ++it )
+    {
+        for ( MTL::AccelerationStructure* pStructure : it->structures )
+        {
+            pStructure->release();
+        }
+        for ( const HeapAllocation& storage : it->storage )
+        {
+            _allocator.free( storage );
+        }
+        it->pCommandBuffer->release();
+    }
+    _retired.erase( done, _retired.end() );
+}
+
+void util::AccelerationStructurePool::encodeBuilds( MTL::CommandBuffer* pCommandBuffer )
+{
+    collect();
+    if ( _pending.empty() )
+    {
+        return;
+    }
+
+    std::vector< uint64_t > scratchSizes( _pending.size() );
+    for ( size_t i = 0; i < _pending.size(); ++i )
+    {
+        Entry& e = _entries[ _pending[ i ] ];
+        MTL::AccelerationStructureSizes sizes = _pDevice->accelerationStructureSizes( e.pDescriptor );
+        e.pStructure = place( sizes.accelerationStructureSize, &e.storage );
+        scratchSizes[ i ] = sizes.buildScratchBufferSize;
+    }
+
+    ScratchPlan plan = planScratch( scratchSizes.data(), scratchSizes.size(), _scratchBudget );
+    if ( scratchSize() < plan.size )
+    {
+        // Builds already encoded keep the old buffer alive until they finish.
+        if ( _pScratch )
+        {
+            _pScratch->release();
+        }
+        _pScratch = _pDevice->newBuffer( plan.size, MTL::ResourceStorageModePrivate );
+    }
+
+    // One encoder per wave; the scratch buffer is tracked, so each waits for
+    // the wave before it to stop using its ranges.
+    for ( uint32_t wave = 0; wave < plan.waveCount; ++wave )
+    {
+        MTL::AccelerationStructureCommandEncoder* pEnc = pCommandBuffer->accelerationStructureCommandEncoder();
+        for ( size_t i = 0; i < _pending.size(); ++i )
+        {
+            if ( plan.waves[ i ] == wave )
+            {
+                const Entry& e = _entries[ _pending[ i ] ];
+                pEnc->buildAccelerationStructure( e.pStructure, e.pDescriptor, _pScratch, plan.offsets[ i ] );
+            }
+        }
+        pEnc->endEncoding();
+    }
+
+    Batch batch = { nullptr, nullptr, {} };
+    for ( uint32_t handle : _pending )
+    {
+        if ( _entries[ handle ].compact )
+        {
+            batch.handles.push_back( handle );
+        }
+    }
+    _pending.clear();
+    if ( batch.handles.empty() )
+    {
+        return;
+    }
+
+    batch.pSizes = _pDevice->newBuffer( batch.handles.size() * sizeof( uint32_t ), MTL::ResourceStorageModeShared );
+    MTL::AccelerationStructureCommandEncoder* pEnc = pCommandBuffer->accelerationStructureCommandEncoder();
+    for ( size_t i = 0; i < batch.handles.size(); ++i )
+    {
+        pEnc->writeCompactedAccelerationStructureSize( _entries[ batch.handles[ i ] ].pStructure, batch.pSizes, i * sizeof( uint32_t ) );
+    }
+    pEnc->endEncoding();
+    batch.pCommandBuffer = pCommandBuffer->retain();
+    _batches.push_back( std::move( batch ) );
+}
+
+void util::AccelerationStructurePool::encodeCompaction( MTL::CommandBuffer* pCommandBuffer )
+{
+    collect();
+    Retired retired = { nullptr, {}, {} };
+    MTL::AccelerationStructureCommandEncoder* pEnc = nullptr;
+    std::vector< uint64_t > sizes;
+    std::vector< uint64_t > compactedSizes;
+    std::vector< uint32_t > chosen;
+
+    auto ready = std::partition( _batches.begin(), _batches.end(), []( const Batch& b ){
+        return !finished( b.pCommandBuffer );
+    } );
+    for ( auto it = ready; it != _batches.end(); ++it )
+    {
+        if ( it->pCommandBuffer->status() == MTL::CommandBufferStatusCompleted )
+        {
+            sizes.clear();
+            compactedSizes.clear();
+            chosen.clear();
+            const uint32_t* pCompacted = static_cast< const uint32_t* >( it->pSizes->contents() );
+            for ( size_t i = 0; i < it->handles.size(); ++i )
+            {
+                sizes.push_back( _entries[ it->handles[ i ] ].pStructure->size() );
+                compactedSizes.push_back( pCompacted[ i ] );
+            }
+            _bytesCompacted += planCompaction( sizes.data(), compactedSizes.data(), sizes.size(), _minCompactionSaving, &chosen );
+
+            for ( uint32_t i : chosen )
+            {
+                Entry& e = _entries[ it->handles[ i ] ];
+                HeapAllocation storage;
+                MTL::AccelerationStructure* pCompact = place( compactedSizes[ i ], &storage );
+                if ( !pEnc )
+                {
+                    pEnc = pCommandBuffer->accelerationStructureCommandEncoder();
+                }
+                pEnc->copyAndCompactAccelerationStructure( e.pStructure, pCompact );
+                retired.structures.push_back( e.pStructure );
+                retired.storage.push_back( e.storage );
+                e.pStructure = pCompact;
+                e.storage = storage;
+            }
+        }
+        it->pCommandBuffer->release();
+        it->pSizes->release();
+    }
+    _batches.erase( ready, _batches.end() );
+
+    if ( pEnc )
+    {
+        pEnc->endEncoding();
+        retired.pCommandBuffer = pCommandBuffer->retain();
+        _retired.push_back( std::move( retired ) );
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "AccelerationStructurePlanner.hpp"
+
+#include <vector>
+
+namespace util
+{
+    // Acceleration structures placed in shared heaps rather than one
+    // allocation each. Builds queued with add() are encoded a batch at a
+    // time on one reused scratch buffer, and every batch asks for its
+    // compacted sizes in the same command buffer:
+    //
+    //     uint32_t mesh = pool.add( pDescriptor );
+    //     pool.encodeBuilds( pCmd );      // frame N
+    //     ...
+    //     pool.encodeCompaction( pCmd );  // any later frame
+    //
+    // encodeCompaction() copies the structures of every batch whose builds
+    // have completed into smaller allocations; structure() then returns the
+    // copy. The storage replaced is freed once that command buffer
+    // completes. Heaps track hazards as a whole, so readers need only
+    // useHeap() on heaps().
+    class AccelerationStructurePool
+    {
+        public:
+            AccelerationStructurePool( MTL::Device* pDevice, NS::UInteger heapSize = 64 << 20, NS::UInteger scratchBudget = 0,
+                                       float minCompactionSaving = 0.1f );
+            ~AccelerationStructurePool();
+
+            uint32_t add( MTL::AccelerationStructureDescriptor* pDescriptor, bool compact = true );
+            MTL::AccelerationStructure* structure( uint32_t handle ) const { return _entries[ handle ].pStructure; }
+
+            void encodeBuilds( MTL::CommandBuffer* pCommandBuffer );
+            void encodeCompaction( MTL::CommandBuffer* pCommandBuffer );
+
+            const std::vector< MTL::Heap* >& heaps() const { return _heaps; }
+            const HeapAllocator& allocator() const { return _allocator; }
+            NS::UInteger scratchSize() const { return _pScratch ? _pScratch->length() : 0; }
+            uint64_t bytesCompacted() const { return _bytesCompacted; }
+
+        private:
+            struct Entry
+            {
+                MTL::AccelerationStructureDescriptor* pDescriptor;
+                MTL::AccelerationStructure* pStructure;
+                HeapAllocation storage;
+                bool compact;
+            };
+
+            // Builds waiting for their compacted sizes.
+            struct Batch
+            {
+                MTL::CommandBuffer* pCommandBuffer;
+                MTL::Buffer* pSizes;
+                std::vector< uint32_t > handles;
+            };
+
+            // Storage replaced by compaction, freed once pCommandBuffer
+            // completes.
+            struct Retired
+            {
+                MTL::CommandBuffer* pCommandBuffer;
+                std::vector< MTL::AccelerationStructure* > structures;
+                std::vector< HeapAllocation > storage;
+            };
+
+            MTL::AccelerationStructure* place( NS::UInteger size, HeapAllocation* pStorage );
+            void collect();
+
+            MTL::Device* _pDevice;
+            NS::UInteger _scratchBudget;
+            float _minCompactionSaving;
+            HeapAllocator _allocator;
+            std::vector< MTL::Heap* > _heaps;
+            MTL::Buffer* _pScratch;
+            std::vector< Entry > _entries;
+            std::vector< uint32_t > _pending;
+            std::vector< Batch > _batches;
+            std::vector< Retired > _retired;
+            uint64_t _bytesCompacted;
+    };
+}
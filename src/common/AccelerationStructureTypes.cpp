@@ -0,0 +1,188 @@
+#include "AccelerationStructureTypes.hpp"
+
+#include <cstring>
+
+// Four-lane vectors through the GCC/Clang vector extension, as in
+// InstanceTransforms.cpp. Packed float3s are loaded into ( x, y, z, 0 ).
+
+namespace
+{
+    typedef float f32x4 __attribute__(( vector_size( 16 ) ));
+    typedef int32_t i32x4 __attribute__(( vector_size( 16 ) ));
+
+    inline f32x4 splat( float v ) { return f32x4{ v, v, v, v }; }
+
+    inline f32x4 load3( const float* p )
+    {
+        f32x4 v = {};
+        memcpy( &v, p, 3 * sizeof( float ) );
+        return v;
+    }
+
+    inline f32x4 load4( const float* p )
+    {
+        f32x4 v;
+        memcpy( &v, p, sizeof( v ) );
+        return v;
+    }
+
+    inline void store3( f32x4 v, float* p ) { memcpy( p, &v, 3 * sizeof( float ) ); }
+    inline void store4( f32x4 v, float* p ) { memcpy( p, &v, sizeof( v ) ); }
+
+    inline f32x4 select( i32x4 mask, f32x4 a, f32x4 b )
+    {
+        return (f32x4)( ( (i32x4)a & mask ) | ( (i32x4)b & ~mask ) );
+    }
+
+    inline f32x4 vmin( f32x4 a, f32x4 b ) { return select( a < b, a, b ); }
+    inline f32x4 vmax( f32x4 a, f32x4 b ) { return select( a > b, a, b ); }
+
+    inline util::BoundingBox storeBox( f32x4 lo, f32x4 hi )
+    {
+        util::BoundingBox r;
+        store3( lo, r.min );
+        store3( hi, r.max );
+        return r;
+    }
+
+    // Arvo's method: the new centre is the transformed centre and each new
+    // half extent sums the absolute matrix row times the old extents.
+    inline util::BoundingBox transform( const util::BoundingBox& box, const util::PackedTransform& t )
+    {
+        if ( util::isEmpty( box ) )
+        {
+            return box;
+        }
+        f32x4 lo = load3( box.min );
+        f32x4 hi = load3( box.max );
+        f32x4 center = ( lo + hi ) * splat( 0.5f );
+        f32x4 extent = ( hi - lo ) * splat( 0.5f );
+        f32x4 newCenter = load3( t.columns[ 3 ] );
+        f32x4 newExtent = splat( 0.0f );
+        for ( int c = 0; c < 3; ++c )
+        {
+            f32x4 column = load3( t.columns[ c ] );
+            newCenter += column * center[ c ];
+            newExtent += vmax( column, -column ) * extent[ c ];
+        }
+        return storeBox( newCenter - newExtent, newCenter + newExtent );
+    }
+
+    // Twelve of the sixteen floats, as three 16-byte stores. The last lane
+    // of each column is dropped by the shuffles.
+    inline void pack( const float* m, float* pOut )
+    {
+        f32x4 c0 = load4( m );
+        f32x4 c1 = load4( m + 4 );
+        f32x4 c2 = load4( m + 8 );
+        f32x4 c3 = load4( m + 12 );
+        store4( __builtin_shufflevector( c0, c1, 0, 1, 2, 4 ), pOut );
+        store4( __builtin_shufflevector( c1, c2, 1, 2, 4, 5 ), pOut + 4 );
+        store4( __builtin_shufflevector( c2, c3, 2, 4, 5, 6 ), pOut + 8 );
+    }
+}
+
+util::BoundingBox util::computeBounds( const float* pPositions, size_t count, size_t stride )
+{
+    // Two accumulators to overlap the dependent min/max chains.
+    f32x4 loA = splat( INFINITY ), hiA = splat( -INFINITY );
+    f32x4 loB = loA, hiB = hiA;
+    const char* p = reinterpret_cast< const char* >( pPositions );
+    size_t i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+    {
+        f32x4 a = load3( reinterpret_cast< const float* >( p + i * stride ) );
+        f32x4 b = load3( reinterpret_cast< const float* >( p + ( i + 1 ) * stride ) );
+        loA = vmin( loA, a );
+        hiA = vmax( hiA, a );
+        loB = vmin( loB, b );
+        hiB = vmax( hiB, b );
+    }
+    if ( i < count )
+    {
+        f32x4 a = load3( reinterpret_cast< const float* >( p + i * stride ) );
+        loA = vmin( loA, a );
+        hiA = vmax( hiA, a );
+    }
+    return storeBox( vmin( loA, loB ), vmax( hiA, hiB ) );
+}
+
+util::BoundingBox util::mergeBounds( const BoundingBox* pBoxes, size_t count )
+{
+    f32x4 loA = splat( INFINITY ), hiA = splat( -INFINITY );
+    f32x4 loB = loA, hiB = hiA;
+    size_t i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+    {
+        loA = vmin( loA, load3( pBoxes[ i ].min ) );
+        hiA = vmax( hiA, load3( pBoxes[ i ].max ) );
+        loB = vmin( loB, load3( pBoxes[ i + 1 ].min ) );
+        hiB = vmax( hiB, load3( pBoxes[ i + 1 ].max ) );
+    }
+    if ( i < count )
+    {
+        loA = vmin( loA, load3( pBoxes[ i ].min ) );
+        hiA = vmax( hiA, load3( pBoxes[ i ].max ) );
+    }
+    return storeBox( vmin( loA, loB ), vmax( hiA, hiB ) );
+}
+
+void util::minMax( const float* pValues, size_t count, float* pMin, float* pMax )
+{
+    f32x4 loA = splat( INFINITY ), hiA = splat( -INFINITY );
+    f32x4 loB = loA, hiB = hiA;
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        f32x4 a = load4( pValues + i );
+        f32x4 b = load4( pValues + i + 4 );
+        loA = vmin( loA, a );
+        hiA = vmax( hiA, a );
+        loB = vmin( loB, b );
+        hiB = vmax( hiB, b );
+    }
+    f32x4 lo = vmin( loA, loB );
+    f32x4 hi = vmax( hiA, hiB );
+    float resultMin = lo[ 0 ] < lo[ 1 ] ? lo[ 0 ] : lo[ 1 ];
+    float resultMax = hi[ 0 ] > hi[ 1 ] ? hi[ 0 ] : hi[ 1 ];
+    for ( int k = 2; k < 4; ++k )
+    {
+        resultMin = lo[ k ] < resultMin ? lo[ k ] : resultMin;
+        resultMax = hi[ k ] > resultMax ? hi[ k ] : resultMax;
+    }
+    for ( ; i < count; ++i )
+    {
+        resultMin = pValues[ i ] < resultMin ? pValues[ i ] : resultMin;
+        resultMax = pValues[ i ] > resultMax ? pValues[ i ] : resultMax;
+    }
+    *pMin = resultMin;
+    *pMax = resultMax;
+}
+
+util::BoundingBox util::transformBounds( const BoundingBox& box, const PackedTransform& t )
+{
+    return transform( box, t );
+}
+
+void util::transformBounds( const BoundingBox* pBoxes, const PackedTransform* pTransforms, size_t count, BoundingBox* pOut )
+{
+    for ( size_t i = 0; i < count; ++i )
+    {
+        pOut[ i ] = transform( pBoxes[ i ], pTransforms[ i ] );
+    }
+}
+
+util::PackedTransform util::packTransform( const float* pColumnMajor4x4 )
+{
+    PackedTransform t;
+    pack( pColumnMajor4x4, &t.columns[ 0 ][ 0 ] );
+    return t;
+}
+
+void util::packTransforms( const float* pColumnMajor4x4, size_t count, PackedTransform* pOut )
+{
+    for ( size_t i = 0; i < count; ++i )
+    {
+        pack( pColumnMajor4x4 + i * 16, &pOut[ i ].columns[ 0 ][ 0 ] );
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+    // Layout of MTL::AxisAlignedBoundingBox. Empty boxes have min > max.
+    struct BoundingBox
+    {
+        float min[ 3 ];
+        float max[ 3 ];
+    };
+    static_assert( sizeof( BoundingBox ) == 24, "BoundingBox must match MTL::AxisAlignedBoundingBox" );
+
+    // Layout of MTL::PackedFloat4x3: the four columns of an affine transform,
+    // each a packed float3.
+    struct PackedTransform
+    {
+        float columns[ 4 ][ 3 ];
+    };
+    static_assert( sizeof( PackedTransform ) == 48, "PackedTransform must match MTL::PackedFloat4x3" );
+
+    // Layout of MTL::AccelerationStructureInstanceDescriptor.
+    struct InstanceDescriptor
+    {
+        PackedTransform transformationMatrix;
+        uint32_t options;
+        uint32_t mask;
+        uint32_t intersectionFunctionTableOffset;
+        uint32_t accelerationStructureIndex;
+    };
+    static_assert( sizeof( InstanceDescriptor ) == 64, "InstanceDescriptor must match MTL::AccelerationStructureInstanceDescriptor" );
+
+    inline BoundingBox emptyBounds()
+    {
+        return { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+    }
+
+    inline bool isEmpty( const BoundingBox& box )
+    {
+        return !( box.min[ 0 ] <= box.max[ 0 ] && box.min[ 1 ] <= box.max[ 1 ] && box.min[ 2 ] <= box.max[ 2 ] );
+    }
+
+    // Smallest box holding both.
+    inline BoundingBox merge( const BoundingBox& a, const BoundingBox& b )
+    {
+        BoundingBox r;
+        for ( int i = 0; i < 3; ++i )
+        {
+            r.min[ i ] = a.min[ i ] < b.min[ i ] ? a.min[ i ] : b.min[ i ];
+            r.max[ i ] = a.max[ i ] > b.max[ i ] ? a.max[ i ] : b.max[ i ];
+        }
+        return r;
+    }
+
+    inline BoundingBox expand( const BoundingBox& box, const float* pPoint )
+    {
+        return merge( box, { { pPoint[ 0 ], pPoint[ 1 ], pPoint[ 2 ] }, { pPoint[ 0 ], pPoint[ 1 ], pPoint[ 2 ] } } );
+    }
+
+    // Overlap of both; empty when they are disjoint.
+    inline BoundingBox intersect( const BoundingBox& a, const BoundingBox& b )
+    {
+        BoundingBox r;
+        for ( int i = 0; i < 3; ++i )
+        {
+            r.min[ i ] = a.min[ i ] > b.min[ i ] ? a.min[ i ] : b.min[ i ];
+            r.max[ i ] = a.max[ i ] < b.max[ i ] ? a.max[ i ] : b.max[ i ];
+        }
+        return r;
+    }
+
+    inline bool overlaps( const BoundingBox& a, const BoundingBox& b )
+    {
+        return !isEmpty( intersect( a, b ) );
+    }
+
+    // Bounds of count float3 positions spaced stride bytes apart.
+    BoundingBox computeBounds( const float* pPositions, size_t count, size_t stride );
+
+    // Union of count boxes.
+    BoundingBox mergeBounds( const BoundingBox* pBoxes, size_t count );
+
+    // Smallest and largest of count floats. Both are NaN-free as long as
+    // the input is.
+    void minMax( const float* pValues, size_t count, float* pMin, float* pMax );
+
+    // Bounds of the box after an affine transform, from its centre and
+    // extents rather than all eight corners. Empty boxes stay empty.
+    BoundingBox transformBounds( const BoundingBox& box, const PackedTransform& transform );
+    void transformBounds( const BoundingBox* pBoxes, const PackedTransform* pTransforms, size_t count, BoundingBox* pOut );
+
+    // Drops the last row of column major affine float4x4s (math::float4x4,
+    // simd::float4x4), three shuffles per matrix.
+    PackedTransform packTransform( const float* pColumnMajor4x4 );
+    void packTransforms( const float* pColumnMajor4x4, size_t count, PackedTransform* pOut );
+}
@@ -0,0 +1,112 @@
+#include "ArgumentLayout.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    size_t alignUp( size_t value, size_t alignment )
+    {
+        return ( value + alignment - 1 ) / alignment * alignment;
+    }
+
+    bool isPowerOfTwo( uint32_t v )
+    {
+        return v && !( v & ( v - 1 ) );
+    }
+}
+
+util::ArgumentBufferLayout::ArgumentBufferLayout()
+: _size( 0 )
+, _alignment( 1 )
+, _stride( 0 )
+, _valid( false )
+{
+}
+
+util::ArgumentBufferLayout util::ArgumentBufferLayout::compile( const ArgumentField* pFields, size_t count )
+{
+    ArgumentBufferLayout layout;
+
+    std::vector< ArgumentField > sorted( pFields, pFields + count );
+    std::sort( sorted.begin(), sorted.end(), []( const ArgumentField& a, const ArgumentField& b ){
+        return a.index < b.index;
+    } );
+
+    size_t offset = 0;
+    for ( size_t i = 0; i < sorted.size(); ++i )
+    {
+        const ArgumentField& f = sorted[ i ];
+
+        if ( i > 0 && sorted[ i - 1 ].index + sorted[ i - 1 ].arrayLength > f.index )
+        {
+            __builtin_printf( "Argument [[id(%u)]] overlaps the previous member\n", f.index );
+            return ArgumentBufferLayout();
+        }
+
+        uint32_t elementSize = kResourceHandleSize;
+        uint32_t alignment = kResourceHandleSize;
+        if ( f.kind == ArgumentKind::Constant )
+        {
+            elementSize = f.size;
+            alignment = f.alignment ? f.alignment : 1;
+        }
+
+        if ( elementSize == 0 || f.arrayLength == 0 || !isPowerOfTwo( alignment ) )
+        {
+            __builtin_printf( "Argument [[id(%u)]] has an invalid size or alignment\n", f.index );
+            return ArgumentBufferLayout();
+        }
+
+        offset = alignUp( offset, alignment );
+        layout._fields.push_back( { f.index, (uint32_t)offset, elementSize, f.arrayLength, f.kind } );
+        offset += (size_t)elementSize * f.arrayLength;
+        layout._alignment = std::max( layout._alignment, (size_t)alignment );
+    }
+
+    layout._size = offset;
+    layout._stride = alignUp( offset, layout._alignment );
+    layout._valid = true;
+    return layout;
+}
+
+const util::ArgumentFieldLayout* util::ArgumentBufferLayout::field( uint32_t index ) const
+{
+    // Fields are sorted by index and each array member covers a range of ids.
+    auto it = std::upper_bound( _fields.begin(), _fields.end(), index, []( uint32_t i, const ArgumentFieldLayout& f ){
+        return i < f.index;
+    } );
+    if ( it == _fields.begin() )
+    {
+        return nullptr;
+    }
+    --it;
+    return ( index == it->index ) ? &*it : nullptr;
+}
+
+uint32_t util::ArgumentBufferLayout::offsetOf( uint32_t index, uint32_t arrayElement ) const
+{
+    const ArgumentFieldLayout* pField = field( index );
+    if ( !pField || arrayElement >= pField->arrayLength )
+    {
+        return kInvalidOffset;
+    }
+    return pField->offset + arrayElement * pField->elementSize;
+}
+
+void util::ArgumentBufferLayout::writeConstant( void* pTable, uint32_t index, const void* pData, size_t size, uint32_t arrayElement ) const
+{
+    const ArgumentFieldLayout* pField = field( index );
+    assert( pField && pField->kind == ArgumentKind::Constant );
+    assert( size <= pField->elementSize && arrayElement < pField->arrayLength );
+    memcpy( static_cast< uint8_t* >( pTable ) + pField->offset + arrayElement * pField->elementSize, pData, size );
+}
+
+void util::ArgumentBufferLayout::writeHandle( void* pTable, uint32_t index, uint64_t handle, uint32_t arrayElement ) const
+{
+    const ArgumentFieldLayout* pField = field( index );
+    assert( pField && pField->kind == ArgumentKind::Resource );
+    assert( arrayElement < pField->arrayLength );
+    memcpy( static_cast< uint8_t* >( pTable ) + pField->offset + arrayElement * pField->elementSize, &handle, sizeof( handle ) );
+}
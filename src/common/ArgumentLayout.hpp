@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    enum class ArgumentKind : uint8_t
+    {
+        Resource,   // buffer pointer, texture, sampler, pipeline or ICB handle
+        Constant    // inline constant data
+    };
+
+    // One [[id(n)]] member of an argument buffer struct.
+    struct ArgumentField
+    {
+        uint32_t index = 0;
+        ArgumentKind kind = ArgumentKind::Resource;
+        uint32_t arrayLength = 1;
+        uint32_t size = 0;          // element size, constants only
+        uint32_t alignment = 0;     // element alignment, constants only
+    };
+
+    struct ArgumentFieldLayout
+    {
+        uint32_t index;
+        uint32_t offset;
+        uint32_t elementSize;
+        uint32_t arrayLength;
+        ArgumentKind kind;
+    };
+
+    // CPU computed layout of an argument buffer struct, following the tier 2
+    // rules: every resource is an 8 byte handle, constants use their MSL size
+    // and alignment, members are laid out in [[id]] order. Compiled once and
+    // shared by every table encoded with the same struct.
+    class ArgumentBufferLayout
+    {
+        public:
+            static constexpr uint32_t kResourceHandleSize = 8;
+            static constexpr uint32_t kInvalidOffset = UINT32_MAX;
+
+            ArgumentBufferLayout();
+
+            static ArgumentBufferLayout compile( const ArgumentField* pFields, size_t count );
+
+            bool valid() const { return _valid; }
+            size_t size() const { return _size; }
+            size_t alignment() const { return _alignment; }
+
+            // Distance between consecutive tables in an array of tables.
+            size_t stride() const { return _stride; }
+
+            uint32_t offsetOf( uint32_t index, uint32_t arrayElement = 0 ) const;
+            const ArgumentFieldLayout* field( uint32_t index ) const;
+            const std::vector< ArgumentFieldLayout >& fields() const { return _fields; }
+
+            // Plain stores into a CPU visible table at a precomputed offset.
+            void writeConstant( void* pTable, uint32_t index, const void* pData, size_t size, uint32_t arrayElement = 0 ) const;
+            void writeHandle( void* pTable, uint32_t index, uint64_t handle, uint32_t arrayElement = 0 ) const;
+
+        private:
+            std::vector< ArgumentFieldLayout > _fields;
+            size_t _size;
+            size_t _alignment;
+            size_t _stride;
+            bool _valid;
+    };
+}
@@ -0,0 +1,209 @@
+#include "ArgumentTableEncoder.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    bool constantSizeAndAlignment( MTL::DataType type, uint32_t* pSize, uint32_t* pAlignment )
+    {
+        using namespace MTL;
+
+        // MSL sizes; three component vectors are padded to four.
+        switch ( type )
+        {
+            case DataTypeFloat:    case DataTypeInt:    case DataTypeUInt:    *pSize = 4;  *pAlignment = 4;  return true;
+            case DataTypeFloat2:   case DataTypeInt2:   case DataTypeUInt2:   *pSize = 8;  *pAlignment = 8;  return true;
+            case DataTypeFloat3:   case DataTypeInt3:   case DataTypeUInt3:
+            case DataTypeFloat4:   case DataTypeInt4:   case DataTypeUInt4:   *pSize = 16; *pAlignment = 16; return true;
+            case DataTypeHalf:     case DataTypeShort:  case DataTypeUShort:  *pSize = 2;  *pAlignment = 2;  return true;
+            case DataTypeHalf2:    case DataTypeShort2: case DataTypeUShort2: *pSize = 4;  *pAlignment = 4;  return true;
+            case DataTypeHalf3:    case DataTypeShort3: case DataTypeUShort3:
+            case DataTypeHalf4:    case DataTypeShort4: case DataTypeUShort4: *pSize = 8;  *pAlignment = 8;  return true;
+            case DataTypeChar:     case DataTypeUChar:  case DataTypeBool:    *pSize = 1;  *pAlignment = 1;  return true;
+            case DataTypeChar2:    case DataTypeUChar2: case DataTypeBool2:   *pSize = 2;  *pAlignment = 2;  return true;
+            case DataTypeChar3:    case DataTypeUChar3: case DataTypeBool3:
+            case DataTypeChar4:    case DataTypeUChar4: case DataTypeBool4:   *pSize = 4;  *pAlignment = 4;  return true;
+            case DataTypeFloat2x2: *pSize = 16; *pAlignment = 8;  return true;
+            case DataTypeFloat3x3: *pSize = 48; *pAlignment = 16; return true;
+            case DataTypeFloat4x4: *pSize = 64; *pAlignment = 16; return true;
+            default: return false;
+        }
+    }
+
+    MTL::ResourceUsage usageForAccess( MTL::ArgumentAccess access, MTL::DataType type )
+    {
+        MTL::ResourceUsage usage = 0;
+        if ( access != MTL::ArgumentAccessWriteOnly )
+        {
+            usage |= MTL::ResourceUsageRead;
+        }
+        if ( access != MTL::ArgumentAccessReadOnly )
+        {
+            usage |= MTL::ResourceUsageWrite;
+        }
+        if ( type == MTL::DataTypeTexture && ( usage & MTL::ResourceUsageRead ) )
+        {
+            usage |= MTL::ResourceUsageSample;
+        }
+        return usage;
+    }
+
+    bool isResource( MTL::DataType type )
+    {
+        return type == MTL::DataTypePointer || type == MTL::DataTypeTexture || type == MTL::DataTypeSampler
+            || type == MTL::DataTypeRenderPipeline || type == MTL::DataTypeComputePipeline
+            || type == MTL::DataTypeIndirectCommandBuffer;
+    }
+}
+
+util::ArgumentBufferLayout util::compileArgumentLayout( const NS::Array* pDescriptors )
+{
+    std::vector< ArgumentField > fields;
+    fields.reserve( pDescriptors->count() );
+
+    for ( NS::UInteger i = 0; i < pDescriptors->count(); ++i )
+    {
+        MTL::ArgumentDescriptor* pDesc = pDescriptors->object< MTL::ArgumentDescriptor >( i );
+
+        ArgumentField f;
+        f.index = (uint32_t)pDesc->index();
+        f.arrayLength = pDesc->arrayLength() ? (uint32_t)pDesc->arrayLength() : 1;
+
+        if ( isResource( pDesc->dataType() ) )
+        {
+            f.kind = ArgumentKind::Resource;
+        }
+        else if ( constantSizeAndAlignment( pDesc->dataType(), &f.size, &f.alignment ) )
+        {
+            f.kind = ArgumentKind::Constant;
+            if ( pDesc->constantBlockAlignment() )
+            {
+                f.alignment = (uint32_t)pDesc->constantBlockAlignment();
+            }
+        }
+        else
+        {
+            __builtin_printf( "Unsupported argument data type %lu at [[id(%u)]]\n", (unsigned long)pDesc->dataType(), f.index );
+            return ArgumentBufferLayout();
+        }
+
+        fields.push_back( f );
+    }
+
+    return ArgumentBufferLayout::compile( fields.data(), fields.size() );
+}
+
+util::ArgumentTableEncoder::ArgumentTableEncoder( MTL::Device* pDevice, const NS::Array* pDescriptors )
+: _pEncoder( pDevice->newArgumentEncoder( pDescriptors ) )
+, _layout( compileArgumentLayout( pDescriptors ) )
+, _pResidencySet( nullptr )
+, _stride( 0 )
+, _directConstants( false )
+, _pCurrentBuffer( nullptr )
+, _pCurrentTable( nullptr )
+{
+    assert( _pEncoder );
+    assert( _layout.valid() );
+
+    NS::UInteger alignment = _pEncoder->alignment();
+    _stride = ( _pEncoder->encodedLength() + alignment - 1 ) / alignment * alignment;
+
+    // Tier 2 tables match the CPU layout exactly, so constants can be stored
+    // without going through constantData(). Tier 1 layouts are opaque.
+    _directConstants = pDevice->argumentBuffersSupport() == MTL::ArgumentBuffersTier2
+                    && _stride == _layout.stride();
+
+    for ( NS::UInteger i = 0; i < pDescriptors->count(); ++i )
+    {
+        MTL::ArgumentDescriptor* pDesc = pDescriptors->object< MTL::ArgumentDescriptor >( i );
+        NS::UInteger last = pDesc->index() + ( pDesc->arrayLength() ? pDesc->arrayLength() : 1 );
+        if ( _usageByIndex.size() < last )
+        {
+            _usageByIndex.resize( last, 0 );
+        }
+        for ( NS::UInteger j = pDesc->index(); j < last; ++j )
+        {
+            _usageByIndex[ j ] = usageForAccess( pDesc->access(), pDesc->dataType() );
+        }
+    }
+}
+
+util::ArgumentTableEncoder::~ArgumentTableEncoder()
+{
+    _pEncoder->release();
+}
+
+MTL::Buffer* util::ArgumentTableEncoder::newTableBuffer( size_t tableCount, MTL::ResourceOptions options ) const
+{
+    return _pEncoder->device()->newBuffer( _stride * tableCount, options );
+}
+
+void util::ArgumentTableEncoder::encode( MTL::Buffer* pBuffer, size_t first, size_t count, const EncodeFunction& fn )
+{
+    assert( ( first + count ) * _stride <= pBuffer->length() );
+
+    _pCurrentBuffer = pBuffer;
+    uint8_t* pBase = static_cast< uint8_t* >( pBuffer->contents() );
+
+    for ( size_t i = first; i < first + count; ++i )
+    {
+        _pEncoder->setArgumentBuffer( pBuffer, i * _stride );
+        _pCurrentTable = pBase + i * _stride;
+        fn( *this, i );
+    }
+
+    if ( pBuffer->storageMode() == MTL::StorageModeManaged && count > 0 )
+    {
+        pBuffer->didModifyRange( NS::Range::Make( first * _stride, count * _stride ) );
+    }
+
+    _pCurrentBuffer = nullptr;
+    _pCurrentTable = nullptr;
+}
+
+void util::ArgumentTableEncoder::setBuffer( const MTL::Buffer* pBuffer, NS::UInteger offset, NS::UInteger index )
+{
+    assert( _pCurrentTable );
+    _pEncoder->setBuffer( pBuffer, offset, index );
+    track( pBuffer, index );
+}
+
+void util::ArgumentTableEncoder::setTexture( const MTL::Texture* pTexture, NS::UInteger index )
+{
+    assert( _pCurrentTable );
+    _pEncoder->setTexture( pTexture, index );
+    track( pTexture, index );
+}
+
+void util::ArgumentTableEncoder::setSamplerState( const MTL::SamplerState* pSampler, NS::UInteger index )
+{
+    assert( _pCurrentTable );
+    _pEncoder->setSamplerState( pSampler, index );
+}
+
+void util::ArgumentTableEncoder::setConstant( const void* pData, size_t size, NS::UInteger index, uint32_t arrayElement )
+{
+    assert( _pCurrentTable );
+    if ( _directConstants )
+    {
+        _layout.writeConstant( _pCurrentTable, (uint32_t)index, pData, size, arrayElement );
+    }
+    else
+    {
+        const ArgumentFieldLayout* pField = _layout.field( (uint32_t)index );
+        assert( pField );
+        uint8_t* pDst = static_cast< uint8_t* >( _pEncoder->constantData( index ) );
+        memcpy( pDst + (size_t)arrayElement * pField->elementSize, pData, size );
+    }
+}
+
+void util::ArgumentTableEncoder::track( const MTL::Resource* pResource, NS::UInteger index )
+{
+    if ( _pResidencySet && pResource )
+    {
+        assert( index < _usageByIndex.size() );
+        _pResidencySet->add( const_cast< MTL::Resource* >( pResource ), _usageByIndex[ index ] );
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "ArgumentLayout.hpp"
+#include "ResidencySet.hpp"
+
+namespace util
+{
+    // Translates an MTL::ArgumentDescriptor list into the CPU layout used by
+    // ArgumentBufferLayout. Returns an invalid layout for unsupported types.
+    ArgumentBufferLayout compileArgumentLayout( const NS::Array* pDescriptors );
+
+    // Encodes arrays of argument buffer tables that share one struct layout.
+    // The layout and the MTL::ArgumentEncoder are built once per struct
+    // instead of once per table; constants go straight into the buffer with
+    // plain stores at the precomputed offsets, and each batch ends with a
+    // single didModifyRange() over the tables it touched.
+    class ArgumentTableEncoder
+    {
+        public:
+            using EncodeFunction = std::function< void( ArgumentTableEncoder& encoder, size_t table ) >;
+
+            ArgumentTableEncoder( MTL::Device* pDevice, const NS::Array* pDescriptors );
+            ~ArgumentTableEncoder();
+
+            const ArgumentBufferLayout& layout() const { return _layout; }
+            size_t stride() const { return _stride; }
+
+            // Resources encoded while a set is attached are recorded in it with
+            // the usage implied by their descriptor's access.
+            void setResidencySet( ResidencySet* pSet ) { _pResidencySet = pSet; }
+
+            MTL::Buffer* newTableBuffer( size_t tableCount, MTL::ResourceOptions options = MTL::ResourceStorageModeManaged ) const;
+
+            // Calls fn for every table in [first, first + count) of pBuffer.
+            void encode( MTL::Buffer* pBuffer, size_t first, size_t count, const EncodeFunction& fn );
+
+            // Valid inside encode() callbacks only.
+            void setBuffer( const MTL::Buffer* pBuffer, NS::UInteger offset, NS::UInteger index );
+            void setTexture( const MTL::Texture* pTexture, NS::UInteger index );
+            void setSamplerState( const MTL::SamplerState* pSampler, NS::UInteger index );
+            void setConstant( const void* pData, size_t size, NS::UInteger index, uint32_t arrayElement = 0 );
+
+        private:
+            void track( const MTL::Resource* pResource, NS::UInteger index );
+
+            MTL::ArgumentEncoder* _pEncoder;
+            ArgumentBufferLayout _layout;
+            std::vector< MTL::ResourceUsage > _usageByIndex;
+            ResidencySet* _pResidencySet;
+            size_t _stride;
+            bool _directConstants;
+            MTL::Buffer* _pCurrentBuffer;
+            uint8_t* _pCurrentTable;
+    };
+}
@@ -0,0 +1,152 @@
+#include "AsyncPipelineBuilder.hpp"
+
+#include "ShaderLayout.hpp"
+#include "ShaderLibrary.hpp"
+
+namespace
+{
+    void printError( const char* pJob, NS::Error* pError )
+    {
+        __builtin_printf( "%s: %s\n", pJob, pError ? pError->localizedDescription()->utf8String() : "unknown error" );
+    }
+}
+
+util::AsyncPipelineBuilder::AsyncPipelineBuilder( MTL::Device* pDevice )
+: _pDevice( pDevice->retain() )
+{
+}
+
+util::AsyncPipelineBuilder::~AsyncPipelineBuilder()
+{
+    for ( NS::Object* pObject : _objects )
+    {
+        // Pipeline states belong to the caller and are not tracked here.
+        if ( pObject )
+        {
+            pObject->release();
+        }
+    }
+    for ( NS::Object* pObject : _retained )
+    {
+        pObject->release();
+    }
+    _pDevice->release();
+}
+
+util::AsyncPipelineBuilder::JobId util::AsyncPipelineBuilder::track( JobId id, NS::Object* pRetained )
+{
+    _objects.resize( id + 1, nullptr );
+    if ( pRetained )
+    {
+        _retained.push_back( pRetained->retain() );
+    }
+    return id;
+}
+
+util::AsyncPipelineBuilder::JobId util::AsyncPipelineBuilder::addLibrary( const char* pName, const char* pSource, ShaderMath math )
+{
+    NS::String* pSourceStr = NS::String::string( expandShaderTypes( pSource ).c_str(), NS::UTF8StringEncoding );
+    JobId id = (JobId)_objects.size();
+
+    // Owned by the builder until it goes, like the other retained objects.
+    MTL::CompileOptions* pOptions = newCompileOptions( math );
+    if ( pOptions )
+    {
+        _retained.push_back( pOptions );
+    }
+
+    return track( _scheduler.add( pName, [this, id, pName, pSource, pSourceStr, pOptions, math]( CompileScheduler::Completion done ){
+        if ( hasPrecompiledLibrary( pSource, math ) )
+        {
+            // Loading an embedded metallib is cheap; no need to go async.
+            NS::Error* pError = nullptr;
+            MTL::Library* pLibrary = newShaderLibrary( _pDevice, pSource, &pError, math );
+            if ( !pLibrary )
+            {
+                printError( pName, pError );
+            }
+            _objects[ id ] = pLibrary;
+            done( pLibrary != nullptr );
+            return;
+        }
+
+        _pDevice->newLibrary( pSourceStr, pOptions, [this, id, pName, done]( MTL::Library* pLibrary, NS::Error* pError ){
+            if ( !pLibrary )
+            {
+                printError( pName, pError );
+                done( false );
+                return;
+            }
+            _objects[ id ] = pLibrary->retain();
+            done( true );
+        } );
+    } ), pSourceStr );
+}
+
+util::AsyncPipelineBuilder::JobId util::AsyncPipelineBuilder::addFunction( JobId library, const char* pName )
+{
+    JobId id = (JobId)_objects.size();
+
+    // Function lookup is cheap next to compilation; it completes in place.
+    return track( _scheduler.add( pName, [this, id, library, pName]( CompileScheduler::Completion done ){
+        MTL::Function* pFn = this->library( library )->newFunction( NS::String::string( pName, NS::UTF8StringEncoding ) );
+        if ( !pFn )
+        {
+            __builtin_printf( "%s: function not found\n", pName );
+        }
+        _objects[ id ] = pFn;
+        done( pFn != nullptr );
+    }, { library } ) );
+}
+
+util::AsyncPipelineBuilder::JobId util::AsyncPipelineBuilder::addRenderPipeline( const char* pName, MTL::RenderPipelineDescriptor* pDesc,
+                                                                                 JobId vertexFunction, JobId fragmentFunction,
+                                                                                 MTL::RenderPipelineState** ppPipelineState )
+{
+    *ppPipelineState = nullptr;
+
+    return track( _scheduler.add( pName, [this, pName, pDesc, vertexFunction, fragmentFunction, ppPipelineState]( CompileScheduler::Completion done ){
+        pDesc->setVertexFunction( function( vertexFunction ) );
+        pDesc->setFragmentFunction( function( fragmentFunction ) );
+        _pDevice->newRenderPipelineState( pDesc, [pName, done, ppPipelineState]( MTL::RenderPipelineState* pPSO, NS::Error* pError ){
+            if ( !pPSO )
+            {
+                printError( pName, pError );
+                done( false );
+                return;
+            }
+            *ppPipelineState = pPSO->retain();
+            done( true );
+        } );
+    }, { vertexFunction, fragmentFunction } ), pDesc );
+}
+
+util::AsyncPipelineBuilder::JobId util::AsyncPipelineBuilder::addComputePipeline( const char* pName, JobId function,
+                                                                                  MTL::ComputePipelineState** ppPipelineState )
+{
+    *ppPipelineState = nullptr;
+
+    return track( _scheduler.add( pName, [this, pName, function, ppPipelineState]( CompileScheduler::Completion done ){
+        _pDevice->newComputePipelineState( this->function( function ), [pName, done, ppPipelineState]( MTL::ComputePipelineState* pPSO, NS::Error* pError ){
+            if ( !pPSO )
+            {
+                printError( pName, pError );
+                done( false );
+                return;
+            }
+            *ppPipelineState = pPSO->retain();
+            done( true );
+        } );
+    }, { function } ) );
+}
+
+bool util::AsyncPipelineBuilder::build( bool printReport )
+{
+    _scheduler.run();
+    bool success = _scheduler.wait();
+    if ( printReport )
+    {
+        _scheduler.printReport();
+    }
+    return success;
+}
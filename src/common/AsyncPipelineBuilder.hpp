@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include <vector>
+
+#include "CompileScheduler.hpp"
+#include "EmbeddedShaders.hpp"
+
+namespace util
+{
+    // Declares the startup shader work of a renderer as library -> function
+    // -> pipeline state jobs and compiles them concurrently through the
+    // completion-handler overloads of MTL::Device. Independent libraries and
+    // pipelines compile in parallel; build() joins everything so the first
+    // frame never waits on the compiler.
+    //
+    // Libraries and functions stay owned by the builder and are released with
+    // it; retain them to keep them. Pipeline states are written to the
+    // caller's pointers and, like MTL::Device::new*(), owned by the caller.
+    //
+    // Sources and names are not copied and must stay valid until build()
+    // returns; raw string literals, as in the samples, also let the build's
+    // precompiled libraries (see util::newShaderLibrary) replace compilation.
+    class AsyncPipelineBuilder
+    {
+        public:
+            using JobId = CompileScheduler::JobId;
+
+            AsyncPipelineBuilder( MTL::Device* pDevice );
+            ~AsyncPipelineBuilder();
+
+            JobId addLibrary( const char* pName, const char* pSource, ShaderMath math = ShaderMath::Fast );
+            JobId addFunction( JobId library, const char* pName );
+
+            // The descriptor is retained; its vertex and fragment functions
+            // are filled in from the function jobs once they finish.
+            JobId addRenderPipeline( const char* pName, MTL::RenderPipelineDescriptor* pDesc,
+                                     JobId vertexFunction, JobId fragmentFunction,
+                                     MTL::RenderPipelineState** ppPipelineState );
+            JobId addComputePipeline( const char* pName, JobId function,
+                                      MTL::ComputePipelineState** ppPipelineState );
+
+            // Compiles everything and waits for it. Returns false if any job
+            // failed; compiler errors have been printed by then.
+            bool build( bool printReport = true );
+
+            MTL::Library* library( JobId id ) const { return static_cast< MTL::Library* >( _objects[ id ] ); }
+            MTL::Function* function( JobId id ) const { return static_cast< MTL::Function* >( _objects[ id ] ); }
+
+            const CompileScheduler& scheduler() const { return _scheduler; }
+
+        private:
+            JobId track( JobId id, NS::Object* pRetained = nullptr );
+
+            MTL::Device* _pDevice;
+            CompileScheduler _scheduler;
+            std::vector< NS::Object* > _objects;
+            std::vector< NS::Object* > _retained;
+    };
+}
@@ -0,0 +1,121 @@
+#include "CaptureController.hpp"
+
+#include "ChromeTrace.hpp"
+
+#include <ctime>
+
+namespace
+{
+    double nowSeconds()
+    {
+        return util::traceClockNs() * 1e-9;
+    }
+}
+
+util::CaptureController::CaptureController( MTL::CommandQueue* pQueue, const CapturePolicy& policy, const char* outputDirectory )
+: _trigger( policy )
+, _outputDirectory( outputDirectory ? outputDirectory : "" )
+, _capturing( false )
+{
+    MTL::CaptureManager* pManager = MTL::CaptureManager::sharedCaptureManager();
+    _supported = pManager->supportsDestination( MTL::CaptureDestinationGPUTraceDocument );
+    if ( !_supported )
+    {
+        __builtin_printf( "GPU trace capture is not available; regressions will not be captured\n" );
+    }
+
+    _pScope = pManager->newCaptureScope( pQueue );
+    _pScope->setLabel( NS::String::string( "Frame", NS::UTF8StringEncoding ) );
+}
+
+util::CaptureController::~CaptureController()
+{
+    if ( _capturing )
+    {
+        MTL::CaptureManager::sharedCaptureManager()->stopCapture();
+    }
+    _pScope->release();
+}
+
+void util::CaptureController::track( MTL::CommandBuffer* pCommandBuffer )
+{
+    CaptureController* pController = this;
+    pCommandBuffer->addCompletedHandler( [pController]( MTL::CommandBuffer* pCmd ){
+        if ( pCmd->status() != MTL::CommandBufferStatusCompleted )
+        {
+            return;
+        }
+        double ms = ( pCmd->GPUEndTime() - pCmd->GPUStartTime() ) * 1e3;
+        std::lock_guard< std::mutex > lock( pController->_mutex );
+        pController->_completed.push_back( ms );
+    } );
+}
+
+bool util::CaptureController::start()
+{
+    MTL::CaptureManager* pManager = MTL::CaptureManager::sharedCaptureManager();
+    if ( !_supported || pManager->isCapturing() )
+    {
+        return false;
+    }
+
+    char filename[ 64 ];
+    std::time_t now = std::time( nullptr );
+    std::strftime( filename, sizeof( filename ), "regression-%H-%M-%S_%m-%d-%y", std::localtime( &now ) );
+    _lastPath = _outputDirectory + filename + "-" + std::to_string( _trigger.captures() ) + ".gputrace";
+
+    NS::URL* pURL = NS::URL::alloc()->initFileURLWithPath( NS::String::string( _lastPath.c_str(), NS::UTF8StringEncoding ) );
+    MTL::CaptureDescriptor* pDesc = MTL::CaptureDescriptor::alloc()->init();
+    pDesc->setDestination( MTL::CaptureDestinationGPUTraceDocument );
+    pDesc->setOutputURL( pURL );
+    pDesc->setCaptureObject( _pScope );
+
+    NS::Error* pError = nullptr;
+    bool ok = pManager->startCapture( pDesc, &pError );
+    if ( !ok )
+    {
+        __builtin_printf( "Failed to start capture: \"%s\" for file \"%s\"\n", pError->localizedDescription()->utf8String(),
+                          _lastPath.c_str() );
+    }
+    pDesc->release();
+    pURL->release();
+    return ok;
+}
+
+void util::CaptureController::beginFrame()
+{
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _drained.swap( _completed );
+    }
+    for ( double ms : _drained )
+    {
+        _trigger.addFrameTime( ms );
+    }
+    _drained.clear();
+
+    double now = nowSeconds();
+    if ( _trigger.beginFrame( now ) )
+    {
+        if ( start() )
+        {
+            __builtin_printf( "Capturing %s: %s\n", _lastPath.c_str(), _trigger.reason().c_str() );
+            _capturing = true;
+        }
+        else
+        {
+            _trigger.captureFailed( now );
+        }
+    }
+    _pScope->beginScope();
+}
+
+void util::CaptureController::endFrame()
+{
+    _pScope->endScope();
+    if ( _trigger.endFrame( nowSeconds() ) && _capturing )
+    {
+        MTL::CaptureManager::sharedCaptureManager()->stopCapture();
+        _capturing = false;
+    }
+}
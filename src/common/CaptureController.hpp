@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "CaptureTrigger.hpp"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+    // Captures frames to .gputrace documents when GPU frame times regress.
+    // track() adds a completed handler that reports each command buffer's
+    // GPUEndTime - GPUStartTime; beginFrame() feeds those to a
+    // CaptureTrigger and, when it fires, starts a capture of a capture
+    // scope on the queue that every frame opens and closes. Each capture
+    // and the reason for it are logged.
+    //
+    // Does nothing but keep statistics when the capture manager cannot
+    // write trace documents, which needs MetalCaptureEnabled in the
+    // Info.plist or MTL_CAPTURE_ENABLED=1 in the environment.
+    class CaptureController
+    {
+        public:
+            CaptureController( MTL::CommandQueue* pQueue, const CapturePolicy& policy, const char* outputDirectory );
+            ~CaptureController();
+
+            // Call with each frame's command buffer before committing it. The
+            // handler refers to the controller, so it must outlive the
+            // command buffer.
+            void track( MTL::CommandBuffer* pCommandBuffer );
+
+            // Bracket the encoding of every frame.
+            void beginFrame();
+            void endFrame();
+
+            const CaptureTrigger& trigger() const { return _trigger; }
+            bool capturing() const { return _capturing; }
+            const std::string& lastCapturePath() const { return _lastPath; }
+
+        private:
+            bool start();
+
+            MTL::CaptureScope* _pScope;
+            CaptureTrigger _trigger;
+            std::string _outputDirectory;
+            std::string _lastPath;
+            bool _supported;
+            bool _capturing;
+
+            std::mutex _mutex;
+            std::vector< double > _completed;
+            std::vector< double > _drained;
+    };
+}
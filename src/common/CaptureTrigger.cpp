@@ -0,0 +1,151 @@
+#include "CaptureTrigger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+util::FrameTimeWindow::FrameTimeWindow( size_t capacity )
+: _times( std::max< size_t >( capacity, 1 ) )
+, _next( 0 )
+, _count( 0 )
+{
+    _sorted.reserve( _times.size() );
+}
+
+void util::FrameTimeWindow::add( double ms )
+{
+    _times[ _next ] = ms;
+    _next = ( _next + 1 ) % _times.size();
+    _count = std::min( _count + 1, _times.size() );
+}
+
+void util::FrameTimeWindow::clear()
+{
+    _next = 0;
+    _count = 0;
+}
+
+double util::FrameTimeWindow::percentile( double q ) const
+{
+    if ( _count == 0 )
+    {
+        return 0.0;
+    }
+    _sorted.assign( _times.begin(), _times.begin() + _count );
+    size_t rank = (size_t)std::ceil( std::min( std::max( q, 0.0 ), 1.0 ) * _count );
+    size_t index = rank > 0 ? rank - 1 : 0;
+    std::nth_element( _sorted.begin(), _sorted.begin() + index, _sorted.end() );
+    return _sorted[ index ];
+}
+
+util::CaptureTrigger::CaptureTrigger( const CapturePolicy& policy )
+: _policy( policy )
+, _window( policy.windowFrames )
+, _state( policy.maxCaptures > 0 ? CaptureState::Warmup : CaptureState::Exhausted )
+, _lastFrameMs( 0.0 )
+, _cooldownEnd( 0.0 )
+, _captures( 0 )
+, _capturedFrames( 0 )
+{
+}
+
+void util::CaptureTrigger::addFrameTime( double ms )
+{
+    // Frames that complete during a capture or just after it are slowed by
+    // it, so the window only fills while waiting for a regression.
+    if ( _state != CaptureState::Warmup && _state != CaptureState::Armed )
+    {
+        return;
+    }
+    _window.add( ms );
+    _lastFrameMs = ms;
+}
+
+bool util::CaptureTrigger::breached()
+{
+    char buffer[ 160 ];
+    double p50 = _window.percentile( 0.5 );
+    if ( _policy.p50LimitMs > 0.0 && p50 > _policy.p50LimitMs )
+    {
+        snprintf( buffer, sizeof( buffer ), "p50 %.2f ms over %zu frames exceeds %.2f ms", p50, _window.count(),
+                  _policy.p50LimitMs );
+        _reason = buffer;
+        return true;
+    }
+    double p99 = _window.percentile( 0.99 );
+    if ( _policy.p99LimitMs > 0.0 && p99 > _policy.p99LimitMs )
+    {
+        snprintf( buffer, sizeof( buffer ), "p99 %.2f ms over %zu frames exceeds %.2f ms", p99, _window.count(),
+                  _policy.p99LimitMs );
+        _reason = buffer;
+        return true;
+    }
+    if ( _policy.spikeFactor > 0.0 && _lastFrameMs > _policy.spikeFactor * p50 )
+    {
+        snprintf( buffer, sizeof( buffer ), "frame of %.2f ms exceeds %.1fx the p50 of %.2f ms", _lastFrameMs,
+                  _policy.spikeFactor, p50 );
+        _reason = buffer;
+        return true;
+    }
+    return false;
+}
+
+bool util::CaptureTrigger::beginFrame( double nowSeconds )
+{
+    if ( _state == CaptureState::Cooldown && nowSeconds >= _cooldownEnd )
+    {
+        _state = CaptureState::Warmup;
+    }
+    if ( _state == CaptureState::Warmup && _window.full() )
+    {
+        _state = CaptureState::Armed;
+    }
+    if ( _state != CaptureState::Armed || !breached() )
+    {
+        return false;
+    }
+
+    _state = CaptureState::Capturing;
+    _capturedFrames = 0;
+    ++_captures;
+    return true;
+}
+
+bool util::CaptureTrigger::endFrame( double nowSeconds )
+{
+    if ( _state != CaptureState::Capturing || ++_capturedFrames < std::max( _policy.captureFrames, 1u ) )
+    {
+        return false;
+    }
+    finish( nowSeconds );
+    return true;
+}
+
+void util::CaptureTrigger::captureFailed( double nowSeconds )
+{
+    if ( _state == CaptureState::Capturing )
+    {
+        finish( nowSeconds );
+    }
+}
+
+void util::CaptureTrigger::finish( double nowSeconds )
+{
+    _window.clear();
+    _lastFrameMs = 0.0;
+    _cooldownEnd = nowSeconds + _policy.cooldownSeconds;
+    _state = _captures < _policy.maxCaptures ? CaptureState::Cooldown : CaptureState::Exhausted;
+}
+
+const char* util::captureStateName( CaptureState state )
+{
+    switch ( state )
+    {
+        case CaptureState::Warmup: return "warmup";
+        case CaptureState::Armed: return "armed";
+        case CaptureState::Capturing: return "capturing";
+        case CaptureState::Cooldown: return "cooldown";
+        case CaptureState::Exhausted: return "exhausted";
+    }
+    return "unknown";
+}
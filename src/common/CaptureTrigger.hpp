@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace util
+{
+    // The last N frame times, with percentiles over them.
+    class FrameTimeWindow
+    {
+        public:
+            explicit FrameTimeWindow( size_t capacity );
+
+            void add( double ms );
+            void clear();
+
+            size_t count() const { return _count; }
+            size_t capacity() const { return _times.size(); }
+            bool full() const { return _count == _times.size(); }
+
+            // Nearest-rank percentile, q in [0, 1]; 0 when empty.
+            double percentile( double q ) const;
+
+        private:
+            std::vector< double > _times;
+            mutable std::vector< double > _sorted;
+            size_t _next;
+            size_t _count;
+    };
+
+    struct CapturePolicy
+    {
+        size_t windowFrames = 120;
+
+        // Limits on the window's percentiles; 0 disables one.
+        double p50LimitMs = 0.0;
+        double p99LimitMs = 0.0;
+
+        // A single frame above spikeFactor times the window's median also
+        // triggers; 0 disables.
+        double spikeFactor = 0.0;
+
+        uint32_t captureFrames = 1;
+
+        // Seconds after a capture before another may start, and captures
+        // allowed over the whole run.
+        double cooldownSeconds = 30.0;
+        uint32_t maxCaptures = 3;
+    };
+
+    enum class CaptureState
+    {
+        Warmup,
+        Armed,
+        Capturing,
+        Cooldown,
+        Exhausted
+    };
+
+    // Decides when to capture from GPU frame times; CaptureController does
+    // the capturing. Frame times come in as command buffers complete, which
+    // is frames after they were encoded, so a capture records the frames
+    // that follow a regression rather than the regressed ones.
+    //
+    // The window restarts after every capture, since captured frames run
+    // slower and the frames around them are not representative; with the
+    // cooldown it must then fill again before the trigger re-arms.
+    class CaptureTrigger
+    {
+        public:
+            explicit CaptureTrigger( const CapturePolicy& policy );
+
+            void addFrameTime( double ms );
+
+            // True when a capture should start with the frame about to be
+            // encoded.
+            bool beginFrame( double nowSeconds );
+
+            // True when the capture should stop after the frame just
+            // committed.
+            bool endFrame( double nowSeconds );
+
+            // A capture could not start; counts against the budget so a
+            // failing capture is not retried every frame.
+            void captureFailed( double nowSeconds );
+
+            CaptureState state() const { return _state; }
+            const std::string& reason() const { return _reason; }
+            uint32_t captures() const { return _captures; }
+            const FrameTimeWindow& window() const { return _window; }
+            const CapturePolicy& policy() const { return _policy; }
+
+        private:
+            bool breached();
+            void finish( double nowSeconds );
+
+            CapturePolicy _policy;
+            FrameTimeWindow _window;
+            CaptureState _state;
+            std::string _reason;
+            double _lastFrameMs;
+            double _cooldownEnd;
+            uint32_t _captures;
+            uint32_t _capturedFrames;
+    };
+
+    const char* captureStateName( CaptureState state );
+}
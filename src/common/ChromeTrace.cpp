@@ -0,0 +1,122 @@
+#include "ChromeTrace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+namespace
+{
+    void appendEscaped( std::string* pOut, const std::string& s )
+    {
+        for ( char c : s )
+        {
+            if ( c == '"' || c == '\\' )
+            {
+                pOut->push_back( '\\' );
+                pOut->push_back( c );
+            }
+            else if ( (unsigned char)c < 0x20 )
+            {
+                char buffer[ 8 ];
+                snprintf( buffer, sizeof( buffer ), "\\u%04x", (unsigned)c );
+                pOut->append( buffer );
+            }
+            else
+            {
+                pOut->push_back( c );
+            }
+        }
+    }
+
+    void appendMicroseconds( std::string* pOut, uint64_t ns )
+    {
+        char buffer[ 32 ];
+        snprintf( buffer, sizeof( buffer ), "%llu.%03llu", (unsigned long long)( ns / 1000 ), (unsigned long long)( ns % 1000 ) );
+        pOut->append( buffer );
+    }
+}
+
+uint64_t util::traceClockNs()
+{
+    timespec ts;
+#ifdef __APPLE__
+    clock_gettime( CLOCK_UPTIME_RAW, &ts );
+#else
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void util::ChromeTrace::nameTrack( uint32_t track, const std::string& name )
+{
+    for ( auto& entry : _trackNames )
+    {
+        if ( entry.first == track )
+        {
+            entry.second = name;
+            return;
+        }
+    }
+    _trackNames.emplace_back( track, name );
+}
+
+void util::ChromeTrace::add( const std::string& name, const char* pCategory, uint64_t startNs, uint64_t endNs, uint32_t track )
+{
+    _events.push_back( { name, pCategory, startNs, endNs > startNs ? endNs - startNs : 0, track } );
+}
+
+void util::ChromeTrace::write( std::string* pOut ) const
+{
+    uint64_t origin = UINT64_MAX;
+    for ( const TraceEvent& e : _events )
+    {
+        origin = std::min( origin, e.startNs );
+    }
+
+    pOut->clear();
+    pOut->reserve( 64 + _trackNames.size() * 96 + _events.size() * 112 );
+    pOut->append( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" );
+    bool first = true;
+    for ( const auto& entry : _trackNames )
+    {
+        pOut->append( first ? "\n" : ",\n" );
+        first = false;
+        pOut->append( "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" );
+        pOut->append( std::to_string( entry.first ) );
+        pOut->append( ",\"args\":{\"name\":\"" );
+        appendEscaped( pOut, entry.second );
+        pOut->append( "\"}}" );
+    }
+    for ( const TraceEvent& e : _events )
+    {
+        pOut->append( first ? "\n" : ",\n" );
+        first = false;
+        pOut->append( "{\"ph\":\"X\",\"name\":\"" );
+        appendEscaped( pOut, e.name );
+        pOut->append( "\",\"cat\":\"" );
+        pOut->append( e.pCategory ? e.pCategory : "" );
+        pOut->append( "\",\"pid\":1,\"tid\":" );
+        pOut->append( std::to_string( e.track ) );
+        pOut->append( ",\"ts\":" );
+        appendMicroseconds( pOut, e.startNs - origin );
+        pOut->append( ",\"dur\":" );
+        appendMicroseconds( pOut, e.durationNs );
+        pOut->append( "}" );
+    }
+    pOut->append( "\n]}\n" );
+}
+
+bool util::ChromeTrace::writeFile( const char* path ) const
+{
+    std::string json;
+    write( &json );
+    FILE* pFile = fopen( path, "wb" );
+    if ( !pFile )
+    {
+        __builtin_printf( "Cannot write trace to %s\n", path );
+        return false;
+    }
+    bool ok = fwrite( json.data(), 1, json.size(), pFile ) == json.size();
+    ok = fclose( pFile ) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace util
+{
+    // Monotonic nanoseconds. On Apple platforms this is CLOCK_UPTIME_RAW,
+    // the clock behind mach_absolute_time(), which is what
+    // Device::sampleTimestamps() reports CPU time in.
+    uint64_t traceClockNs();
+
+    struct TraceEvent
+    {
+        std::string name;
+        const char* pCategory;  // must outlive the trace, usually a literal
+        uint64_t startNs;
+        uint64_t durationNs;
+        uint32_t track;
+    };
+
+    // Complete ("X") events in the Chrome trace event format, which
+    // chrome://tracing and ui.perfetto.dev both open. Tracks become threads
+    // of a single process and can be given names.
+    class ChromeTrace
+    {
+        public:
+            void nameTrack( uint32_t track, const std::string& name );
+            void add( TraceEvent event ) { _events.push_back( std::move( event ) ); }
+            void add( const std::string& name, const char* pCategory, uint64_t startNs, uint64_t endNs, uint32_t track );
+
+            const std::vector< TraceEvent >& events() const { return _events; }
+            size_t eventCount() const { return _events.size(); }
+            void clear() { _events.clear(); }
+
+            // Times are written in microseconds from the earliest event.
+            void write( std::string* pOut ) const;
+            bool writeFile( const char* path ) const;
+
+        private:
+            std::vector< TraceEvent > _events;
+            std::vector< std::pair< uint32_t, std::string > > _trackNames;
+    };
+}
@@ -0,0 +1,35 @@
+#include "CommandBufferStats.hpp"
+
+namespace
+{
+    uint64_t toNs( double seconds )
+    {
+        return seconds > 0.0 ? (uint64_t)( seconds * 1e9 + 0.5 ) : 0;
+    }
+}
+
+void util::CommandBufferStats::recordCompleted( double kernelStartTime, double gpuStartTime, double gpuEndTime )
+{
+    _queueDelay.record( toNs( gpuStartTime - kernelStartTime ) );
+    _gpuTime.record( toNs( gpuEndTime - gpuStartTime ) );
+}
+
+void util::CommandBufferStats::recordFailed( int64_t errorCode )
+{
+    int64_t last = CommandBufferStatsSnapshot::kErrorCodes - 1;
+    int64_t slot = errorCode < 0 || errorCode > last ? last : errorCode;
+    _errors[ slot ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+void util::CommandBufferStats::snapshot( CommandBufferStatsSnapshot* pOut, bool reset )
+{
+    _queueDelay.snapshot( &pOut->queueDelay, reset );
+    _gpuTime.snapshot( &pOut->gpuTime, reset );
+    pOut->completed = pOut->gpuTime.count;
+    pOut->failed = 0;
+    for ( int i = 0; i < CommandBufferStatsSnapshot::kErrorCodes; ++i )
+    {
+        pOut->errors[ i ] = reset ? _errors[ i ].exchange( 0, std::memory_order_relaxed ) : _errors[ i ].load( std::memory_order_relaxed );
+        pOut->failed += pOut->errors[ i ];
+    }
+}
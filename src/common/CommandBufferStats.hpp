@@ -0,0 +1,44 @@
+#pragma once
+
+#include "LatencyHistogram.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace util
+{
+    // Totals for command buffers between two snapshots. Times are in ns.
+    struct CommandBufferStatsSnapshot
+    {
+        static constexpr int kErrorCodes = 16;
+
+        HistogramSnapshot queueDelay;
+        HistogramSnapshot gpuTime;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        // Failures by MTL::CommandBufferError code; codes past the end are
+        // counted in the last entry.
+        uint64_t errors[ kErrorCodes ] = {};
+    };
+
+    // Collects what Metal reports as each command buffer completes. The
+    // queueing delay runs from kernelStartTime, when the buffer was handed
+    // to the driver, to GPUStartTime; GPU time runs from GPUStartTime to
+    // GPUEndTime. Every record call is lock-free and safe from any thread.
+    class CommandBufferStats
+    {
+        public:
+            // Times are CFTimeInterval seconds as read from the buffer. A
+            // start before submission, which the two clocks can report for
+            // buffers that start at once, counts as no delay.
+            void recordCompleted( double kernelStartTime, double gpuStartTime, double gpuEndTime );
+            void recordFailed( int64_t errorCode );
+
+            void snapshot( CommandBufferStatsSnapshot* pOut, bool reset = false );
+
+        private:
+            LatencyHistogram _queueDelay;
+            LatencyHistogram _gpuTime;
+            std::atomic< uint64_t > _errors[ CommandBufferStatsSnapshot::kErrorCodes ] = {};
+    };
+}
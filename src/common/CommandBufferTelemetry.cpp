@@ -0,0 +1,35 @@
+#include "CommandBufferTelemetry.hpp"
+
+void util::CommandBufferTelemetry::track( MTL::CommandBuffer* pCommandBuffer )
+{
+    CommandBufferStats* pStats = &_stats;
+    pCommandBuffer->addCompletedHandler( [pStats]( MTL::CommandBuffer* pCmd ){
+        if ( pCmd->status() == MTL::CommandBufferStatusCompleted )
+        {
+            pStats->recordCompleted( pCmd->kernelStartTime(), pCmd->GPUStartTime(), pCmd->GPUEndTime() );
+        }
+        else
+        {
+            NS::Error* pError = pCmd->error();
+            pStats->recordFailed( pError ? pError->code() : MTL::CommandBufferErrorNone );
+        }
+    } );
+}
+
+void util::CommandBufferTelemetry::report( const char* pLabel )
+{
+    _stats.snapshot( &_snapshot, true );
+    const HistogramSnapshot& q = _snapshot.queueDelay;
+    const HistogramSnapshot& g = _snapshot.gpuTime;
+    __builtin_printf( "%s: %llu buffers, queue p50 %.3f p99 %.3f max %.3f ms, gpu p50 %.3f p99 %.3f max %.3f ms\n", pLabel,
+                      (unsigned long long)_snapshot.completed,
+                      q.percentile( 0.5 ) * 1e-6, q.percentile( 0.99 ) * 1e-6, q.max * 1e-6,
+                      g.percentile( 0.5 ) * 1e-6, g.percentile( 0.99 ) * 1e-6, g.max * 1e-6 );
+    for ( int i = 0; i < CommandBufferStatsSnapshot::kErrorCodes; ++i )
+    {
+        if ( _snapshot.errors[ i ] )
+        {
+            __builtin_printf( "%s: %llu buffers failed with error %d\n", pLabel, (unsigned long long)_snapshot.errors[ i ], i );
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "CommandBufferStats.hpp"
+
+namespace util
+{
+    // Records queueing delay, GPU time and errors for every tracked
+    // command buffer through a single completed handler per buffer.
+    class CommandBufferTelemetry
+    {
+        public:
+            // Call before committing; the telemetry must outlive the buffer.
+            void track( MTL::CommandBuffer* pCommandBuffer );
+
+            void snapshot( CommandBufferStatsSnapshot* pOut, bool reset = false ) { _stats.snapshot( pOut, reset ); }
+
+            // Prints percentiles and error counts, then starts a new period.
+            void report( const char* pLabel );
+
+        private:
+            CommandBufferStats _stats;
+            CommandBufferStatsSnapshot _snapshot;
+    };
+}
@@ -0,0 +1,191 @@
+#include "CompileScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+util::CompileScheduler::JobId util::CompileScheduler::add( const char* pName, StartFunction start, std::initializer_list< JobId > dependencies )
+{
+    return add( pName, std::move( start ), std::vector< JobId >( dependencies ) );
+}
+
+util::CompileScheduler::JobId util::CompileScheduler::add( const char* pName, StartFunction start, const std::vector< JobId >& dependencies )
+{
+    JobId id = (JobId)_jobs.size();
+
+    Job job;
+    job.start = std::move( start );
+    for ( JobId dep : dependencies )
+    {
+        // Dependencies must already exist, which also rules out cycles.
+        assert( dep < id );
+        _jobs[ dep ].dependents.push_back( id );
+        job.pendingDependencies += 1;
+    }
+
+    _jobs.push_back( std::move( job ) );
+
+    JobTiming timing;
+    timing.name = pName;
+    _timings.push_back( timing );
+    return id;
+}
+
+double util::CompileScheduler::nowMs() const
+{
+    return std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - _origin ).count();
+}
+
+void util::CompileScheduler::run()
+{
+    std::vector< JobId > ready;
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _origin = std::chrono::steady_clock::now();
+        _remaining = (uint32_t)_jobs.size();
+        for ( JobId id = 0; id < _jobs.size(); ++id )
+        {
+            if ( _jobs[ id ].pendingDependencies == 0 )
+            {
+                ready.push_back( id );
+            }
+        }
+    }
+
+    for ( JobId id : ready )
+    {
+        start( id );
+    }
+}
+
+void util::CompileScheduler::start( JobId id )
+{
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _timings[ id ].startMs = nowMs();
+    }
+
+    // The callback may run on another thread, or before start() returns.
+    _jobs[ id ].start( [this, id]( bool success ){
+        std::vector< JobId > ready;
+        {
+            std::lock_guard< std::mutex > lock( _mutex );
+            finish( id, success, false, ready );
+
+            // Notify under the lock so wait() cannot return, and the
+            // scheduler be destroyed, before this callback is done with it.
+            _finished.notify_all();
+        }
+        for ( JobId next : ready )
+        {
+            start( next );
+        }
+    } );
+}
+
+void util::CompileScheduler::finish( JobId id, bool success, bool skipped, std::vector< JobId >& ready )
+{
+    Job& job = _jobs[ id ];
+    assert( !job.finished );
+    job.finished = true;
+
+    JobTiming& timing = _timings[ id ];
+    timing.endMs = nowMs();
+    if ( skipped )
+    {
+        timing.startMs = timing.endMs;
+    }
+    timing.success = success;
+    timing.skipped = skipped;
+    _failed = _failed || !success;
+    _remaining -= 1;
+
+    for ( JobId dependent : job.dependents )
+    {
+        Job& next = _jobs[ dependent ];
+        next.failedDependency = next.failedDependency || !success;
+
+        JobTiming& nextTiming = _timings[ dependent ];
+        nextTiming.gatedBy = id;
+        nextTiming.readyMs = timing.endMs;
+
+        if ( --next.pendingDependencies == 0 )
+        {
+            if ( next.failedDependency )
+            {
+                // Nothing to compile against; propagate the failure.
+                finish( dependent, false, true, ready );
+            }
+            else
+            {
+                ready.push_back( dependent );
+            }
+        }
+    }
+}
+
+bool util::CompileScheduler::wait()
+{
+    std::unique_lock< std::mutex > lock( _mutex );
+    _finished.wait( lock, [this]{ return _remaining == 0; } );
+    return !_failed;
+}
+
+std::vector< util::CompileScheduler::JobId > util::CompileScheduler::criticalPath() const
+{
+    std::vector< JobId > path;
+    if ( _timings.empty() )
+    {
+        return path;
+    }
+
+    JobId last = 0;
+    for ( JobId id = 1; id < _timings.size(); ++id )
+    {
+        if ( _timings[ id ].endMs > _timings[ last ].endMs )
+        {
+            last = id;
+        }
+    }
+
+    for ( JobId id = last; id != kNoJob; id = _timings[ id ].gatedBy )
+    {
+        path.push_back( id );
+    }
+    std::reverse( path.begin(), path.end() );
+    return path;
+}
+
+double util::CompileScheduler::wallTimeMs() const
+{
+    double end = 0.0;
+    for ( const JobTiming& t : _timings )
+    {
+        end = std::max( end, t.endMs );
+    }
+    return end;
+}
+
+double util::CompileScheduler::serialTimeMs() const
+{
+    double total = 0.0;
+    for ( const JobTiming& t : _timings )
+    {
+        total += t.endMs - t.startMs;
+    }
+    return total;
+}
+
+void util::CompileScheduler::printReport() const
+{
+    __builtin_printf( "Startup compile: %.2f ms wall, %.2f ms if serial, %zu jobs\n",
+                      wallTimeMs(), serialTimeMs(), _timings.size() );
+
+    __builtin_printf( "Critical path:\n" );
+    for ( JobId id : criticalPath() )
+    {
+        const JobTiming& t = _timings[ id ];
+        __builtin_printf( "  %-32s wait %8.2f ms  run %8.2f ms  end %8.2f ms%s\n",
+                          t.name.c_str(), t.startMs - t.readyMs, t.endMs - t.startMs, t.endMs,
+                          t.success ? "" : ( t.skipped ? "  (skipped)" : "  (failed)" ) );
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace util
+{
+    // Runs startup compile jobs (library, function, pipeline state) as soon
+    // as their dependencies finish. Jobs start asynchronous work and report
+    // back through the completion callback they are handed, which may be
+    // called from any thread, including synchronously from start().
+    //
+    // The scheduler knows nothing about Metal; jobs are plain callables so the
+    // dependency and timing logic can be driven by fake jobs.
+    class CompileScheduler
+    {
+        public:
+            using JobId = uint32_t;
+            using Completion = std::function< void( bool success ) >;
+            using StartFunction = std::function< void( Completion done ) >;
+
+            struct JobTiming
+            {
+                std::string name;
+                double readyMs = 0.0;       // all dependencies finished
+                double startMs = 0.0;
+                double endMs = 0.0;
+                bool success = false;
+                bool skipped = false;       // a dependency failed
+                JobId gatedBy = kNoJob;     // dependency that finished last
+            };
+
+            static constexpr JobId kNoJob = UINT32_MAX;
+
+            JobId add( const char* pName, StartFunction start, std::initializer_list< JobId > dependencies = {} );
+            JobId add( const char* pName, StartFunction start, const std::vector< JobId >& dependencies );
+
+            // Starts every job whose dependencies are met; the rest follow as
+            // their dependencies complete.
+            void run();
+
+            // Blocks until every job finished or was skipped. Returns false if
+            // any job failed.
+            bool wait();
+
+            const std::vector< JobTiming >& timings() const { return _timings; }
+
+            // Longest dependency chain ending at the job that finished last,
+            // listed from first to last job.
+            std::vector< JobId > criticalPath() const;
+
+            double wallTimeMs() const;
+            double serialTimeMs() const;
+
+            void printReport() const;
+
+        private:
+            struct Job
+            {
+                StartFunction start;
+                std::vector< JobId > dependents;
+                uint32_t pendingDependencies = 0;
+                bool failedDependency = false;
+                bool finished = false;
+            };
+
+            double nowMs() const;
+            void start( JobId id );
+            void finish( JobId id, bool success, bool skipped, std::vector< JobId >& ready );
+
+            std::vector< Job > _jobs;
+            std::vector< JobTiming > _timings;
+            std::chrono::steady_clock::time_point _origin;
+            std::mutex _mutex;
+            std::condition_variable _finished;
+            uint32_t _remaining = 0;
+            bool _failed = false;
+    };
+}
@@ -0,0 +1,224 @@
+#include "CpuZones.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    struct ZoneRegistry
+    {
+        std::mutex mutex;
+        std::vector< std::unique_ptr< util::ZoneRing > > rings;
+        std::vector< std::string > names;
+    };
+
+    // Never destroyed, so threads that outlive static destruction can
+    // still register.
+    ZoneRegistry& registry()
+    {
+        static ZoneRegistry* pRegistry = new ZoneRegistry();
+        return *pRegistry;
+    }
+
+    std::atomic< bool > writerActive( false );
+
+    // How long the writer spends on its first calibration pair; the rate
+    // it gives is refined by a new pair on every drain.
+    static constexpr auto kCalibrationSpan = std::chrono::milliseconds( 2 );
+
+    uint64_t ringDrops()
+    {
+        ZoneRegistry& r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        uint64_t dropped = 0;
+        for ( const std::unique_ptr< util::ZoneRing >& pRing : r.rings )
+        {
+            dropped += pRing->dropped();
+        }
+        return dropped;
+    }
+}
+
+util::ZoneRing::ZoneRing( uint32_t track )
+: _head( 0 )
+, _cachedTail( 0 )
+, _dropped( 0 )
+, _tail( 0 )
+, _track( track )
+{
+}
+
+size_t util::ZoneRing::pop( ZoneRecord* pOut, size_t maxCount )
+{
+    uint64_t tail = _tail.load( std::memory_order_relaxed );
+    uint64_t head = _head.load( std::memory_order_acquire );
+    size_t count = 0;
+    for ( ; tail != head && count < maxCount; ++tail, ++count )
+    {
+        pOut[ count ] = _records[ tail % kCapacity ];
+    }
+    _tail.store( tail, std::memory_order_release );
+    return count;
+}
+
+util::ZoneRing* util::registerZoneThread()
+{
+    ZoneRegistry& r = registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    uint32_t track = (uint32_t)r.rings.size();
+    r.rings.emplace_back( new ZoneRing( track ) );
+    r.names.push_back( "thread " + std::to_string( track ) );
+    return r.rings.back().get();
+}
+
+void util::nameZoneThread( const char* name )
+{
+    uint32_t track = threadZoneRing()->track();
+    ZoneRegistry& r = registry();
+    std::lock_guard< std::mutex > lock( r.mutex );
+    r.names[ track ] = name;
+}
+
+util::ZoneWriter::ZoneWriter( const char* path, uint32_t periodMs, size_t maxEvents )
+: _path( path ? path : "" )
+, _periodMs( periodMs )
+, _maxEvents( maxEvents )
+, _active( false )
+, _overflow( 0 )
+, _droppedBefore( 0 )
+, _stop( false )
+{
+    if ( !path )
+    {
+        return;
+    }
+    if ( writerActive.exchange( true ) )
+    {
+        __builtin_printf( "Only one ZoneWriter may be active; not tracing to %s\n", path );
+        return;
+    }
+    _active = true;
+    _droppedBefore = ringDrops();
+
+    calibrate();
+    std::this_thread::sleep_for( kCalibrationSpan );
+    calibrate();
+
+    if ( _periodMs > 0 )
+    {
+        _thread = std::thread( &ZoneWriter::writerMain, this );
+    }
+}
+
+util::ZoneWriter::~ZoneWriter()
+{
+    if ( !_active )
+    {
+        return;
+    }
+    if ( _thread.joinable() )
+    {
+        {
+            std::lock_guard< std::mutex > lock( _wakeMutex );
+            _stop = true;
+        }
+        _wake.notify_one();
+        _thread.join();
+    }
+    drain();
+
+    std::lock_guard< std::mutex > lock( _mutex );
+    if ( !_path.empty() )
+    {
+        _trace.writeFile( _path.c_str() );
+    }
+    writerActive.store( false );
+}
+
+void util::ZoneWriter::calibrate()
+{
+    // Read the tick counter either side of the clock and take the middle,
+    // which halves the error a preemption between the two reads causes.
+    uint64_t before = zoneTicks();
+    uint64_t ns = traceClockNs();
+    uint64_t after = zoneTicks();
+    _clock.addSample( ns, before + ( after - before ) / 2 );
+}
+
+void util::ZoneWriter::writerMain()
+{
+    std::unique_lock< std::mutex > lock( _wakeMutex );
+    while ( !_wake.wait_for( lock, std::chrono::milliseconds( _periodMs ), [this]{ return _stop; } ) )
+    {
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+void util::ZoneWriter::drain()
+{
+    if ( !_active )
+    {
+        return;
+    }
+
+    // Rings are only ever appended, so the ones seen here stay valid after
+    // the registry lock is dropped.
+    std::vector< ZoneRing* > rings;
+    std::vector< std::string > names;
+    {
+        ZoneRegistry& r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        for ( const std::unique_ptr< ZoneRing >& pRing : r.rings )
+        {
+            rings.push_back( pRing.get() );
+        }
+        names = r.names;
+    }
+
+    std::lock_guard< std::mutex > lock( _mutex );
+    calibrate();
+    for ( size_t i = 0; i < rings.size(); ++i )
+    {
+        _trace.nameTrack( rings[ i ]->track(), names[ i ] );
+    }
+
+    ZoneRecord records[ 256 ];
+    for ( ZoneRing* pRing : rings )
+    {
+        while ( size_t count = pRing->pop( records, 256 ) )
+        {
+            for ( size_t i = 0; i < count; ++i )
+            {
+                if ( _trace.eventCount() == _maxEvents )
+                {
+                    ++_overflow;
+                    continue;
+                }
+                _trace.add( records[ i ].pName, "cpu", _clock.toCpu( records[ i ].begin ), _clock.toCpu( records[ i ].end ),
+                            pRing->track() );
+            }
+        }
+    }
+}
+
+uint64_t util::ZoneWriter::dropped()
+{
+    uint64_t dropped = ringDrops();
+    std::lock_guard< std::mutex > lock( _mutex );
+    return dropped - _droppedBefore + _overflow;
+}
+
+size_t util::ZoneWriter::eventCount()
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    return _trace.eventCount();
+}
+
+void util::ZoneWriter::snapshot( ChromeTrace* pOut )
+{
+    std::lock_guard< std::mutex > lock( _mutex );
+    *pOut = _trace;
+}
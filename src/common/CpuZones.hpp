@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ChromeTrace.hpp"
+#include "GpuTimeline.hpp"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+// Scoped CPU zones compile to nothing unless LEARN_METAL_ZONES is defined
+// to 1, which the LEARN_METAL_ZONES CMake option does. Zone names must be
+// string literals; only the pointer is recorded.
+//
+// LEARN_METAL_ZONE_SEQUENCE splits the rest of a scope into consecutive
+// zones, each LEARN_METAL_ZONE_NEXT ending one and starting the next, so
+// the phases of a long function can be timed without new scopes. The
+// writer is static so that it still flushes when the application ends
+// the process through exit().
+#ifndef LEARN_METAL_ZONES
+#define LEARN_METAL_ZONES 0
+#endif
+
+#define LEARN_METAL_ZONE_JOIN2( a, b ) a##b
+#define LEARN_METAL_ZONE_JOIN( a, b ) LEARN_METAL_ZONE_JOIN2( a, b )
+
+#if LEARN_METAL_ZONES
+#define LEARN_METAL_ZONE( name ) ::util::ScopedZone LEARN_METAL_ZONE_JOIN( _zone, __COUNTER__ )( name )
+#define LEARN_METAL_ZONE_SEQUENCE( sequence, name ) ::util::ZoneSequence sequence( name )
+#define LEARN_METAL_ZONE_NEXT( sequence, name ) sequence.next( name )
+#define LEARN_METAL_ZONE_WRITER( path ) static ::util::ZoneWriter LEARN_METAL_ZONE_JOIN( _zoneWriter, __COUNTER__ )( path )
+#else
+#define LEARN_METAL_ZONE( name )
+#define LEARN_METAL_ZONE_SEQUENCE( sequence, name )
+#define LEARN_METAL_ZONE_NEXT( sequence, name )
+#define LEARN_METAL_ZONE_WRITER( path )
+#endif
+
+namespace util
+{
+    // Raw CPU timestamp: the TSC on x86, the virtual counter on ARM64 and
+    // traceClockNs() elsewhere. ZoneWriter maps it to nanoseconds.
+    inline uint64_t zoneTicks()
+    {
+#if defined( __x86_64__ ) || defined( __i386__ )
+        return __rdtsc();
+#elif defined( __aarch64__ )
+        uint64_t ticks;
+        asm volatile( "mrs %0, cntvct_el0" : "=r"( ticks ) );
+        return ticks;
+#else
+        return traceClockNs();
+#endif
+    }
+
+    struct ZoneRecord
+    {
+        const char* pName;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Single producer, single consumer ring of finished zones. The owning
+    // thread pushes and the writer pops; a full ring drops the zone and
+    // counts it rather than wait.
+    class ZoneRing
+    {
+        public:
+            static constexpr size_t kCapacity = 4096;
+
+            explicit ZoneRing( uint32_t track );
+
+            bool push( const ZoneRecord& record )
+            {
+                uint64_t head = _head.load( std::memory_order_relaxed );
+                if ( head - _cachedTail == kCapacity )
+                {
+                    _cachedTail = _tail.load( std::memory_order_acquire );
+                    if ( head - _cachedTail == kCapacity )
+                    {
+                        _dropped.store( _dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                        return false;
+                    }
+                }
+                _records[ head % kCapacity ] = record;
+                _head.store( head + 1, std::memory_order_release );
+                return true;
+            }
+
+            // Consumer side.
+            size_t pop( ZoneRecord* pOut, size_t maxCount );
+            uint64_t dropped() const { return _dropped.load( std::memory_order_relaxed ); }
+
+            uint32_t track() const { return _track; }
+
+        private:
+            alignas( 64 ) std::atomic< uint64_t > _head;
+            uint64_t _cachedTail;
+            std::atomic< uint64_t > _dropped;
+            alignas( 64 ) std::atomic< uint64_t > _tail;
+            uint32_t _track;
+            ZoneRecord _records[ kCapacity ];
+    };
+
+    // The calling thread's ring, registered on first use. Rings live for
+    // the rest of the process so the writer never races a thread exit.
+    ZoneRing* registerZoneThread();
+
+    inline ZoneRing* threadZoneRing()
+    {
+        static thread_local ZoneRing* pRing = nullptr;
+        if ( !pRing )
+        {
+            pRing = registerZoneThread();
+        }
+        return pRing;
+    }
+
+    // Names the calling thread's track in the trace.
+    void nameZoneThread( const char* name );
+
+    class ScopedZone
+    {
+        public:
+            explicit ScopedZone( const char* pName )
+            : _pRing( threadZoneRing() )
+            , _pName( pName )
+            , _begin( zoneTicks() )
+            {
+            }
+
+            ~ScopedZone()
+            {
+                _pRing->push( { _pName, _begin, zoneTicks() } );
+            }
+
+            ScopedZone( const ScopedZone& ) = delete;
+            ScopedZone& operator=( const ScopedZone& ) = delete;
+
+        private:
+            ZoneRing* _pRing;
+            const char* _pName;
+            uint64_t _begin;
+    };
+
+    class ZoneSequence
+    {
+        public:
+            explicit ZoneSequence( const char* pName )
+            : _pRing( threadZoneRing() )
+            , _pName( pName )
+            , _begin( zoneTicks() )
+            {
+            }
+
+            ~ZoneSequence()
+            {
+                _pRing->push( { _pName, _begin, zoneTicks() } );
+            }
+
+            void next( const char* pName )
+            {
+                uint64_t now = zoneTicks();
+                _pRing->push( { _pName, _begin, now } );
+                _pName = pName;
+                _begin = now;
+            }
+
+            ZoneSequence( const ZoneSequence& ) = delete;
+            ZoneSequence& operator=( const ZoneSequence& ) = delete;
+
+        private:
+            ZoneRing* _pRing;
+            const char* _pName;
+            uint64_t _begin;
+    };
+
+    // Drains every thread's ring on a background thread every periodMs and
+    // converts the zones to a Chrome trace, written to path when the writer
+    // is destroyed. A null path leaves the writer idle and an empty one
+    // records without writing. Only one writer may be active at a time,
+    // since each ring has a single consumer. periodMs 0 leaves draining to
+    // the caller.
+    class ZoneWriter
+    {
+        public:
+            explicit ZoneWriter( const char* path, uint32_t periodMs = 50, size_t maxEvents = 1 << 20 );
+            ~ZoneWriter();
+
+            ZoneWriter( const ZoneWriter& ) = delete;
+            ZoneWriter& operator=( const ZoneWriter& ) = delete;
+
+            bool active() const { return _active; }
+
+            // Also called by the background thread; safe to call from any
+            // thread.
+            void drain();
+
+            // Zones lost to full rings or to the event limit since the
+            // writer started.
+            uint64_t dropped();
+            size_t eventCount();
+            void snapshot( ChromeTrace* pOut );
+
+        private:
+            void writerMain();
+            void calibrate();
+
+            std::string _path;
+            uint32_t _periodMs;
+            size_t _maxEvents;
+            bool _active;
+
+            std::mutex _mutex;
+            ClockCorrelator _clock;
+            ChromeTrace _trace;
+            uint64_t _overflow;
+            uint64_t _droppedBefore;
+
+            std::mutex _wakeMutex;
+            std::condition_variable _wake;
+            bool _stop;
+            std::thread _thread;
+    };
+}
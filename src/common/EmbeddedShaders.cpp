@@ -0,0 +1,43 @@
+#include "EmbeddedShaders.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct ShaderTable
+    {
+        const util::EmbeddedShader* pShaders;
+        size_t count;
+    };
+
+    // Function-local so registration from other translation units' static
+    // initializers does not depend on initialization order.
+    std::vector< ShaderTable >& shaderTables()
+    {
+        static std::vector< ShaderTable > tables;
+        return tables;
+    }
+}
+
+util::EmbeddedShaderRegistration::EmbeddedShaderRegistration( const EmbeddedShader* pShaders, size_t count )
+{
+    shaderTables().push_back( { pShaders, count } );
+}
+
+const util::EmbeddedShader* util::findEmbeddedShader( const char* pSource )
+{
+    size_t size = strlen( pSource );
+    for ( const ShaderTable& table : shaderTables() )
+    {
+        for ( size_t i = 0; i < table.count; ++i )
+        {
+            const EmbeddedShader& shader = table.pShaders[ i ];
+            if ( shader.sourceSize == size && memcmp( shader.pSource, pSource, size ) == 0 )
+            {
+                return &shader;
+            }
+        }
+    }
+    return nullptr;
+}
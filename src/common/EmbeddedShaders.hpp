@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace util
+{
+    // Whether a shader may be compiled with fast math. Kernels whose results
+    // are compared against a CPU reference, like mandelbrot_set, need
+    // Precise so both sides round the same way.
+    enum class ShaderMath
+    {
+        Fast,
+        Precise,
+    };
+
+    // A shader extracted from a sample at build time: the MSL source exactly
+    // as it appears in the raw string literal, and the compiled metallib if
+    // the Metal toolchain was available (null otherwise), compiled with the
+    // given math mode.
+    struct EmbeddedShader
+    {
+        const unsigned char* pSource;
+        size_t sourceSize;
+        const unsigned char* pLibrary;
+        size_t librarySize;
+        ShaderMath math;
+    };
+
+    // Generated shader tables register themselves through a static instance
+    // of this class. The table must have static storage duration.
+    class EmbeddedShaderRegistration
+    {
+        public:
+            EmbeddedShaderRegistration( const EmbeddedShader* pShaders, size_t count );
+    };
+
+    // Finds the embedded shader whose source matches pSource, or null.
+    const EmbeddedShader* findEmbeddedShader( const char* pSource );
+}
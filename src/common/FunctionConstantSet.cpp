@@ -0,0 +1,57 @@
+#include "FunctionConstantSet.hpp"
+
+#include <algorithm>
+
+#include "PipelineKey.hpp"
+
+util::FunctionConstantSet::Constant& util::FunctionConstantSet::slot( uint32_t index, FunctionConstantType type )
+{
+    auto it = std::lower_bound( _constants.begin(), _constants.end(), index, []( const Constant& c, uint32_t i ){
+        return c.index < i;
+    } );
+    if ( it == _constants.end() || it->index != index )
+    {
+        Constant c = {};
+        c.index = index;
+        it = _constants.insert( it, c );
+    }
+    it->type = type;
+    return *it;
+}
+
+util::FunctionConstantSet& util::FunctionConstantSet::setBool( uint32_t index, bool value )
+{
+    Constant& c = slot( index, FunctionConstantType::Bool );
+    c.i = 0;
+    c.b = value;
+    return *this;
+}
+
+util::FunctionConstantSet& util::FunctionConstantSet::setInt( uint32_t index, int32_t value )
+{
+    slot( index, FunctionConstantType::Int ).i = value;
+    return *this;
+}
+
+util::FunctionConstantSet& util::FunctionConstantSet::setFloat( uint32_t index, float value )
+{
+    slot( index, FunctionConstantType::Float ).f = value;
+    return *this;
+}
+
+uint64_t util::FunctionConstantSet::key() const
+{
+    PipelineKeyBuilder builder;
+    builder.add( _constants.size() );
+    for ( const Constant& c : _constants )
+    {
+        builder.add( ( (uint64_t)c.index << 8 ) | (uint64_t)c.type );
+        switch ( c.type )
+        {
+            case FunctionConstantType::Bool: builder.add( c.b ? 1 : 0 ); break;
+            case FunctionConstantType::Int: builder.add( (uint64_t)(uint32_t)c.i ); break;
+            case FunctionConstantType::Float: builder.addFloat( c.f ); break;
+        }
+    }
+    return builder.key();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    enum class FunctionConstantType : uint8_t
+    {
+        Bool,
+        Int,
+        Float,
+    };
+
+    // A set of function constant values, kept sorted by index so that the
+    // same values set in any order produce the same key.
+    class FunctionConstantSet
+    {
+        public:
+            struct Constant
+            {
+                uint32_t index;
+                FunctionConstantType type;
+                union
+                {
+                    bool b;
+                    int32_t i;
+                    float f;
+                };
+            };
+
+            FunctionConstantSet& setBool( uint32_t index, bool value );
+            FunctionConstantSet& setInt( uint32_t index, int32_t value );
+            FunctionConstantSet& setFloat( uint32_t index, float value );
+
+            // Compact hash of the indices, types and values; a set that
+            // differs only in float sign of zero hashes the same.
+            uint64_t key() const;
+
+            const std::vector< Constant >& constants() const { return _constants; }
+            bool empty() const { return _constants.empty(); }
+
+        private:
+            Constant& slot( uint32_t index, FunctionConstantType type );
+
+            std::vector< Constant > _constants;
+    };
+}
@@ -0,0 +1,193 @@
+#include "GpuProfiler.hpp"
+
+#include <mach/mach_time.h>
+
+namespace
+{
+    // MTLCounterDontSample, which the bundled metal-cpp does not define.
+    static constexpr NS::UInteger kDontSample = NS::UIntegerMax;
+
+    MTL::CounterSet* timestampCounterSet( MTL::Device* pDevice )
+    {
+        NS::Array* pSets = pDevice->counterSets();
+        for ( NS::UInteger i = 0; pSets && i < pSets->count(); ++i )
+        {
+            MTL::CounterSet* pSet = static_cast< MTL::CounterSet* >( pSets->object( i ) );
+            if ( pSet->name()->isEqualToString( MTL::CommonCounterSetTimestamp ) )
+            {
+                return pSet;
+            }
+        }
+        return nullptr;
+    }
+
+    // sampleTimestamps() reports CPU time in mach_absolute_time() ticks.
+    uint64_t machTicksToNs( uint64_t ticks )
+    {
+        static mach_timebase_info_data_t timebase = []{
+            mach_timebase_info_data_t info;
+            mach_timebase_info( &info );
+            return info;
+        }();
+        return (uint64_t)( (unsigned __int128)ticks * timebase.numer / timebase.denom );
+    }
+}
+
+util::GpuProfiler::GpuProfiler( MTL::Device* pDevice, uint32_t frameCount, uint32_t maxPassesPerFrame )
+: _pDevice( pDevice->retain() )
+, _maxPasses( maxPassesPerFrame )
+, _pCurrent( nullptr )
+, _frame( 0 )
+{
+    _trace.nameTrack( kCpuTrack, "CPU" );
+    _trace.nameTrack( kGpuTrack, "GPU" );
+
+    MTL::CounterSet* pTimestamps = timestampCounterSet( pDevice );
+    if ( !pTimestamps || !pDevice->supportsCounterSampling( MTL::CounterSamplingPointAtStageBoundary ) )
+    {
+        __builtin_printf( "GPU timestamps are not supported on this device\n" );
+        return;
+    }
+
+    MTL::CounterSampleBufferDescriptor* pDesc = MTL::CounterSampleBufferDescriptor::alloc()->init();
+    pDesc->setCounterSet( pTimestamps );
+    pDesc->setStorageMode( MTL::StorageModeShared );
+    pDesc->setSampleCount( 2 * maxPassesPerFrame );
+    for ( uint32_t i = 0; i < frameCount; ++i )
+    {
+        NS::Error* pError = nullptr;
+        MTL::CounterSampleBuffer* pSamples = pDevice->newCounterSampleBuffer( pDesc, &pError );
+        if ( !pSamples )
+        {
+            __builtin_printf( "%s\n", pError->localizedDescription()->utf8String() );
+            _slots.clear();
+            break;
+        }
+        _slots.emplace_back( new Slot() );
+        _slots.back()->pSamples = pSamples;
+        _slots.back()->completed = false;
+        _slots.back()->inFlight = false;
+    }
+    pDesc->release();
+}
+
+util::GpuProfiler::~GpuProfiler()
+{
+    for ( std::unique_ptr< Slot >& pSlot : _slots )
+    {
+        pSlot->pSamples->release();
+    }
+    _pDevice->release();
+}
+
+void util::GpuProfiler::resolve( Slot& slot )
+{
+    if ( !slot.passes.empty() )
+    {
+        NS::Data* pData = slot.pSamples->resolveCounterRange( NS::Range::Make( 0, 2 * slot.passes.size() ) );
+        if ( pData )
+        {
+            static_assert( sizeof( MTL::CounterResultTimestamp ) == sizeof( uint64_t ), "Timestamp layout mismatch" );
+            appendGpuPasses( slot.passes.data(), slot.passes.size(), static_cast< const uint64_t* >( pData->mutableBytes() ),
+                             pData->length() / sizeof( uint64_t ), _clock, kGpuTrack, &_trace );
+        }
+    }
+    slot.passes.clear();
+    slot.inFlight = false;
+}
+
+void util::GpuProfiler::beginFrame( MTL::CommandBuffer* pCommandBuffer )
+{
+    _pCurrent = nullptr;
+    if ( !enabled() )
+    {
+        return;
+    }
+
+    if ( calibrationDue( _frame ) )
+    {
+        MTL::Timestamp cpu = 0, gpu = 0;
+        _pDevice->sampleTimestamps( &cpu, &gpu );
+        _clock.addSample( machTicksToNs( cpu ), gpu );
+    }
+
+    // A slot whose frame is still on the GPU is skipped rather than waited
+    // for; that frame just goes unprofiled.
+    Slot& slot = *_slots[ _frame++ % _slots.size() ];
+    if ( slot.inFlight )
+    {
+        if ( !slot.completed.load( std::memory_order_acquire ) )
+        {
+            return;
+        }
+        resolve( slot );
+    }
+
+    slot.completed.store( false, std::memory_order_relaxed );
+    slot.inFlight = true;
+    Slot* pSlot = &slot;
+    pCommandBuffer->addCompletedHandler( [pSlot]( MTL::CommandBuffer* ){
+        pSlot->completed.store( true, std::memory_order_release );
+    } );
+    _pCurrent = pSlot;
+}
+
+uint32_t util::GpuProfiler::reserve( const char* name )
+{
+    if ( !_pCurrent || _pCurrent->passes.size() == _maxPasses )
+    {
+        return UINT32_MAX;
+    }
+    uint32_t begin = (uint32_t)_pCurrent->passes.size() * 2;
+    _pCurrent->passes.push_back( { name, begin, begin + 1 } );
+    return begin;
+}
+
+void util::GpuProfiler::attach( MTL::RenderPassDescriptor* pDescriptor, const char* name )
+{
+    // Descriptors such as MTK::View's are reused across frames, so a pass
+    // that is not sampled must drop the buffer an earlier frame attached.
+    MTL::RenderPassSampleBufferAttachmentDescriptor* pAttachment = pDescriptor->sampleBufferAttachments()->object( 0 );
+    uint32_t begin = reserve( name );
+    if ( begin == UINT32_MAX )
+    {
+        pAttachment->setSampleBuffer( nullptr );
+        return;
+    }
+    pAttachment->setSampleBuffer( _pCurrent->pSamples );
+    pAttachment->setStartOfVertexSampleIndex( begin );
+    pAttachment->setEndOfVertexSampleIndex( kDontSample );
+    pAttachment->setStartOfFragmentSampleIndex( kDontSample );
+    pAttachment->setEndOfFragmentSampleIndex( begin + 1 );
+}
+
+void util::GpuProfiler::attach( MTL::ComputePassDescriptor* pDescriptor, const char* name )
+{
+    MTL::ComputePassSampleBufferAttachmentDescriptor* pAttachment = pDescriptor->sampleBufferAttachments()->object( 0 );
+    uint32_t begin = reserve( name );
+    if ( begin == UINT32_MAX )
+    {
+        pAttachment->setSampleBuffer( nullptr );
+        return;
+    }
+    pAttachment->setSampleBuffer( _pCurrent->pSamples );
+    pAttachment->setStartOfEncoderSampleIndex( begin );
+    pAttachment->setEndOfEncoderSampleIndex( begin + 1 );
+}
+
+void util::GpuProfiler::addCpuEvent( const char* name, uint64_t startNs, uint64_t endNs )
+{
+    _trace.add( name, "cpu", startNs, endNs, kCpuTrack );
+}
+
+bool util::GpuProfiler::writeTrace( const char* path )
+{
+    for ( std::unique_ptr< Slot >& pSlot : _slots )
+    {
+        if ( pSlot->inFlight && pSlot->completed.load( std::memory_order_acquire ) )
+        {
+            resolve( *pSlot );
+        }
+    }
+    return _trace.writeFile( path );
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "ChromeTrace.hpp"
+#include "GpuTimeline.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace util
+{
+    // Per-pass GPU times from timestamp counters, on the same timeline as
+    // CPU events. Every frame takes the next of frameCount sample buffers;
+    // attach() asks Metal to sample at the start and end of a pass, and the
+    // buffer is resolved when the ring comes back to it, provided its
+    // command buffer has completed, so nothing waits on the GPU. Passes go
+    // on track 1 and CPU events added with addCpuEvent() on track 0.
+    //
+    // Uses stage boundary sampling, which every GPU with a timestamp counter
+    // set supports; on devices without one enabled() is false and every
+    // call does nothing.
+    class GpuProfiler
+    {
+        public:
+            static constexpr uint32_t kCpuTrack = 0;
+            static constexpr uint32_t kGpuTrack = 1;
+
+            GpuProfiler( MTL::Device* pDevice, uint32_t frameCount, uint32_t maxPassesPerFrame = 16 );
+            ~GpuProfiler();
+
+            bool enabled() const { return !_slots.empty(); }
+
+            // Call once per frame before encoding any pass into pCommandBuffer.
+            // The command buffer's completed handler writes into the profiler,
+            // so it must outlive the command buffer.
+            void beginFrame( MTL::CommandBuffer* pCommandBuffer );
+
+            // Call before creating the encoder from pDescriptor.
+            void attach( MTL::RenderPassDescriptor* pDescriptor, const char* name );
+            void attach( MTL::ComputePassDescriptor* pDescriptor, const char* name );
+
+            void addCpuEvent( const char* name, uint64_t startNs, uint64_t endNs );
+
+            // Resolves whatever has completed and writes the trace.
+            bool writeTrace( const char* path );
+            const ChromeTrace& trace() const { return _trace; }
+
+        private:
+            struct Slot
+            {
+                MTL::CounterSampleBuffer* pSamples;
+                std::vector< GpuPassRange > passes;
+                std::atomic< bool > completed;
+                bool inFlight;
+            };
+
+            uint32_t reserve( const char* name );
+            void resolve( Slot& slot );
+
+            MTL::Device* _pDevice;
+            uint32_t _maxPasses;
+            std::vector< std::unique_ptr< Slot > > _slots;
+            Slot* _pCurrent;
+            uint64_t _frame;
+            ClockCorrelator _clock;
+            ChromeTrace _trace;
+    };
+}
@@ -0,0 +1,88 @@
+#include "GpuTimeline.hpp"
+
+#include <cmath>
+
+util::ClockCorrelator::ClockCorrelator()
+{
+    reset();
+}
+
+void util::ClockCorrelator::reset()
+{
+    _count = 0;
+    _next = 0;
+    _cpuOrigin = 0;
+    _gpuOrigin = 0;
+    _cpuIntercept = 0.0;
+    _slope = 1.0;
+}
+
+void util::ClockCorrelator::addSample( uint64_t cpuNs, uint64_t gpuTicks )
+{
+    _cpu[ _next ] = cpuNs;
+    _gpu[ _next ] = gpuTicks;
+    _next = ( _next + 1 ) % kWindow;
+    _count = _count < kWindow ? _count + 1 : kWindow;
+    fit();
+}
+
+void util::ClockCorrelator::fit()
+{
+    // Offsets from the newest pair keep the doubles exact for the range
+    // being mapped, which is usually just before it.
+    size_t newest = ( _next + kWindow - 1 ) % kWindow;
+    _cpuOrigin = _cpu[ newest ];
+    _gpuOrigin = _gpu[ newest ];
+
+    double meanX = 0.0, meanY = 0.0;
+    for ( size_t i = 0; i < _count; ++i )
+    {
+        meanX += (double)(int64_t)( _gpu[ i ] - _gpuOrigin );
+        meanY += (double)(int64_t)( _cpu[ i ] - _cpuOrigin );
+    }
+    meanX /= _count;
+    meanY /= _count;
+
+    double sxx = 0.0, sxy = 0.0;
+    for ( size_t i = 0; i < _count; ++i )
+    {
+        double dx = (double)(int64_t)( _gpu[ i ] - _gpuOrigin ) - meanX;
+        double dy = (double)(int64_t)( _cpu[ i ] - _cpuOrigin ) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if ( sxx > 0.0 )
+    {
+        _slope = sxy / sxx;
+    }
+    _cpuIntercept = meanY - _slope * meanX;
+}
+
+uint64_t util::ClockCorrelator::toCpu( uint64_t gpuTicks ) const
+{
+    double dx = (double)(int64_t)( gpuTicks - _gpuOrigin );
+    return _cpuOrigin + (uint64_t)(int64_t)llround( _cpuIntercept + _slope * dx );
+}
+
+size_t util::appendGpuPasses( const GpuPassRange* pPasses, size_t passCount, const uint64_t* pSamples, size_t sampleCount,
+                              const ClockCorrelator& clock, uint32_t track, ChromeTrace* pTrace )
+{
+    size_t added = 0;
+    for ( size_t i = 0; i < passCount; ++i )
+    {
+        const GpuPassRange& p = pPasses[ i ];
+        if ( p.beginSample >= sampleCount || p.endSample >= sampleCount )
+        {
+            continue;
+        }
+        uint64_t begin = pSamples[ p.beginSample ];
+        uint64_t end = pSamples[ p.endSample ];
+        if ( begin == 0 || end == 0 || begin == kCounterErrorValue || end == kCounterErrorValue || end < begin )
+        {
+            continue;
+        }
+        pTrace->add( p.name, "gpu", clock.toCpu( begin ), clock.toCpu( end ), track );
+        ++added;
+    }
+    return added;
+}
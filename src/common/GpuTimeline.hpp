@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ChromeTrace.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace util
+{
+    // Maps GPU timestamps onto the CPU clock. Each addSample() takes a pair
+    // read together by Device::sampleTimestamps(); the map is a least
+    // squares line through the last kWindow pairs, so it follows drift
+    // between the clocks and averages out the latency of each read.
+    class ClockCorrelator
+    {
+        public:
+            static constexpr size_t kWindow = 8;
+
+            ClockCorrelator();
+
+            void addSample( uint64_t cpuNs, uint64_t gpuTicks );
+            void reset();
+
+            // Two pairs give the rate; before that GPU ticks are taken to
+            // be nanoseconds.
+            bool calibrated() const { return _count >= 2; }
+            size_t sampleCount() const { return _count; }
+
+            uint64_t toCpu( uint64_t gpuTicks ) const;
+            double nsPerTick() const { return _slope; }
+
+        private:
+            void fit();
+
+            uint64_t _cpu[ kWindow ];
+            uint64_t _gpu[ kWindow ];
+            size_t _count;
+            size_t _next;
+            uint64_t _cpuOrigin;
+            uint64_t _gpuOrigin;
+            double _cpuIntercept;
+            double _slope;
+    };
+
+    // Whether frame should read a new clock pair: on power-of-two frames,
+    // so the first pairs quickly span enough time to give a good rate, and
+    // then every kCalibrationInterval frames to follow drift.
+    static constexpr uint64_t kCalibrationInterval = 60;
+
+    inline bool calibrationDue( uint64_t frame )
+    {
+        return ( frame & ( frame - 1 ) ) == 0 || frame % kCalibrationInterval == 0;
+    }
+
+    // Pass timestamps as written by the GPU: what a sample buffer entry
+    // holds when the GPU could not take a sample, and which two entries
+    // bound each pass.
+    static constexpr uint64_t kCounterErrorValue = ~0ull;
+
+    struct GpuPassRange
+    {
+        std::string name;
+        uint32_t beginSample;
+        uint32_t endSample;
+    };
+
+    // Adds an event on track for every pass with two valid samples, in CPU
+    // time. Returns how many were added.
+    size_t appendGpuPasses( const GpuPassRange* pPasses, size_t passCount, const uint64_t* pSamples, size_t sampleCount,
+                            const ClockCorrelator& clock, uint32_t track, ChromeTrace* pTrace );
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace util
+{
+    // FNV-1a, 64 bit. Stable across runs and platforms, so hashes built with
+    // it can be persisted (pipeline cache keys, specialization keys).
+    static constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+    static constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+    inline uint64_t hashBytes( const void* pData, size_t size, uint64_t seed = kFnvOffset )
+    {
+        const uint8_t* p = static_cast< const uint8_t* >( pData );
+        uint64_t h = seed;
+        for ( size_t i = 0; i < size; ++i )
+        {
+            h ^= p[ i ];
+            h *= kFnvPrime;
+        }
+        return h;
+    }
+
+    template< typename T >
+    inline uint64_t hashValue( const T& value, uint64_t seed = kFnvOffset )
+    {
+        return hashBytes( &value, sizeof( T ), seed );
+    }
+
+    // Hashes the bit pattern of a float with -0.0 folded into +0.0 so that
+    // values comparing equal also hash equal.
+    inline uint64_t hashFloat( float value, uint64_t seed = kFnvOffset )
+    {
+        value += 0.0f;
+        uint32_t bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        return hashValue( bits, seed );
+    }
+
+    inline uint64_t hashString( const char* pString, uint64_t seed = kFnvOffset )
+    {
+        return pString ? hashBytes( pString, strlen( pString ), seed ) : hashValue( 0u, seed );
+    }
+}
@@ -0,0 +1,146 @@
+#include "HeadlessRunner.hpp"
+
+#include "ChromeTrace.hpp"
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    uint8_t toUnorm8( float v )
+    {
+        return (uint8_t)( std::min( std::max( v, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+    }
+}
+
+bool util::headlessOptionsFromEnv( const char* pSampleName, HeadlessOptions* pOut )
+{
+    const char* pFrames = getenv( "LEARN_METAL_HEADLESS" );
+    pOut->frames = pFrames ? (uint32_t)std::max( 0, atoi( pFrames ) ) : 0;
+    if ( pOut->frames == 0 )
+    {
+        return false;
+    }
+
+    if ( const char* pSize = getenv( "LEARN_METAL_HEADLESS_SIZE" ) )
+    {
+        unsigned width = 0;
+        unsigned height = 0;
+        if ( sscanf( pSize, "%ux%u", &width, &height ) == 2 && width > 0 && height > 0 )
+        {
+            pOut->width = width;
+            pOut->height = height;
+        }
+        else
+        {
+            __builtin_printf( "Ignoring LEARN_METAL_HEADLESS_SIZE \"%s\"; expected WxH\n", pSize );
+        }
+    }
+
+    const char* pImage = getenv( "LEARN_METAL_HEADLESS_IMAGE" );
+    pOut->imagePath = pImage ? pImage : std::string( pSampleName ) + ".ppm";
+    return true;
+}
+
+uint64_t util::Image::hash() const
+{
+    uint64_t h = hashValue( width );
+    h = hashValue( height, h );
+    return hashBytes( rgba.data(), rgba.size(), h );
+}
+
+bool util::Image::writePpm( const char* pPath ) const
+{
+    FILE* pFile = fopen( pPath, "wb" );
+    if ( !pFile )
+    {
+        __builtin_printf( "Failed to open \"%s\" for writing\n", pPath );
+        return false;
+    }
+    fprintf( pFile, "P6\n%u %u\n255\n", width, height );
+    std::vector< uint8_t > row( width * 3 );
+    for ( uint32_t y = 0; y < height; ++y )
+    {
+        const uint8_t* pSrc = rgba.data() + (size_t)y * width * 4;
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            row[ x * 3 + 0 ] = pSrc[ x * 4 + 0 ];
+            row[ x * 3 + 1 ] = pSrc[ x * 4 + 1 ];
+            row[ x * 3 + 2 ] = pSrc[ x * 4 + 2 ];
+        }
+        fwrite( row.data(), 1, row.size(), pFile );
+    }
+    bool ok = !ferror( pFile );
+    fclose( pFile );
+    if ( !ok )
+    {
+        __builtin_printf( "Failed to write \"%s\"\n", pPath );
+    }
+    return ok;
+}
+
+util::SoftwareTarget::SoftwareTarget( uint32_t width, uint32_t height )
+: _depth( (size_t)width * height, 1.0f )
+{
+    _color.width = width;
+    _color.height = height;
+    _color.rgba.assign( (size_t)width * height * 4, 0 );
+}
+
+void util::SoftwareTarget::clear( float r, float g, float b, float a, float depth )
+{
+    const uint8_t rgba[ 4 ] = { toUnorm8( r ), toUnorm8( g ), toUnorm8( b ), toUnorm8( a ) };
+    for ( size_t i = 0; i < _depth.size(); ++i )
+    {
+        std::copy( rgba, rgba + 4, _color.rgba.data() + i * 4 );
+    }
+    std::fill( _depth.begin(), _depth.end(), depth );
+}
+
+void util::SoftwareTarget::fillRect( int x0, int y0, int x1, int y1, float depth, const uint8_t rgba[ 4 ] )
+{
+    x0 = std::max( x0, 0 );
+    y0 = std::max( y0, 0 );
+    x1 = std::min( x1, (int)_color.width );
+    y1 = std::min( y1, (int)_color.height );
+    for ( int y = y0; y < y1; ++y )
+    {
+        size_t row = (size_t)y * _color.width;
+        for ( int x = x0; x < x1; ++x )
+        {
+            if ( depth <= _depth[ row + x ] )
+            {
+                _depth[ row + x ] = depth;
+                std::copy( rgba, rgba + 4, _color.rgba.data() + ( row + x ) * 4 );
+            }
+        }
+    }
+}
+
+void util::runHeadlessFrames( uint32_t frames, const std::function< void( uint32_t ) >& drawFrame,
+                              const std::function< void() >& waitIdle, HeadlessStats* pOut )
+{
+    LatencyHistogram frameNs;
+    uint64_t start = traceClockNs();
+    for ( uint32_t frame = 0; frame < frames; ++frame )
+    {
+        uint64_t frameStart = traceClockNs();
+        drawFrame( frame );
+        frameNs.record( traceClockNs() - frameStart );
+    }
+    waitIdle();
+
+    pOut->frames = frames;
+    pOut->seconds = ( traceClockNs() - start ) * 1e-9;
+    frameNs.snapshot( &pOut->frameNs );
+}
+
+void util::printHeadlessStats( const char* pLabel, const HeadlessStats& stats )
+{
+    __builtin_printf( "%s: %u frames in %.3f s (%.1f fps), CPU per frame mean %.3f p50 %.3f p99 %.3f max %.3f ms\n",
+                      pLabel, stats.frames, stats.seconds, stats.seconds > 0.0 ? stats.frames / stats.seconds : 0.0,
+                      stats.frameNs.mean() * 1e-6, stats.frameNs.percentile( 0.5 ) * 1e-6,
+                      stats.frameNs.percentile( 0.99 ) * 1e-6, stats.frameNs.max * 1e-6 );
+}
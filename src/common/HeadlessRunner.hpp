@@ -0,0 +1,75 @@
+#pragma once
+
+#include "LatencyHistogram.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace util
+{
+    // Settings for running a sample without a window, read from
+    // LEARN_METAL_HEADLESS (frame count; unset or 0 means windowed),
+    // LEARN_METAL_HEADLESS_SIZE ("WxH", default 1024x1024) and
+    // LEARN_METAL_HEADLESS_IMAGE (where to write the last frame, default
+    // "<sample>.ppm").
+    struct HeadlessOptions
+    {
+        uint32_t frames = 0;
+        uint32_t width = 1024;
+        uint32_t height = 1024;
+        std::string imagePath;
+    };
+
+    bool headlessOptionsFromEnv( const char* pSampleName, HeadlessOptions* pOut );
+
+    // A tightly packed RGBA8 image, top row first.
+    struct Image
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector< uint8_t > rgba;
+
+        uint64_t hash() const;
+        // Binary PPM (P6); alpha is dropped.
+        bool writePpm( const char* pPath ) const;
+    };
+
+    // Stand-in for a color and depth texture pair where there is no GPU.
+    // Draws depth-tested solid rectangles, which is enough to see where
+    // a sample's instances land.
+    class SoftwareTarget
+    {
+        public:
+            SoftwareTarget( uint32_t width, uint32_t height );
+
+            // Components in [0, 1], as in MTL::ClearColor.
+            void clear( float r, float g, float b, float a, float depth );
+            // Covers pixels [x0, x1) x [y0, y1), clipped to the target, where
+            // depth passes LessEqual against what is there.
+            void fillRect( int x0, int y0, int x1, int y1, float depth, const uint8_t rgba[ 4 ] );
+
+            uint32_t width() const { return _color.width; }
+            uint32_t height() const { return _color.height; }
+            void readback( Image* pOut ) const { *pOut = _color; }
+
+        private:
+            Image _color;
+            std::vector< float > _depth;
+    };
+
+    struct HeadlessStats
+    {
+        uint32_t frames = 0;
+        double seconds = 0.0;       // all frames, including the final wait
+        HistogramSnapshot frameNs;  // CPU time of each drawFrame call
+    };
+
+    // Calls drawFrame( 0 .. frames - 1 ) back to back, then waitIdle() so
+    // every submitted frame has finished, timing each call.
+    void runHeadlessFrames( uint32_t frames, const std::function< void( uint32_t ) >& drawFrame,
+                            const std::function< void() >& waitIdle, HeadlessStats* pOut );
+
+    void printHeadlessStats( const char* pLabel, const HeadlessStats& stats );
+}
@@ -0,0 +1,470 @@
+#include "InstanceTransforms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Four-lane vectors through the GCC/Clang vector extension, which lowers to
+// SSE on x86 and NEON on ARM, and to scalar code anywhere else.
+
+namespace
+{
+    typedef float f32x4 __attribute__(( vector_size( 16 ) ));
+    typedef int32_t i32x4 __attribute__(( vector_size( 16 ) ));
+
+    inline f32x4 splat( float v ) { return f32x4{ v, v, v, v }; }
+
+    inline f32x4 load( const float* p, size_t i, size_t lanes, float fallback )
+    {
+        if ( !p )
+        {
+            return splat( fallback );
+        }
+        f32x4 v = splat( fallback );
+        memcpy( &v, p + i, lanes * sizeof( float ) );
+        return v;
+    }
+
+    inline f32x4 select( i32x4 mask, f32x4 a, f32x4 b )
+    {
+        return (f32x4)( ( (i32x4)a & mask ) | ( (i32x4)b & ~mask ) );
+    }
+
+    inline f32x4 clamp( f32x4 v, float lo, float hi )
+    {
+        v = select( v < splat( lo ), splat( lo ), v );
+        return select( v > splat( hi ), splat( hi ), v );
+    }
+
+    // Nearest integer, halves away from zero.
+    inline i32x4 roundToInt( f32x4 v )
+    {
+        return __builtin_convertvector( v + select( v < splat( 0.0f ), splat( -0.5f ), splat( 0.5f ) ), i32x4 );
+    }
+
+    // Cephes-style reduction to [-pi/4, pi/4] around the nearest multiple of
+    // pi/2, with pi/2 split in three parts to keep the reduction exact.
+    void sincos( f32x4 x, f32x4* pSin, f32x4* pCos )
+    {
+        const f32x4 half = splat( 0.5f );
+        i32x4 quadrant = roundToInt( x * splat( 0.63661977236758134308f ) );
+        f32x4 j = __builtin_convertvector( quadrant, f32x4 );
+
+        f32x4 y = x - j * splat( 1.5703125f );
+        y = y - j * splat( 4.837512969970703125e-4f );
+        y = y - j * splat( 7.54978995489188216e-8f );
+
+        f32x4 z = y * y;
+        f32x4 s = ( ( splat( -1.9515295891e-4f ) * z + splat( 8.3321608736e-3f ) ) * z + splat( -1.6666654611e-1f ) ) * z * y + y;
+        f32x4 c = ( ( splat( 2.443315711809948e-5f ) * z + splat( -1.388731625493765e-3f ) ) * z + splat( 4.166664568298827e-2f ) ) * z * z
+                  - half * z + splat( 1.0f );
+
+        // Quadrant q: sin = { s, c, -s, -c }[ q ], cos = { c, -s, -c, s }[ q ].
+        i32x4 swap = ( quadrant & 1 ) != 0;
+        f32x4 sinValue = select( swap, c, s );
+        f32x4 cosValue = select( swap, s, c );
+        i32x4 negateSin = ( quadrant & 2 ) != 0;
+        i32x4 negateCos = ( ( quadrant + 1 ) & 2 ) != 0;
+        *pSin = select( negateSin, -sinValue, sinValue );
+        *pCos = select( negateCos, -cosValue, cosValue );
+    }
+
+    struct Parent
+    {
+        float m[ 3 ][ 3 ];  // [ row ][ column ]
+        float t[ 3 ];
+    };
+
+    Parent loadParent( const float* pParent )
+    {
+        Parent p = {};
+        for ( int r = 0; r < 3; ++r )
+        {
+            for ( int c = 0; c < 3; ++c )
+            {
+                p.m[ r ][ c ] = pParent ? pParent[ c * 4 + r ] : ( r == c ? 1.0f : 0.0f );
+            }
+            p.t[ r ] = pParent ? pParent[ 12 + r ] : 0.0f;
+        }
+        return p;
+    }
+
+    // Four instances' worth of composed transforms, one lane per instance.
+    struct Lanes
+    {
+        f32x4 m[ 3 ][ 3 ];  // [ row ][ column ]
+        f32x4 t[ 3 ];
+        f32x4 color[ 4 ];
+        bool hasColor;
+    };
+
+    void compose4( const util::InstanceTransformInputs& in, const Parent& parent, size_t i, size_t lanes, Lanes* pLanes )
+    {
+        f32x4 sx, cx, sy, cy, sz, cz;
+        sincos( load( in.pRotationX, i, lanes, 0.0f ), &sx, &cx );
+        sincos( load( in.pRotationY, i, lanes, 0.0f ), &sy, &cy );
+        sincos( load( in.pRotationZ, i, lanes, 0.0f ), &sz, &cz );
+
+        f32x4 scale[ 3 ] = {
+            load( in.pScaleX, i, lanes, in.uniformScale ),
+            load( in.pScaleY, i, lanes, in.uniformScale ),
+            load( in.pScaleZ, i, lanes, in.uniformScale ),
+        };
+
+        // R = Rx * Ry * Rz multiplied out, [ row ][ column ].
+        f32x4 sxsy = sx * sy;
+        f32x4 cxsy = cx * sy;
+        f32x4 l[ 3 ][ 3 ] = {
+            { cy * cz, cy * sz, sy },
+            { -cx * sz - sxsy * cz, cx * cz - sxsy * sz, sx * cy },
+            { sx * sz - cxsy * cz, -sx * cz - cxsy * sz, cx * cy },
+        };
+        for ( int r = 0; r < 3; ++r )
+        {
+            for ( int c = 0; c < 3; ++c )
+            {
+                l[ r ][ c ] *= scale[ c ];
+            }
+        }
+
+        f32x4 t[ 3 ] = {
+            load( in.pPositionX, i, lanes, 0.0f ),
+            load( in.pPositionY, i, lanes, 0.0f ),
+            load( in.pPositionZ, i, lanes, 0.0f ),
+        };
+
+        for ( int r = 0; r < 3; ++r )
+        {
+            f32x4 p0 = splat( parent.m[ r ][ 0 ] );
+            f32x4 p1 = splat( parent.m[ r ][ 1 ] );
+            f32x4 p2 = splat( parent.m[ r ][ 2 ] );
+            for ( int c = 0; c < 3; ++c )
+            {
+                pLanes->m[ r ][ c ] = p0 * l[ 0 ][ c ] + p1 * l[ 1 ][ c ] + p2 * l[ 2 ][ c ];
+            }
+            pLanes->t[ r ] = p0 * t[ 0 ] + p1 * t[ 1 ] + p2 * t[ 2 ] + splat( parent.t[ r ] );
+        }
+
+        pLanes->hasColor = in.pColorR && in.pColorG && in.pColorB;
+        if ( pLanes->hasColor )
+        {
+            pLanes->color[ 0 ] = load( in.pColorR, i, lanes, 0.0f );
+            pLanes->color[ 1 ] = load( in.pColorG, i, lanes, 0.0f );
+            pLanes->color[ 2 ] = load( in.pColorB, i, lanes, 0.0f );
+            pLanes->color[ 3 ] = load( in.pColorA, i, lanes, 1.0f );
+        }
+    }
+
+    // 4x4 transpose: lane k of the inputs becomes vector k of the outputs.
+    void transpose( f32x4 a, f32x4 b, f32x4 c, f32x4 d, f32x4* pOut )
+    {
+        f32x4 ab01 = __builtin_shufflevector( a, b, 0, 4, 1, 5 );
+        f32x4 ab23 = __builtin_shufflevector( a, b, 2, 6, 3, 7 );
+        f32x4 cd01 = __builtin_shufflevector( c, d, 0, 4, 1, 5 );
+        f32x4 cd23 = __builtin_shufflevector( c, d, 2, 6, 3, 7 );
+        pOut[ 0 ] = __builtin_shufflevector( ab01, cd01, 0, 1, 4, 5 );
+        pOut[ 1 ] = __builtin_shufflevector( ab01, cd01, 2, 3, 6, 7 );
+        pOut[ 2 ] = __builtin_shufflevector( ab23, cd23, 0, 1, 4, 5 );
+        pOut[ 3 ] = __builtin_shufflevector( ab23, cd23, 2, 3, 6, 7 );
+    }
+
+    // Per-instance columns: [ column ][ instance ], translation in column 3.
+    struct Columns
+    {
+        f32x4 c[ 5 ][ 4 ];
+    };
+
+    void toColumns( const Lanes& l, Columns* pCols )
+    {
+        for ( int c = 0; c < 3; ++c )
+        {
+            transpose( l.m[ 0 ][ c ], l.m[ 1 ][ c ], l.m[ 2 ][ c ], splat( 0.0f ), pCols->c[ c ] );
+        }
+        transpose( l.t[ 0 ], l.t[ 1 ], l.t[ 2 ], splat( 1.0f ), pCols->c[ 3 ] );
+        if ( l.hasColor )
+        {
+            transpose( l.color[ 0 ], l.color[ 1 ], l.color[ 2 ], l.color[ 3 ], pCols->c[ 4 ] );
+        }
+    }
+
+    void store( const Lanes& l, const Columns& cols, size_t k, util::InstanceRecord* pOut )
+    {
+        for ( int c = 0; c < 4; ++c )
+        {
+            memcpy( pOut->transform + c * 4, &cols.c[ c ][ k ], sizeof( f32x4 ) );
+        }
+        for ( int c = 0; c < 3; ++c )
+        {
+            memcpy( pOut->normalTransform + c * 4, &cols.c[ c ][ k ], sizeof( f32x4 ) );
+        }
+        if ( l.hasColor )
+        {
+            memcpy( pOut->color, &cols.c[ 4 ][ k ], sizeof( f32x4 ) );
+        }
+    }
+
+    // Packed columns are 12 bytes apart. Each 16-byte store's last lane is
+    // overwritten by the next column; the final ones are 12 bytes so nothing
+    // past the record (or the colour, when there is none) is touched.
+    void store( const Lanes& l, const Columns& cols, size_t k, util::PackedInstanceRecord* pOut )
+    {
+        for ( int c = 0; c < 4; ++c )
+        {
+            memcpy( pOut->transform + c * 3, &cols.c[ c ][ k ], sizeof( f32x4 ) );
+        }
+        memcpy( pOut->normalTransform, &cols.c[ 0 ][ k ], sizeof( f32x4 ) );
+        memcpy( pOut->normalTransform + 3, &cols.c[ 1 ][ k ], sizeof( f32x4 ) );
+        memcpy( pOut->normalTransform + 6, &cols.c[ 2 ][ k ], 3 * sizeof( float ) );
+        if ( l.hasColor )
+        {
+            memcpy( pOut->color, &cols.c[ 4 ][ k ], 3 * sizeof( float ) );
+        }
+    }
+
+    template< typename Record >
+    void build( const util::InstanceTransformInputs& inputs, size_t first, size_t count, const float* pParent, Record* pOut )
+    {
+        Parent parent = loadParent( pParent );
+        Lanes lanes;
+        Columns cols;
+        size_t end = first + count;
+        size_t i = first;
+        for ( ; i + 4 <= end; i += 4 )
+        {
+            compose4( inputs, parent, i, 4, &lanes );
+            toColumns( lanes, &cols );
+            for ( size_t k = 0; k < 4; ++k )
+            {
+                store( lanes, cols, k, pOut + i + k );
+            }
+        }
+        if ( i < end )
+        {
+            compose4( inputs, parent, i, end - i, &lanes );
+            toColumns( lanes, &cols );
+            for ( size_t k = 0; k < end - i; ++k )
+            {
+                store( lanes, cols, k, pOut + i + k );
+            }
+        }
+    }
+
+    void encode4( const util::InstanceTransformInputs& in, size_t i, size_t lanes, util::CompactInstanceRecord* pOut )
+    {
+        // makeXRotate() and makeZRotate() turn by -angle about their axis and
+        // makeYRotate() by +angle, so q = qx( -x ) * qy( y ) * qz( -z ), from
+        // half angles a, b and c.
+        f32x4 sa, ca, sb, cb, sc, cc;
+        sincos( load( in.pRotationX, i, lanes, 0.0f ) * splat( -0.5f ), &sa, &ca );
+        sincos( load( in.pRotationY, i, lanes, 0.0f ) * splat( 0.5f ), &sb, &cb );
+        sincos( load( in.pRotationZ, i, lanes, 0.0f ) * splat( -0.5f ), &sc, &cc );
+        f32x4 q[ 4 ] = {
+            sa * cb * cc + ca * sb * sc,
+            ca * sb * cc - sa * cb * sc,
+            ca * cb * sc + sa * sb * cc,
+            ca * cb * cc - sa * sb * sc,
+        };
+
+        // q and -q are the same rotation; keep w >= 0.
+        i32x4 flip = q[ 3 ] < splat( 0.0f );
+        i32x4 snorm[ 4 ];
+        for ( int k = 0; k < 4; ++k )
+        {
+            snorm[ k ] = roundToInt( clamp( select( flip, -q[ k ], q[ k ] ), -1.0f, 1.0f ) * splat( 32767.0f ) ) & 0xFFFF;
+        }
+
+        bool hasColor = in.pColorR && in.pColorG && in.pColorB;
+        i32x4 rgba = {};
+        if ( hasColor )
+        {
+            const float* pChannels[ 4 ] = { in.pColorR, in.pColorG, in.pColorB, in.pColorA };
+            for ( int k = 0; k < 4; ++k )
+            {
+                rgba |= roundToInt( clamp( load( pChannels[ k ], i, lanes, 1.0f ), 0.0f, 1.0f ) * splat( 255.0f ) ) << ( k * 8 );
+            }
+        }
+
+        f32x4 head[ 4 ], tail[ 4 ];
+        transpose( load( in.pPositionX, i, lanes, 0.0f ), load( in.pPositionY, i, lanes, 0.0f ),
+                   load( in.pPositionZ, i, lanes, 0.0f ), load( in.pScaleX, i, lanes, in.uniformScale ), head );
+        transpose( (f32x4)( snorm[ 0 ] | ( snorm[ 1 ] << 16 ) ), (f32x4)( snorm[ 2 ] | ( snorm[ 3 ] << 16 ) ),
+                   (f32x4)rgba, splat( 0.0f ), tail );
+        for ( size_t k = 0; k < lanes; ++k )
+        {
+            memcpy( pOut[ k ].position, &head[ k ], sizeof( f32x4 ) );
+            memcpy( pOut[ k ].rotation, &tail[ k ], hasColor ? 3 * sizeof( uint32_t ) : 2 * sizeof( uint32_t ) );
+        }
+    }
+
+    // unpack_snorm2x16_to_float() for one half.
+    float snorm16( uint32_t bits )
+    {
+        return std::max( (float)(int16_t)( bits & 0xFFFF ) / 32767.0f, -1.0f );
+    }
+
+    // Column major 4x4 helpers for the reference path.
+    void multiply( const float* a, const float* b, float* pOut )
+    {
+        float r[ 16 ];
+        for ( int c = 0; c < 4; ++c )
+        {
+            for ( int row = 0; row < 4; ++row )
+            {
+                float sum = 0.0f;
+                for ( int k = 0; k < 4; ++k )
+                {
+                    sum += a[ k * 4 + row ] * b[ c * 4 + k ];
+                }
+                r[ c * 4 + row ] = sum;
+            }
+        }
+        memcpy( pOut, r, sizeof( r ) );
+    }
+
+    void identity( float* m )
+    {
+        memset( m, 0, 16 * sizeof( float ) );
+        m[ 0 ] = m[ 5 ] = m[ 10 ] = m[ 15 ] = 1.0f;
+    }
+
+    // Same element placement as math::makeXRotate() and friends.
+    void rotation( int axis, float angle, float* m )
+    {
+        identity( m );
+        float c = cosf( angle );
+        float s = sinf( angle );
+        switch ( axis )
+        {
+            case 0: m[ 5 ] = c; m[ 9 ] = s; m[ 6 ] = -s; m[ 10 ] = c; break;
+            case 1: m[ 0 ] = c; m[ 8 ] = s; m[ 2 ] = -s; m[ 10 ] = c; break;
+            case 2: m[ 0 ] = c; m[ 4 ] = s; m[ 1 ] = -s; m[ 5 ] = c; break;
+        }
+    }
+
+    float valueAt( const float* p, size_t i, float fallback )
+    {
+        return p ? p[ i ] : fallback;
+    }
+}
+
+void util::sincos4( const float* pX, float* pSin, float* pCos )
+{
+    f32x4 s, c;
+    sincos( load( pX, 0, 4, 0.0f ), &s, &c );
+    memcpy( pSin, &s, sizeof( s ) );
+    memcpy( pCos, &c, sizeof( c ) );
+}
+
+void util::buildInstanceTransforms( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                    const float* pParent, InstanceRecord* pOut )
+{
+    build( inputs, first, count, pParent, pOut );
+}
+
+void util::buildInstanceTransforms( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                    const float* pParent, PackedInstanceRecord* pOut )
+{
+    build( inputs, first, count, pParent, pOut );
+}
+
+void util::buildInstanceTransformsReference( const InstanceTransformInputs& in, size_t first, size_t count,
+                                             const float* pParent, InstanceRecord* pOut )
+{
+    float parent[ 16 ];
+    if ( pParent )
+    {
+        memcpy( parent, pParent, sizeof( parent ) );
+    }
+    else
+    {
+        identity( parent );
+    }
+
+    for ( size_t i = first; i < first + count; ++i )
+    {
+        float translate[ 16 ], rx[ 16 ], ry[ 16 ], rz[ 16 ], scale[ 16 ], m[ 16 ];
+        identity( translate );
+        translate[ 12 ] = valueAt( in.pPositionX, i, 0.0f );
+        translate[ 13 ] = valueAt( in.pPositionY, i, 0.0f );
+        translate[ 14 ] = valueAt( in.pPositionZ, i, 0.0f );
+        rotation( 0, valueAt( in.pRotationX, i, 0.0f ), rx );
+        rotation( 1, valueAt( in.pRotationY, i, 0.0f ), ry );
+        rotation( 2, valueAt( in.pRotationZ, i, 0.0f ), rz );
+        identity( scale );
+        scale[ 0 ] = valueAt( in.pScaleX, i, in.uniformScale );
+        scale[ 5 ] = valueAt( in.pScaleY, i, in.uniformScale );
+        scale[ 10 ] = valueAt( in.pScaleZ, i, in.uniformScale );
+
+        multiply( parent, translate, m );
+        multiply( m, rx, m );
+        multiply( m, ry, m );
+        multiply( m, rz, m );
+        multiply( m, scale, m );
+
+        InstanceRecord& out = pOut[ i ];
+        memcpy( out.transform, m, sizeof( m ) );
+        for ( int c = 0; c < 3; ++c )
+        {
+            memcpy( out.normalTransform + c * 4, m + c * 4, 3 * sizeof( float ) );
+            out.normalTransform[ c * 4 + 3 ] = 0.0f;
+        }
+        if ( in.pColorR && in.pColorG && in.pColorB )
+        {
+            out.color[ 0 ] = in.pColorR[ i ];
+            out.color[ 1 ] = in.pColorG[ i ];
+            out.color[ 2 ] = in.pColorB[ i ];
+            out.color[ 3 ] = valueAt( in.pColorA, i, 1.0f );
+        }
+    }
+}
+
+void util::encodeCompactInstances( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                   CompactInstanceRecord* pOut )
+{
+    size_t end = first + count;
+    size_t i = first;
+    for ( ; i + 4 <= end; i += 4 )
+    {
+        encode4( inputs, i, 4, pOut + i );
+    }
+    if ( i < end )
+    {
+        encode4( inputs, i, end - i, pOut + i );
+    }
+}
+
+void util::decodeCompactInstance( const CompactInstanceRecord& in, InstanceRecord* pOut )
+{
+    float x = snorm16( in.rotation[ 0 ] );
+    float y = snorm16( in.rotation[ 0 ] >> 16 );
+    float z = snorm16( in.rotation[ 1 ] );
+    float w = snorm16( in.rotation[ 1 ] >> 16 );
+    float invLength = 1.0f / sqrtf( x * x + y * y + z * z + w * w );
+    x *= invLength;
+    y *= invLength;
+    z *= invLength;
+    w *= invLength;
+
+    const float columns[ 3 ][ 3 ] = {
+        { 1.0f - 2.0f * ( y * y + z * z ), 2.0f * ( x * y + z * w ), 2.0f * ( x * z - y * w ) },
+        { 2.0f * ( x * y - z * w ), 1.0f - 2.0f * ( x * x + z * z ), 2.0f * ( y * z + x * w ) },
+        { 2.0f * ( x * z + y * w ), 2.0f * ( y * z - x * w ), 1.0f - 2.0f * ( x * x + y * y ) },
+    };
+    for ( int c = 0; c < 3; ++c )
+    {
+        for ( int r = 0; r < 3; ++r )
+        {
+            pOut->transform[ c * 4 + r ] = columns[ c ][ r ] * in.scale;
+            pOut->normalTransform[ c * 4 + r ] = columns[ c ][ r ] * in.scale;
+        }
+        pOut->transform[ c * 4 + 3 ] = 0.0f;
+        pOut->normalTransform[ c * 4 + 3 ] = 0.0f;
+        pOut->transform[ 12 + c ] = in.position[ c ];
+    }
+    pOut->transform[ 15 ] = 1.0f;
+
+    for ( int k = 0; k < 4; ++k )
+    {
+        pOut->color[ k ] = (float)( ( in.color >> ( k * 8 ) ) & 0xFF ) / 255.0f;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+    // Memory layout of the samples' shader_types::InstanceData: a column
+    // major float4x4 transform, a float3x3 normal transform stored as three
+    // float4 columns, and a float4 colour.
+    struct alignas( 16 ) InstanceRecord
+    {
+        float transform[ 16 ];
+        float normalTransform[ 12 ];
+        float color[ 4 ];
+    };
+    static_assert( sizeof( InstanceRecord ) == 128, "InstanceRecord must match shader_types::InstanceData" );
+
+    // Packed layout: the affine transform's four columns, the normal
+    // transform's three columns and the colour, each as a packed_float3.
+    // Colour alpha is dropped.
+    struct PackedInstanceRecord
+    {
+        float transform[ 12 ];
+        float normalTransform[ 9 ];
+        float color[ 3 ];
+    };
+    static_assert( sizeof( PackedInstanceRecord ) == 96, "PackedInstanceRecord must be 96 bytes" );
+
+    // Compact layout: position, uniform scale, the rotation as a unit
+    // quaternion ( x, y, z, w ) quantized to four snorm16 values, and an
+    // RGBA8 colour with red in the low byte. Shaders decode rotation[ 0 ] to
+    // ( x, y ) and rotation[ 1 ] to ( z, w ) with unpack_snorm2x16_to_float()
+    // and renormalize, and the colour with unpack_unorm4x8_to_float().
+    struct CompactInstanceRecord
+    {
+        float position[ 3 ];
+        float scale;
+        uint32_t rotation[ 2 ];
+        uint32_t color;
+    };
+    static_assert( sizeof( CompactInstanceRecord ) == 28, "CompactInstanceRecord must be 28 bytes" );
+
+    // Per-instance inputs as separate arrays (structure of arrays). Rotation
+    // angles are radians with R = Rx( x ) * Ry( y ) * Rz( z ), using the same
+    // conventions as the samples' math::makeXRotate() and friends. Null
+    // rotation arrays mean 0, null scale arrays mean uniformScale and null
+    // colour arrays leave the colour untouched (alpha defaults to 1).
+    struct InstanceTransformInputs
+    {
+        const float* pPositionX = nullptr;
+        const float* pPositionY = nullptr;
+        const float* pPositionZ = nullptr;
+        const float* pRotationX = nullptr;
+        const float* pRotationY = nullptr;
+        const float* pRotationZ = nullptr;
+        const float* pScaleX = nullptr;
+        const float* pScaleY = nullptr;
+        const float* pScaleZ = nullptr;
+        float uniformScale = 1.0f;
+        const float* pColorR = nullptr;
+        const float* pColorG = nullptr;
+        const float* pColorB = nullptr;
+        const float* pColorA = nullptr;
+    };
+
+    // Writes pOut[ i ] = parent * T( position ) * R( rotation ) * S( scale )
+    // and its upper 3x3 as the normal transform, for i in [first, first +
+    // count). The TRS product is composed in closed form, four instances at
+    // a time with vectorized sin/cos, and the parent (a column major affine
+    // float4x4, or null for identity) costs one 3x3 product per instance.
+    // Inputs are indexed from first as well, so disjoint ranges can be built
+    // in parallel.
+    void buildInstanceTransforms( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                  const float* pParent, InstanceRecord* pOut );
+    void buildInstanceTransforms( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                  const float* pParent, PackedInstanceRecord* pOut );
+
+    // Same result through per-instance sinf/cosf and full 4x4 products, as
+    // the samples used to do it. For validation and benchmarks.
+    void buildInstanceTransformsReference( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                           const float* pParent, InstanceRecord* pOut );
+
+    // Encodes T( position ) * R( rotation ) * S( scale ) for i in [first,
+    // first + count) into the compact layout, four instances at a time. The
+    // scale is pScaleX, or uniformScale when that is null; pScaleY and
+    // pScaleZ are ignored. Quaternions are stored with w >= 0. As with
+    // buildInstanceTransforms(), a null colour leaves it untouched.
+    void encodeCompactInstances( const InstanceTransformInputs& inputs, size_t first, size_t count,
+                                 CompactInstanceRecord* pOut );
+
+    // Expands a compact record the way the shaders decode it, with the upper
+    // 3x3 as the normal transform. For validation.
+    void decodeCompactInstance( const CompactInstanceRecord& in, InstanceRecord* pOut );
+
+    // Four-wide sin and cos, accurate to a few ulp for |x| < 8192.
+    void sincos4( const float* pX, float* pSin, float* pCos );
+}
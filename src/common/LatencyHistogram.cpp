@@ -0,0 +1,99 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+util::LatencyHistogram::LatencyHistogram()
+: _sum( 0 )
+, _min( UINT64_MAX )
+, _max( 0 )
+{
+    for ( std::atomic< uint64_t >& c : _counts )
+    {
+        c.store( 0, std::memory_order_relaxed );
+    }
+}
+
+uint64_t util::LatencyHistogram::lowestValue( size_t bucket )
+{
+    if ( bucket < 2 * kSubBuckets )
+    {
+        return bucket;
+    }
+    uint32_t shift = (uint32_t)( bucket / kSubBuckets ) - 1;
+    return (uint64_t)( bucket % kSubBuckets + kSubBuckets ) << shift;
+}
+
+uint64_t util::LatencyHistogram::highestValue( size_t bucket )
+{
+    if ( bucket + 1 == kBucketCount )
+    {
+        return UINT64_MAX;
+    }
+    return lowestValue( bucket + 1 ) - 1;
+}
+
+void util::LatencyHistogram::snapshot( HistogramSnapshot* pOut, bool reset )
+{
+    pOut->counts.assign( kBucketCount, 0 );
+    pOut->count = 0;
+    for ( size_t i = 0; i < kBucketCount; ++i )
+    {
+        uint64_t n = reset ? _counts[ i ].exchange( 0, std::memory_order_relaxed ) : _counts[ i ].load( std::memory_order_relaxed );
+        pOut->counts[ i ] = n;
+        pOut->count += n;
+    }
+    if ( reset )
+    {
+        pOut->sum = _sum.exchange( 0, std::memory_order_relaxed );
+        pOut->min = _min.exchange( UINT64_MAX, std::memory_order_relaxed );
+        pOut->max = _max.exchange( 0, std::memory_order_relaxed );
+    }
+    else
+    {
+        pOut->sum = _sum.load( std::memory_order_relaxed );
+        pOut->min = _min.load( std::memory_order_relaxed );
+        pOut->max = _max.load( std::memory_order_relaxed );
+    }
+    if ( pOut->count == 0 )
+    {
+        pOut->min = 0;
+        pOut->max = 0;
+    }
+}
+
+uint64_t util::HistogramSnapshot::percentile( double q ) const
+{
+    if ( count == 0 )
+    {
+        return 0;
+    }
+    uint64_t rank = std::max< uint64_t >( 1, (uint64_t)std::ceil( std::min( std::max( q, 0.0 ), 1.0 ) * count ) );
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < counts.size(); ++i )
+    {
+        seen += counts[ i ];
+        if ( seen >= rank )
+        {
+            return std::min( LatencyHistogram::highestValue( i ), max );
+        }
+    }
+    return max;
+}
+
+void util::HistogramSnapshot::merge( const HistogramSnapshot& other )
+{
+    if ( other.count == 0 )
+    {
+        return;
+    }
+    counts.resize( std::max( counts.size(), other.counts.size() ), 0 );
+    for ( size_t i = 0; i < other.counts.size(); ++i )
+    {
+        counts[ i ] += other.counts[ i ];
+    }
+    min = count ? std::min( min, other.min ) : other.min;
+    max = count ? std::max( max, other.max ) : other.max;
+    count += other.count;
+    sum += other.sum;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    // A copy of a LatencyHistogram's counts, for reading percentiles.
+    struct HistogramSnapshot
+    {
+        std::vector< uint64_t > counts;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+
+        // The highest value of the bucket holding the nearest-rank
+        // percentile q in [0, 1], clamped to max; 0 when empty.
+        uint64_t percentile( double q ) const;
+        double mean() const { return count ? (double)sum / count : 0.0; }
+
+        void merge( const HistogramSnapshot& other );
+    };
+
+    // Log-linear histogram of unsigned values in the style of HdrHistogram:
+    // values below 64 have a bucket each, and every power of two above
+    // that is split into 32 buckets, so a value is known to within 1/32 of
+    // itself. Recording is a few relaxed atomic adds and never blocks, so
+    // it can be called from Metal's completion threads.
+    class LatencyHistogram
+    {
+        public:
+            static constexpr uint32_t kSubBucketBits = 5;
+            static constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+            // Two linear groups below 64, then one group per remaining bit.
+            static constexpr size_t kBucketCount = ( 64 - kSubBucketBits + 1 ) * kSubBuckets;
+
+            LatencyHistogram();
+
+            void record( uint64_t value )
+            {
+                _counts[ bucketOf( value ) ].fetch_add( 1, std::memory_order_relaxed );
+                _sum.fetch_add( value, std::memory_order_relaxed );
+                uint64_t seen = _min.load( std::memory_order_relaxed );
+                while ( value < seen && !_min.compare_exchange_weak( seen, value, std::memory_order_relaxed ) )
+                {
+                }
+                seen = _max.load( std::memory_order_relaxed );
+                while ( value > seen && !_max.compare_exchange_weak( seen, value, std::memory_order_relaxed ) )
+                {
+                }
+            }
+
+            // Each bucket is read atomically but not all of them at once;
+            // values recorded meanwhile may or may not be included. With
+            // reset, whatever is included is taken out of the histogram.
+            void snapshot( HistogramSnapshot* pOut, bool reset = false );
+
+            static size_t bucketOf( uint64_t value )
+            {
+                if ( value < 2 * kSubBuckets )
+                {
+                    return (size_t)value;
+                }
+                uint32_t shift = 63 - (uint32_t)__builtin_clzll( value ) - kSubBucketBits;
+                return ( shift + 1 ) * kSubBuckets + (size_t)( ( value >> shift ) - kSubBuckets );
+            }
+
+            static uint64_t lowestValue( size_t bucket );
+            static uint64_t highestValue( size_t bucket );
+
+        private:
+            std::atomic< uint64_t > _counts[ kBucketCount ];
+            std::atomic< uint64_t > _sum;
+            std::atomic< uint64_t > _min;
+            std::atomic< uint64_t > _max;
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace util
+{
+    // Fixed-capacity map from 64 bit keys to values that evicts the least
+    // recently used entry on overflow. Evicted values are handed to a
+    // callback so owners can release whatever they hold.
+    template< typename Value >
+    class LruCache
+    {
+        public:
+            explicit LruCache( size_t capacity ) : _capacity( capacity ? capacity : 1 ) {}
+
+            // Returns the value and marks it most recently used, or null.
+            Value* find( uint64_t key )
+            {
+                auto it = _index.find( key );
+                if ( it == _index.end() )
+                {
+                    ++_misses;
+                    return nullptr;
+                }
+                ++_hits;
+                _entries.splice( _entries.begin(), _entries, it->second );
+                return &it->second->second;
+            }
+
+            template< typename EvictFn >
+            Value& insert( uint64_t key, Value value, EvictFn&& onEvict )
+            {
+                auto it = _index.find( key );
+                if ( it != _index.end() )
+                {
+                    onEvict( it->second->second );
+                    _entries.erase( it->second );
+                    _index.erase( it );
+                }
+
+                while ( _entries.size() >= _capacity )
+                {
+                    onEvict( _entries.back().second );
+                    _index.erase( _entries.back().first );
+                    _entries.pop_back();
+                    ++_evictions;
+                }
+
+                _entries.emplace_front( key, std::move( value ) );
+                _index[ key ] = _entries.begin();
+                return _entries.front().second;
+            }
+
+            // Keys from most to least recently used.
+            template< typename Fn >
+            void forEach( Fn&& fn ) const
+            {
+                for ( const auto& entry : _entries )
+                {
+                    fn( entry.first, entry.second );
+                }
+            }
+
+            template< typename EvictFn >
+            void clear( EvictFn&& onEvict )
+            {
+                for ( auto& entry : _entries )
+                {
+                    onEvict( entry.second );
+                }
+                _entries.clear();
+                _index.clear();
+            }
+
+            size_t size() const { return _entries.size(); }
+            size_t capacity() const { return _capacity; }
+            uint64_t hits() const { return _hits; }
+            uint64_t misses() const { return _misses; }
+            uint64_t evictions() const { return _evictions; }
+
+        private:
+            using Entry = std::pair< uint64_t, Value >;
+
+            size_t _capacity;
+            std::list< Entry > _entries;
+            std::unordered_map< uint64_t, typename std::list< Entry >::iterator > _index;
+            uint64_t _hits = 0;
+            uint64_t _misses = 0;
+            uint64_t _evictions = 0;
+    };
+}
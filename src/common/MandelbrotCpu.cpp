@@ -0,0 +1,340 @@
+#include "MandelbrotCpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "WorkStealingPool.hpp"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define MANDELBROT_X86 1
+#include <immintrin.h>
+#elif defined( __ARM_NEON )
+#define MANDELBROT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// This file must be built with floating point contraction disabled (see
+// src/common/CMakeLists.txt); a fused x * x - y * y + x0 rounds differently
+// and changes iteration counts near the boundary.
+
+namespace
+{
+    // The kernel multiplies before dividing by the grid size; keep that
+    // order rather than precomputing scale / width.
+    inline float pixelX( const util::MandelbrotParams& p, float widthF, uint32_t x )
+    {
+        return p.scaleX * (float)x / widthF + p.originX;
+    }
+
+    inline float pixelY( const util::MandelbrotParams& p, float heightF, uint32_t y )
+    {
+        return p.scaleY * (float)y / heightF + p.originY;
+    }
+
+    inline uint32_t iterate( float x0, float y0, uint32_t maxIterations )
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        uint32_t iteration = 0;
+        while ( x * x + y * y <= 4.0f && iteration < maxIterations )
+        {
+            float xtmp = x * x - y * y + x0;
+            y = 2.0f * x * y + y0;
+            x = xtmp;
+            iteration += 1;
+        }
+        return iteration;
+    }
+
+    void tileScalar( const util::MandelbrotParams& p, float widthF, float heightF, uint32_t width,
+                     uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t* pIterations )
+    {
+        for ( uint32_t j = y; j < y + h; ++j )
+        {
+            float y0 = pixelY( p, heightF, j );
+            uint32_t* pRow = pIterations + (size_t)j * width;
+            for ( uint32_t i = x; i < x + w; ++i )
+            {
+                pRow[ i ] = iterate( pixelX( p, widthF, i ), y0, p.maxIterations );
+            }
+        }
+    }
+
+#if MANDELBROT_X86
+    __attribute__(( target( "avx2" ) ))
+    void tileAvx2( const util::MandelbrotParams& p, float widthF, float heightF, uint32_t width,
+                   uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t* pIterations )
+    {
+        const __m256 four = _mm256_set1_ps( 4.0f );
+        const __m256 two = _mm256_set1_ps( 2.0f );
+        const __m256i one = _mm256_set1_epi32( 1 );
+        const __m256 lane = _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+        for ( uint32_t j = y; j < y + h; ++j )
+        {
+            const __m256 y0 = _mm256_set1_ps( pixelY( p, heightF, j ) );
+            uint32_t* pRow = pIterations + (size_t)j * width;
+
+            uint32_t i = x;
+            for ( ; i + 8 <= x + w; i += 8 )
+            {
+                // Exact for any index below 2^24.
+                __m256 px = _mm256_add_ps( _mm256_set1_ps( (float)i ), lane );
+                __m256 x0 = _mm256_add_ps( _mm256_div_ps( _mm256_mul_ps( _mm256_set1_ps( p.scaleX ), px ), _mm256_set1_ps( widthF ) ),
+                                           _mm256_set1_ps( p.originX ) );
+
+                __m256 zx = _mm256_setzero_ps();
+                __m256 zy = _mm256_setzero_ps();
+                __m256i count = _mm256_setzero_si256();
+                for ( uint32_t n = 0; n < p.maxIterations; ++n )
+                {
+                    __m256 xx = _mm256_mul_ps( zx, zx );
+                    __m256 yy = _mm256_mul_ps( zy, zy );
+                    __m256 active = _mm256_cmp_ps( _mm256_add_ps( xx, yy ), four, _CMP_LE_OQ );
+                    if ( _mm256_movemask_ps( active ) == 0 )
+                    {
+                        break;
+                    }
+
+                    // Escaped lanes keep their values and stop counting.
+                    __m256 nx = _mm256_add_ps( _mm256_sub_ps( xx, yy ), x0 );
+                    __m256 ny = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( two, zx ), zy ), y0 );
+                    zx = _mm256_blendv_ps( zx, nx, active );
+                    zy = _mm256_blendv_ps( zy, ny, active );
+                    count = _mm256_add_epi32( count, _mm256_and_si256( _mm256_castps_si256( active ), one ) );
+                }
+                _mm256_storeu_si256( (__m256i*)( pRow + i ), count );
+            }
+
+            for ( ; i < x + w; ++i )
+            {
+                pRow[ i ] = iterate( pixelX( p, widthF, i ), pixelY( p, heightF, j ), p.maxIterations );
+            }
+        }
+    }
+
+    __attribute__(( target( "avx512f" ) ))
+    void tileAvx512( const util::MandelbrotParams& p, float widthF, float heightF, uint32_t width,
+                     uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t* pIterations )
+    {
+        const __m512 four = _mm512_set1_ps( 4.0f );
+        const __m512 two = _mm512_set1_ps( 2.0f );
+        const __m512i one = _mm512_set1_epi32( 1 );
+        const __m512 lane = _mm512_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 );
+
+        for ( uint32_t j = y; j < y + h; ++j )
+        {
+            const __m512 y0 = _mm512_set1_ps( pixelY( p, heightF, j ) );
+            uint32_t* pRow = pIterations + (size_t)j * width;
+
+            uint32_t i = x;
+            for ( ; i + 16 <= x + w; i += 16 )
+            {
+                __m512 px = _mm512_add_ps( _mm512_set1_ps( (float)i ), lane );
+                __m512 x0 = _mm512_add_ps( _mm512_div_ps( _mm512_mul_ps( _mm512_set1_ps( p.scaleX ), px ), _mm512_set1_ps( widthF ) ),
+                                           _mm512_set1_ps( p.originX ) );
+
+                __m512 zx = _mm512_setzero_ps();
+                __m512 zy = _mm512_setzero_ps();
+                __m512i count = _mm512_setzero_si512();
+                for ( uint32_t n = 0; n < p.maxIterations; ++n )
+                {
+                    __m512 xx = _mm512_mul_ps( zx, zx );
+                    __m512 yy = _mm512_mul_ps( zy, zy );
+                    __mmask16 active = _mm512_cmp_ps_mask( _mm512_add_ps( xx, yy ), four, _CMP_LE_OQ );
+                    if ( active == 0 )
+                    {
+                        break;
+                    }
+
+                    __m512 ny = _mm512_mul_ps( _mm512_mul_ps( two, zx ), zy );
+                    zx = _mm512_mask_add_ps( zx, active, _mm512_sub_ps( xx, yy ), x0 );
+                    zy = _mm512_mask_add_ps( zy, active, ny, y0 );
+                    count = _mm512_mask_add_epi32( count, active, count, one );
+                }
+                _mm512_storeu_si512( pRow + i, count );
+            }
+
+            for ( ; i < x + w; ++i )
+            {
+                pRow[ i ] = iterate( pixelX( p, widthF, i ), pixelY( p, heightF, j ), p.maxIterations );
+            }
+        }
+    }
+#endif
+
+#if MANDELBROT_NEON
+    void tileNeon( const util::MandelbrotParams& p, float widthF, float heightF, uint32_t width,
+                   uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t* pIterations )
+    {
+        const float32x4_t four = vdupq_n_f32( 4.0f );
+        const float32x4_t two = vdupq_n_f32( 2.0f );
+        const uint32x4_t one = vdupq_n_u32( 1 );
+        const float laneValues[ 4 ] = { 0, 1, 2, 3 };
+        const float32x4_t lane = vld1q_f32( laneValues );
+
+        for ( uint32_t j = y; j < y + h; ++j )
+        {
+            const float32x4_t y0 = vdupq_n_f32( pixelY( p, heightF, j ) );
+            uint32_t* pRow = pIterations + (size_t)j * width;
+
+            uint32_t i = x;
+            for ( ; i + 4 <= x + w; i += 4 )
+            {
+                float32x4_t px = vaddq_f32( vdupq_n_f32( (float)i ), lane );
+                float32x4_t x0 = vaddq_f32( vdivq_f32( vmulq_f32( vdupq_n_f32( p.scaleX ), px ), vdupq_n_f32( widthF ) ),
+                                            vdupq_n_f32( p.originX ) );
+
+                float32x4_t zx = vdupq_n_f32( 0.0f );
+                float32x4_t zy = vdupq_n_f32( 0.0f );
+                uint32x4_t count = vdupq_n_u32( 0 );
+                for ( uint32_t n = 0; n < p.maxIterations; ++n )
+                {
+                    // vmulq/vaddq, never vfmaq/vmlaq, to keep rounding
+                    // identical to the scalar path.
+                    float32x4_t xx = vmulq_f32( zx, zx );
+                    float32x4_t yy = vmulq_f32( zy, zy );
+                    uint32x4_t active = vcleq_f32( vaddq_f32( xx, yy ), four );
+                    if ( vmaxvq_u32( active ) == 0 )
+                    {
+                        break;
+                    }
+
+                    float32x4_t nx = vaddq_f32( vsubq_f32( xx, yy ), x0 );
+                    float32x4_t ny = vaddq_f32( vmulq_f32( vmulq_f32( two, zx ), zy ), y0 );
+                    zx = vbslq_f32( active, nx, zx );
+                    zy = vbslq_f32( active, ny, zy );
+                    count = vaddq_u32( count, vandq_u32( active, one ) );
+                }
+                vst1q_u32( pRow + i, count );
+            }
+
+            for ( ; i < x + w; ++i )
+            {
+                pRow[ i ] = iterate( pixelX( p, widthF, i ), pixelY( p, heightF, j ), p.maxIterations );
+            }
+        }
+    }
+#endif
+}
+
+bool util::isMandelbrotPathSupported( MandelbrotPath path )
+{
+    switch ( path )
+    {
+        case MandelbrotPath::Scalar:
+            return true;
+#if MANDELBROT_X86
+        case MandelbrotPath::Avx2:
+            return __builtin_cpu_supports( "avx2" );
+        case MandelbrotPath::Avx512:
+            return __builtin_cpu_supports( "avx512f" );
+#endif
+#if MANDELBROT_NEON
+        case MandelbrotPath::Neon:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+util::MandelbrotPath util::bestMandelbrotPath()
+{
+    for ( MandelbrotPath path : { MandelbrotPath::Avx512, MandelbrotPath::Avx2, MandelbrotPath::Neon } )
+    {
+        if ( isMandelbrotPathSupported( path ) )
+        {
+            return path;
+        }
+    }
+    return MandelbrotPath::Scalar;
+}
+
+const char* util::mandelbrotPathName( MandelbrotPath path )
+{
+    switch ( path )
+    {
+        case MandelbrotPath::Scalar: return "scalar";
+        case MandelbrotPath::Neon: return "neon";
+        case MandelbrotPath::Avx2: return "avx2";
+        case MandelbrotPath::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+void util::mandelbrotTile( const MandelbrotParams& params, uint32_t width, uint32_t height,
+                           uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                           uint32_t* pIterations, MandelbrotPath path )
+{
+    float widthF = (float)width;
+    float heightF = (float)height;
+
+    if ( !isMandelbrotPathSupported( path ) )
+    {
+        path = MandelbrotPath::Scalar;
+    }
+
+    switch ( path )
+    {
+#if MANDELBROT_X86
+        case MandelbrotPath::Avx2:
+            tileAvx2( params, widthF, heightF, width, x, y, w, h, pIterations );
+            return;
+        case MandelbrotPath::Avx512:
+            tileAvx512( params, widthF, heightF, width, x, y, w, h, pIterations );
+            return;
+#endif
+#if MANDELBROT_NEON
+        case MandelbrotPath::Neon:
+            tileNeon( params, widthF, heightF, width, x, y, w, h, pIterations );
+            return;
+#endif
+        default:
+            tileScalar( params, widthF, heightF, width, x, y, w, h, pIterations );
+            return;
+    }
+}
+
+void util::mandelbrotImage( const MandelbrotParams& params, uint32_t width, uint32_t height,
+                            uint32_t* pIterations, WorkStealingPool* pPool,
+                            MandelbrotPath path, uint32_t tileSize )
+{
+    tileSize = std::max( tileSize, 1u );
+    uint32_t tilesX = ( width + tileSize - 1 ) / tileSize;
+    uint32_t tilesY = ( height + tileSize - 1 ) / tileSize;
+
+    auto runTile = [&]( size_t tile, unsigned ){
+        uint32_t tx = (uint32_t)( tile % tilesX ) * tileSize;
+        uint32_t ty = (uint32_t)( tile / tilesX ) * tileSize;
+        mandelbrotTile( params, width, height, tx, ty,
+                        std::min( tileSize, width - tx ), std::min( tileSize, height - ty ),
+                        pIterations, path );
+    };
+
+    size_t tileCount = (size_t)tilesX * tilesY;
+    if ( pPool )
+    {
+        pPool->parallelFor( tileCount, runTile );
+    }
+    else
+    {
+        for ( size_t tile = 0; tile < tileCount; ++tile )
+        {
+            runTile( tile, 0 );
+        }
+    }
+}
+
+void util::mandelbrotColors( const uint32_t* pIterations, size_t count, uint8_t* pRGBA )
+{
+    for ( size_t i = 0; i < count; ++i )
+    {
+        float color = 0.5f + 0.5f * std::cos( 3.0f + (float)pIterations[ i ] * 0.15f );
+        uint8_t c = (uint8_t)std::lround( std::min( std::max( color, 0.0f ), 1.0f ) * 255.0f );
+        pRGBA[ 4 * i + 0 ] = c;
+        pRGBA[ 4 * i + 1 ] = c;
+        pRGBA[ 4 * i + 2 ] = c;
+        pRGBA[ 4 * i + 3 ] = 255;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+    class WorkStealingPool;
+
+    // Inputs of the mandelbrot_set kernel in 08-compute. Pixel (x, y) maps
+    // to c = ( scaleX * x / width + originX, scaleY * y / height + originY ).
+    struct MandelbrotParams
+    {
+        uint32_t maxIterations = 1000;
+        float scaleX = 2.0f;
+        float scaleY = 2.0f;
+        float originX = -1.5f;
+        float originY = -1.0f;
+    };
+
+    enum class MandelbrotPath
+    {
+        Scalar,
+        Neon,       // 4 lanes
+        Avx2,       // 8 lanes
+        Avx512,     // 16 lanes
+    };
+
+    // Widest path the running CPU supports.
+    MandelbrotPath bestMandelbrotPath();
+    bool isMandelbrotPathSupported( MandelbrotPath path );
+    const char* mandelbrotPathName( MandelbrotPath path );
+
+    // CPU version of the mandelbrot_set kernel writing iteration counts.
+    //
+    // Every path performs the kernel's float operations in the kernel's
+    // order without fused multiply-add, so iteration counts are identical
+    // across paths and match the GPU when the kernel is compiled without
+    // fast math, as the samples do with util::ShaderMath::Precise.
+    //
+    // Computes the tile [x, x + w) x [y, y + h) of a width x height image.
+    // pIterations points at pixel (0, 0); rows are width elements apart.
+    void mandelbrotTile( const MandelbrotParams& params, uint32_t width, uint32_t height,
+                         uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                         uint32_t* pIterations, MandelbrotPath path );
+
+    // Whole image, split into tileSize x tileSize tiles spread over pPool
+    // (null runs on the calling thread).
+    void mandelbrotImage( const MandelbrotParams& params, uint32_t width, uint32_t height,
+                          uint32_t* pIterations, WorkStealingPool* pPool,
+                          MandelbrotPath path, uint32_t tileSize = 32 );
+
+    // The kernel's colour ramp, 0.5 + 0.5 * cos( 3 + iterations * 0.15 ),
+    // as opaque grey RGBA8. The GPU evaluates cos in half precision, so
+    // colours may differ by one step; compare iteration counts instead.
+    void mandelbrotColors( const uint32_t* pIterations, size_t count, uint8_t* pRGBA );
+}
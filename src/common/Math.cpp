@@ -0,0 +1,80 @@
+#include "Math.hpp"
+
+util::math::float3x3 util::math::normalMatrix( const float4x4& m )
+{
+    const float3 a = m.columns[ 0 ].xyz();
+    const float3 b = m.columns[ 1 ].xyz();
+    const float3 c = m.columns[ 2 ].xyz();
+
+    // Rows of the inverse are cross( b, c ) / det and so on, so these are
+    // the columns of its transpose.
+    float3 bc = cross( b, c );
+    float det = dot( a, bc );
+    float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+    return { { bc * invDet, cross( c, a ) * invDet, cross( a, b ) * invDet } };
+}
+
+util::math::float4x4 util::math::inverseAffine( const float4x4& m )
+{
+    const float3 a = m.columns[ 0 ].xyz();
+    const float3 b = m.columns[ 1 ].xyz();
+    const float3 c = m.columns[ 2 ].xyz();
+    const float3 t = m.columns[ 3 ].xyz();
+
+    float3 r0 = cross( b, c );
+    float det = dot( a, r0 );
+    float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+    r0 = r0 * invDet;
+    float3 r1 = cross( c, a ) * invDet;
+    float3 r2 = cross( a, b ) * invDet;
+
+    return makeFromRows( { r0.x, r0.y, r0.z, -dot( r0, t ) },
+                         { r1.x, r1.y, r1.z, -dot( r1, t ) },
+                         { r2.x, r2.y, r2.z, -dot( r2, t ) },
+                         { 0.0f, 0.0f, 0.0f, 1.0f } );
+}
+
+util::math::float4x4 util::math::inverse( const float4x4& m )
+{
+    // Laplace expansion over 2x2 minors of the top and bottom row pairs.
+    const float4* c = m.columns;
+    float s0 = c[ 0 ].x * c[ 1 ].y - c[ 1 ].x * c[ 0 ].y;
+    float s1 = c[ 0 ].x * c[ 2 ].y - c[ 2 ].x * c[ 0 ].y;
+    float s2 = c[ 0 ].x * c[ 3 ].y - c[ 3 ].x * c[ 0 ].y;
+    float s3 = c[ 1 ].x * c[ 2 ].y - c[ 2 ].x * c[ 1 ].y;
+    float s4 = c[ 1 ].x * c[ 3 ].y - c[ 3 ].x * c[ 1 ].y;
+    float s5 = c[ 2 ].x * c[ 3 ].y - c[ 3 ].x * c[ 2 ].y;
+
+    float c5 = c[ 2 ].z * c[ 3 ].w - c[ 3 ].z * c[ 2 ].w;
+    float c4 = c[ 1 ].z * c[ 3 ].w - c[ 3 ].z * c[ 1 ].w;
+    float c3 = c[ 1 ].z * c[ 2 ].w - c[ 2 ].z * c[ 1 ].w;
+    float c2 = c[ 0 ].z * c[ 3 ].w - c[ 3 ].z * c[ 0 ].w;
+    float c1 = c[ 0 ].z * c[ 2 ].w - c[ 2 ].z * c[ 0 ].w;
+    float c0 = c[ 0 ].z * c[ 1 ].w - c[ 1 ].z * c[ 0 ].w;
+
+    float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if ( det == 0.0f )
+    {
+        return {};
+    }
+    float invDet = 1.0f / det;
+
+    float4x4 r;
+    r.columns[ 0 ] = { ( c[ 1 ].y * c5 - c[ 2 ].y * c4 + c[ 3 ].y * c3 ) * invDet,
+                       ( -c[ 0 ].y * c5 + c[ 2 ].y * c2 - c[ 3 ].y * c1 ) * invDet,
+                       ( c[ 0 ].y * c4 - c[ 1 ].y * c2 + c[ 3 ].y * c0 ) * invDet,
+                       ( -c[ 0 ].y * c3 + c[ 1 ].y * c1 - c[ 2 ].y * c0 ) * invDet };
+    r.columns[ 1 ] = { ( -c[ 1 ].x * c5 + c[ 2 ].x * c4 - c[ 3 ].x * c3 ) * invDet,
+                       ( c[ 0 ].x * c5 - c[ 2 ].x * c2 + c[ 3 ].x * c1 ) * invDet,
+                       ( -c[ 0 ].x * c4 + c[ 1 ].x * c2 - c[ 3 ].x * c0 ) * invDet,
+                       ( c[ 0 ].x * c3 - c[ 1 ].x * c1 + c[ 2 ].x * c0 ) * invDet };
+    r.columns[ 2 ] = { ( c[ 1 ].w * s5 - c[ 2 ].w * s4 + c[ 3 ].w * s3 ) * invDet,
+                       ( -c[ 0 ].w * s5 + c[ 2 ].w * s2 - c[ 3 ].w * s1 ) * invDet,
+                       ( c[ 0 ].w * s4 - c[ 1 ].w * s2 + c[ 3 ].w * s0 ) * invDet,
+                       ( -c[ 0 ].w * s3 + c[ 1 ].w * s1 - c[ 2 ].w * s0 ) * invDet };
+    r.columns[ 3 ] = { ( -c[ 1 ].z * s5 + c[ 2 ].z * s4 - c[ 3 ].z * s3 ) * invDet,
+                       ( c[ 0 ].z * s5 - c[ 2 ].z * s2 + c[ 3 ].z * s1 ) * invDet,
+                       ( -c[ 0 ].z * s4 + c[ 1 ].z * s2 - c[ 3 ].z * s0 ) * invDet,
+                       ( c[ 0 ].z * s3 - c[ 1 ].z * s1 + c[ 2 ].z * s0 ) * invDet };
+    return r;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Matrix products use the GCC/Clang vector extension (SSE on x86, NEON on
+// ARM) unless LEARN_METAL_MATH_SIMD is defined to 0, which selects plain
+// scalar loops.
+#ifndef LEARN_METAL_MATH_SIMD
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define LEARN_METAL_MATH_SIMD 1
+#else
+#define LEARN_METAL_MATH_SIMD 0
+#endif
+#endif
+
+namespace util
+{
+    namespace math
+    {
+        // Vector and matrix types with the size and alignment of the MSL types
+        // of the same name, so they can be used directly in structs shared with
+        // shaders. As in MSL, float3 occupies 16 bytes and float3x3 holds three
+        // of them. Matrices are column major.
+        struct alignas( 8 ) float2
+        {
+            float x, y;
+        };
+
+        struct alignas( 16 ) float3
+        {
+            float x, y, z;
+        };
+
+        struct alignas( 16 ) float4
+        {
+            float x, y, z, w;
+
+            constexpr float3 xyz() const { return { x, y, z }; }
+        };
+
+        struct alignas( 8 ) uint2
+        {
+            uint32_t x, y;
+        };
+
+        struct float3x3
+        {
+            float3 columns[ 3 ];
+        };
+
+        struct float4x4
+        {
+            float4 columns[ 4 ];
+        };
+
+        static_assert( sizeof( float2 ) == 8 && alignof( float2 ) == 8, "float2 must match MSL" );
+        static_assert( sizeof( float3 ) == 16 && alignof( float3 ) == 16, "float3 must match MSL" );
+        static_assert( sizeof( float4 ) == 16 && alignof( float4 ) == 16, "float4 must match MSL" );
+        static_assert( sizeof( uint2 ) == 8 && alignof( uint2 ) == 8, "uint2 must match MSL" );
+        static_assert( sizeof( float3x3 ) == 48 && alignof( float3x3 ) == 16, "float3x3 must match MSL" );
+        static_assert( sizeof( float4x4 ) == 64 && alignof( float4x4 ) == 16, "float4x4 must match MSL" );
+
+        constexpr float3 operator+( const float3& a, const float3& b ) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+        constexpr float3 operator-( const float3& a, const float3& b ) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+        constexpr float3 operator-( const float3& a ) { return { -a.x, -a.y, -a.z }; }
+        constexpr float3 operator*( const float3& a, float s ) { return { a.x * s, a.y * s, a.z * s }; }
+        constexpr float4 operator+( const float4& a, const float4& b ) { return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; }
+        constexpr float4 operator*( const float4& a, float s ) { return { a.x * s, a.y * s, a.z * s, a.w * s }; }
+
+        constexpr float dot( const float3& a, const float3& b ) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+        constexpr float3 cross( const float3& a, const float3& b )
+        {
+            return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+        }
+        inline float length( const float3& v ) { return sqrtf( dot( v, v ) ); }
+        inline float3 normalize( const float3& v ) { return v * ( 1.0f / length( v ) ); }
+
+        constexpr float3 add( const float3& a, const float3& b ) { return a + b; }
+
+        constexpr float4x4 makeIdentity()
+        {
+            return { { { 1.f, 0.f, 0.f, 0.f },
+                       { 0.f, 1.f, 0.f, 0.f },
+                       { 0.f, 0.f, 1.f, 0.f },
+                       { 0.f, 0.f, 0.f, 1.f } } };
+        }
+
+        constexpr float4x4 makeFromRows( const float4& r0, const float4& r1, const float4& r2, const float4& r3 )
+        {
+            return { { { r0.x, r1.x, r2.x, r3.x },
+                       { r0.y, r1.y, r2.y, r3.y },
+                       { r0.z, r1.z, r2.z, r3.z },
+                       { r0.w, r1.w, r2.w, r3.w } } };
+        }
+
+        constexpr float4x4 makeTranslate( const float3& v )
+        {
+            return { { { 1.f, 0.f, 0.f, 0.f },
+                       { 0.f, 1.f, 0.f, 0.f },
+                       { 0.f, 0.f, 1.f, 0.f },
+                       { v.x, v.y, v.z, 1.f } } };
+        }
+
+        constexpr float4x4 makeScale( const float3& v )
+        {
+            return { { { v.x, 0.f, 0.f, 0.f },
+                       { 0.f, v.y, 0.f, 0.f },
+                       { 0.f, 0.f, v.z, 0.f },
+                       { 0.f, 0.f, 0.f, 1.f } } };
+        }
+
+        inline float4x4 makePerspective( float fovRadians, float aspect, float znear, float zfar )
+        {
+            float ys = 1.f / tanf( fovRadians * 0.5f );
+            float xs = ys / aspect;
+            float zs = zfar / ( znear - zfar );
+            return makeFromRows( { xs, 0.0f, 0.0f, 0.0f },
+                                 { 0.0f, ys, 0.0f, 0.0f },
+                                 { 0.0f, 0.0f, zs, znear * zs },
+                                 { 0.0f, 0.0f, -1.0f, 0.0f } );
+        }
+
+        inline float4x4 makeXRotate( float angleRadians )
+        {
+            const float c = cosf( angleRadians );
+            const float s = sinf( angleRadians );
+            return makeFromRows( { 1.0f, 0.0f, 0.0f, 0.0f },
+                                 { 0.0f, c, s, 0.0f },
+                                 { 0.0f, -s, c, 0.0f },
+                                 { 0.0f, 0.0f, 0.0f, 1.0f } );
+        }
+
+        inline float4x4 makeYRotate( float angleRadians )
+        {
+            const float c = cosf( angleRadians );
+            const float s = sinf( angleRadians );
+            return makeFromRows( { c, 0.0f, s, 0.0f },
+                                 { 0.0f, 1.0f, 0.0f, 0.0f },
+                                 { -s, 0.0f, c, 0.0f },
+                                 { 0.0f, 0.0f, 0.0f, 1.0f } );
+        }
+
+        inline float4x4 makeZRotate( float angleRadians )
+        {
+            const float c = cosf( angleRadians );
+            const float s = sinf( angleRadians );
+            return makeFromRows( { c, s, 0.0f, 0.0f },
+                                 { -s, c, 0.0f, 0.0f },
+                                 { 0.0f, 0.0f, 1.0f, 0.0f },
+                                 { 0.0f, 0.0f, 0.0f, 1.0f } );
+        }
+
+        constexpr float3x3 discardTranslation( const float4x4& m )
+        {
+            return { { m.columns[ 0 ].xyz(), m.columns[ 1 ].xyz(), m.columns[ 2 ].xyz() } };
+        }
+
+        constexpr float4x4 transpose( const float4x4& m )
+        {
+            return makeFromRows( m.columns[ 0 ], m.columns[ 1 ], m.columns[ 2 ], m.columns[ 3 ] );
+        }
+
+#if LEARN_METAL_MATH_SIMD
+        namespace detail
+        {
+            typedef float f32x4 __attribute__(( vector_size( 16 ) ));
+
+            inline f32x4 load( const float4& v ) { f32x4 r; memcpy( &r, &v, sizeof( r ) ); return r; }
+            inline float4 store( f32x4 v ) { float4 r; memcpy( &r, &v, sizeof( r ) ); return r; }
+
+            // a * ( x, y, z, w ) as a sum of scaled columns.
+            inline f32x4 transform( const f32x4* a, const float4& v )
+            {
+                return a[ 0 ] * v.x + a[ 1 ] * v.y + a[ 2 ] * v.z + a[ 3 ] * v.w;
+            }
+        }
+
+        inline float4 operator*( const float4x4& m, const float4& v )
+        {
+            const detail::f32x4 a[ 4 ] = { detail::load( m.columns[ 0 ] ), detail::load( m.columns[ 1 ] ),
+                                           detail::load( m.columns[ 2 ] ), detail::load( m.columns[ 3 ] ) };
+            return detail::store( detail::transform( a, v ) );
+        }
+
+        inline float4x4 operator*( const float4x4& m, const float4x4& n )
+        {
+            const detail::f32x4 a[ 4 ] = { detail::load( m.columns[ 0 ] ), detail::load( m.columns[ 1 ] ),
+                                           detail::load( m.columns[ 2 ] ), detail::load( m.columns[ 3 ] ) };
+            float4x4 r;
+            for ( int c = 0; c < 4; ++c )
+            {
+                r.columns[ c ] = detail::store( detail::transform( a, n.columns[ c ] ) );
+            }
+            return r;
+        }
+#else
+        inline float4 operator*( const float4x4& m, const float4& v )
+        {
+            const float4* a = m.columns;
+            return { a[ 0 ].x * v.x + a[ 1 ].x * v.y + a[ 2 ].x * v.z + a[ 3 ].x * v.w,
+                     a[ 0 ].y * v.x + a[ 1 ].y * v.y + a[ 2 ].y * v.z + a[ 3 ].y * v.w,
+                     a[ 0 ].z * v.x + a[ 1 ].z * v.y + a[ 2 ].z * v.z + a[ 3 ].z * v.w,
+                     a[ 0 ].w * v.x + a[ 1 ].w * v.y + a[ 2 ].w * v.z + a[ 3 ].w * v.w };
+        }
+
+        inline float4x4 operator*( const float4x4& m, const float4x4& n )
+        {
+            float4x4 r;
+            for ( int c = 0; c < 4; ++c )
+            {
+                r.columns[ c ] = m * n.columns[ c ];
+            }
+            return r;
+        }
+#endif
+
+        // Inverse transpose of the upper 3x3, for transforming normals. Built
+        // from cross products of the columns (the cofactor matrix), so it
+        // handles non-uniform scale without a full 4x4 inverse.
+        float3x3 normalMatrix( const float4x4& m );
+
+        // Inverse of a matrix whose last row is ( 0, 0, 0, 1 ): rotation,
+        // scale, shear and translation, but no projection.
+        float4x4 inverseAffine( const float4x4& m );
+
+        // General 4x4 inverse. Singular matrices return all zeros.
+        float4x4 inverse( const float4x4& m );
+    }
+}
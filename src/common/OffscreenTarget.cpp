@@ -0,0 +1,95 @@
+#include "OffscreenTarget.hpp"
+
+#include <cassert>
+
+namespace
+{
+    MTL::Texture* newTarget( MTL::Device* pDevice, uint32_t width, uint32_t height, MTL::PixelFormat format, MTL::TextureUsage usage )
+    {
+        MTL::TextureDescriptor* pDesc = MTL::TextureDescriptor::texture2DDescriptor( format, width, height, false );
+        pDesc->setStorageMode( MTL::StorageModePrivate );
+        pDesc->setUsage( usage );
+        MTL::Texture* pTexture = pDevice->newTexture( pDesc );
+        assert( pTexture );
+        return pTexture;
+    }
+}
+
+util::OffscreenTarget::OffscreenTarget( MTL::Device* pDevice, uint32_t width, uint32_t height,
+                                        MTL::PixelFormat colorFormat, MTL::PixelFormat depthFormat,
+                                        MTL::ClearColor clearColor, double clearDepth,
+                                        RenderPassDescriptorPool* pPool )
+: _pColor( newTarget( pDevice, width, height, colorFormat, MTL::TextureUsageRenderTarget | MTL::TextureUsageShaderRead ) )
+, _pDepth( newTarget( pDevice, width, height, depthFormat, MTL::TextureUsageRenderTarget ) )
+, _pPool( pPool ? pPool : new RenderPassDescriptorPool() )
+, _ownsPool( !pPool )
+{
+    _signature.colorCount = 1;
+    _signature.color[ 0 ] = makeColorAttachment( colorFormat, MTL::LoadActionClear, MTL::StoreActionStore, clearColor );
+    _signature.depth = makeDepthAttachment( depthFormat, MTL::LoadActionClear, MTL::StoreActionDontCare, clearDepth );
+    _signature.width = width;
+    _signature.height = height;
+}
+
+util::OffscreenTarget::~OffscreenTarget()
+{
+    if ( _ownsPool )
+    {
+        delete _pPool;
+    }
+    _pDepth->release();
+    _pColor->release();
+}
+
+MTL::RenderPassDescriptor* util::OffscreenTarget::renderPassDescriptor()
+{
+    return _pPool->descriptor( _signature, &_pColor, _pDepth );
+}
+
+bool util::OffscreenTarget::readback( MTL::CommandQueue* pQueue, Image* pOut )
+{
+    MTL::PixelFormat format = _pColor->pixelFormat();
+    bool bgra = format == MTL::PixelFormatBGRA8Unorm || format == MTL::PixelFormatBGRA8Unorm_sRGB;
+    bool rgba = format == MTL::PixelFormatRGBA8Unorm || format == MTL::PixelFormatRGBA8Unorm_sRGB;
+    if ( !bgra && !rgba )
+    {
+        __builtin_printf( "Cannot read back pixel format %lu\n", (unsigned long)format );
+        return false;
+    }
+
+    uint32_t width = (uint32_t)_pColor->width();
+    uint32_t height = (uint32_t)_pColor->height();
+    size_t bytesPerRow = (size_t)width * 4;
+    MTL::Buffer* pBuffer = _pColor->device()->newBuffer( bytesPerRow * height, MTL::ResourceStorageModeShared );
+
+    // The queue runs buffers in order, so this copy sees every frame's output
+    MTL::CommandBuffer* pCmd = pQueue->commandBuffer();
+    MTL::BlitCommandEncoder* pBlit = pCmd->blitCommandEncoder();
+    pBlit->copyFromTexture( _pColor, 0, 0, MTL::Origin( 0, 0, 0 ), MTL::Size( width, height, 1 ),
+                            pBuffer, 0, bytesPerRow, bytesPerRow * height );
+    pBlit->endEncoding();
+    pCmd->commit();
+    pCmd->waitUntilCompleted();
+
+    bool ok = pCmd->status() == MTL::CommandBufferStatusCompleted;
+    if ( ok )
+    {
+        pOut->width = width;
+        pOut->height = height;
+        pOut->rgba.resize( bytesPerRow * height );
+        const uint8_t* pSrc = static_cast< const uint8_t* >( pBuffer->contents() );
+        for ( size_t i = 0; i < pOut->rgba.size(); i += 4 )
+        {
+            pOut->rgba[ i + 0 ] = pSrc[ i + ( bgra ? 2 : 0 ) ];
+            pOut->rgba[ i + 1 ] = pSrc[ i + 1 ];
+            pOut->rgba[ i + 2 ] = pSrc[ i + ( bgra ? 0 : 2 ) ];
+            pOut->rgba[ i + 3 ] = pSrc[ i + 3 ];
+        }
+    }
+    else
+    {
+        __builtin_printf( "Reading back the offscreen target failed\n" );
+    }
+    pBuffer->release();
+    return ok;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "HeadlessRunner.hpp"
+#include "RenderPassDescriptorPool.hpp"
+
+namespace util
+{
+    // The color and depth textures an MTK::View would provide, for running
+    // a sample's draw code without a window. Every pass through
+    // renderPassDescriptor() clears both and stores the color. Targets
+    // sharing a pool with the same size, formats and clear values share
+    // one descriptor.
+    class OffscreenTarget
+    {
+        public:
+            OffscreenTarget( MTL::Device* pDevice, uint32_t width, uint32_t height,
+                             MTL::PixelFormat colorFormat, MTL::PixelFormat depthFormat,
+                             MTL::ClearColor clearColor, double clearDepth = 1.0,
+                             RenderPassDescriptorPool* pPool = nullptr );
+            ~OffscreenTarget();
+
+            // Valid until the next call on any target sharing the pool.
+            MTL::RenderPassDescriptor* renderPassDescriptor();
+            MTL::Texture* colorTexture() const { return _pColor; }
+            MTL::Texture* depthTexture() const { return _pDepth; }
+
+            // Copies the color texture out once the queue's earlier work is
+            // done. Handles 8-bit RGBA and BGRA formats; returns false for
+            // others.
+            bool readback( MTL::CommandQueue* pQueue, Image* pOut );
+
+        private:
+            MTL::Texture* _pColor;
+            MTL::Texture* _pDepth;
+            RenderPassSignature _signature;
+            RenderPassDescriptorPool* _pPool;
+            bool _ownsPool;
+    };
+}
@@ -0,0 +1,72 @@
+#include "ParallelInstanceUpdater.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    size_t gcd( size_t a, size_t b )
+    {
+        while ( b != 0 )
+        {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+}
+
+util::ParallelInstanceUpdater::ParallelInstanceUpdater( WorkStealingPool* pPool, size_t instanceSize, size_t chunkInstances )
+: _pPool( pPool )
+, _instanceSize( instanceSize )
+{
+    // Smallest instance count whose byte size is a whole number of cache
+    // lines, then widened to a multiple of four.
+    size_t lineInstances = util::kCacheLineSize / gcd( instanceSize, util::kCacheLineSize );
+    size_t granule = lineInstances * 4 / gcd( lineInstances, 4 );
+    chunkInstances = std::max< size_t >( chunkInstances, 1 );
+    _chunkInstances = ( chunkInstances + granule - 1 ) / granule * granule;
+}
+
+void util::ParallelInstanceUpdater::update( size_t instanceCount, const UpdateFunction& fn )
+{
+    size_t chunks = chunkCount( instanceCount );
+    _chunks.resize( chunks );
+
+    auto runChunk = [&]( size_t chunk, unsigned worker ){
+        size_t first = chunk * _chunkInstances;
+        size_t count = std::min( _chunkInstances, instanceCount - first );
+        _chunks[ chunk ].dirty = fn( first, count, worker );
+    };
+
+    if ( _pPool && chunks > 1 )
+    {
+        _pPool->parallelFor( chunks, runChunk );
+    }
+    else
+    {
+        for ( size_t chunk = 0; chunk < chunks; ++chunk )
+        {
+            runChunk( chunk, 0 );
+        }
+    }
+
+    _dirtyRanges.clear();
+    for ( size_t chunk = 0; chunk < chunks; ++chunk )
+    {
+        if ( !_chunks[ chunk ].dirty )
+        {
+            continue;
+        }
+        size_t offset = chunk * _chunkInstances * _instanceSize;
+        size_t length = std::min( _chunkInstances, instanceCount - chunk * _chunkInstances ) * _instanceSize;
+        if ( !_dirtyRanges.empty() && _dirtyRanges.back().offset + _dirtyRanges.back().length == offset )
+        {
+            _dirtyRanges.back().length += length;
+        }
+        else
+        {
+            _dirtyRanges.push_back( { offset, length } );
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <common/WorkStealingPool.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace util
+{
+    static constexpr size_t kCacheLineSize = 64;
+
+    // Byte range of an instance buffer, ready for MTL::Buffer::didModifyRange().
+    struct DirtyRange
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    // Splits an instance array into fixed-size chunks and updates them on a
+    // WorkStealingPool, each worker writing straight into the mapped buffer.
+    //
+    // Chunks always start on a cache line, so two workers never write the same
+    // line, and they are a multiple of four instances to keep the SIMD
+    // transform builder on its full-width path. Chunk boundaries depend only on
+    // the instance count, never on the thread count, so results are identical
+    // however many workers run.
+    class ParallelInstanceUpdater
+    {
+        public:
+            // Writes instances [first, first + count) and returns whether any
+            // of them changed.
+            using UpdateFunction = std::function< bool( size_t first, size_t count, unsigned worker ) >;
+
+            // chunkInstances is rounded up to satisfy the alignment rules above.
+            ParallelInstanceUpdater( WorkStealingPool* pPool, size_t instanceSize, size_t chunkInstances = 256 );
+
+            size_t chunkInstances() const { return _chunkInstances; }
+            size_t chunkCount( size_t instanceCount ) const { return ( instanceCount + _chunkInstances - 1 ) / _chunkInstances; }
+
+            // Runs fn over every chunk of instanceCount instances, then merges
+            // the chunks that reported changes into dirtyRanges().
+            void update( size_t instanceCount, const UpdateFunction& fn );
+
+            // Byte ranges written by the last update(), ascending, with
+            // adjacent chunks merged.
+            const std::vector< DirtyRange >& dirtyRanges() const { return _dirtyRanges; }
+
+        private:
+            // One flag per cache line so workers don't contend on neighbours'.
+            struct alignas( kCacheLineSize ) ChunkState
+            {
+                bool dirty;
+            };
+
+            WorkStealingPool* _pPool;
+            size_t _instanceSize;
+            size_t _chunkInstances;
+            std::vector< ChunkState > _chunks;
+            std::vector< DirtyRange > _dirtyRanges;
+    };
+}
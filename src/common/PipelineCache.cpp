@@ -0,0 +1,314 @@
+#include "PipelineCache.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "ShaderLibrary.hpp"
+
+namespace
+{
+    const char* describe( NS::Error* pError )
+    {
+        return pError ? pError->localizedDescription()->utf8String() : "unknown error";
+    }
+}
+
+std::string util::PipelineCache::defaultArchivePath( const char* pFileName )
+{
+    // NSTemporaryDirectory() is $TMPDIR for sandboxed and unsandboxed apps alike
+    const char* pTmp = getenv( "TMPDIR" );
+    std::string path = ( pTmp && *pTmp ) ? pTmp : "/tmp/";
+    if ( path.back() != '/' )
+    {
+        path += '/';
+    }
+    return path + pFileName;
+}
+
+util::PipelineCache::PipelineCache( MTL::Device* pDevice )
+: PipelineCache( pDevice, defaultArchivePath().c_str() )
+{
+}
+
+util::PipelineCache::PipelineCache( MTL::Device* pDevice, const char* pArchivePath )
+: _pDevice( pDevice->retain() )
+, _pArchive( nullptr )
+, _pArchiveURL( nullptr )
+, _archiveDirty( false )
+{
+    if ( !pArchivePath )
+    {
+        return;
+    }
+
+    _pArchiveURL = NS::URL::alloc()->initFileURLWithPath( NS::String::string( pArchivePath, NS::UTF8StringEncoding ) );
+
+    MTL::BinaryArchiveDescriptor* pArchiveDesc = MTL::BinaryArchiveDescriptor::alloc()->init();
+    if ( access( pArchivePath, F_OK ) == 0 )
+    {
+        pArchiveDesc->setUrl( _pArchiveURL );
+    }
+
+    NS::Error* pError = nullptr;
+    _pArchive = _pDevice->newBinaryArchive( pArchiveDesc, &pError );
+    if ( !_pArchive && pArchiveDesc->url() )
+    {
+        // A stale or corrupt archive is not fatal; start over with an empty one.
+        __builtin_printf( "Discarding pipeline archive: %s\n", describe( pError ) );
+        pArchiveDesc->setUrl( nullptr );
+        pError = nullptr;
+        _pArchive = _pDevice->newBinaryArchive( pArchiveDesc, &pError );
+    }
+    if ( !_pArchive )
+    {
+        __builtin_printf( "Pipeline archive unavailable: %s\n", describe( pError ) );
+    }
+
+    pArchiveDesc->release();
+}
+
+util::PipelineCache::~PipelineCache()
+{
+    auto release = []( uint64_t, void* pObject ){
+        static_cast< NS::Object* >( pObject )->release();
+    };
+    _renderPipelines.forEach( release );
+    _computePipelines.forEach( release );
+    _functions.forEach( release );
+    _libraries.forEach( release );
+
+    if ( _pArchive )
+    {
+        _pArchive->release();
+    }
+    if ( _pArchiveURL )
+    {
+        _pArchiveURL->release();
+    }
+    _pDevice->release();
+}
+
+MTL::Library* util::PipelineCache::newLibrary( const char* pSource, NS::Error** ppError, ShaderMath math )
+{
+    uint64_t key = PipelineKeyBuilder( hashString( pSource ) ).add( (uint64_t)math ).key();
+    if ( void* pCached = _libraries.find( key ) )
+    {
+        return static_cast< MTL::Library* >( pCached )->retain();
+    }
+
+    MTL::Library* pLibrary = newShaderLibrary( _pDevice, pSource, ppError, math );
+    if ( !pLibrary )
+    {
+        return nullptr;
+    }
+
+    _libraries.insert( key, pLibrary );
+    _libraryKeys[ pLibrary ] = key;
+    return pLibrary->retain();
+}
+
+MTL::Function* util::PipelineCache::newFunction( MTL::Library* pLibrary, const char* pName )
+{
+    auto it = _libraryKeys.find( pLibrary );
+    uint64_t libraryKey = ( it != _libraryKeys.end() ) ? it->second : hashValue( pLibrary );
+    uint64_t key = PipelineKeyBuilder( libraryKey ).addString( pName ).key();
+
+    if ( void* pCached = _functions.find( key ) )
+    {
+        return static_cast< MTL::Function* >( pCached )->retain();
+    }
+
+    MTL::Function* pFunction = pLibrary->newFunction( NS::String::string( pName, NS::UTF8StringEncoding ) );
+    if ( !pFunction )
+    {
+        return nullptr;
+    }
+
+    _functions.insert( key, pFunction );
+    _functionKeys[ pFunction ] = key;
+    return pFunction->retain();
+}
+
+uint64_t util::PipelineCache::functionKey( const MTL::Function* pFunction ) const
+{
+    if ( !pFunction )
+    {
+        return 0;
+    }
+
+    auto it = _functionKeys.find( pFunction );
+    if ( it != _functionKeys.end() )
+    {
+        return it->second;
+    }
+
+    return PipelineKeyBuilder( hashValue( pFunction ) ).addString( pFunction->name()->utf8String() ).key();
+}
+
+uint64_t util::PipelineCache::renderPipelineKey( const MTL::RenderPipelineDescriptor* pDesc ) const
+{
+    RenderPipelineSummary s;
+    s.vertexFunction = functionKey( pDesc->vertexFunction() );
+    s.fragmentFunction = functionKey( pDesc->fragmentFunction() );
+
+    for ( uint32_t i = 0; i < RenderPipelineSummary::kMaxColorAttachments; ++i )
+    {
+        MTL::RenderPipelineColorAttachmentDescriptor* pColor = pDesc->colorAttachments()->object( i );
+        RenderPipelineSummary::ColorAttachment& c = s.color[ i ];
+        c.pixelFormat = (uint32_t)pColor->pixelFormat();
+        c.writeMask = (uint32_t)pColor->writeMask();
+        c.blendingEnabled = pColor->blendingEnabled();
+        c.sourceRGBBlendFactor = (uint32_t)pColor->sourceRGBBlendFactor();
+        c.destinationRGBBlendFactor = (uint32_t)pColor->destinationRGBBlendFactor();
+        c.rgbBlendOperation = (uint32_t)pColor->rgbBlendOperation();
+        c.sourceAlphaBlendFactor = (uint32_t)pColor->sourceAlphaBlendFactor();
+        c.destinationAlphaBlendFactor = (uint32_t)pColor->destinationAlphaBlendFactor();
+        c.alphaBlendOperation = (uint32_t)pColor->alphaBlendOperation();
+    }
+
+    s.depthAttachmentPixelFormat = (uint32_t)pDesc->depthAttachmentPixelFormat();
+    s.stencilAttachmentPixelFormat = (uint32_t)pDesc->stencilAttachmentPixelFormat();
+    s.rasterSampleCount = pDesc->rasterSampleCount();
+    s.alphaToCoverageEnabled = pDesc->alphaToCoverageEnabled();
+    s.alphaToOneEnabled = pDesc->alphaToOneEnabled();
+    s.rasterizationEnabled = pDesc->rasterizationEnabled();
+    s.inputPrimitiveTopology = (uint32_t)pDesc->inputPrimitiveTopology();
+
+    MTL::VertexDescriptor* pVertexDesc = pDesc->vertexDescriptor();
+    s.hasVertexDescriptor = pVertexDesc != nullptr;
+    if ( pVertexDesc )
+    {
+        for ( uint32_t i = 0; i < RenderPipelineSummary::kMaxVertexAttributes; ++i )
+        {
+            MTL::VertexAttributeDescriptor* pAttr = pVertexDesc->attributes()->object( i );
+            s.attributes[ i ].format = (uint32_t)pAttr->format();
+            s.attributes[ i ].offset = pAttr->offset();
+            s.attributes[ i ].bufferIndex = pAttr->bufferIndex();
+        }
+        for ( uint32_t i = 0; i < RenderPipelineSummary::kMaxVertexBufferLayouts; ++i )
+        {
+            MTL::VertexBufferLayoutDescriptor* pLayout = pVertexDesc->layouts()->object( i );
+            s.layouts[ i ].stride = pLayout->stride();
+            s.layouts[ i ].stepFunction = (uint32_t)pLayout->stepFunction();
+            s.layouts[ i ].stepRate = pLayout->stepRate();
+        }
+    }
+
+    return s.key();
+}
+
+uint64_t util::PipelineCache::computePipelineKey( const MTL::ComputePipelineDescriptor* pDesc ) const
+{
+    ComputePipelineSummary s;
+    s.computeFunction = functionKey( pDesc->computeFunction() );
+    s.threadGroupSizeIsMultipleOfThreadExecutionWidth = pDesc->threadGroupSizeIsMultipleOfThreadExecutionWidth();
+    s.maxTotalThreadsPerThreadgroup = pDesc->maxTotalThreadsPerThreadgroup();
+    return s.key();
+}
+
+MTL::RenderPipelineState* util::PipelineCache::newRenderPipelineState( const MTL::RenderPipelineDescriptor* pDesc, NS::Error** ppError )
+{
+    uint64_t key = renderPipelineKey( pDesc );
+    if ( void* pCached = _renderPipelines.find( key ) )
+    {
+        return static_cast< MTL::RenderPipelineState* >( pCached )->retain();
+    }
+
+    MTL::RenderPipelineDescriptor* pArchivedDesc = pDesc->copy();
+    if ( _pArchive )
+    {
+        pArchivedDesc->setBinaryArchives( NS::Array::array( _pArchive ) );
+    }
+
+    // Only a pipeline the archive misses is compiled and added to it.
+    MTL::RenderPipelineState* pPSO = nullptr;
+    if ( _pArchive )
+    {
+        pPSO = _pDevice->newRenderPipelineState( pArchivedDesc, MTL::PipelineOptionFailOnBinaryArchiveMiss, nullptr, nullptr );
+    }
+    if ( !pPSO )
+    {
+        pPSO = _pDevice->newRenderPipelineState( pArchivedDesc, ppError );
+        if ( pPSO && _pArchive )
+        {
+            NS::Error* pError = nullptr;
+            _archiveDirty |= _pArchive->addRenderPipelineFunctions( pArchivedDesc, &pError );
+        }
+    }
+    pArchivedDesc->release();
+
+    if ( !pPSO )
+    {
+        return nullptr;
+    }
+
+    _renderPipelines.insert( key, pPSO );
+    return pPSO->retain();
+}
+
+MTL::ComputePipelineState* util::PipelineCache::newComputePipelineState( const MTL::ComputePipelineDescriptor* pDesc, NS::Error** ppError )
+{
+    uint64_t key = computePipelineKey( pDesc );
+    if ( void* pCached = _computePipelines.find( key ) )
+    {
+        return static_cast< MTL::ComputePipelineState* >( pCached )->retain();
+    }
+
+    MTL::ComputePipelineDescriptor* pArchivedDesc = pDesc->copy();
+    if ( _pArchive )
+    {
+        pArchivedDesc->setBinaryArchives( NS::Array::array( _pArchive ) );
+    }
+
+    MTL::ComputePipelineState* pPSO = nullptr;
+    if ( _pArchive )
+    {
+        pPSO = _pDevice->newComputePipelineState( pArchivedDesc, MTL::PipelineOptionFailOnBinaryArchiveMiss, nullptr, nullptr );
+    }
+    if ( !pPSO )
+    {
+        pPSO = _pDevice->newComputePipelineState( pArchivedDesc, MTL::PipelineOptionNone, nullptr, ppError );
+        if ( pPSO && _pArchive )
+        {
+            NS::Error* pError = nullptr;
+            _archiveDirty |= _pArchive->addComputePipelineFunctions( pArchivedDesc, &pError );
+        }
+    }
+    pArchivedDesc->release();
+
+    if ( !pPSO )
+    {
+        return nullptr;
+    }
+
+    _computePipelines.insert( key, pPSO );
+    return pPSO->retain();
+}
+
+MTL::ComputePipelineState* util::PipelineCache::newComputePipelineState( MTL::Function* pFunction, NS::Error** ppError )
+{
+    MTL::ComputePipelineDescriptor* pDesc = MTL::ComputePipelineDescriptor::alloc()->init();
+    pDesc->setComputeFunction( pFunction );
+    MTL::ComputePipelineState* pPSO = newComputePipelineState( pDesc, ppError );
+    pDesc->release();
+    return pPSO;
+}
+
+bool util::PipelineCache::serialize()
+{
+    if ( !_pArchive || !_archiveDirty )
+    {
+        return true;
+    }
+
+    NS::Error* pError = nullptr;
+    if ( !_pArchive->serializeToURL( _pArchiveURL, &pError ) )
+    {
+        __builtin_printf( "Failed to write pipeline archive: %s\n", describe( pError ) );
+        return false;
+    }
+
+    _archiveDirty = false;
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include <string>
+#include <unordered_map>
+
+#include "EmbeddedShaders.hpp"
+#include "PipelineKey.hpp"
+
+namespace util
+{
+    // Deduplicates libraries, functions and pipeline states across renderers
+    // and persists compiled pipelines in an MTL::BinaryArchive so warm starts
+    // skip backend compilation.
+    //
+    // Pipelines are keyed by descriptor content. Functions are identified by
+    // the source hash and math mode of their library and their name, which
+    // only works for functions created through newFunction() here; other
+    // functions fall back to pointer identity and are deduplicated per object
+    // only.
+    //
+    // Like the MTL::Device methods they replace, the new*() calls return
+    // objects the caller owns and must release.
+    class PipelineCache
+    {
+        public:
+            // pArchivePath may be null for an in-memory cache. An existing
+            // archive at that path is loaded; serialize() writes it back.
+            PipelineCache( MTL::Device* pDevice, const char* pArchivePath );
+            // Uses the archive at defaultArchivePath().
+            explicit PipelineCache( MTL::Device* pDevice );
+            ~PipelineCache();
+
+            MTL::Library* newLibrary( const char* pSource, NS::Error** ppError, ShaderMath math = ShaderMath::Fast );
+            MTL::Function* newFunction( MTL::Library* pLibrary, const char* pName );
+
+            MTL::RenderPipelineState* newRenderPipelineState( const MTL::RenderPipelineDescriptor* pDesc, NS::Error** ppError );
+            MTL::ComputePipelineState* newComputePipelineState( const MTL::ComputePipelineDescriptor* pDesc, NS::Error** ppError );
+            MTL::ComputePipelineState* newComputePipelineState( MTL::Function* pFunction, NS::Error** ppError );
+
+            // Lets functions created elsewhere (e.g. specialized with function
+            // constants) take part in content keys. The function must stay
+            // alive for as long as the cache is used with it.
+            void registerFunction( const MTL::Function* pFunction, uint64_t key ) { _functionKeys[ pFunction ] = key; }
+
+            uint64_t renderPipelineKey( const MTL::RenderPipelineDescriptor* pDesc ) const;
+            uint64_t computePipelineKey( const MTL::ComputePipelineDescriptor* pDesc ) const;
+
+            bool serialize();
+
+            // pFileName in the user's temporary directory.
+            static std::string defaultArchivePath( const char* pFileName = "learn-metal-pipelines.metallib" );
+
+            const PipelineRegistry& renderPipelines() const { return _renderPipelines; }
+            const PipelineRegistry& computePipelines() const { return _computePipelines; }
+
+        private:
+            uint64_t functionKey( const MTL::Function* pFunction ) const;
+
+            MTL::Device* _pDevice;
+            MTL::BinaryArchive* _pArchive;
+            NS::URL* _pArchiveURL;
+            bool _archiveDirty;
+            PipelineRegistry _libraries;
+            PipelineRegistry _functions;
+            PipelineRegistry _renderPipelines;
+            PipelineRegistry _computePipelines;
+            std::unordered_map< const void*, uint64_t > _libraryKeys;
+            std::unordered_map< const void*, uint64_t > _functionKeys;
+    };
+}
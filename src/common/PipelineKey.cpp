@@ -0,0 +1,64 @@
+#include "PipelineKey.hpp"
+
+uint64_t util::RenderPipelineSummary::key() const
+{
+    PipelineKeyBuilder b;
+    b.add( vertexFunction );
+    b.add( fragmentFunction );
+
+    for ( const ColorAttachment& c : color )
+    {
+        b.add( c.pixelFormat );
+        if ( c.pixelFormat == 0 )
+        {
+            continue;
+        }
+
+        b.add( c.writeMask );
+        b.add( c.blendingEnabled );
+        if ( c.blendingEnabled )
+        {
+            b.add( c.sourceRGBBlendFactor ).add( c.destinationRGBBlendFactor ).add( c.rgbBlendOperation );
+            b.add( c.sourceAlphaBlendFactor ).add( c.destinationAlphaBlendFactor ).add( c.alphaBlendOperation );
+        }
+    }
+
+    b.add( depthAttachmentPixelFormat );
+    b.add( stencilAttachmentPixelFormat );
+    b.add( rasterSampleCount );
+    b.add( alphaToCoverageEnabled );
+    b.add( alphaToOneEnabled );
+    b.add( rasterizationEnabled );
+    b.add( inputPrimitiveTopology );
+
+    if ( hasVertexDescriptor )
+    {
+        for ( uint32_t i = 0; i < kMaxVertexAttributes; ++i )
+        {
+            const VertexAttribute& a = attributes[ i ];
+            if ( a.format != 0 )
+            {
+                b.add( i ).add( a.format ).add( a.offset ).add( a.bufferIndex );
+            }
+        }
+        for ( uint32_t i = 0; i < kMaxVertexBufferLayouts; ++i )
+        {
+            const VertexBufferLayout& l = layouts[ i ];
+            if ( l.stride != 0 )
+            {
+                b.add( i ).add( l.stride ).add( l.stepFunction ).add( l.stepRate );
+            }
+        }
+    }
+
+    return b.key();
+}
+
+uint64_t util::ComputePipelineSummary::key() const
+{
+    PipelineKeyBuilder b;
+    b.add( computeFunction );
+    b.add( threadGroupSizeIsMultipleOfThreadExecutionWidth );
+    b.add( maxTotalThreadsPerThreadgroup );
+    return b.key();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "Hash.hpp"
+
+namespace util
+{
+    // Accumulates the state that affects a compiled pipeline into a single
+    // 64 bit key. Field order matters, so callers must add fields in a fixed
+    // order for a given descriptor type.
+    class PipelineKeyBuilder
+    {
+        public:
+            explicit PipelineKeyBuilder( uint64_t seed = kFnvOffset ) : _hash( seed ) {}
+
+            PipelineKeyBuilder& add( uint64_t value ) { _hash = hashValue( value, _hash ); return *this; }
+            PipelineKeyBuilder& addFloat( float value ) { _hash = hashFloat( value, _hash ); return *this; }
+            PipelineKeyBuilder& addString( const char* pString ) { _hash = hashString( pString, _hash ); return *this; }
+            PipelineKeyBuilder& addBytes( const void* pData, size_t size ) { _hash = hashBytes( pData, size, _hash ); return *this; }
+
+            uint64_t key() const { return _hash; }
+
+        private:
+            uint64_t _hash;
+    };
+
+    // The parts of an MTL::RenderPipelineDescriptor that change the compiled
+    // pipeline, as raw MTL enum values. Functions are the cache's function
+    // keys. Members the descriptor leaves unused (the rest of an attachment
+    // with an invalid format, blend factors with blending off, attributes
+    // with an invalid format, layouts with a zero stride) are not hashed.
+    struct RenderPipelineSummary
+    {
+        static constexpr uint32_t kMaxColorAttachments = 8;
+        static constexpr uint32_t kMaxVertexAttributes = 31;
+        static constexpr uint32_t kMaxVertexBufferLayouts = 31;
+
+        struct ColorAttachment
+        {
+            uint32_t pixelFormat = 0;
+            uint32_t writeMask = 0;
+            bool blendingEnabled = false;
+            uint32_t sourceRGBBlendFactor = 0;
+            uint32_t destinationRGBBlendFactor = 0;
+            uint32_t rgbBlendOperation = 0;
+            uint32_t sourceAlphaBlendFactor = 0;
+            uint32_t destinationAlphaBlendFactor = 0;
+            uint32_t alphaBlendOperation = 0;
+        };
+
+        struct VertexAttribute
+        {
+            uint32_t format = 0;
+            uint64_t offset = 0;
+            uint64_t bufferIndex = 0;
+        };
+
+        struct VertexBufferLayout
+        {
+            uint64_t stride = 0;
+            uint32_t stepFunction = 0;
+            uint64_t stepRate = 0;
+        };
+
+        uint64_t vertexFunction = 0;
+        uint64_t fragmentFunction = 0;
+        ColorAttachment color[ kMaxColorAttachments ];
+        uint32_t depthAttachmentPixelFormat = 0;
+        uint32_t stencilAttachmentPixelFormat = 0;
+        uint64_t rasterSampleCount = 1;
+        bool alphaToCoverageEnabled = false;
+        bool alphaToOneEnabled = false;
+        bool rasterizationEnabled = true;
+        uint32_t inputPrimitiveTopology = 0;
+        bool hasVertexDescriptor = false;
+        VertexAttribute attributes[ kMaxVertexAttributes ];
+        VertexBufferLayout layouts[ kMaxVertexBufferLayouts ];
+
+        uint64_t key() const;
+    };
+
+    struct ComputePipelineSummary
+    {
+        uint64_t computeFunction = 0;
+        bool threadGroupSizeIsMultipleOfThreadExecutionWidth = false;
+        uint64_t maxTotalThreadsPerThreadgroup = 0;
+
+        uint64_t key() const;
+    };
+
+    // Key to object map shared by everything that asks for the same
+    // pipeline. Stores opaque pointers; the owner retains and releases them.
+    class PipelineRegistry
+    {
+        public:
+            void* find( uint64_t key )
+            {
+                auto it = _objects.find( key );
+                if ( it == _objects.end() )
+                {
+                    ++_misses;
+                    return nullptr;
+                }
+                ++_hits;
+                return it->second;
+            }
+
+            void insert( uint64_t key, void* pObject ) { _objects[ key ] = pObject; }
+
+            template< typename Fn >
+            void forEach( Fn&& fn ) const
+            {
+                for ( const auto& entry : _objects )
+                {
+                    fn( entry.first, entry.second );
+                }
+            }
+
+            void clear() { _objects.clear(); }
+
+            size_t size() const { return _objects.size(); }
+            uint64_t hits() const { return _hits; }
+            uint64_t misses() const { return _misses; }
+
+        private:
+            std::unordered_map< uint64_t, void* > _objects;
+            uint64_t _hits = 0;
+            uint64_t _misses = 0;
+    };
+}
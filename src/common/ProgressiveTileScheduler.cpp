@@ -0,0 +1,154 @@
+#include "ProgressiveTileScheduler.hpp"
+
+#include <algorithm>
+
+constexpr uint32_t util::ProgressiveTileScheduler::kLevelStrides[];
+
+util::ProgressiveTileScheduler::ProgressiveTileScheduler( uint32_t width, uint32_t height, uint32_t tileSize, uint64_t pixelBudget )
+: _width( width )
+, _height( height )
+, _tileSize( std::max( tileSize, 1u ) )
+, _pixelBudget( pixelBudget )
+{
+    _tilesX = ( width + _tileSize - 1 ) / _tileSize;
+    _tilesY = ( height + _tileSize - 1 ) / _tileSize;
+    _levels.assign( (size_t)_tilesX * _tilesY, 0 );
+    _pendingTiles = (uint32_t)_levels.size();
+
+    for ( uint32_t i = 0; i < _levels.size(); ++i )
+    {
+        _order.push_back( i );
+    }
+
+    // Distances in doubled tile units keep the comparison in integers.
+    auto distance = [this]( uint32_t tile ){
+        int64_t dx = 2 * (int64_t)( tile % _tilesX ) + 1 - (int64_t)_tilesX;
+        int64_t dy = 2 * (int64_t)( tile / _tilesX ) + 1 - (int64_t)_tilesY;
+        return dx * dx + dy * dy;
+    };
+    std::stable_sort( _order.begin(), _order.end(), [&]( uint32_t a, uint32_t b ){
+        return distance( a ) < distance( b );
+    } );
+}
+
+bool util::ProgressiveTileScheduler::setView( const MandelbrotView& view )
+{
+    if ( _hasView && view == _view )
+    {
+        return false;
+    }
+
+    _view = view;
+    _hasView = true;
+    invalidateAll();
+    return true;
+}
+
+void util::ProgressiveTileScheduler::invalidateAll()
+{
+    std::fill( _levels.begin(), _levels.end(), 0 );
+    _pendingTiles = (uint32_t)_levels.size();
+}
+
+void util::ProgressiveTileScheduler::invalidate( uint32_t x, uint32_t y, uint32_t width, uint32_t height )
+{
+    if ( width == 0 || height == 0 || x >= _width || y >= _height )
+    {
+        return;
+    }
+
+    uint32_t tx0 = x / _tileSize;
+    uint32_t ty0 = y / _tileSize;
+    uint32_t tx1 = std::min( ( x + width - 1 ) / _tileSize, _tilesX - 1 );
+    uint32_t ty1 = std::min( ( y + height - 1 ) / _tileSize, _tilesY - 1 );
+    for ( uint32_t ty = ty0; ty <= ty1; ++ty )
+    {
+        for ( uint32_t tx = tx0; tx <= tx1; ++tx )
+        {
+            uint8_t& level = _levels[ ty * _tilesX + tx ];
+            if ( level == kLevelCount )
+            {
+                ++_pendingTiles;
+            }
+            level = 0;
+        }
+    }
+}
+
+uint64_t util::ProgressiveTileScheduler::cost( const TileDispatch& d )
+{
+    return (uint64_t)( ( d.width + d.stride - 1 ) / d.stride ) * ( ( d.height + d.stride - 1 ) / d.stride );
+}
+
+util::TileDispatch util::ProgressiveTileScheduler::tileRect( uint32_t tile ) const
+{
+    TileDispatch d;
+    d.x = ( tile % _tilesX ) * _tileSize;
+    d.y = ( tile / _tilesX ) * _tileSize;
+    d.width = std::min( _tileSize, _width - d.x );
+    d.height = std::min( _tileSize, _height - d.y );
+    d.stride = 1;
+    return d;
+}
+
+uint64_t util::ProgressiveTileScheduler::nextFrame( std::vector< TileDispatch >* pDispatches )
+{
+    pDispatches->clear();
+    if ( _pendingTiles == 0 )
+    {
+        return 0;
+    }
+
+    uint64_t spent = 0;
+    auto dispatch = [&]( uint32_t tile, uint32_t level ){
+        TileDispatch d = tileRect( tile );
+        d.stride = kLevelStrides[ level ];
+        pDispatches->push_back( d );
+        spent += cost( d );
+
+        _levels[ tile ] = (uint8_t)( level + 1 );
+        if ( _levels[ tile ] == kLevelCount )
+        {
+            --_pendingTiles;
+        }
+    };
+
+    // Cover the whole image at the coarsest level before sharpening any of
+    // it, so a view that changes every frame still shows every tile.
+    for ( uint32_t tile : _order )
+    {
+        if ( _levels[ tile ] != 0 )
+        {
+            continue;
+        }
+
+        TileDispatch d = tileRect( tile );
+        d.stride = kLevelStrides[ 0 ];
+        if ( spent + cost( d ) > _pixelBudget && !pDispatches->empty() )
+        {
+            return spent;
+        }
+        dispatch( tile, 0 );
+    }
+
+    // Then sharpen from the centre out, taking each tile straight to the
+    // finest level the rest of the budget pays for. A tile may be dispatched
+    // again after its coarse pass; dispatches in one serial encoder run in
+    // order, so the finer one overwrites it.
+    for ( uint32_t tile : _order )
+    {
+        for ( uint32_t level = kLevelCount; level-- > _levels[ tile ]; )
+        {
+            TileDispatch d = tileRect( tile );
+            d.stride = kLevelStrides[ level ];
+            bool next = level == _levels[ tile ];
+            if ( spent + cost( d ) <= _pixelBudget || ( next && pDispatches->empty() ) )
+            {
+                dispatch( tile, level );
+                break;
+            }
+        }
+    }
+
+    return spent;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    // Parameters a Mandelbrot image depends on. Any change invalidates every
+    // tile.
+    struct MandelbrotView
+    {
+        float zoom = 1.0f;
+        float centerX = 0.0f;
+        float centerY = 0.0f;
+        uint32_t maxIterations = 1000;
+
+        bool operator==( const MandelbrotView& rhs ) const
+        {
+            return zoom == rhs.zoom && centerX == rhs.centerX && centerY == rhs.centerY
+                && maxIterations == rhs.maxIterations;
+        }
+        bool operator!=( const MandelbrotView& rhs ) const { return !( *this == rhs ); }
+    };
+
+    // One tile to evaluate at every stride-th pixel in x and y, each result
+    // filling a stride x stride block clipped to the tile.
+    struct TileDispatch
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+    };
+
+    // Decides which tiles of an image to (re)compute each frame. Dirty tiles
+    // are refined progressively, 1/16 of their pixels first (stride 4), then
+    // 1/4 (stride 2), then all of them. Every tile gets its coarse pass before
+    // any tile is refined, and refinement spends what is left of the frame
+    // from the centre out, skipping levels the budget can afford to. Each
+    // frame spends at most a fixed number of pixel evaluations, but always
+    // makes progress. Once all tiles are at full resolution nothing is
+    // dispatched until the view changes.
+    class ProgressiveTileScheduler
+    {
+        public:
+            static constexpr uint32_t kLevelCount = 3;
+            static constexpr uint32_t kLevelStrides[ kLevelCount ] = { 4, 2, 1 };
+
+            ProgressiveTileScheduler( uint32_t width, uint32_t height, uint32_t tileSize, uint64_t pixelBudget );
+
+            // Returns true if the view differs from the previous one, in which
+            // case every tile starts over from the coarsest level.
+            bool setView( const MandelbrotView& view );
+            const MandelbrotView& view() const { return _view; }
+
+            void invalidateAll();
+            void invalidate( uint32_t x, uint32_t y, uint32_t width, uint32_t height );
+
+            // Appends this frame's work to pDispatches (cleared first) and
+            // returns the number of pixels it evaluates.
+            uint64_t nextFrame( std::vector< TileDispatch >* pDispatches );
+
+            bool converged() const { return _pendingTiles == 0; }
+
+            void setPixelBudget( uint64_t pixelBudget ) { _pixelBudget = pixelBudget; }
+            uint64_t pixelBudget() const { return _pixelBudget; }
+
+            uint32_t tileCount() const { return (uint32_t)_levels.size(); }
+            uint32_t tileLevel( uint32_t tile ) const { return _levels[ tile ]; }
+
+        private:
+            // Pixels a dispatch evaluates.
+            static uint64_t cost( const TileDispatch& d );
+            TileDispatch tileRect( uint32_t tile ) const;
+
+            uint32_t _width;
+            uint32_t _height;
+            uint32_t _tileSize;
+            uint32_t _tilesX;
+            uint32_t _tilesY;
+            uint64_t _pixelBudget;
+            MandelbrotView _view;
+            bool _hasView = false;
+
+            // Levels completed per tile: 0 none, kLevelCount at full resolution.
+            std::vector< uint8_t > _levels;
+            // Tiles nearest the image centre first, so the middle of the image
+            // sharpens before the borders.
+            std::vector< uint32_t > _order;
+            uint32_t _pendingTiles = 0;
+    };
+}
@@ -0,0 +1,208 @@
+#include "RefitScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    inline float diagonal( const util::BoundingBox& box )
+    {
+        if ( util::isEmpty( box ) )
+        {
+            return 0.0f;
+        }
+        float dx = box.max[ 0 ] - box.min[ 0 ];
+        float dy = box.max[ 1 ] - box.min[ 1 ];
+        float dz = box.max[ 2 ] - box.min[ 2 ];
+        return sqrtf( dx * dx + dy * dy + dz * dz );
+    }
+
+    // Squared distance between the doubled box centres.
+    inline float centreStep2( const util::BoundingBox& a, const util::BoundingBox& b )
+    {
+        float d2 = 0.0f;
+        for ( int i = 0; i < 3; ++i )
+        {
+            float d = ( b.min[ i ] + b.max[ i ] ) - ( a.min[ i ] + a.max[ i ] );
+            d2 += d * d;
+        }
+        return d2;
+    }
+
+    inline float costRatio( const util::RefitStats& stats )
+    {
+        return stats.builtCost > 0.0f ? stats.cost / stats.builtCost : INFINITY;
+    }
+}
+
+util::RefitScheduler::RefitScheduler( const RefitPolicy& policy )
+: _policy( policy )
+, _refits( 0 )
+, _rebuilds( 0 )
+{
+}
+
+uint32_t util::RefitScheduler::addStructure( const BoundingBox* pBounds, size_t count, WorkStealingPool* pPool )
+{
+    _structures.emplace_back();
+    Structure& s = _structures.back();
+    s.bounds.assign( pBounds, pBounds + count );
+    s.stats = {};
+    s.action = AccelerationStructureUpdate::Rebuild;
+    s.updated = false;
+    s.moved = false;
+    s.resized = false;
+    rebuild( s, pPool );
+    return (uint32_t)_structures.size() - 1;
+}
+
+void util::RefitScheduler::update( uint32_t structure, const BoundingBox* pBounds, size_t count )
+{
+    assert( structure < _structures.size() );
+    Structure& s = _structures[ structure ];
+    if ( !s.updated )
+    {
+        s.stats.maxMotion = 0.0f;
+        s.stats.meanMotion = 0.0f;
+        s.updated = true;
+    }
+
+    if ( count != s.bounds.size() )
+    {
+        s.bounds.assign( pBounds, pBounds + count );
+        s.moved = true;
+        s.resized = true;
+        return;
+    }
+    if ( count == 0 || memcmp( s.bounds.data(), pBounds, count * sizeof( BoundingBox ) ) == 0 )
+    {
+        return;
+    }
+
+    float maxStep2 = 0.0f;
+    double sumStep = 0.0;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        float step2 = centreStep2( s.bounds[ i ], pBounds[ i ] );
+        maxStep2 = std::max( maxStep2, step2 );
+        sumStep += sqrtf( step2 );
+    }
+    memcpy( s.bounds.data(), pBounds, count * sizeof( BoundingBox ) );
+    s.moved = true;
+    if ( s.resized )
+    {
+        return;
+    }
+
+    s.bvh.refit( s.bounds.data() );
+    s.stats.cost = s.bvh.sahCost();
+
+    // Steps were measured between doubled centres.
+    float scale = diagonal( s.bvh.bounds() ) * 2.0f;
+    if ( scale > 0.0f )
+    {
+        s.stats.maxMotion = std::max( s.stats.maxMotion, sqrtf( maxStep2 ) / scale );
+        s.stats.meanMotion = (float)( sumStep / count ) / scale;
+    }
+}
+
+util::RefitPlan util::RefitScheduler::schedule( WorkStealingPool* pPool )
+{
+    // Structures that must be rebuilt are marked right away; those merely
+    // over the cost ratio become candidates for the budget.
+    _candidates.clear();
+    size_t movedCount = 0;
+    size_t wantedCount = 0;
+    size_t forcedCount = 0;
+    for ( uint32_t i = 0; i < _structures.size(); ++i )
+    {
+        Structure& s = _structures[ i ];
+        s.action = AccelerationStructureUpdate::Keep;
+        if ( !s.updated || !s.moved )
+        {
+            continue;
+        }
+
+        size_t count = s.bounds.size();
+        movedCount += count;
+        s.action = AccelerationStructureUpdate::Refit;
+        if ( s.resized || s.stats.maxMotion > _policy.teleportFraction
+             || ( _policy.maxRefitFrames && s.stats.refitFrames >= _policy.maxRefitFrames ) )
+        {
+            s.action = AccelerationStructureUpdate::Rebuild;
+            wantedCount += count;
+            forcedCount += count;
+        }
+        else if ( costRatio( s.stats ) > _policy.rebuildCostRatio )
+        {
+            _candidates.push_back( i );
+            wantedCount += count;
+        }
+    }
+
+    if ( movedCount && (float)wantedCount >= _policy.fullRebuildFraction * (float)movedCount )
+    {
+        for ( Structure& s : _structures )
+        {
+            if ( s.action == AccelerationStructureUpdate::Refit )
+            {
+                s.action = AccelerationStructureUpdate::Rebuild;
+            }
+        }
+    }
+    else
+    {
+        // Worst first, within the budget; at least one a frame so a
+        // structure larger than the budget still gets rebuilt eventually.
+        std::stable_sort( _candidates.begin(), _candidates.end(), [this]( uint32_t a, uint32_t b ){
+            return costRatio( _structures[ a ].stats ) > costRatio( _structures[ b ].stats );
+        } );
+        size_t spent = forcedCount;
+        for ( uint32_t i : _candidates )
+        {
+            Structure& s = _structures[ i ];
+            if ( spent == 0 || spent + s.bounds.size() <= _policy.rebuildBudget )
+            {
+                s.action = AccelerationStructureUpdate::Rebuild;
+                spent += s.bounds.size();
+            }
+        }
+    }
+
+    size_t refits = 0;
+    size_t rebuilds = 0;
+    for ( Structure& s : _structures )
+    {
+        if ( s.action == AccelerationStructureUpdate::Rebuild )
+        {
+            rebuild( s, pPool );
+            ++rebuilds;
+        }
+        else if ( s.action == AccelerationStructureUpdate::Refit )
+        {
+            ++s.stats.refitFrames;
+            ++refits;
+        }
+        s.updated = false;
+        s.moved = false;
+        s.resized = false;
+    }
+    _refits += refits;
+    _rebuilds += rebuilds;
+
+    if ( rebuilds == 0 )
+    {
+        return refits ? RefitPlan::Refit : RefitPlan::Idle;
+    }
+    return refits ? RefitPlan::PartialRebuild : RefitPlan::FullRebuild;
+}
+
+void util::RefitScheduler::rebuild( Structure& s, WorkStealingPool* pPool )
+{
+    s.bvh.build( s.bounds.data(), s.bounds.size(), pPool );
+    s.stats.builtCost = s.bvh.sahCost();
+    s.stats.cost = s.stats.builtCost;
+    s.stats.refitFrames = 0;
+}
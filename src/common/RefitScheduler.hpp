@@ -0,0 +1,120 @@
+#pragma once
+
+#include "SceneBvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    class WorkStealingPool;
+
+    // How to bring one acceleration structure up to date this frame.
+    enum class AccelerationStructureUpdate
+    {
+        Keep,     // nothing moved
+        Refit,    // refitAccelerationStructure(); needs AccelerationStructureUsageRefit
+        Rebuild,  // buildAccelerationStructure()
+    };
+
+    // Summary of one schedule() call over all structures that were updated.
+    enum class RefitPlan
+    {
+        Idle,            // nothing moved
+        Refit,           // every moved structure is refit
+        PartialRebuild,  // some are rebuilt, the others refit
+        FullRebuild,     // every moved structure is rebuilt
+    };
+
+    struct RefitPolicy
+    {
+        // Rebuild once the refitted tree's SAH cost exceeds the cost it had
+        // right after its last build by this factor.
+        float rebuildCostRatio = 1.3f;
+
+        // Rebuild when a primitive's centre moves further than this fraction
+        // of the structure's diagonal in one frame; refitting a teleported
+        // primitive stretches every node above it.
+        float teleportFraction = 0.25f;
+
+        // Most primitives rebuilt in a partial rebuild. Structures over the
+        // cost ratio but outside the budget are refit and retried next
+        // frame, worst first.
+        size_t rebuildBudget = 1 << 16;
+
+        // Rebuild every moved structure once those asking for a rebuild hold
+        // this share of the moved primitives.
+        float fullRebuildFraction = 0.5f;
+
+        // Rebuild after this many refits in a row regardless of cost; 0
+        // never forces one.
+        uint32_t maxRefitFrames = 0;
+    };
+
+    struct RefitStats
+    {
+        float builtCost;       // Bvh::sahCost() after the last rebuild
+        float cost;            // Bvh::sahCost() of the refitted tree
+        float maxMotion;       // largest centre step this frame, in structure diagonals
+        float meanMotion;      // mean centre step this frame, in structure diagonals
+        uint32_t refitFrames;  // refits since the last rebuild
+    };
+
+    // Decides each frame whether animated acceleration structures are refit
+    // or rebuilt. Every structure keeps a CPU Bvh over the same primitive
+    // bounds as the GPU one; update() refits it, so its SAH cost tracks how
+    // much a GPU refit would have degraded, and schedule() rebuilds it
+    // whenever the GPU structure is rebuilt. Structures are typically the
+    // instance structure over instance bounds (SceneBvh) and one primitive
+    // structure per deforming mesh.
+    class RefitScheduler
+    {
+        public:
+            explicit RefitScheduler( const RefitPolicy& policy = RefitPolicy() );
+
+            // Builds the CPU tree for a structure the caller just built on
+            // the GPU.
+            uint32_t addStructure( const BoundingBox* pBounds, size_t count, WorkStealingPool* pPool = nullptr );
+
+            // This frame's primitive bounds. A different count than before
+            // forces a rebuild, since refits keep the primitive count.
+            void update( uint32_t structure, const BoundingBox* pBounds, size_t count );
+
+            // Picks an action for every structure and rebuilds the CPU trees
+            // of those to rebuild. Structures not updated since the last call
+            // are kept.
+            RefitPlan schedule( WorkStealingPool* pPool = nullptr );
+
+            AccelerationStructureUpdate action( uint32_t structure ) const { return _structures[ structure ].action; }
+            const RefitStats& stats( uint32_t structure ) const { return _structures[ structure ].stats; }
+            const Bvh& bvh( uint32_t structure ) const { return _structures[ structure ].bvh; }
+            size_t structureCount() const { return _structures.size(); }
+
+            const RefitPolicy& policy() const { return _policy; }
+            void setPolicy( const RefitPolicy& policy ) { _policy = policy; }
+
+            uint64_t refits() const { return _refits; }
+            uint64_t rebuilds() const { return _rebuilds; }
+
+        private:
+            struct Structure
+            {
+                Bvh bvh;
+                std::vector< BoundingBox > bounds;
+                RefitStats stats;
+                AccelerationStructureUpdate action;
+                bool updated;
+                bool moved;
+                bool resized;
+            };
+
+            void rebuild( Structure& s, WorkStealingPool* pPool );
+
+            RefitPolicy _policy;
+            std::vector< Structure > _structures;
+            std::vector< uint32_t > _candidates;
+            uint64_t _refits;
+            uint64_t _rebuilds;
+    };
+}
@@ -0,0 +1,114 @@
+#include "RenderPassDescriptorPool.hpp"
+
+#include <cassert>
+
+util::AttachmentConfig util::makeColorAttachment( MTL::PixelFormat format, MTL::LoadAction load, MTL::StoreAction store, MTL::ClearColor clear )
+{
+    AttachmentConfig a;
+    a.pixelFormat = (uint32_t)format;
+    a.loadAction = (uint8_t)load;
+    a.storeAction = (uint8_t)store;
+    a.clearValue[0] = clear.red;
+    a.clearValue[1] = clear.green;
+    a.clearValue[2] = clear.blue;
+    a.clearValue[3] = clear.alpha;
+    return a;
+}
+
+util::AttachmentConfig util::makeDepthAttachment( MTL::PixelFormat format, MTL::LoadAction load, MTL::StoreAction store, double clearDepth )
+{
+    AttachmentConfig a;
+    a.pixelFormat = (uint32_t)format;
+    a.loadAction = (uint8_t)load;
+    a.storeAction = (uint8_t)store;
+    a.clearValue[0] = clearDepth;
+    return a;
+}
+
+util::RenderPassDescriptorPool::~RenderPassDescriptorPool()
+{
+    clear();
+}
+
+MTL::RenderPassDescriptor* util::RenderPassDescriptorPool::newDescriptor( const RenderPassSignature& signature )
+{
+    MTL::RenderPassDescriptor* pRpd = MTL::RenderPassDescriptor::alloc()->init();
+
+    for ( uint32_t i = 0; i < signature.colorCount; ++i )
+    {
+        const AttachmentConfig& a = signature.color[ i ];
+        MTL::RenderPassColorAttachmentDescriptor* pColor = pRpd->colorAttachments()->object( i );
+        pColor->setLoadAction( (MTL::LoadAction)a.loadAction );
+        pColor->setStoreAction( (MTL::StoreAction)a.storeAction );
+        pColor->setClearColor( MTL::ClearColor::Make( a.clearValue[0], a.clearValue[1], a.clearValue[2], a.clearValue[3] ) );
+    }
+
+    if ( signature.depth.pixelFormat != MTL::PixelFormatInvalid )
+    {
+        MTL::RenderPassDepthAttachmentDescriptor* pDepth = pRpd->depthAttachment();
+        pDepth->setLoadAction( (MTL::LoadAction)signature.depth.loadAction );
+        pDepth->setStoreAction( (MTL::StoreAction)signature.depth.storeAction );
+        pDepth->setClearDepth( signature.depth.clearValue[0] );
+    }
+
+    if ( signature.stencil.pixelFormat != MTL::PixelFormatInvalid )
+    {
+        MTL::RenderPassStencilAttachmentDescriptor* pStencil = pRpd->stencilAttachment();
+        pStencil->setLoadAction( (MTL::LoadAction)signature.stencil.loadAction );
+        pStencil->setStoreAction( (MTL::StoreAction)signature.stencil.storeAction );
+        pStencil->setClearStencil( (uint32_t)signature.stencil.clearValue[0] );
+    }
+
+    pRpd->setRenderTargetWidth( signature.width );
+    pRpd->setRenderTargetHeight( signature.height );
+    pRpd->setDefaultRasterSampleCount( signature.sampleCount );
+
+    return pRpd;
+}
+
+MTL::RenderPassDescriptor* util::RenderPassDescriptorPool::descriptor( const RenderPassSignature& signature,
+                                                                       MTL::Texture* const* ppColorTextures,
+                                                                       MTL::Texture* pDepthTexture,
+                                                                       MTL::Texture* pStencilTexture )
+{
+    assert( signature.colorCount <= RenderPassSignature::kMaxColorAttachments );
+
+    MTL::RenderPassDescriptor* pRpd;
+    auto it = _descriptors.find( signature );
+    if ( it != _descriptors.end() )
+    {
+        pRpd = it->second;
+        ++_hits;
+    }
+    else
+    {
+        pRpd = newDescriptor( signature );
+        _descriptors.emplace( signature, pRpd );
+        ++_misses;
+    }
+
+    for ( uint32_t i = 0; i < signature.colorCount; ++i )
+    {
+        assert( ppColorTextures[ i ]->pixelFormat() == (MTL::PixelFormat)signature.color[ i ].pixelFormat );
+        pRpd->colorAttachments()->object( i )->setTexture( ppColorTextures[ i ] );
+    }
+    if ( signature.depth.pixelFormat != MTL::PixelFormatInvalid )
+    {
+        pRpd->depthAttachment()->setTexture( pDepthTexture );
+    }
+    if ( signature.stencil.pixelFormat != MTL::PixelFormatInvalid )
+    {
+        pRpd->stencilAttachment()->setTexture( pStencilTexture );
+    }
+
+    return pRpd;
+}
+
+void util::RenderPassDescriptorPool::clear()
+{
+    for ( auto& entry : _descriptors )
+    {
+        entry.second->release();
+    }
+    _descriptors.clear();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include <unordered_map>
+
+#include "RenderPassSignature.hpp"
+
+namespace util
+{
+    AttachmentConfig makeColorAttachment( MTL::PixelFormat format, MTL::LoadAction load, MTL::StoreAction store,
+                                          MTL::ClearColor clear = MTL::ClearColor::Make( 0.0, 0.0, 0.0, 1.0 ) );
+    AttachmentConfig makeDepthAttachment( MTL::PixelFormat format, MTL::LoadAction load, MTL::StoreAction store,
+                                          double clearDepth = 1.0 );
+
+    // Reuses MTL::RenderPassDescriptor objects for offscreen passes. The
+    // descriptor for a signature is built once; later requests only swap the
+    // attachment textures.
+    class RenderPassDescriptorPool
+    {
+        public:
+            ~RenderPassDescriptorPool();
+
+            // ppColorTextures holds signature.colorCount entries. The returned
+            // descriptor is owned by the pool and stays valid until clear().
+            MTL::RenderPassDescriptor* descriptor( const RenderPassSignature& signature,
+                                                   MTL::Texture* const* ppColorTextures,
+                                                   MTL::Texture* pDepthTexture = nullptr,
+                                                   MTL::Texture* pStencilTexture = nullptr );
+
+            void clear();
+
+            size_t size() const { return _descriptors.size(); }
+            uint64_t hits() const { return _hits; }
+            uint64_t misses() const { return _misses; }
+
+        private:
+            static MTL::RenderPassDescriptor* newDescriptor( const RenderPassSignature& signature );
+
+            std::unordered_map< RenderPassSignature, MTL::RenderPassDescriptor*, RenderPassSignatureHash > _descriptors;
+            uint64_t _hits = 0;
+            uint64_t _misses = 0;
+    };
+}
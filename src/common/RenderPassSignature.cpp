@@ -0,0 +1,83 @@
+#include "RenderPassSignature.hpp"
+
+#include "Hash.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Fold -0.0 into +0.0 and every NaN into one, so that clear values
+    // hash alike exactly when sameClearValue() holds.
+    double canonicalClearValue( double v )
+    {
+        return std::isnan( v ) ? std::numeric_limits< double >::quiet_NaN() : v + 0.0;
+    }
+
+    // NaN never compares equal, which would give a NaN-cleared signature a
+    // new pool entry on every lookup.
+    bool sameClearValue( double a, double b )
+    {
+        return a == b || ( std::isnan( a ) && std::isnan( b ) );
+    }
+
+    uint64_t hashAttachment( const util::AttachmentConfig& a, uint64_t h )
+    {
+        h = util::hashValue( a.pixelFormat, h );
+        h = util::hashValue( a.loadAction, h );
+        h = util::hashValue( a.storeAction, h );
+        for ( double v : a.clearValue )
+        {
+            h = util::hashValue( canonicalClearValue( v ), h );
+        }
+        return h;
+    }
+}
+
+bool util::AttachmentConfig::operator==( const AttachmentConfig& other ) const
+{
+    return pixelFormat == other.pixelFormat
+        && loadAction == other.loadAction
+        && storeAction == other.storeAction
+        && sameClearValue( clearValue[0], other.clearValue[0] )
+        && sameClearValue( clearValue[1], other.clearValue[1] )
+        && sameClearValue( clearValue[2], other.clearValue[2] )
+        && sameClearValue( clearValue[3], other.clearValue[3] );
+}
+
+uint64_t util::RenderPassSignature::hash() const
+{
+    // Hash member by member; struct padding is never read.
+    uint64_t h = kFnvOffset;
+    h = hashValue( colorCount, h );
+    for ( uint32_t i = 0; i < colorCount && i < kMaxColorAttachments; ++i )
+    {
+        h = hashAttachment( color[ i ], h );
+    }
+    h = hashAttachment( depth, h );
+    h = hashAttachment( stencil, h );
+    h = hashValue( sampleCount, h );
+    h = hashValue( width, h );
+    h = hashValue( height, h );
+    return h;
+}
+
+bool util::RenderPassSignature::operator==( const RenderPassSignature& other ) const
+{
+    if ( colorCount != other.colorCount || sampleCount != other.sampleCount
+      || width != other.width || height != other.height
+      || depth != other.depth || stencil != other.stencil )
+    {
+        return false;
+    }
+
+    // Attachments past colorCount are ignored, as in hash().
+    for ( uint32_t i = 0; i < colorCount && i < kMaxColorAttachments; ++i )
+    {
+        if ( color[ i ] != other.color[ i ] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+    // Everything about a render pass attachment except the texture itself.
+    // Pixel format and load/store actions hold the raw MTL enum values; depth
+    // and stencil attachments only use clearValue[0].
+    struct AttachmentConfig
+    {
+        uint32_t pixelFormat = 0;
+        uint8_t loadAction = 0;
+        uint8_t storeAction = 0;
+        double clearValue[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+        bool operator==( const AttachmentConfig& other ) const;
+        bool operator!=( const AttachmentConfig& other ) const { return !( *this == other ); }
+    };
+
+    // Key of the render pass descriptor pool. Two passes with equal
+    // signatures can share one MTL::RenderPassDescriptor and differ only in
+    // the textures bound to it.
+    struct RenderPassSignature
+    {
+        static constexpr uint32_t kMaxColorAttachments = 8;
+
+        AttachmentConfig color[ kMaxColorAttachments ];
+        uint32_t colorCount = 0;
+        AttachmentConfig depth;
+        AttachmentConfig stencil;
+        uint32_t sampleCount = 1;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        uint64_t hash() const;
+
+        bool operator==( const RenderPassSignature& other ) const;
+        bool operator!=( const RenderPassSignature& other ) const { return !( *this == other ); }
+    };
+
+    struct RenderPassSignatureHash
+    {
+        size_t operator()( const RenderPassSignature& s ) const { return (size_t)s.hash(); }
+    };
+}
@@ -0,0 +1,29 @@
+#include "ResidencySet.hpp"
+
+void util::ResidencySet::add( MTL::Resource* pResource, MTL::ResourceUsage usage )
+{
+    // heap() is looked up once here rather than on every bind.
+    _tracker.add( pResource, pResource->heap(), (uint32_t)usage );
+}
+
+void util::ResidencySet::bind( MTL::RenderCommandEncoder* pEnc )
+{
+    _tracker.resolve( pEnc, MTL::ResourceUsageRead | MTL::ResourceUsageSample,
+        [pEnc]( void* pHeap ){
+            pEnc->useHeap( static_cast< MTL::Heap* >( pHeap ) );
+        },
+        [pEnc]( void** ppResources, size_t count, uint32_t usage ){
+            pEnc->useResources( reinterpret_cast< MTL::Resource** >( ppResources ), count, (MTL::ResourceUsage)usage );
+        } );
+}
+
+void util::ResidencySet::bind( MTL::ComputeCommandEncoder* pEnc )
+{
+    _tracker.resolve( pEnc, MTL::ResourceUsageRead | MTL::ResourceUsageSample,
+        [pEnc]( void* pHeap ){
+            pEnc->useHeap( static_cast< MTL::Heap* >( pHeap ) );
+        },
+        [pEnc]( void** ppResources, size_t count, uint32_t usage ){
+            pEnc->useResources( reinterpret_cast< MTL::Resource** >( ppResources ), count, (MTL::ResourceUsage)usage );
+        } );
+}
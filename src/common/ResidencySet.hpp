@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "ResidencyTracker.hpp"
+
+namespace util
+{
+    // Remembers every resource written into argument buffers so renderers do
+    // not have to call useResource() by hand for each one. bind() emits a
+    // single useHeap() when all resources are read-only and share a heap,
+    // otherwise one useResources() per usage; repeated binds on the same
+    // encoder only emit resources that encoder has not seen yet.
+    class ResidencySet
+    {
+        public:
+            void add( MTL::Resource* pResource, MTL::ResourceUsage usage );
+            void clear() { _tracker.clear(); }
+
+            void bind( MTL::RenderCommandEncoder* pEnc );
+            void bind( MTL::ComputeCommandEncoder* pEnc );
+
+            // Call once the encoder passed to bind() has ended encoding.
+            void encoderEnded() { _tracker.resetEncoder(); }
+
+            const ResidencyTracker& tracker() const { return _tracker; }
+
+        private:
+            ResidencyTracker _tracker;
+    };
+}
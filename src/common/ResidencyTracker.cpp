@@ -0,0 +1,52 @@
+#include "ResidencyTracker.hpp"
+
+util::ResidencyTracker::ResidencyTracker()
+: _pEncoder( nullptr )
+, _pCommonHeap( nullptr )
+, _heapEmitted( false )
+, _mixedHeaps( false )
+, _callsEmitted( 0 )
+, _callsSaved( 0 )
+{
+}
+
+void util::ResidencyTracker::add( void* pResource, void* pHeap, uint32_t usage )
+{
+    auto it = _lookup.find( pResource );
+    if ( it != _lookup.end() )
+    {
+        _entries[ it->second ].usage |= usage;
+        return;
+    }
+
+    if ( _entries.empty() )
+    {
+        _pCommonHeap = pHeap;
+    }
+    else if ( pHeap != _pCommonHeap )
+    {
+        _mixedHeaps = true;
+    }
+
+    _lookup.emplace( pResource, _entries.size() );
+    _entries.push_back( { pResource, pHeap, usage, 0 } );
+}
+
+void util::ResidencyTracker::clear()
+{
+    _entries.clear();
+    _lookup.clear();
+    _pCommonHeap = nullptr;
+    _mixedHeaps = false;
+    resetEncoder();
+}
+
+void util::ResidencyTracker::resetEncoder()
+{
+    _pEncoder = nullptr;
+    _heapEmitted = false;
+    for ( Entry& e : _entries )
+    {
+        e.emittedUsage = 0;
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace util
+{
+    // Device independent bookkeeping behind ResidencySet. Resources and heaps
+    // are opaque pointers and usage is a bit mask, so the batching and
+    // per-encoder dedupe logic can run without Metal.
+    class ResidencyTracker
+    {
+        public:
+            ResidencyTracker();
+
+            // Records a resource referenced indirectly through an argument
+            // buffer. Adding it again merges the usage bits.
+            void add( void* pResource, void* pHeap, uint32_t usage );
+            void clear();
+
+            size_t size() const { return _entries.size(); }
+
+            // Forgets what was already made resident; call when the encoder
+            // the set was bound to ends encoding.
+            void resetEncoder();
+
+            // Emits whatever pEncoder has not seen yet. When every resource
+            // lives in one heap and only needs reading (readUsage), a single
+            // useHeap(pHeap) call covers them; otherwise resources are grouped
+            // into one useResources(ppResources, count, usage) call per usage.
+            template< typename UseHeapFn, typename UseResourcesFn >
+            void resolve( const void* pEncoder, uint32_t readUsage, UseHeapFn&& useHeap, UseResourcesFn&& useResources );
+
+            uint64_t callsEmitted() const { return _callsEmitted; }
+            uint64_t callsSaved() const { return _callsSaved; }
+
+        private:
+            struct Entry
+            {
+                void* pResource;
+                void* pHeap;
+                uint32_t usage;
+                uint32_t emittedUsage;
+            };
+
+            std::vector< Entry > _entries;
+            std::unordered_map< void*, size_t > _lookup;
+            std::vector< void* > _scratch;
+            const void* _pEncoder;
+            void* _pCommonHeap;
+            bool _heapEmitted;
+            bool _mixedHeaps;
+            uint64_t _callsEmitted;
+            uint64_t _callsSaved;
+    };
+
+    template< typename UseHeapFn, typename UseResourcesFn >
+    void ResidencyTracker::resolve( const void* pEncoder, uint32_t readUsage, UseHeapFn&& useHeap, UseResourcesFn&& useResources )
+    {
+        if ( pEncoder != _pEncoder )
+        {
+            resetEncoder();
+            _pEncoder = pEncoder;
+        }
+
+        bool readOnly = true;
+        size_t pending = 0;
+        for ( const Entry& e : _entries )
+        {
+            readOnly = readOnly && ( e.usage & ~readUsage ) == 0;
+            pending += ( e.usage & ~e.emittedUsage ) ? 1 : 0;
+        }
+
+        if ( pending == 0 )
+        {
+            return;
+        }
+
+        if ( _pCommonHeap && !_mixedHeaps && readOnly )
+        {
+            if ( !_heapEmitted )
+            {
+                useHeap( _pCommonHeap );
+                _heapEmitted = true;
+                _callsEmitted += 1;
+                _callsSaved += pending - 1;
+            }
+            for ( Entry& e : _entries )
+            {
+                e.emittedUsage = e.usage;
+            }
+            return;
+        }
+
+        // One call per distinct usage mask, in first-seen order.
+        size_t calls = 0;
+        for ( size_t i = 0; i < _entries.size(); ++i )
+        {
+            uint32_t usage = _entries[ i ].usage;
+            if ( !( usage & ~_entries[ i ].emittedUsage ) )
+            {
+                continue;
+            }
+
+            _scratch.clear();
+            for ( size_t j = i; j < _entries.size(); ++j )
+            {
+                Entry& e = _entries[ j ];
+                if ( e.usage == usage && ( e.usage & ~e.emittedUsage ) )
+                {
+                    _scratch.push_back( e.pResource );
+                    e.emittedUsage = e.usage;
+                }
+            }
+
+            useResources( _scratch.data(), _scratch.size(), usage );
+            ++calls;
+        }
+
+        _callsEmitted += calls;
+        _callsSaved += pending - calls;
+    }
+}
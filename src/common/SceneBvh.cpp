@@ -0,0 +1,684 @@
+#include "SceneBvh.hpp"
+
+#include "Math.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+// Boxes and rays go through four-lane vectors ( x, y, z, unused ) with the
+// GCC/Clang vector extension, as in InstanceTransforms.cpp.
+
+namespace
+{
+    typedef float f32x4 __attribute__(( vector_size( 16 ) ));
+    typedef int32_t i32x4 __attribute__(( vector_size( 16 ) ));
+
+    inline f32x4 splat( float v ) { return f32x4{ v, v, v, v }; }
+
+    inline f32x4 load3( const float* p )
+    {
+        f32x4 v = {};
+        memcpy( &v, p, 3 * sizeof( float ) );
+        return v;
+    }
+
+    inline void store3( f32x4 v, float* p ) { memcpy( p, &v, 3 * sizeof( float ) ); }
+
+    inline f32x4 select( i32x4 mask, f32x4 a, f32x4 b )
+    {
+        return (f32x4)( ( (i32x4)a & mask ) | ( (i32x4)b & ~mask ) );
+    }
+
+    inline f32x4 vmin( f32x4 a, f32x4 b ) { return select( a < b, a, b ); }
+    inline f32x4 vmax( f32x4 a, f32x4 b ) { return select( a > b, a, b ); }
+
+    struct Box4
+    {
+        f32x4 min;
+        f32x4 max;
+    };
+
+    inline Box4 emptyBox4() { return { splat( INFINITY ), splat( -INFINITY ) }; }
+    inline Box4 load( const util::BoundingBox& b ) { return { load3( b.min ), load3( b.max ) }; }
+
+    inline util::BoundingBox store( const Box4& b )
+    {
+        util::BoundingBox r;
+        store3( b.min, r.min );
+        store3( b.max, r.max );
+        return r;
+    }
+
+    inline void grow( Box4* pBox, const Box4& b )
+    {
+        pBox->min = vmin( pBox->min, b.min );
+        pBox->max = vmax( pBox->max, b.max );
+    }
+
+    inline void grow( Box4* pBox, f32x4 p )
+    {
+        pBox->min = vmin( pBox->min, p );
+        pBox->max = vmax( pBox->max, p );
+    }
+
+    // Half the surface area; SAH only compares ratios. Empty boxes give 0.
+    inline float halfArea( const Box4& b )
+    {
+        f32x4 d = vmax( b.max - b.min, splat( 0.0f ) );
+        return d[ 0 ] * d[ 1 ] + d[ 1 ] * d[ 2 ] + d[ 2 ] * d[ 0 ];
+    }
+
+    static constexpr int kBinCount = 16;
+    static constexpr uint32_t kMaxLeafSize = 4;
+
+    // Past this depth ranges are halved by count, which bounds the depth of
+    // any tree (and so the traversal stack) by kMaxSahDepth + 32.
+    static constexpr int kMaxSahDepth = 32;
+    static constexpr int kStackSize = kMaxSahDepth + 32;
+
+    // Ranges up to this many primitives are built as one task.
+    static constexpr uint32_t kTaskSize = 2048;
+
+    struct Builder
+    {
+        std::vector< Box4 > boxes;
+        std::vector< f32x4 > centroids;
+        uint32_t* pIndices;
+    };
+
+    // Computes the bounds of [begin, end) and partitions it for the cheapest
+    // binned SAH split. Returns the split point, or begin for a leaf.
+    uint32_t split( const Builder& b, uint32_t begin, uint32_t end, int depth, Box4* pBounds )
+    {
+        Box4 bounds = emptyBox4();
+        Box4 centroidBounds = emptyBox4();
+        for ( uint32_t i = begin; i < end; ++i )
+        {
+            uint32_t index = b.pIndices[ i ];
+            grow( &bounds, b.boxes[ index ] );
+            grow( &centroidBounds, b.centroids[ index ] );
+        }
+        *pBounds = bounds;
+
+        uint32_t count = end - begin;
+        if ( count <= 1 )
+        {
+            return begin;
+        }
+
+        f32x4 extent = centroidBounds.max - centroidBounds.min;
+        f32x4 scale = select( extent > splat( 0.0f ), splat( (float)kBinCount ) / extent, splat( 0.0f ) );
+        int bestAxis = -1;
+        int bestBin = 0;
+        float bestCost = INFINITY;
+
+        if ( depth < kMaxSahDepth )
+        {
+            struct Bin
+            {
+                Box4 box;
+                uint32_t count;
+            };
+            Bin bins[ 3 ][ kBinCount ];
+            for ( int axis = 0; axis < 3; ++axis )
+            {
+                for ( Bin& bin : bins[ axis ] )
+                {
+                    bin = { emptyBox4(), 0 };
+                }
+            }
+
+            const i32x4 lastBin = { kBinCount - 1, kBinCount - 1, kBinCount - 1, kBinCount - 1 };
+            for ( uint32_t i = begin; i < end; ++i )
+            {
+                uint32_t index = b.pIndices[ i ];
+                i32x4 bin = __builtin_convertvector( ( b.centroids[ index ] - centroidBounds.min ) * scale, i32x4 );
+                i32x4 over = bin > lastBin;
+                bin = ( bin & ~over ) | ( lastBin & over );
+                for ( int axis = 0; axis < 3; ++axis )
+                {
+                    Bin& target = bins[ axis ][ bin[ axis ] ];
+                    grow( &target.box, b.boxes[ index ] );
+                    ++target.count;
+                }
+            }
+
+            for ( int axis = 0; axis < 3; ++axis )
+            {
+                if ( !( extent[ axis ] > 0.0f ) )
+                {
+                    continue;
+                }
+
+                float rightArea[ kBinCount ];
+                uint32_t rightCount[ kBinCount ];
+                Box4 box = emptyBox4();
+                uint32_t n = 0;
+                for ( int k = kBinCount - 1; k > 0; --k )
+                {
+                    grow( &box, bins[ axis ][ k ].box );
+                    n += bins[ axis ][ k ].count;
+                    rightArea[ k ] = halfArea( box );
+                    rightCount[ k ] = n;
+                }
+
+                box = emptyBox4();
+                n = 0;
+                for ( int k = 1; k < kBinCount; ++k )
+                {
+                    grow( &box, bins[ axis ][ k - 1 ].box );
+                    n += bins[ axis ][ k - 1 ].count;
+                    if ( n == 0 || rightCount[ k ] == 0 )
+                    {
+                        continue;
+                    }
+                    float cost = halfArea( box ) * n + rightArea[ k ] * rightCount[ k ];
+                    if ( cost < bestCost )
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = k;
+                    }
+                }
+            }
+        }
+
+        if ( bestAxis < 0 )
+        {
+            // Coincident centroids or too deep: halve by count so leaves stay small.
+            if ( count <= kMaxLeafSize )
+            {
+                return begin;
+            }
+            uint32_t mid = begin + count / 2;
+            int axis = extent[ 0 ] >= extent[ 1 ] ? ( extent[ 0 ] >= extent[ 2 ] ? 0 : 2 ) : ( extent[ 1 ] >= extent[ 2 ] ? 1 : 2 );
+            std::nth_element( b.pIndices + begin, b.pIndices + mid, b.pIndices + end, [&]( uint32_t l, uint32_t r ){
+                return b.centroids[ l ][ axis ] < b.centroids[ r ][ axis ];
+            } );
+            return mid;
+        }
+
+        // In units of one primitive test, with a traversal step costing one.
+        float parentArea = halfArea( bounds );
+        float splitCost = 1.0f + ( parentArea > 0.0f ? bestCost / parentArea : 0.0f );
+        if ( count <= kMaxLeafSize && (float)count <= splitCost )
+        {
+            return begin;
+        }
+
+        // Same arithmetic as the binning loop, so every primitive lands on
+        // the side its bin was counted on.
+        float origin = centroidBounds.min[ bestAxis ];
+        float axisScale = scale[ bestAxis ];
+        uint32_t* pMid = std::partition( b.pIndices + begin, b.pIndices + end, [&]( uint32_t index ){
+            int bin = (int)( ( b.centroids[ index ][ bestAxis ] - origin ) * axisScale );
+            return std::min( bin, kBinCount - 1 ) < bestBin;
+        } );
+        return (uint32_t)( pMid - b.pIndices );
+    }
+
+    // Builds the subtree over [begin, end) into nodes[ node ], appending its
+    // descendants.
+    void buildSubtree( const Builder& b, std::vector< util::BvhNode >& nodes, uint32_t node, uint32_t begin, uint32_t end, int depth )
+    {
+        Box4 bounds;
+        uint32_t mid = split( b, begin, end, depth, &bounds );
+        nodes[ node ].bounds = store( bounds );
+        if ( mid == begin )
+        {
+            nodes[ node ].index = begin;
+            nodes[ node ].count = end - begin;
+            return;
+        }
+
+        uint32_t left = (uint32_t)nodes.size();
+        nodes.resize( left + 2 );
+        nodes[ node ].index = left;
+        nodes[ node ].count = 0;
+        buildSubtree( b, nodes, left, begin, mid, depth + 1 );
+        buildSubtree( b, nodes, left + 1, mid, end, depth + 1 );
+    }
+
+    struct RayLanes
+    {
+        f32x4 origin;
+        f32x4 invDirection;
+        float minDistance;
+    };
+
+    RayLanes prepare( const util::Ray& ray )
+    {
+        // Keep zero components from producing 0 * inf = NaN in the slab test.
+        const f32x4 tiny = splat( 1e-30f );
+        f32x4 d = load3( ray.direction );
+        d = select( ( d >= splat( 0.0f ) ) & ( d < tiny ), tiny, d );
+        d = select( ( d < splat( 0.0f ) ) & ( d > -tiny ), -tiny, d );
+        return { load3( ray.origin ), splat( 1.0f ) / d, ray.minDistance };
+    }
+
+    // Distance at which the ray enters box, or INFINITY if it misses it
+    // before tMax.
+    inline float enter( const util::BoundingBox& box, const RayLanes& r, float tMax )
+    {
+        f32x4 t0 = ( load3( box.min ) - r.origin ) * r.invDirection;
+        f32x4 t1 = ( load3( box.max ) - r.origin ) * r.invDirection;
+        f32x4 lo = vmin( t0, t1 );
+        f32x4 hi = vmax( t0, t1 );
+        float entry = std::max( std::max( lo[ 0 ], lo[ 1 ] ), std::max( lo[ 2 ], r.minDistance ) );
+        float exit = std::min( std::min( hi[ 0 ], hi[ 1 ] ), std::min( hi[ 2 ], tMax ) );
+        return entry <= exit ? entry : INFINITY;
+    }
+
+    // Calls hitLeaf( first, count ) for the leaves the ray reaches, nearest
+    // child first, skipping subtrees that start beyond *pTMax. hitLeaf may
+    // lower *pTMax.
+    template< typename LeafFn >
+    void traverse( const std::vector< util::BvhNode >& nodes, const RayLanes& r, const float* pTMax, LeafFn&& hitLeaf )
+    {
+        if ( nodes.empty() || enter( nodes[ 0 ].bounds, r, *pTMax ) == INFINITY )
+        {
+            return;
+        }
+
+        struct Entry
+        {
+            uint32_t node;
+            float distance;
+        };
+        Entry stack[ kStackSize ];
+        int top = 0;
+        uint32_t node = 0;
+        for ( ;; )
+        {
+            const util::BvhNode& n = nodes[ node ];
+            if ( n.count == 0 )
+            {
+                uint32_t nearNode = n.index;
+                uint32_t farNode = n.index + 1;
+                float nearDistance = enter( nodes[ nearNode ].bounds, r, *pTMax );
+                float farDistance = enter( nodes[ farNode ].bounds, r, *pTMax );
+                if ( farDistance < nearDistance )
+                {
+                    std::swap( nearNode, farNode );
+                    std::swap( nearDistance, farDistance );
+                }
+                if ( nearDistance != INFINITY )
+                {
+                    if ( farDistance != INFINITY )
+                    {
+                        stack[ top++ ] = { farNode, farDistance };
+                    }
+                    node = nearNode;
+                    continue;
+                }
+            }
+            else
+            {
+                hitLeaf( n.index, n.count );
+            }
+
+            do
+            {
+                if ( top == 0 )
+                {
+                    return;
+                }
+                --top;
+            }
+            while ( stack[ top ].distance > *pTMax );
+            node = stack[ top ].node;
+        }
+    }
+
+    // Moller-Trumbore; returns the distance, or INFINITY on a miss.
+    inline float intersectTriangle( const util::Ray& ray, const float* p0, const float* p1, const float* p2, float* pU, float* pV )
+    {
+        using util::math::float3;
+        const float3 a = { p0[ 0 ], p0[ 1 ], p0[ 2 ] };
+        const float3 e1 = float3{ p1[ 0 ], p1[ 1 ], p1[ 2 ] } - a;
+        const float3 e2 = float3{ p2[ 0 ], p2[ 1 ], p2[ 2 ] } - a;
+        const float3 d = { ray.direction[ 0 ], ray.direction[ 1 ], ray.direction[ 2 ] };
+
+        float3 p = util::math::cross( d, e2 );
+        float det = util::math::dot( e1, p );
+        if ( det == 0.0f )
+        {
+            return INFINITY;
+        }
+        float invDet = 1.0f / det;
+        float3 s = float3{ ray.origin[ 0 ], ray.origin[ 1 ], ray.origin[ 2 ] } - a;
+        float u = util::math::dot( s, p ) * invDet;
+        if ( u < 0.0f || u > 1.0f )
+        {
+            return INFINITY;
+        }
+        float3 q = util::math::cross( s, e1 );
+        float v = util::math::dot( d, q ) * invDet;
+        if ( v < 0.0f || u + v > 1.0f )
+        {
+            return INFINITY;
+        }
+        *pU = u;
+        *pV = v;
+        return util::math::dot( e2, q ) * invDet;
+    }
+
+    util::math::float4x4 unpack( const util::PackedTransform& t )
+    {
+        util::math::float4x4 m;
+        for ( int c = 0; c < 4; ++c )
+        {
+            m.columns[ c ] = { t.columns[ c ][ 0 ], t.columns[ c ][ 1 ], t.columns[ c ][ 2 ], c == 3 ? 1.0f : 0.0f };
+        }
+        return m;
+    }
+
+    util::Ray transformRay( const util::Ray& ray, const util::PackedTransform& t )
+    {
+        util::Ray r = ray;
+        for ( int row = 0; row < 3; ++row )
+        {
+            r.origin[ row ] = t.columns[ 0 ][ row ] * ray.origin[ 0 ] + t.columns[ 1 ][ row ] * ray.origin[ 1 ]
+                            + t.columns[ 2 ][ row ] * ray.origin[ 2 ] + t.columns[ 3 ][ row ];
+            r.direction[ row ] = t.columns[ 0 ][ row ] * ray.direction[ 0 ] + t.columns[ 1 ][ row ] * ray.direction[ 1 ]
+                               + t.columns[ 2 ][ row ] * ray.direction[ 2 ];
+        }
+        return r;
+    }
+}
+
+void util::Bvh::build( const BoundingBox* pBounds, size_t count, WorkStealingPool* pPool )
+{
+    _nodes.clear();
+    _indices.resize( count );
+    std::iota( _indices.begin(), _indices.end(), 0u );
+    if ( count == 0 )
+    {
+        return;
+    }
+
+    Builder b;
+    b.boxes.resize( count );
+    b.centroids.resize( count );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        b.boxes[ i ] = load( pBounds[ i ] );
+        b.centroids[ i ] = ( b.boxes[ i ].min + b.boxes[ i ].max ) * splat( 0.5f );
+    }
+    b.pIndices = _indices.data();
+
+    // Split the top of the tree here until every open range fits in a task.
+    struct Task
+    {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        int depth;
+    };
+    std::vector< Task > tasks;
+    std::vector< Task > open = { { 0, 0, (uint32_t)count, 0 } };
+    _nodes.resize( 1 );
+    while ( !open.empty() )
+    {
+        Task t = open.back();
+        open.pop_back();
+        if ( t.end - t.begin <= kTaskSize )
+        {
+            tasks.push_back( t );
+            continue;
+        }
+
+        Box4 bounds;
+        uint32_t mid = split( b, t.begin, t.end, t.depth, &bounds );
+        uint32_t left = (uint32_t)_nodes.size();
+        _nodes.resize( left + 2 );
+        _nodes[ t.node ].bounds = store( bounds );
+        _nodes[ t.node ].index = left;
+        _nodes[ t.node ].count = 0;
+        open.push_back( { left + 1, mid, t.end, t.depth + 1 } );
+        open.push_back( { left, t.begin, mid, t.depth + 1 } );
+    }
+
+    // Tasks own disjoint index ranges and build into their own arrays, root
+    // at 0.
+    std::vector< std::vector< BvhNode > > subtrees( tasks.size() );
+    auto buildTask = [&]( size_t i, unsigned ){
+        subtrees[ i ].resize( 1 );
+        buildSubtree( b, subtrees[ i ], 0, tasks[ i ].begin, tasks[ i ].end, tasks[ i ].depth );
+    };
+    if ( pPool && tasks.size() > 1 )
+    {
+        pPool->parallelFor( tasks.size(), buildTask );
+    }
+    else
+    {
+        for ( size_t i = 0; i < tasks.size(); ++i )
+        {
+            buildTask( i, 0 );
+        }
+    }
+
+    // Each subtree root replaces its placeholder and the rest is appended,
+    // in task order so the result does not depend on scheduling.
+    for ( size_t i = 0; i < tasks.size(); ++i )
+    {
+        const std::vector< BvhNode >& subtree = subtrees[ i ];
+        uint32_t offset = (uint32_t)_nodes.size() - 1;
+        for ( size_t k = 0; k < subtree.size(); ++k )
+        {
+            BvhNode n = subtree[ k ];
+            if ( n.count == 0 )
+            {
+                n.index += offset;
+            }
+            if ( k == 0 )
+            {
+                _nodes[ tasks[ i ].node ] = n;
+            }
+            else
+            {
+                _nodes.push_back( n );
+            }
+        }
+    }
+}
+
+void util::Bvh::refit( const BoundingBox* pBounds )
+{
+    // Children always follow their parent, so one backwards pass sees
+    // every child before the node that holds it.
+    for ( size_t k = _nodes.size(); k-- > 0; )
+    {
+        BvhNode& n = _nodes[ k ];
+        Box4 box = emptyBox4();
+        if ( n.count )
+        {
+            for ( uint32_t i = n.index; i < n.index + n.count; ++i )
+            {
+                grow( &box, load( pBounds[ _indices[ i ] ] ) );
+            }
+        }
+        else
+        {
+            grow( &box, load( _nodes[ n.index ].bounds ) );
+            grow( &box, load( _nodes[ n.index + 1 ].bounds ) );
+        }
+        n.bounds = store( box );
+    }
+}
+
+float util::Bvh::sahCost() const
+{
+    if ( _nodes.empty() )
+    {
+        return 0.0f;
+    }
+    float rootArea = halfArea( load( _nodes[ 0 ].bounds ) );
+    if ( rootArea <= 0.0f )
+    {
+        return (float)_indices.size();
+    }
+
+    float cost = 0.0f;
+    for ( const BvhNode& n : _nodes )
+    {
+        cost += halfArea( load( n.bounds ) ) / rootArea * ( n.count ? (float)n.count : 1.0f );
+    }
+    return cost;
+}
+
+uint32_t util::SceneBvh::addMesh( const float* pPositions, size_t vertexStride, const uint32_t* pIndices, size_t triangleCount )
+{
+    _meshes.push_back( { pPositions, vertexStride, pIndices, triangleCount, Bvh(), false } );
+    return (uint32_t)_meshes.size() - 1;
+}
+
+uint32_t util::SceneBvh::addInstance( const float* pTransform, uint32_t mesh, uint32_t mask, uint32_t options )
+{
+    assert( mesh < _meshes.size() );
+    InstanceDescriptor d = {};
+    d.options = options;
+    d.mask = mask;
+    d.accelerationStructureIndex = mesh;
+    _descriptors.push_back( d );
+    _inverseTransforms.emplace_back();
+    setTransform( (uint32_t)_descriptors.size() - 1, pTransform );
+    return (uint32_t)_descriptors.size() - 1;
+}
+
+void util::SceneBvh::setTransform( uint32_t instance, const float* pTransform )
+{
+    PackedTransform t = packTransform( pTransform );
+    _descriptors[ instance ].transformationMatrix = t;
+    math::float4x4 inverse = math::inverseAffine( unpack( t ) );
+    _inverseTransforms[ instance ] = packTransform( reinterpret_cast< const float* >( &inverse ) );
+}
+
+void util::SceneBvh::buildMesh( Mesh& mesh, WorkStealingPool* pPool )
+{
+    std::vector< BoundingBox > bounds( mesh.triangleCount );
+    const char* p = reinterpret_cast< const char* >( mesh.pPositions );
+    for ( size_t t = 0; t < mesh.triangleCount; ++t )
+    {
+        const uint32_t* pTri = mesh.pIndices + t * 3;
+        Box4 box = emptyBox4();
+        for ( int k = 0; k < 3; ++k )
+        {
+            grow( &box, load3( reinterpret_cast< const float* >( p + pTri[ k ] * mesh.vertexStride ) ) );
+        }
+        bounds[ t ] = store( box );
+    }
+    mesh.bvh.build( bounds.data(), bounds.size(), pPool );
+    mesh.built = true;
+}
+
+void util::SceneBvh::build( WorkStealingPool* pPool )
+{
+    std::vector< Mesh* > pending;
+    for ( Mesh& mesh : _meshes )
+    {
+        if ( !mesh.built )
+        {
+            pending.push_back( &mesh );
+        }
+    }
+
+    // The pool is not reentrant: either many meshes side by side, or one at
+    // a time with parallel subtrees.
+    if ( pPool && pending.size() >= pPool->threadCount() )
+    {
+        pPool->parallelFor( pending.size(), [&]( size_t i, unsigned ){
+            buildMesh( *pending[ i ], nullptr );
+        } );
+    }
+    else
+    {
+        for ( Mesh* pMesh : pending )
+        {
+            buildMesh( *pMesh, pPool );
+        }
+    }
+
+    std::vector< BoundingBox > bounds( _descriptors.size() );
+    instanceBounds( bounds.data() );
+    _instanceBvh.build( bounds.data(), bounds.size(), pPool );
+}
+
+void util::SceneBvh::instanceBounds( BoundingBox* pOut ) const
+{
+    for ( size_t i = 0; i < _descriptors.size(); ++i )
+    {
+        const InstanceDescriptor& d = _descriptors[ i ];
+        pOut[ i ] = transformBounds( _meshes[ d.accelerationStructureIndex ].bvh.bounds(), d.transformationMatrix );
+    }
+}
+
+bool util::SceneBvh::intersectMesh( const Mesh& mesh, const Ray& objectRay, RayHit* pHit ) const
+{
+    RayLanes r = prepare( objectRay );
+    float tMax = objectRay.maxDistance;
+    bool found = false;
+    const char* p = reinterpret_cast< const char* >( mesh.pPositions );
+    const std::vector< uint32_t >& order = mesh.bvh.primitiveIndices();
+
+    traverse( mesh.bvh.nodes(), r, &tMax, [&]( uint32_t first, uint32_t count ){
+        for ( uint32_t k = first; k < first + count; ++k )
+        {
+            uint32_t triangle = order[ k ];
+            const uint32_t* pTri = mesh.pIndices + triangle * 3;
+            float u = 0.f, v = 0.f;
+            float t = intersectTriangle( objectRay,
+                                         reinterpret_cast< const float* >( p + pTri[ 0 ] * mesh.vertexStride ),
+                                         reinterpret_cast< const float* >( p + pTri[ 1 ] * mesh.vertexStride ),
+                                         reinterpret_cast< const float* >( p + pTri[ 2 ] * mesh.vertexStride ), &u, &v );
+            if ( t > objectRay.minDistance && t < tMax )
+            {
+                tMax = t;
+                pHit->distance = t;
+                pHit->u = u;
+                pHit->v = v;
+                pHit->primitive = triangle;
+                found = true;
+            }
+        }
+    } );
+    return found;
+}
+
+bool util::SceneBvh::intersect( const Ray& ray, uint32_t rayMask, RayHit* pHit ) const
+{
+    RayLanes r = prepare( ray );
+    float tMax = ray.maxDistance;
+    bool found = false;
+    const std::vector< uint32_t >& order = _instanceBvh.primitiveIndices();
+
+    traverse( _instanceBvh.nodes(), r, &tMax, [&]( uint32_t first, uint32_t count ){
+        for ( uint32_t k = first; k < first + count; ++k )
+        {
+            uint32_t instance = order[ k ];
+            const InstanceDescriptor& d = _descriptors[ instance ];
+            if ( !( d.mask & rayMask ) )
+            {
+                continue;
+            }
+
+            // Affine transforms keep distances along the ray, so the hit
+            // distance in object space is the world one.
+            Ray objectRay = transformRay( ray, _inverseTransforms[ instance ] );
+            objectRay.maxDistance = tMax;
+            RayHit hit;
+            if ( intersectMesh( _meshes[ d.accelerationStructureIndex ], objectRay, &hit ) )
+            {
+                tMax = hit.distance;
+                hit.instance = instance;
+                *pHit = hit;
+                found = true;
+            }
+        }
+    } );
+    return found;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "AccelerationStructureTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    class WorkStealingPool;
+
+    struct BvhNode
+    {
+        BoundingBox bounds;
+        uint32_t index;  // first child, the second follows it; for leaves the first primitiveIndices() entry
+        uint32_t count;  // primitives in a leaf, 0 for interior nodes
+    };
+
+    // Bounding volume hierarchy over boxes, split with a 16-bin surface area
+    // heuristic (SAH). The top of the tree is split on the calling thread;
+    // subtrees below that are built in parallel on pPool when one is given.
+    // Where that cut falls depends only on the input, so the tree is the same
+    // for any number of threads.
+    class Bvh
+    {
+        public:
+            void build( const BoundingBox* pBounds, size_t count, WorkStealingPool* pPool = nullptr );
+
+            // Recomputes every node's bounds from moved primitives, keeping
+            // the topology: the CPU counterpart of Metal's refit. pBounds
+            // must hold as many boxes as the last build().
+            void refit( const BoundingBox* pBounds );
+
+            const std::vector< BvhNode >& nodes() const { return _nodes; }
+            const std::vector< uint32_t >& primitiveIndices() const { return _indices; }
+            BoundingBox bounds() const { return _nodes.empty() ? emptyBounds() : _nodes[ 0 ].bounds; }
+
+            // Expected cost of a random ray, counting one per node visited and
+            // one per primitive tested.
+            float sahCost() const;
+
+        private:
+            std::vector< BvhNode > _nodes;
+            std::vector< uint32_t > _indices;
+    };
+
+    struct Ray
+    {
+        float origin[ 3 ];
+        float minDistance;
+        float direction[ 3 ];
+        float maxDistance;
+    };
+
+    struct RayHit
+    {
+        float distance;
+        float u, v;  // barycentrics of the second and third vertex
+        uint32_t instance;
+        uint32_t primitive;
+    };
+
+    // Two-level scene mirroring Metal's split between primitive and instance
+    // acceleration structures: one Bvh per triangle mesh and one over the
+    // instances' world bounds. instanceDescriptors() are ready to copy into
+    // the buffer passed to InstanceAccelerationStructureDescriptor::
+    // setInstanceDescriptorBuffer(), with accelerationStructureIndex naming
+    // the mesh. intersect() is the CPU fallback for ray queries.
+    class SceneBvh
+    {
+        public:
+            // Positions are float3 spaced vertexStride bytes apart, indices
+            // three per triangle. Neither is copied.
+            uint32_t addMesh( const float* pPositions, size_t vertexStride, const uint32_t* pIndices, size_t triangleCount );
+
+            // pTransform is a column major affine float4x4.
+            uint32_t addInstance( const float* pTransform, uint32_t mesh, uint32_t mask = 0xFF, uint32_t options = 0 );
+            void setTransform( uint32_t instance, const float* pTransform );
+
+            // Builds meshes added since the last call, then the instance
+            // hierarchy. Call again after moving instances.
+            void build( WorkStealingPool* pPool = nullptr );
+
+            // World bounds of every instance from its current transform and
+            // its mesh's bounds, which must be built; what build() puts the
+            // instance hierarchy over.
+            void instanceBounds( BoundingBox* pOut ) const;
+
+            size_t meshCount() const { return _meshes.size(); }
+            size_t instanceCount() const { return _descriptors.size(); }
+            const Bvh& meshBvh( uint32_t mesh ) const { return _meshes[ mesh ].bvh; }
+            const Bvh& instanceBvh() const { return _instanceBvh; }
+            const std::vector< InstanceDescriptor >& instanceDescriptors() const { return _descriptors; }
+
+            // Closest hit among instances with ( mask & rayMask ) != 0.
+            bool intersect( const Ray& ray, uint32_t rayMask, RayHit* pHit ) const;
+
+        private:
+            struct Mesh
+            {
+                const float* pPositions;
+                size_t vertexStride;
+                const uint32_t* pIndices;
+                size_t triangleCount;
+                Bvh bvh;
+                bool built;
+            };
+
+            void buildMesh( Mesh& mesh, WorkStealingPool* pPool );
+            bool intersectMesh( const Mesh& mesh, const Ray& objectRay, RayHit* pHit ) const;
+
+            std::vector< Mesh > _meshes;
+            std::vector< InstanceDescriptor > _descriptors;
+            std::vector< PackedTransform > _inverseTransforms;
+            Bvh _instanceBvh;
+    };
+}
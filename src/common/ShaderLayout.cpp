@@ -0,0 +1,66 @@
+#include "ShaderLayout.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    static constexpr const char* kIncludeLine = "#include \"shader_types.h\"";
+
+    // Function-local for the same reason as the embedded shader tables:
+    // registrations run from other translation units' static initializers.
+    std::vector< const char* >& shaderStructs()
+    {
+        static std::vector< const char* > structs;
+        return structs;
+    }
+
+    bool isIncludeLine( const char* pBegin, const char* pEnd )
+    {
+        while ( pBegin < pEnd && ( *pBegin == ' ' || *pBegin == '\t' ) )
+        {
+            ++pBegin;
+        }
+        while ( pEnd > pBegin && ( pEnd[ -1 ] == ' ' || pEnd[ -1 ] == '\t' || pEnd[ -1 ] == '\r' ) )
+        {
+            --pEnd;
+        }
+        size_t length = strlen( kIncludeLine );
+        return (size_t)( pEnd - pBegin ) == length && memcmp( pBegin, kIncludeLine, length ) == 0;
+    }
+}
+
+util::ShaderStructRegistration::ShaderStructRegistration( const char* pMsl )
+{
+    shaderStructs().push_back( pMsl );
+}
+
+std::string util::expandShaderTypes( const char* pSource )
+{
+    std::string expanded;
+    const char* pLine = pSource;
+    while ( *pLine )
+    {
+        const char* pEnd = strchr( pLine, '\n' );
+        const char* pNext = pEnd ? pEnd + 1 : pLine + strlen( pLine );
+        if ( !pEnd )
+        {
+            pEnd = pNext;
+        }
+
+        if ( isIncludeLine( pLine, pEnd ) )
+        {
+            for ( const char* pMsl : shaderStructs() )
+            {
+                expanded += pMsl;
+                expanded += "\n";
+            }
+        }
+        else
+        {
+            expanded.append( pLine, pNext );
+        }
+        pLine = pNext;
+    }
+    return expanded;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <common/Math.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Structs shared between C++ and MSL, declared once as a field list:
+ *
+ *     #define INSTANCE_DATA_FIELDS( FIELD, ARRAY ) \
+ *         FIELD( float4x4, instanceTransform ) \
+ *         ARRAY( packed_float3, instanceNormalTransform, 3 )
+ *     LEARN_METAL_SHADER_STRUCT( InstanceData, INSTANCE_DATA_FIELDS )
+ *
+ * Field types use their MSL names. The macro defines the C++ struct, checks
+ * every field offset and the struct size against MSL's layout rules at
+ * compile time, and registers the MSL declaration. A shader source line
+ *
+ *     #include "shader_types.h"
+ *
+ * is replaced by the declarations of all registered structs, in declaration
+ * order, before the source is compiled. EmbedShaders.cmake parses the same
+ * field lists so precompiled libraries see identical declarations.
+ */
+
+namespace util
+{
+    namespace shader_layout
+    {
+        using math::float2;
+        using math::float3;
+        using math::float4;
+        using math::uint2;
+        using math::float3x3;
+        using math::float4x4;
+        using uint = uint32_t;
+
+        // MSL packed_float3: 12 bytes, 4-byte aligned.
+        struct packed_float3
+        {
+            float x, y, z;
+        };
+
+        // Size and alignment of each type in MSL (Metal Shading Language
+        // specification, scalar, vector and matrix data types), kept apart
+        // from the C++ definitions so the two can be checked against each
+        // other.
+        template< typename T > struct MslType;
+        template<> struct MslType< float > { static constexpr size_t size = 4, align = 4; };
+        template<> struct MslType< uint > { static constexpr size_t size = 4, align = 4; };
+        template<> struct MslType< float2 > { static constexpr size_t size = 8, align = 8; };
+        template<> struct MslType< float3 > { static constexpr size_t size = 16, align = 16; };
+        template<> struct MslType< float4 > { static constexpr size_t size = 16, align = 16; };
+        template<> struct MslType< uint2 > { static constexpr size_t size = 8, align = 8; };
+        template<> struct MslType< packed_float3 > { static constexpr size_t size = 12, align = 4; };
+        template<> struct MslType< float3x3 > { static constexpr size_t size = 48, align = 16; };
+        template<> struct MslType< float4x4 > { static constexpr size_t size = 64, align = 16; };
+
+        struct FieldLayout
+        {
+            size_t size;
+            size_t align;
+            size_t offset;  // where the C++ compiler put the field
+        };
+
+        constexpr size_t alignUp( size_t value, size_t align ) { return ( value + align - 1 ) / align * align; }
+
+        // True if each field sits where MSL would place it and the struct is
+        // as large as MSL's, including tail padding.
+        constexpr bool matchesMsl( const FieldLayout* pFields, size_t count, size_t structSize )
+        {
+            size_t offset = 0;
+            size_t structAlign = 1;
+            for ( size_t i = 0; i < count; ++i )
+            {
+                offset = alignUp( offset, pFields[ i ].align );
+                if ( pFields[ i ].offset != offset )
+                {
+                    return false;
+                }
+                offset += pFields[ i ].size;
+                structAlign = pFields[ i ].align > structAlign ? pFields[ i ].align : structAlign;
+            }
+            return structSize == alignUp( offset, structAlign );
+        }
+    }
+
+    // Adds a struct's MSL declaration to the set emitted for
+    // #include "shader_types.h". Used by LEARN_METAL_SHADER_STRUCT.
+    class ShaderStructRegistration
+    {
+        public:
+            explicit ShaderStructRegistration( const char* pMsl );
+    };
+
+    // Returns pSource with every #include "shader_types.h" line replaced by
+    // the registered declarations. Sources without one come back unchanged.
+    std::string expandShaderTypes( const char* pSource );
+}
+
+#define LEARN_METAL_SHADER_FIELD( type, name ) type name;
+#define LEARN_METAL_SHADER_ARRAY( type, name, count ) type name[ count ];
+#define LEARN_METAL_SHADER_FIELD_MSL( type, name ) "    " #type " " #name ";\n"
+#define LEARN_METAL_SHADER_ARRAY_MSL( type, name, count ) "    " #type " " #name "[" #count "];\n"
+#define LEARN_METAL_SHADER_FIELD_LAYOUT( type, name ) \
+    { ::util::shader_layout::MslType< type >::size, ::util::shader_layout::MslType< type >::align, offsetof( Self, name ) },
+#define LEARN_METAL_SHADER_ARRAY_LAYOUT( type, name, count ) \
+    { ::util::shader_layout::MslType< type >::size * ( count ), ::util::shader_layout::MslType< type >::align, offsetof( Self, name ) },
+
+#define LEARN_METAL_SHADER_STRUCT( Name, FIELDS ) \
+    namespace Name##_layout \
+    { \
+        using namespace ::util::shader_layout; \
+        struct Name \
+        { \
+            FIELDS( LEARN_METAL_SHADER_FIELD, LEARN_METAL_SHADER_ARRAY ) \
+            static constexpr const char* kMsl = \
+                "struct " #Name "\n{\n" FIELDS( LEARN_METAL_SHADER_FIELD_MSL, LEARN_METAL_SHADER_ARRAY_MSL ) "};\n"; \
+        }; \
+        using Self = Name; \
+        constexpr ::util::shader_layout::FieldLayout kFields[] = { \
+            FIELDS( LEARN_METAL_SHADER_FIELD_LAYOUT, LEARN_METAL_SHADER_ARRAY_LAYOUT ) \
+        }; \
+        static_assert( ::util::shader_layout::matchesMsl( kFields, sizeof( kFields ) / sizeof( kFields[ 0 ] ), sizeof( Name ) ), \
+                       #Name " does not match its MSL layout" ); \
+        static const ::util::ShaderStructRegistration kRegistration( Name::kMsl ); \
+    } \
+    using Name = Name##_layout::Name;
@@ -0,0 +1,51 @@
+#include "ShaderLibrary.hpp"
+
+#include <dispatch/dispatch.h>
+
+#include "ShaderLayout.hpp"
+
+bool util::hasPrecompiledLibrary( const char* pSource, ShaderMath math )
+{
+    const EmbeddedShader* pShader = findEmbeddedShader( pSource );
+    return pShader && pShader->pLibrary && pShader->math == math;
+}
+
+MTL::CompileOptions* util::newCompileOptions( ShaderMath math )
+{
+    if ( math == ShaderMath::Fast )
+    {
+        return nullptr;
+    }
+
+    MTL::CompileOptions* pOptions = MTL::CompileOptions::alloc()->init();
+    pOptions->setFastMathEnabled( false );
+    return pOptions;
+}
+
+MTL::Library* util::newShaderLibrary( MTL::Device* pDevice, const char* pSource, NS::Error** ppError, ShaderMath math )
+{
+    const EmbeddedShader* pShader = findEmbeddedShader( pSource );
+    if ( pShader && pShader->pLibrary && pShader->math == math )
+    {
+        // The embedded bytes are static; no need for dispatch to copy them.
+        dispatch_data_t data = dispatch_data_create( pShader->pLibrary, pShader->librarySize, nullptr, ^{} );
+        MTL::Library* pLibrary = pDevice->newLibrary( data, ppError );
+        dispatch_release( data );
+        if ( pLibrary )
+        {
+            return pLibrary;
+        }
+
+        // A metallib built for another OS version can fail to load.
+        __builtin_printf( "Precompiled library rejected, compiling from source\n" );
+    }
+
+    std::string source = expandShaderTypes( pSource );
+    MTL::CompileOptions* pOptions = newCompileOptions( math );
+    MTL::Library* pLibrary = pDevice->newLibrary( NS::String::string( source.c_str(), NS::UTF8StringEncoding ), pOptions, ppError );
+    if ( pOptions )
+    {
+        pOptions->release();
+    }
+    return pLibrary;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "EmbeddedShaders.hpp"
+
+namespace util
+{
+    // Drop-in for MTL::Device::newLibrary( source, nullptr, ppError ). If the
+    // build embedded a precompiled metallib for this exact source and math
+    // mode, it is loaded instead of compiling; otherwise the source is
+    // compiled at runtime, after expanding #include "shader_types.h" (see
+    // ShaderLayout.hpp). Returns a library the caller owns.
+    MTL::Library* newShaderLibrary( MTL::Device* pDevice, const char* pSource, NS::Error** ppError,
+                                    ShaderMath math = ShaderMath::Fast );
+
+    // True if newShaderLibrary() would skip the compiler for this source.
+    bool hasPrecompiledLibrary( const char* pSource, ShaderMath math = ShaderMath::Fast );
+
+    // Options to compile with math, or null for the defaults (fast math).
+    // The caller owns the result.
+    MTL::CompileOptions* newCompileOptions( ShaderMath math );
+}
@@ -0,0 +1,76 @@
+#include "SpecializationCache.hpp"
+
+#include "PipelineKey.hpp"
+
+namespace
+{
+    void releaseEntry( util::SpecializationCache::Entry& entry )
+    {
+        entry.pPipeline->release();
+        entry.pLibrary->release();
+    }
+
+    MTL::FunctionConstantValues* newConstantValues( const util::FunctionConstantSet& constants )
+    {
+        MTL::FunctionConstantValues* pValues = MTL::FunctionConstantValues::alloc()->init();
+        for ( const util::FunctionConstantSet::Constant& c : constants.constants() )
+        {
+            switch ( c.type )
+            {
+                case util::FunctionConstantType::Bool:
+                    pValues->setConstantValue( &c.b, MTL::DataTypeBool, c.index );
+                    break;
+                case util::FunctionConstantType::Int:
+                    pValues->setConstantValue( &c.i, MTL::DataTypeInt, c.index );
+                    break;
+                case util::FunctionConstantType::Float:
+                    pValues->setConstantValue( &c.f, MTL::DataTypeFloat, c.index );
+                    break;
+            }
+        }
+        return pValues;
+    }
+}
+
+util::SpecializationCache::SpecializationCache( MTL::Device* pDevice, size_t maxPipelines )
+: _pDevice( pDevice->retain() )
+, _pipelines( maxPipelines )
+{
+}
+
+util::SpecializationCache::~SpecializationCache()
+{
+    _pipelines.clear( releaseEntry );
+    _pDevice->release();
+}
+
+MTL::ComputePipelineState* util::SpecializationCache::computePipeline( MTL::Library* pLibrary, const char* pFunctionName,
+                                                                       const FunctionConstantSet& constants, NS::Error** ppError )
+{
+    uint64_t key = PipelineKeyBuilder( constants.key() )
+        .add( (uint64_t)(uintptr_t)pLibrary )
+        .addString( pFunctionName )
+        .key();
+
+    if ( Entry* pCached = _pipelines.find( key ) )
+    {
+        return pCached->pPipeline;
+    }
+
+    MTL::FunctionConstantValues* pValues = newConstantValues( constants );
+    MTL::Function* pFn = pLibrary->newFunction( NS::String::string( pFunctionName, NS::UTF8StringEncoding ), pValues, ppError );
+    pValues->release();
+    if ( !pFn )
+    {
+        return nullptr;
+    }
+
+    MTL::ComputePipelineState* pPipeline = _pDevice->newComputePipelineState( pFn, ppError );
+    pFn->release();
+    if ( !pPipeline )
+    {
+        return nullptr;
+    }
+
+    return _pipelines.insert( key, { pPipeline, pLibrary->retain() }, releaseEntry ).pPipeline;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "FunctionConstantSet.hpp"
+#include "LruCache.hpp"
+
+namespace util
+{
+    // Compiles each (function, constant set) pair once and keeps the
+    // resulting compute pipeline states in an LRU capped at a fixed number of
+    // live pipelines.
+    //
+    // Returned pipelines are borrowed: they stay valid until a later call
+    // evicts them. Encoders retain the pipelines they are given, so work
+    // already encoded is not affected by eviction.
+    //
+    // Entries are keyed by library address and retain their library, so the
+    // address cannot be reused by a new library while an entry refers to it.
+    class SpecializationCache
+    {
+        public:
+            SpecializationCache( MTL::Device* pDevice, size_t maxPipelines );
+            ~SpecializationCache();
+
+            MTL::ComputePipelineState* computePipeline( MTL::Library* pLibrary, const char* pFunctionName,
+                                                        const FunctionConstantSet& constants, NS::Error** ppError );
+
+            struct Entry
+            {
+                MTL::ComputePipelineState* pPipeline;
+                MTL::Library* pLibrary;
+            };
+
+            const LruCache< Entry >& pipelines() const { return _pipelines; }
+
+        private:
+            MTL::Device* _pDevice;
+            LruCache< Entry > _pipelines;
+    };
+}
@@ -0,0 +1,124 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    size_t alignUp( size_t value, size_t alignment )
+    {
+        return ( value + alignment - 1 ) & ~( alignment - 1 );
+    }
+}
+
+util::UniformUploadPolicy::UniformUploadPolicy( size_t segmentSize, size_t framesInFlight, size_t inlineThreshold )
+: _segmentSize( alignUp( segmentSize, kRingAlignment ) )
+, _framesInFlight( framesInFlight )
+, _inlineThreshold( 0 )
+, _segmentBegin( 0 )
+, _cursor( 0 )
+, _overflowBytes( 0 )
+, _frameUploads( 0 )
+, _ringUsed( false )
+{
+    assert( framesInFlight > 0 );
+    setInlineThreshold( inlineThreshold );
+}
+
+void util::UniformUploadPolicy::setInlineThreshold( size_t bytes )
+{
+    // Metal rejects setVertexBytes() payloads above 4KB.
+    assert( bytes <= kMaxInlineBytes );
+    _inlineThreshold = bytes;
+}
+
+bool util::UniformUploadPolicy::beginFrame( size_t frameIndex )
+{
+    // Grow to hold everything the last frame wanted in the ring, with room
+    // to spare so a slowly growing payload does not reallocate every frame.
+    bool grew = false;
+    if ( _overflowBytes > 0 )
+    {
+        _segmentSize = alignUp( std::max( _segmentSize * 2, _overflowBytes ), kRingAlignment );
+        _stats.ringGrowths += 1;
+        _overflowBytes = 0;
+        grew = true;
+    }
+
+    _segmentBegin = ( frameIndex % _framesInFlight ) * _segmentSize;
+    _cursor = _segmentBegin;
+    _frameUploads = 0;
+    return grew;
+}
+
+util::UniformUploadPolicy::Route util::UniformUploadPolicy::route( size_t size, uint32_t slot, size_t* pOffset )
+{
+    assert( slot < kMaxSlots );
+
+    if ( !_slots.test( slot ) )
+    {
+        // A dedicated-buffer renderer needs one buffer per frame in flight for
+        // every binding it feeds; only the ring itself is ever allocated here.
+        _slots.set( slot );
+        _stats.buffersSaved = _slots.count() * _framesInFlight - _stats.buffersAllocated;
+    }
+
+    ++_frameUploads;
+
+    if ( size < _inlineThreshold || ( size <= kMaxInlineBytes && _segmentSize == 0 ) )
+    {
+        _stats.inlineUploads += 1;
+        _stats.inlineBytes += size;
+        *pOffset = kInvalidOffset;
+        return Route::Inline;
+    }
+
+    size_t offset = alignUp( _cursor, kRingAlignment );
+    if ( offset + size > _segmentBegin + _segmentSize )
+    {
+        // The cursor stays put so smaller payloads can still use the ring
+        _overflowBytes = std::max( _overflowBytes, offset + size - _segmentBegin );
+        // Its own buffer needs its own flush, so nothing is saved
+        --_frameUploads;
+        _stats.flushesIssued += 1;
+        _stats.dedicatedUploads += 1;
+        _stats.dedicatedBytes += size;
+        *pOffset = kInvalidOffset;
+        return Route::Dedicated;
+    }
+
+    _cursor = offset + size;
+    if ( !_ringUsed )
+    {
+        _ringUsed = true;
+        _stats.buffersAllocated = 1;
+        _stats.buffersSaved = _slots.count() * _framesInFlight - _stats.buffersAllocated;
+    }
+
+    _stats.ringUploads += 1;
+    _stats.ringBytes += size;
+    *pOffset = offset;
+    return Route::Ring;
+}
+
+bool util::UniformUploadPolicy::endFrame( size_t* pFlushOffset, size_t* pFlushLength )
+{
+    bool needsFlush = _cursor > _segmentBegin;
+
+    // Every upload would have cost one didModifyRange() on its own buffer.
+    uint64_t flushes = needsFlush ? 1 : 0;
+    _stats.flushesIssued += flushes;
+    _stats.flushesSaved += _frameUploads - flushes;
+
+    *pFlushOffset = _segmentBegin;
+    *pFlushLength = _cursor - _segmentBegin;
+    _frameUploads = 0;
+    return needsFlush;
+}
+
+void util::UniformUploadPolicy::resetStats()
+{
+    _stats = UniformUploadStats();
+    _slots.reset();
+    _stats.buffersAllocated = _ringUsed ? 1 : 0;
+}
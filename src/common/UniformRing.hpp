@@ -0,0 +1,84 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace util
+{
+    // Counters describing what the upload policy saved compared to the
+    // "one managed buffer per uniform per frame in flight" approach.
+    struct UniformUploadStats
+    {
+        uint64_t inlineUploads = 0;
+        uint64_t ringUploads = 0;
+        uint64_t dedicatedUploads = 0;
+        uint64_t inlineBytes = 0;
+        uint64_t ringBytes = 0;
+        uint64_t dedicatedBytes = 0;
+        uint64_t ringGrowths = 0;
+        uint64_t flushesIssued = 0;
+        uint64_t flushesSaved = 0;
+        uint64_t buffersAllocated = 0;
+        uint64_t buffersSaved = 0;
+    };
+
+    // CPU side of the uniform upload path. Decides whether a payload goes
+    // inline (setVertexBytes/setFragmentBytes) or into a sub-allocated ring
+    // segment, and keeps the bookkeeping needed for a single flush per frame.
+    // Contains no Metal calls so it can be exercised without a device.
+    class UniformUploadPolicy
+    {
+        public:
+            // Dedicated: the frame's ring segment is full, so the payload
+            // needs a buffer of its own this frame. The segment grows to fit
+            // at the next beginFrame().
+            enum class Route { Inline, Ring, Dedicated };
+
+            static constexpr size_t kMaxInlineBytes = 4096;
+            static constexpr size_t kDefaultInlineThreshold = 4096;
+            static constexpr size_t kRingAlignment = 256;
+            static constexpr size_t kInvalidOffset = SIZE_MAX;
+            static constexpr uint32_t kMaxSlots = 96;
+
+            UniformUploadPolicy( size_t segmentSize, size_t framesInFlight, size_t inlineThreshold = kDefaultInlineThreshold );
+
+            void setInlineThreshold( size_t bytes );
+            size_t inlineThreshold() const { return _inlineThreshold; }
+
+            size_t segmentSize() const { return _segmentSize; }
+            size_t framesInFlight() const { return _framesInFlight; }
+            size_t ringSize() const { return _segmentSize * _framesInFlight; }
+
+            // Returns true when the segment grew, which moves every segment:
+            // the ring must then be reallocated at ringSize().
+            bool beginFrame( size_t frameIndex );
+
+            // slot identifies the binding (a kUniformSlot* stage base plus the
+            // index) so repeated uploads to the same binding are not counted
+            // as extra buffers.
+            Route route( size_t size, uint32_t slot, size_t* pOffset );
+
+            // Returns false when nothing was written to the ring this frame.
+            bool endFrame( size_t* pFlushOffset, size_t* pFlushLength );
+
+            const UniformUploadStats& stats() const { return _stats; }
+            void resetStats();
+
+        private:
+            size_t _segmentSize;
+            size_t _framesInFlight;
+            size_t _inlineThreshold;
+            size_t _segmentBegin;
+            size_t _cursor;
+            size_t _overflowBytes;
+            std::bitset< kMaxSlots > _slots;
+            uint64_t _frameUploads;
+            bool _ringUsed;
+            UniformUploadStats _stats;
+    };
+
+    static constexpr uint32_t kUniformSlotVertex = 0;
+    static constexpr uint32_t kUniformSlotFragment = 32;
+    static constexpr uint32_t kUniformSlotCompute = 64;
+}
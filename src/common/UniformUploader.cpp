@@ -0,0 +1,104 @@
+#include "UniformUploader.hpp"
+
+#include <cassert>
+#include <cstring>
+
+util::UniformUploader::UniformUploader( MTL::Device* pDevice, size_t framesInFlight, size_t segmentSize, size_t inlineThreshold )
+: _pDevice( pDevice->retain() )
+, _pRing( nullptr )
+, _policy( segmentSize, framesInFlight, inlineThreshold )
+{
+}
+
+util::UniformUploader::~UniformUploader()
+{
+    if ( _pRing )
+    {
+        _pRing->release();
+    }
+    _pDevice->release();
+}
+
+void util::UniformUploader::beginFrame( size_t frameIndex )
+{
+    // Command buffers retain the buffers they reference, so frames in
+    // flight keep the old ring alive
+    if ( _policy.beginFrame( frameIndex ) && _pRing )
+    {
+        _pRing->release();
+        _pRing = nullptr;
+    }
+}
+
+MTL::Buffer* util::UniformUploader::write( const void* pData, size_t size, uint32_t slot, size_t* pOffset )
+{
+    switch ( _policy.route( size, slot, pOffset ) )
+    {
+        case UniformUploadPolicy::Route::Inline:
+            return nullptr;
+
+        case UniformUploadPolicy::Route::Ring:
+            if ( !_pRing )
+            {
+                _pRing = _pDevice->newBuffer( _policy.ringSize(), MTL::ResourceStorageModeManaged );
+            }
+            memcpy( static_cast< uint8_t* >( _pRing->contents() ) + *pOffset, pData, size );
+            return _pRing;
+
+        case UniformUploadPolicy::Route::Dedicated:
+            break;
+    }
+
+    MTL::Buffer* pBuffer = _pDevice->newBuffer( pData, size, MTL::ResourceStorageModeManaged );
+    *pOffset = 0;
+    return pBuffer->autorelease();
+}
+
+void util::UniformUploader::setVertexUniforms( MTL::RenderCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index )
+{
+    size_t offset;
+    if ( MTL::Buffer* pBuffer = write( pData, size, kUniformSlotVertex + (uint32_t)index, &offset ) )
+    {
+        pEnc->setVertexBuffer( pBuffer, offset, index );
+    }
+    else
+    {
+        pEnc->setVertexBytes( pData, size, index );
+    }
+}
+
+void util::UniformUploader::setFragmentUniforms( MTL::RenderCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index )
+{
+    size_t offset;
+    if ( MTL::Buffer* pBuffer = write( pData, size, kUniformSlotFragment + (uint32_t)index, &offset ) )
+    {
+        pEnc->setFragmentBuffer( pBuffer, offset, index );
+    }
+    else
+    {
+        pEnc->setFragmentBytes( pData, size, index );
+    }
+}
+
+void util::UniformUploader::setComputeUniforms( MTL::ComputeCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index )
+{
+    size_t offset;
+    if ( MTL::Buffer* pBuffer = write( pData, size, kUniformSlotCompute + (uint32_t)index, &offset ) )
+    {
+        pEnc->setBuffer( pBuffer, offset, index );
+    }
+    else
+    {
+        pEnc->setBytes( pData, size, index );
+    }
+}
+
+void util::UniformUploader::endFrame()
+{
+    size_t offset, length;
+    if ( _policy.endFrame( &offset, &length ) )
+    {
+        assert( _pRing );
+        _pRing->didModifyRange( NS::Range::Make( offset, length ) );
+    }
+}
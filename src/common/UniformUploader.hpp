@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+#include "UniformRing.hpp"
+
+namespace util
+{
+    // Uploads per-frame uniforms either inline through setVertexBytes() /
+    // setFragmentBytes() or, above the inline threshold, into one managed
+    // ring buffer split into a segment per frame in flight. The ring is
+    // created lazily, so renderers whose uniforms all fit inline never
+    // allocate a buffer. A payload that does not fit in the frame's segment
+    // gets a buffer of its own, and the ring is reallocated larger at the
+    // next beginFrame().
+    class UniformUploader
+    {
+        public:
+            UniformUploader( MTL::Device* pDevice, size_t framesInFlight,
+                             size_t segmentSize = 64 * 1024,
+                             size_t inlineThreshold = UniformUploadPolicy::kDefaultInlineThreshold );
+            ~UniformUploader();
+
+            void setInlineThreshold( size_t bytes ) { _policy.setInlineThreshold( bytes ); }
+
+            void beginFrame( size_t frameIndex );
+            void setVertexUniforms( MTL::RenderCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index );
+            void setFragmentUniforms( MTL::RenderCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index );
+            void setComputeUniforms( MTL::ComputeCommandEncoder* pEnc, const void* pData, size_t size, NS::UInteger index );
+
+            // Flushes everything written to this frame's ring segment with a
+            // single didModifyRange(). Call before committing the command buffer.
+            void endFrame();
+
+            const UniformUploadStats& stats() const { return _policy.stats(); }
+
+        private:
+            // Returns the buffer holding the payload at *pOffset, or null when
+            // it should go inline. Dedicated buffers are autoreleased.
+            MTL::Buffer* write( const void* pData, size_t size, uint32_t slot, size_t* pOffset );
+
+            MTL::Device* _pDevice;
+            MTL::Buffer* _pRing;
+            UniformUploadPolicy _policy;
+    };
+}
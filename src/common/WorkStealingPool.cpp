@@ -0,0 +1,139 @@
+#include "WorkStealingPool.hpp"
+
+util::WorkStealingPool::WorkStealingPool( unsigned threadCount )
+{
+    if ( threadCount == 0 )
+    {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if ( threadCount == 0 )
+    {
+        threadCount = 1;
+    }
+
+    for ( unsigned i = 0; i < threadCount; ++i )
+    {
+        _queues.push_back( std::make_unique< Queue >() );
+    }
+    for ( unsigned i = 1; i < threadCount; ++i )
+    {
+        _threads.emplace_back( &WorkStealingPool::workerMain, this, i );
+    }
+}
+
+util::WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _stop = true;
+    }
+    _wake.notify_all();
+    for ( std::thread& t : _threads )
+    {
+        t.join();
+    }
+}
+
+void util::WorkStealingPool::parallelFor( size_t count, const TaskFunction& fn )
+{
+    if ( count == 0 )
+    {
+        return;
+    }
+
+    unsigned workers = threadCount();
+    {
+        std::lock_guard< std::mutex > lock( _mutex );
+        _pTask = &fn;
+        _remaining = count;
+
+        // Contiguous blocks keep neighbouring indices (adjacent tiles, rows)
+        // on the same worker until stealing kicks in.
+        for ( unsigned w = 0; w < workers; ++w )
+        {
+            size_t begin = count * w / workers;
+            size_t end = count * ( w + 1 ) / workers;
+            std::lock_guard< std::mutex > queueLock( _queues[ w ]->mutex );
+            for ( size_t i = begin; i < end; ++i )
+            {
+                _queues[ w ]->indices.push_back( i );
+            }
+        }
+        ++_generation;
+    }
+    _wake.notify_all();
+
+    drain( 0 );
+
+    std::unique_lock< std::mutex > lock( _mutex );
+    _done.wait( lock, [this]{ return _remaining == 0; } );
+    _pTask = nullptr;
+}
+
+void util::WorkStealingPool::workerMain( unsigned worker )
+{
+    uint64_t seen = 0;
+    for ( ;; )
+    {
+        {
+            std::unique_lock< std::mutex > lock( _mutex );
+            _wake.wait( lock, [&]{ return _stop || _generation != seen; } );
+            if ( _stop )
+            {
+                return;
+            }
+            seen = _generation;
+        }
+        drain( worker );
+    }
+}
+
+void util::WorkStealingPool::drain( unsigned worker )
+{
+    size_t index;
+    while ( pop( worker, &index ) || steal( worker, &index ) )
+    {
+        // The index was queued after _pTask was set, under the same queue
+        // lock we popped it with, so the task is the current one.
+        ( *_pTask )( index, worker );
+
+        std::lock_guard< std::mutex > lock( _mutex );
+        if ( --_remaining == 0 )
+        {
+            _done.notify_all();
+        }
+    }
+}
+
+bool util::WorkStealingPool::pop( unsigned worker, size_t* pIndex )
+{
+    Queue& q = *_queues[ worker ];
+    std::lock_guard< std::mutex > lock( q.mutex );
+    if ( q.indices.empty() )
+    {
+        return false;
+    }
+    *pIndex = q.indices.front();
+    q.indices.pop_front();
+    return true;
+}
+
+bool util::WorkStealingPool::steal( unsigned worker, size_t* pIndex )
+{
+    unsigned workers = threadCount();
+    for ( unsigned i = 1; i < workers; ++i )
+    {
+        Queue& q = *_queues[ ( worker + i ) % workers ];
+        std::lock_guard< std::mutex > lock( q.mutex );
+        if ( !q.indices.empty() )
+        {
+            // Take from the far end of the victim's block so the victim keeps
+            // walking its own indices in order.
+            *pIndex = q.indices.back();
+            q.indices.pop_back();
+            _steals.fetch_add( 1, std::memory_order_relaxed );
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+    // Fixed set of worker threads running parallel-for loops. Each worker
+    // starts on a contiguous block of indices and steals from the back of
+    // other workers' blocks once its own runs dry, which keeps uneven work
+    // (e.g. Mandelbrot tiles near the set) balanced without a shared queue.
+    //
+    // The calling thread takes part as worker 0, so a pool of one thread runs
+    // everything inline.
+    class WorkStealingPool
+    {
+        public:
+            using TaskFunction = std::function< void( size_t index, unsigned worker ) >;
+
+            // threadCount 0 uses one worker per hardware thread.
+            explicit WorkStealingPool( unsigned threadCount = 0 );
+            ~WorkStealingPool();
+
+            WorkStealingPool( const WorkStealingPool& ) = delete;
+            WorkStealingPool& operator=( const WorkStealingPool& ) = delete;
+
+            unsigned threadCount() const { return (unsigned)_queues.size(); }
+
+            // Calls fn for every index in [0, count) and returns when all
+            // calls have finished. Not reentrant.
+            void parallelFor( size_t count, const TaskFunction& fn );
+
+            uint64_t steals() const { return _steals.load( std::memory_order_relaxed ); }
+
+        private:
+            struct Queue
+            {
+                std::mutex mutex;
+                std::deque< size_t > indices;
+            };
+
+            void workerMain( unsigned worker );
+            void drain( unsigned worker );
+            bool pop( unsigned worker, size_t* pIndex );
+            bool steal( unsigned worker, size_t* pIndex );
+
+            std::vector< std::unique_ptr< Queue > > _queues;
+            std::vector< std::thread > _threads;
+            const TaskFunction* _pTask = nullptr;
+
+            std::mutex _mutex;
+            std::condition_variable _wake;
+            std::condition_variable _done;
+            uint64_t _generation = 0;
+            size_t _remaining = 0;
+            bool _stop = false;
+            std::atomic< uint64_t > _steals{ 0 };
+    };
+}
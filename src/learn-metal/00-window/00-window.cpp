@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -25,6 +26,8 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
+#include <common/CpuZones.hpp>
+
 
 #pragma region Declarations {
 
@@ -76,6 +79,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -225,12 +232,15 @@ Renderer::~Renderer()
 void Renderer::draw( MTK::View* pView )
 {
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "encode" );
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
     pEnc->endEncoding();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -27,6 +28,9 @@
 
 #include <simd/simd.h>
 
+#include <common/CpuZones.hpp>
+#include <common/ShaderLibrary.hpp>
+
 
 #pragma region Declarations {
 
@@ -83,6 +87,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -236,6 +244,8 @@ Renderer::~Renderer()
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -265,7 +275,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -295,6 +305,8 @@ void Renderer::buildShaders()
 
 void Renderer::buildBuffers()
 {
+    LEARN_METAL_ZONE( "buildBuffers" );
+
     const size_t NumVertices = 3;
 
     simd::float3 positions[NumVertices] =
@@ -330,8 +342,10 @@ void Renderer::buildBuffers()
 void Renderer::draw( MTK::View* pView )
 {
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "encode" );
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
@@ -342,6 +356,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->endEncoding();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -27,6 +28,10 @@
 
 #include <simd/simd.h>
 
+#include <common/ArgumentTableEncoder.hpp>
+#include <common/CpuZones.hpp>
+#include <common/ShaderLibrary.hpp>
+
 
 #pragma region Declarations {
 
@@ -47,6 +52,7 @@ class Renderer
         MTL::Buffer* _pArgBuffer;
         MTL::Buffer* _pVertexPositionsBuffer;
         MTL::Buffer* _pVertexColorsBuffer;
+        util::ResidencySet _residencySet;
 };
 
 class MyMTKViewDelegate : public MTK::ViewDelegate
@@ -85,6 +91,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -240,6 +250,8 @@ Renderer::~Renderer()
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -273,7 +285,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -303,6 +315,8 @@ void Renderer::buildShaders()
 
 void Renderer::buildBuffers()
 {
+    LEARN_METAL_ZONE( "buildBuffers" );
+
     const size_t NumVertices = 3;
 
     simd::float3 positions[NumVertices] =
@@ -334,42 +348,49 @@ void Renderer::buildBuffers()
     _pVertexPositionsBuffer->didModifyRange( NS::Range::Make( 0, _pVertexPositionsBuffer->length() ) );
     _pVertexColorsBuffer->didModifyRange( NS::Range::Make( 0, _pVertexColorsBuffer->length() ) );
 
-    using NS::StringEncoding::UTF8StringEncoding;
-    assert( _pShaderLibrary );
+    // Describe the VertexData struct once; the layout and the argument
+    // encoder are built from this list instead of from the vertex function.
+    MTL::ArgumentDescriptor* pPositionsArg = MTL::ArgumentDescriptor::argumentDescriptor();
+    pPositionsArg->setIndex( 0 );
+    pPositionsArg->setDataType( MTL::DataTypePointer );
+    pPositionsArg->setAccess( MTL::ArgumentAccessReadOnly );
 
-    MTL::Function* pVertexFn = _pShaderLibrary->newFunction( NS::String::string( "vertexMain", UTF8StringEncoding ) );
-    MTL::ArgumentEncoder* pArgEncoder = pVertexFn->newArgumentEncoder( 0 );
+    MTL::ArgumentDescriptor* pColorsArg = MTL::ArgumentDescriptor::argumentDescriptor();
+    pColorsArg->setIndex( 1 );
+    pColorsArg->setDataType( MTL::DataTypePointer );
+    pColorsArg->setAccess( MTL::ArgumentAccessReadOnly );
 
-    MTL::Buffer* pArgBuffer = _pDevice->newBuffer( pArgEncoder->encodedLength(), MTL::ResourceStorageModeManaged );
-    _pArgBuffer = pArgBuffer;
+    const NS::Object* pArgs[] = { pPositionsArg, pColorsArg };
+    util::ArgumentTableEncoder argEncoder( _pDevice, NS::Array::array( pArgs, 2 ) );
+    argEncoder.setResidencySet( &_residencySet );
 
-    pArgEncoder->setArgumentBuffer( _pArgBuffer, 0 );
+    _pArgBuffer = argEncoder.newTableBuffer( 1 );
 
-    pArgEncoder->setBuffer( _pVertexPositionsBuffer, 0, 0 );
-    pArgEncoder->setBuffer( _pVertexColorsBuffer, 0, 1 );
-
-    _pArgBuffer->didModifyRange( NS::Range::Make( 0, _pArgBuffer->length() ) );
-
-    pVertexFn->release();
-    pArgEncoder->release();
+    argEncoder.encode( _pArgBuffer, 0, 1, [this]( util::ArgumentTableEncoder& enc, size_t ){
+        enc.setBuffer( _pVertexPositionsBuffer, 0, 0 );
+        enc.setBuffer( _pVertexColorsBuffer, 0, 1 );
+    } );
 }
 
 void Renderer::draw( MTK::View* pView )
 {
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "encode" );
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
     pEnc->setRenderPipelineState( _pPSO );
     pEnc->setVertexBuffer( _pArgBuffer, 0, 0 );
-    pEnc->useResource( _pVertexPositionsBuffer, MTL::ResourceUsageRead );
-    pEnc->useResource( _pVertexColorsBuffer, MTL::ResourceUsageRead );
+    _residencySet.bind( pEnc );
     pEnc->drawPrimitives( MTL::PrimitiveType::PrimitiveTypeTriangle, NS::UInteger(0), NS::UInteger(3) );
 
     pEnc->endEncoding();
+    _residencySet.encoderEnded();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -27,6 +28,11 @@
 
 #include <simd/simd.h>
 
+#include <common/ArgumentTableEncoder.hpp>
+#include <common/CpuZones.hpp>
+#include <common/ShaderLibrary.hpp>
+#include <common/UniformUploader.hpp>
+
 
 #pragma region Declarations {
 
@@ -37,7 +43,6 @@ class Renderer
         ~Renderer();
         void buildShaders();
         void buildBuffers();
-        void buildFrameData();
         void draw( MTK::View* pView );
 
     private:
@@ -48,7 +53,8 @@ class Renderer
         MTL::Buffer* _pArgBuffer;
         MTL::Buffer* _pVertexPositionsBuffer;
         MTL::Buffer* _pVertexColorsBuffer;
-        MTL::Buffer* _pFrameData[3];
+        util::ResidencySet _residencySet;
+        util::UniformUploader* _pUniforms;
         float _angle;
         int _frame;
         dispatch_semaphore_t _semaphore;
@@ -91,6 +97,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -235,7 +245,8 @@ Renderer::Renderer( MTL::Device* pDevice )
     _pCommandQueue = _pDevice->newCommandQueue();
     buildShaders();
     buildBuffers();
-    buildFrameData();
+    // FrameData is 4 bytes, so it always goes inline through setVertexBytes()
+    _pUniforms = new util::UniformUploader( _pDevice, Renderer::kMaxFramesInFlight );
 
     _semaphore = dispatch_semaphore_create( Renderer::kMaxFramesInFlight );
 }
@@ -246,10 +257,7 @@ Renderer::~Renderer()
     _pArgBuffer->release();
     _pVertexPositionsBuffer->release();
     _pVertexColorsBuffer->release();
-    for ( int i = 0; i <  Renderer::kMaxFramesInFlight; ++i )
-    {
-        _pFrameData[i]->release();
-    }
+    delete _pUniforms;
     _pPSO->release();
     _pCommandQueue->release();
     _pDevice->release();
@@ -257,6 +265,8 @@ Renderer::~Renderer()
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -297,7 +307,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -327,6 +337,8 @@ void Renderer::buildShaders()
 
 void Renderer::buildBuffers()
 {
+    LEARN_METAL_ZONE( "buildBuffers" );
+
     const size_t NumVertices = 3;
 
     simd::float3 positions[NumVertices] =
@@ -358,24 +370,28 @@ void Renderer::buildBuffers()
     _pVertexPositionsBuffer->didModifyRange( NS::Range::Make( 0, _pVertexPositionsBuffer->length() ) );
     _pVertexColorsBuffer->didModifyRange( NS::Range::Make( 0, _pVertexColorsBuffer->length() ) );
 
-    using NS::StringEncoding::UTF8StringEncoding;
-    assert( _pShaderLibrary );
-
-    MTL::Function* pVertexFn = _pShaderLibrary->newFunction( NS::String::string( "vertexMain", UTF8StringEncoding ) );
-    MTL::ArgumentEncoder* pArgEncoder = pVertexFn->newArgumentEncoder( 0 );
+    // Describe the VertexData struct once; the layout and the argument
+    // encoder are built from this list instead of from the vertex function.
+    MTL::ArgumentDescriptor* pPositionsArg = MTL::ArgumentDescriptor::argumentDescriptor();
+    pPositionsArg->setIndex( 0 );
+    pPositionsArg->setDataType( MTL::DataTypePointer );
+    pPositionsArg->setAccess( MTL::ArgumentAccessReadOnly );
 
-    MTL::Buffer* pArgBuffer = _pDevice->newBuffer( pArgEncoder->encodedLength(), MTL::ResourceStorageModeManaged );
-    _pArgBuffer = pArgBuffer;
+    MTL::ArgumentDescriptor* pColorsArg = MTL::ArgumentDescriptor::argumentDescriptor();
+    pColorsArg->setIndex( 1 );
+    pColorsArg->setDataType( MTL::DataTypePointer );
+    pColorsArg->setAccess( MTL::ArgumentAccessReadOnly );
 
-    pArgEncoder->setArgumentBuffer( _pArgBuffer, 0 );
+    const NS::Object* pArgs[] = { pPositionsArg, pColorsArg };
+    util::ArgumentTableEncoder argEncoder( _pDevice, NS::Array::array( pArgs, 2 ) );
+    argEncoder.setResidencySet( &_residencySet );
 
-    pArgEncoder->setBuffer( _pVertexPositionsBuffer, 0, 0 );
-    pArgEncoder->setBuffer( _pVertexColorsBuffer, 0, 1 );
+    _pArgBuffer = argEncoder.newTableBuffer( 1 );
 
-    _pArgBuffer->didModifyRange( NS::Range::Make( 0, _pArgBuffer->length() ) );
-
-    pVertexFn->release();
-    pArgEncoder->release();
+    argEncoder.encode( _pArgBuffer, 0, 1, [this]( util::ArgumentTableEncoder& enc, size_t ){
+        enc.setBuffer( _pVertexPositionsBuffer, 0, 0 );
+        enc.setBuffer( _pVertexColorsBuffer, 0, 1 );
+    } );
 }
 
 struct FrameData
@@ -383,44 +399,42 @@ struct FrameData
     float angle;
 };
 
-void Renderer::buildFrameData()
-{
-    for ( int i = 0; i < Renderer::kMaxFramesInFlight; ++i )
-    {
-        _pFrameData[ i ]= _pDevice->newBuffer( sizeof( FrameData ), MTL::ResourceStorageModeManaged );
-    }
-}
-
 void Renderer::draw( MTK::View* pView )
 {
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
-    MTL::Buffer* pFrameDataBuffer = _pFrameData[ _frame ];
+    _pUniforms->beginFrame( _frame );
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
-    reinterpret_cast< FrameData * >( pFrameDataBuffer->contents() )->angle = (_angle += 0.01f);
-    pFrameDataBuffer->didModifyRange( NS::Range::Make( 0, sizeof( FrameData ) ) );
+    FrameData frameData;
+    frameData.angle = (_angle += 0.01f);
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
     pEnc->setRenderPipelineState( _pPSO );
     pEnc->setVertexBuffer( _pArgBuffer, 0, 0 );
-    pEnc->useResource( _pVertexPositionsBuffer, MTL::ResourceUsageRead );
-    pEnc->useResource( _pVertexColorsBuffer, MTL::ResourceUsageRead );
+    _residencySet.bind( pEnc );
 
-    pEnc->setVertexBuffer( pFrameDataBuffer, 0, 1 );
+    _pUniforms->setVertexUniforms( pEnc, &frameData, sizeof( frameData ), /* index */ 1 );
     pEnc->drawPrimitives( MTL::PrimitiveType::PrimitiveTypeTriangle, NS::UInteger(0), NS::UInteger(3) );
 
     pEnc->endEncoding();
+    _residencySet.encoderEnded();
+    _pUniforms->endFrame();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
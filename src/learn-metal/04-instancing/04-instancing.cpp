@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -25,7 +26,9 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
-#include <simd/simd.h>
+#include <common/CpuZones.hpp>
+#include <common/Math.hpp>
+#include <common/ShaderLibrary.hpp>
 
 static constexpr size_t kNumInstances = 32;
 static constexpr size_t kMaxFramesInFlight = 3;
@@ -33,6 +36,8 @@ static constexpr size_t kMaxFramesInFlight = 3;
 
 #pragma region Declarations {
 
+namespace math = util::math;
+
 class Renderer
 {
     public:
@@ -92,6 +97,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -258,13 +267,15 @@ namespace shader_types
 {
     struct InstanceData
     {
-        simd::float4x4 instanceTransform;
-        simd::float4 instanceColor;
+        math::float4x4 instanceTransform;
+        math::float4 instanceColor;
     };
 }
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -307,7 +318,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -337,7 +348,9 @@ void Renderer::buildShaders()
 
 void Renderer::buildBuffers()
 {
-    using simd::float3;
+    LEARN_METAL_ZONE( "buildBuffers" );
+
+    using math::float3;
 
     const float s = 0.5f;
 
@@ -377,32 +390,37 @@ void Renderer::buildBuffers()
 
 void Renderer::draw( MTK::View* pView )
 {
-    using simd::float4;
-    using simd::float4x4;
+    using math::float4;
+    using math::float4x4;
 
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
     MTL::Buffer* pInstanceDataBuffer = _pInstanceDataBuffer[ _frame ];
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
     _angle += 0.01f;
 
     const float scl = 0.1f;
+    const float scaledSin = scl * sinf(_angle);
+    const float scaledCos = scl * cosf(_angle);
     shader_types::InstanceData* pInstanceData = reinterpret_cast< shader_types::InstanceData *>( pInstanceDataBuffer->contents() );
     for ( size_t i = 0; i < kNumInstances; ++i )
     {
         float iDivNumInstances = i / (float)kNumInstances;
         float xoff = (iDivNumInstances * 2.0f - 1.0f) + (1.f/kNumInstances);
         float yoff = sin( ( iDivNumInstances + _angle ) * 2.0f * M_PI);
-        pInstanceData[ i ].instanceTransform = (float4x4){ (float4){ scl * sinf(_angle), scl * cosf(_angle), 0.f, 0.f },
-                                                           (float4){ scl * cosf(_angle), scl * -sinf(_angle), 0.f, 0.f },
+        pInstanceData[ i ].instanceTransform = (float4x4){ (float4){ scaledSin, scaledCos, 0.f, 0.f },
+                                                           (float4){ scaledCos, -scaledSin, 0.f, 0.f },
                                                            (float4){ 0.f, 0.f, scl, 0.f },
                                                            (float4){ xoff, yoff, 0.f, 1.f } };
 
@@ -414,6 +432,7 @@ void Renderer::draw( MTK::View* pView )
     pInstanceDataBuffer->didModifyRange( NS::Range::Make( 0, pInstanceDataBuffer->length() ) );
 
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
@@ -432,6 +451,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->endEncoding();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
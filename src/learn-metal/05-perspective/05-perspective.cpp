@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -25,7 +26,10 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
-#include <simd/simd.h>
+#include <common/CpuZones.hpp>
+#include <common/Math.hpp>
+#include <common/ShaderLibrary.hpp>
+#include <common/UniformUploader.hpp>
 
 static constexpr size_t kNumInstances = 32;
 static constexpr size_t kMaxFramesInFlight = 3;
@@ -33,17 +37,7 @@ static constexpr size_t kMaxFramesInFlight = 3;
 
 #pragma region Declarations {
 
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b );
-    constexpr simd_float4x4 makeIdentity();
-    simd::float4x4 makePerspective();
-    simd::float4x4 makeXRotate( float angleRadians );
-    simd::float4x4 makeYRotate( float angleRadians );
-    simd::float4x4 makeZRotate( float angleRadians );
-    simd::float4x4 makeTranslate( const simd::float3& v );
-    simd::float4x4 makeScale( const simd::float3& v );
-}
+namespace math = util::math;
 
 class Renderer
 {
@@ -63,7 +57,7 @@ class Renderer
         MTL::DepthStencilState* _pDepthStencilState;
         MTL::Buffer* _pVertexDataBuffer;
         MTL::Buffer* _pInstanceDataBuffer[kMaxFramesInFlight];
-        MTL::Buffer* _pCameraDataBuffer[kMaxFramesInFlight];
+        util::UniformUploader* _pUniforms;
         MTL::Buffer* _pIndexBuffer;
         float _angle;
         int _frame;
@@ -107,6 +101,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -240,88 +238,6 @@ void MyMTKViewDelegate::drawInMTKView( MTK::View* pView )
 #pragma endregion ViewDelegate }
 
 
-#pragma mark - Math
-
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b )
-    {
-        return { a.x + b.x, a.y + b.y, a.z + b.z };
-    }
-
-    constexpr simd_float4x4 makeIdentity()
-    {
-        using simd::float4;
-        return (simd_float4x4){ (float4){ 1.f, 0.f, 0.f, 0.f },
-                                (float4){ 0.f, 1.f, 0.f, 0.f },
-                                (float4){ 0.f, 0.f, 1.f, 0.f },
-                                (float4){ 0.f, 0.f, 0.f, 1.f } };
-    }
-
-    simd::float4x4 makePerspective( float fovRadians, float aspect, float znear, float zfar )
-    {
-        using simd::float4;
-        float ys = 1.f / tanf(fovRadians * 0.5f);
-        float xs = ys / aspect;
-        float zs = zfar / ( znear - zfar );
-        return simd_matrix_from_rows((float4){ xs, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, ys, 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, zs, znear * zs },
-                                     (float4){ 0, 0, -1, 0 });
-    }
-
-    simd::float4x4 makeXRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ 1.0f, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, cosf( a ), sinf( a ), 0.0f },
-                                     (float4){ 0.0f, -sinf( a ), cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeYRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), 0.0f, sinf( a ), 0.0f },
-                                     (float4){ 0.0f, 1.0f, 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), 0.0f, cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeZRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), sinf( a ), 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), cosf( a ), 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 1.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeTranslate( const simd::float3& v )
-    {
-        using simd::float4;
-        const float4 col0 = { 1.0f, 0.0f, 0.0f, 0.0f };
-        const float4 col1 = { 0.0f, 1.0f, 0.0f, 0.0f };
-        const float4 col2 = { 0.0f, 0.0f, 1.0f, 0.0f };
-        const float4 col3 = { v.x, v.y, v.z, 1.0f };
-        return simd_matrix( col0, col1, col2, col3 );
-    }
-
-    simd::float4x4 makeScale( const simd::float3& v )
-    {
-        using simd::float4;
-        return simd_matrix((float4){ v.x, 0, 0, 0 },
-                           (float4){ 0, v.y, 0, 0 },
-                           (float4){ 0, 0, v.z, 0 },
-                           (float4){ 0, 0, 0, 1.0 });
-    }
-
-}
-
-
 #pragma mark - Renderer
 #pragma region Renderer {
 
@@ -349,10 +265,7 @@ Renderer::~Renderer()
     {
         _pInstanceDataBuffer[i]->release();
     }
-    for ( int i = 0; i < kMaxFramesInFlight; ++i )
-    {
-        _pCameraDataBuffer[i]->release();
-    }
+    delete _pUniforms;
     _pIndexBuffer->release();
     _pPSO->release();
     _pCommandQueue->release();
@@ -363,19 +276,21 @@ namespace shader_types
 {
     struct InstanceData
     {
-        simd::float4x4 instanceTransform;
-        simd::float4 instanceColor;
+        math::float4x4 instanceTransform;
+        math::float4 instanceColor;
     };
 
     struct CameraData
     {
-        simd::float4x4 perspectiveTransform;
-        simd::float4x4 worldTransform;
+        math::float4x4 perspectiveTransform;
+        math::float4x4 worldTransform;
     };
 }
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -407,7 +322,7 @@ void Renderer::buildShaders()
 
         v2f vertex vertexMain( device const VertexData* vertexData [[buffer(0)]],
                                device const InstanceData* instanceData [[buffer(1)]],
-                               device const CameraData& cameraData [[buffer(2)]],
+                               constant CameraData& cameraData [[buffer(2)]],
                                uint vertexId [[vertex_id]],
                                uint instanceId [[instance_id]] )
         {
@@ -427,7 +342,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -469,7 +384,9 @@ void Renderer::buildDepthStencilStates()
 
 void Renderer::buildBuffers()
 {
-    using simd::float3;
+    LEARN_METAL_ZONE( "buildBuffers" );
+
+    using math::float3;
     const float s = 0.5f;
 
     float3 verts[] = {
@@ -525,30 +442,31 @@ void Renderer::buildBuffers()
         _pInstanceDataBuffer[ i ] = _pDevice->newBuffer( instanceDataSize, MTL::ResourceStorageModeManaged );
     }
 
-    const size_t cameraDataSize = kMaxFramesInFlight * sizeof( shader_types::CameraData );
-    for ( size_t i = 0; i < kMaxFramesInFlight; ++i )
-    {
-        _pCameraDataBuffer[ i ] = _pDevice->newBuffer( cameraDataSize, MTL::ResourceStorageModeManaged );
-    }
+    // Camera data is small enough to go through setVertexBytes(); no per-frame buffers needed.
+    _pUniforms = new util::UniformUploader( _pDevice, kMaxFramesInFlight );
 }
 
 void Renderer::draw( MTK::View* pView )
 {
-    using simd::float3;
-    using simd::float4;
-    using simd::float4x4;
+    using math::float3;
+    using math::float4;
+    using math::float4x4;
 
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
+    _pUniforms->beginFrame( _frame );
     MTL::Buffer* pInstanceDataBuffer = _pInstanceDataBuffer[ _frame ];
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
     _angle += 0.01f;
 
@@ -564,19 +482,22 @@ void Renderer::draw( MTK::View* pView )
     float4x4 rtInv = math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
     float4x4 fullObjectRot = rt * rr * rtInv;
 
+    // Use the tiny math library to apply a 3D transformation to the instances.
+    // Every instance spins the same way, so only the translation is per instance.
+    float4x4 scale = math::makeScale( (float3){ scl, scl, scl } );
+    float4x4 zrot = math::makeZRotate( _angle );
+    float4x4 yrot = math::makeYRotate( _angle );
+    float4x4 spin = yrot * zrot * scale;
+
     for ( size_t i = 0; i < kNumInstances; ++i )
     {
         float iDivNumInstances = i / (float)kNumInstances;
         float xoff = (iDivNumInstances * 2.0f - 1.0f) + (1.f/kNumInstances);
         float yoff = sin( ( iDivNumInstances + _angle ) * 2.0f * M_PI);
 
-        // Use the tiny math library to apply a 3D transformation to the instance.
-        float4x4 scale = math::makeScale( (float3){ scl, scl, scl } );
-        float4x4 zrot = math::makeZRotate( _angle );
-        float4x4 yrot = math::makeYRotate( _angle );
         float4x4 translate = math::makeTranslate( math::add( objectPosition, { xoff, yoff, 0.f } ) );
 
-        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
+        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * spin;
 
         float r = iDivNumInstances;
         float g = 1.0f - r;
@@ -587,12 +508,11 @@ void Renderer::draw( MTK::View* pView )
 
     // Update camera state:
 
-    MTL::Buffer* pCameraDataBuffer = _pCameraDataBuffer[ _frame ];
-    shader_types::CameraData* pCameraData = reinterpret_cast< shader_types::CameraData *>( pCameraDataBuffer->contents() );
-    pCameraData->perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
-    pCameraData->worldTransform = math::makeIdentity();
-    pCameraDataBuffer->didModifyRange( NS::Range::Make( 0, sizeof( shader_types::CameraData ) ) );
+    shader_types::CameraData cameraData;
+    cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
+    cameraData.worldTransform = math::makeIdentity();
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     // Begin render pass:
 
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
@@ -603,7 +523,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->setVertexBuffer( _pVertexDataBuffer, /* offset */ 0, /* index */ 0 );
     pEnc->setVertexBuffer( pInstanceDataBuffer, /* offset */ 0, /* index */ 1 );
-    pEnc->setVertexBuffer( pCameraDataBuffer, /* offset */ 0, /* index */ 2 );
+    _pUniforms->setVertexUniforms( pEnc, &cameraData, sizeof( cameraData ), /* index */ 2 );
 
     pEnc->setCullMode( MTL::CullModeBack );
     pEnc->setFrontFacingWinding( MTL::Winding::WindingCounterClockwise );
@@ -615,7 +535,9 @@ void Renderer::draw( MTK::View* pView )
                                 kNumInstances );
 
     pEnc->endEncoding();
+    _pUniforms->endFrame();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -25,29 +26,25 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
-#include <simd/simd.h>
+#include <common/CpuZones.hpp>
+#include <common/InstanceTransforms.hpp>
+#include <common/Math.hpp>
+#include <common/ShaderLibrary.hpp>
+#include <common/UniformUploader.hpp>
+
+#include <vector>
 
 static constexpr size_t kInstanceRows = 10;
 static constexpr size_t kInstanceColumns = 10;
 static constexpr size_t kInstanceDepth = 10;
 static constexpr size_t kNumInstances = (kInstanceRows * kInstanceColumns * kInstanceDepth);
+static constexpr float kInstanceScale = 0.2f;
 static constexpr size_t kMaxFramesInFlight = 3;
 
 
 #pragma region Declarations {
 
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b );
-    constexpr simd_float4x4 makeIdentity();
-    simd::float4x4 makePerspective();
-    simd::float4x4 makeXRotate( float angleRadians );
-    simd::float4x4 makeYRotate( float angleRadians );
-    simd::float4x4 makeZRotate( float angleRadians );
-    simd::float4x4 makeTranslate( const simd::float3& v );
-    simd::float4x4 makeScale( const simd::float3& v );
-    simd::float3x3 discardTranslation( const simd::float4x4& m );
-}
+namespace math = util::math;
 
 class Renderer
 {
@@ -67,8 +64,14 @@ class Renderer
         MTL::DepthStencilState* _pDepthStencilState;
         MTL::Buffer* _pVertexDataBuffer;
         MTL::Buffer* _pInstanceDataBuffer[kMaxFramesInFlight];
-        MTL::Buffer* _pCameraDataBuffer[kMaxFramesInFlight];
+        util::UniformUploader* _pUniforms;
         MTL::Buffer* _pIndexBuffer;
+        // Instance inputs for util::buildInstanceTransforms(), one array per
+        // component. Spin factors scale _angle into per-instance y/z angles.
+        std::vector< float > _instancePosition[3];
+        std::vector< float > _instanceSpin[2];
+        std::vector< float > _instanceRotation[2];
+        std::vector< float > _instanceColor[3];
         float _angle;
         int _frame;
         dispatch_semaphore_t _semaphore;
@@ -111,6 +114,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -244,93 +251,6 @@ void MyMTKViewDelegate::drawInMTKView( MTK::View* pView )
 #pragma endregion ViewDelegate }
 
 
-#pragma mark - Math
-
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b )
-    {
-        return { a.x + b.x, a.y + b.y, a.z + b.z };
-    }
-
-    constexpr simd_float4x4 makeIdentity()
-    {
-        using simd::float4;
-        return (simd_float4x4){ (float4){ 1.f, 0.f, 0.f, 0.f },
-                                (float4){ 0.f, 1.f, 0.f, 0.f },
-                                (float4){ 0.f, 0.f, 1.f, 0.f },
-                                (float4){ 0.f, 0.f, 0.f, 1.f } };
-    }
-
-    simd::float4x4 makePerspective( float fovRadians, float aspect, float znear, float zfar )
-    {
-        using simd::float4;
-        float ys = 1.f / tanf(fovRadians * 0.5f);
-        float xs = ys / aspect;
-        float zs = zfar / ( znear - zfar );
-        return simd_matrix_from_rows((float4){ xs, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, ys, 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, zs, znear * zs },
-                                     (float4){ 0, 0, -1, 0 });
-    }
-
-    simd::float4x4 makeXRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ 1.0f, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, cosf( a ), sinf( a ), 0.0f },
-                                     (float4){ 0.0f, -sinf( a ), cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeYRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), 0.0f, sinf( a ), 0.0f },
-                                     (float4){ 0.0f, 1.0f, 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), 0.0f, cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeZRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), sinf( a ), 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), cosf( a ), 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 1.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeTranslate( const simd::float3& v )
-    {
-        using simd::float4;
-        const float4 col0 = { 1.0f, 0.0f, 0.0f, 0.0f };
-        const float4 col1 = { 0.0f, 1.0f, 0.0f, 0.0f };
-        const float4 col2 = { 0.0f, 0.0f, 1.0f, 0.0f };
-        const float4 col3 = { v.x, v.y, v.z, 1.0f };
-        return simd_matrix( col0, col1, col2, col3 );
-    }
-
-    simd::float4x4 makeScale( const simd::float3& v )
-    {
-        using simd::float4;
-        return simd_matrix((float4){ v.x, 0, 0, 0 },
-                           (float4){ 0, v.y, 0, 0 },
-                           (float4){ 0, 0, v.z, 0 },
-                           (float4){ 0, 0, 0, 1.0 });
-    }
-
-    simd::float3x3 discardTranslation( const simd::float4x4& m )
-    {
-        return simd_matrix( m.columns[0].xyz, m.columns[1].xyz, m.columns[2].xyz );
-    }
-
-}
-
-
 #pragma mark - Renderer
 #pragma region Renderer {
 
@@ -358,10 +278,7 @@ Renderer::~Renderer()
     {
         _pInstanceDataBuffer[i]->release();
     }
-    for ( int i = 0; i < kMaxFramesInFlight; ++i )
-    {
-        _pCameraDataBuffer[i]->release();
-    }
+    delete _pUniforms;
     _pIndexBuffer->release();
     _pPSO->release();
     _pCommandQueue->release();
@@ -372,27 +289,29 @@ namespace shader_types
 {
     struct VertexData
     {
-        simd::float3 position;
-        simd::float3 normal;
+        math::float3 position;
+        math::float3 normal;
     };
 
     struct InstanceData
     {
-        simd::float4x4 instanceTransform;
-        simd::float3x3 instanceNormalTransform;
-        simd::float4 instanceColor;
+        math::float4x4 instanceTransform;
+        math::float3x3 instanceNormalTransform;
+        math::float4 instanceColor;
     };
 
     struct CameraData
     {
-        simd::float4x4 perspectiveTransform;
-        simd::float4x4 worldTransform;
-        simd::float3x3 worldNormalTransform;
+        math::float4x4 perspectiveTransform;
+        math::float4x4 worldTransform;
+        math::float3x3 worldNormalTransform;
     };
 }
 
 void Renderer::buildShaders()
 {
+    LEARN_METAL_ZONE( "buildShaders" );
+
     using NS::StringEncoding::UTF8StringEncoding;
 
     const char* shaderSrc = R"(
@@ -428,7 +347,7 @@ void Renderer::buildShaders()
 
         v2f vertex vertexMain( device const VertexData* vertexData [[buffer(0)]],
                                device const InstanceData* instanceData [[buffer(1)]],
-                               device const CameraData& cameraData [[buffer(2)]],
+                               constant CameraData& cameraData [[buffer(2)]],
                                uint vertexId [[vertex_id]],
                                uint instanceId [[instance_id]] )
         {
@@ -460,7 +379,7 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = util::newShaderLibrary( _pDevice, shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -502,7 +421,9 @@ void Renderer::buildDepthStencilStates()
 
 void Renderer::buildBuffers()
 {
-    using simd::float3;
+    LEARN_METAL_ZONE( "buildBuffers" );
+
+    using math::float3;
     const float s = 0.5f;
 
     shader_types::VertexData verts[] = {
@@ -568,36 +489,76 @@ void Renderer::buildBuffers()
         _pInstanceDataBuffer[ i ] = _pDevice->newBuffer( instanceDataSize, MTL::ResourceStorageModeManaged );
     }
 
-    const size_t cameraDataSize = kMaxFramesInFlight * sizeof( shader_types::CameraData );
-    for ( size_t i = 0; i < kMaxFramesInFlight; ++i )
+    // Camera data is small enough to go through setVertexBytes(); no per-frame buffers needed.
+    _pUniforms = new util::UniformUploader( _pDevice, kMaxFramesInFlight );
+
+    // Everything about an instance but its angles is fixed, so compute it once.
+    const float scl = kInstanceScale;
+    const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+    for ( std::vector< float >* pArray : { &_instancePosition[0], &_instancePosition[1], &_instancePosition[2],
+                                           &_instanceSpin[0], &_instanceSpin[1], &_instanceRotation[0], &_instanceRotation[1],
+                                           &_instanceColor[0], &_instanceColor[1], &_instanceColor[2] } )
     {
-        _pCameraDataBuffer[ i ] = _pDevice->newBuffer( cameraDataSize, MTL::ResourceStorageModeManaged );
+        pArray->resize( kNumInstances );
+    }
+
+    size_t ix = 0;
+    size_t iy = 0;
+    size_t iz = 0;
+    for ( size_t i = 0; i < kNumInstances; ++i )
+    {
+        if ( ix == kInstanceRows )
+        {
+            ix = 0;
+            iy += 1;
+        }
+        if ( iy == kInstanceRows )
+        {
+            iy = 0;
+            iz += 1;
+        }
+
+        _instancePosition[0][i] = objectPosition.x + ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
+        _instancePosition[1][i] = objectPosition.y + ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
+        _instancePosition[2][i] = objectPosition.z + ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
+        _instanceSpin[0][i] = cosf((float)iy);
+        _instanceSpin[1][i] = sinf((float)ix);
+
+        float iDivNumInstances = i / (float)kNumInstances;
+        _instanceColor[0][i] = iDivNumInstances;
+        _instanceColor[1][i] = 1.0f - iDivNumInstances;
+        _instanceColor[2][i] = sinf( M_PI * 2.0f * iDivNumInstances );
+
+        ix += 1;
     }
 }
 
 void Renderer::draw( MTK::View* pView )
 {
-    using simd::float3;
-    using simd::float4;
-    using simd::float4x4;
+    using math::float3;
+    using math::float4;
+    using math::float4x4;
 
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
+    _pUniforms->beginFrame( _frame );
     MTL::Buffer* pInstanceDataBuffer = _pInstanceDataBuffer[ _frame ];
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
     _angle += 0.002f;
 
     // Update instance positions:
 
-    const float scl = 0.2f;
     shader_types::InstanceData* pInstanceData = reinterpret_cast< shader_types::InstanceData *>( pInstanceDataBuffer->contents() );
 
     float3 objectPosition = { 0.f, 0.f, -10.f };
@@ -608,53 +569,37 @@ void Renderer::draw( MTK::View* pView )
     float4x4 rtInv = math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
     float4x4 fullObjectRot = rt * rr1 * rr0 * rtInv;
 
-    size_t ix = 0;
-    size_t iy = 0;
-    size_t iz = 0;
+    // fullObjectRot * translate * yrot * zrot * scale, composed in closed form
+    util::InstanceTransformInputs instanceInputs;
+    instanceInputs.pPositionX = _instancePosition[0].data();
+    instanceInputs.pPositionY = _instancePosition[1].data();
+    instanceInputs.pPositionZ = _instancePosition[2].data();
+    instanceInputs.pRotationY = _instanceRotation[0].data();
+    instanceInputs.pRotationZ = _instanceRotation[1].data();
+    instanceInputs.uniformScale = kInstanceScale;
+    instanceInputs.pColorR = _instanceColor[0].data();
+    instanceInputs.pColorG = _instanceColor[1].data();
+    instanceInputs.pColorB = _instanceColor[2].data();
+
     for ( size_t i = 0; i < kNumInstances; ++i )
     {
-        if ( ix == kInstanceRows )
-        {
-            ix = 0;
-            iy += 1;
-        }
-        if ( iy == kInstanceRows )
-        {
-            iy = 0;
-            iz += 1;
-        }
-
-        float4x4 scale = math::makeScale( (float3){ scl, scl, scl } );
-        float4x4 zrot = math::makeZRotate( _angle * sinf((float)ix) );
-        float4x4 yrot = math::makeYRotate( _angle * cosf((float)iy));
-
-        float x = ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
-        float y = ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
-        float z = ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
-        float4x4 translate = math::makeTranslate( math::add( objectPosition, { x, y, z } ) );
-
-        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
-        pInstanceData[ i ].instanceNormalTransform = math::discardTranslation( pInstanceData[ i ].instanceTransform );
-
-        float iDivNumInstances = i / (float)kNumInstances;
-        float r = iDivNumInstances;
-        float g = 1.0f - r;
-        float b = sinf( M_PI * 2.0f * iDivNumInstances );
-        pInstanceData[ i ].instanceColor = (float4){ r, g, b, 1.0f };
-
-        ix += 1;
+        _instanceRotation[0][i] = _angle * _instanceSpin[0][i];
+        _instanceRotation[1][i] = _angle * _instanceSpin[1][i];
     }
+
+    static_assert( sizeof( shader_types::InstanceData ) == sizeof( util::InstanceRecord ), "InstanceData layout mismatch" );
+    util::buildInstanceTransforms( instanceInputs, 0, kNumInstances, reinterpret_cast< const float* >( &fullObjectRot ),
+                                   reinterpret_cast< util::InstanceRecord* >( pInstanceData ) );
     pInstanceDataBuffer->didModifyRange( NS::Range::Make( 0, pInstanceDataBuffer->length() ) );
 
     // Update camera state:
 
-    MTL::Buffer* pCameraDataBuffer = _pCameraDataBuffer[ _frame ];
-    shader_types::CameraData* pCameraData = reinterpret_cast< shader_types::CameraData *>( pCameraDataBuffer->contents() );
-    pCameraData->perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
-    pCameraData->worldTransform = math::makeIdentity();
-    pCameraData->worldNormalTransform = math::discardTranslation( pCameraData->worldTransform );
-    pCameraDataBuffer->didModifyRange( NS::Range::Make( 0, sizeof( shader_types::CameraData ) ) );
+    shader_types::CameraData cameraData;
+    cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
+    cameraData.worldTransform = math::makeIdentity();
+    cameraData.worldNormalTransform = math::discardTranslation( cameraData.worldTransform );
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     // Begin render pass:
 
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
@@ -665,7 +610,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->setVertexBuffer( _pVertexDataBuffer, /* offset */ 0, /* index */ 0 );
     pEnc->setVertexBuffer( pInstanceDataBuffer, /* offset */ 0, /* index */ 1 );
-    pEnc->setVertexBuffer( pCameraDataBuffer, /* offset */ 0, /* index */ 2 );
+    _pUniforms->setVertexUniforms( pEnc, &cameraData, sizeof( cameraData ), /* index */ 2 );
 
     pEnc->setCullMode( MTL::CullModeBack );
     pEnc->setFrontFacingWinding( MTL::Winding::WindingCounterClockwise );
@@ -677,7 +622,9 @@ void Renderer::draw( MTK::View* pView )
                                 kNumInstances );
 
     pEnc->endEncoding();
+    _pUniforms->endFrame();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
 
     pPool->release();
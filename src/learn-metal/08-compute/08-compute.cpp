@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
@@ -25,31 +26,34 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
-#include <simd/simd.h>
+#include <common/CommandBufferTelemetry.hpp>
+#include <common/CpuZones.hpp>
+#include <common/HeadlessRunner.hpp>
+#include <common/InstanceTransforms.hpp>
+#include <common/MandelbrotCpu.hpp>
+#include <common/Math.hpp>
+#include <common/OffscreenTarget.hpp>
+#include <common/ParallelInstanceUpdater.hpp>
+#include <common/PipelineCache.hpp>
+#include <common/ShaderLayout.hpp>
+#include <common/UniformUploader.hpp>
+
+#include <vector>
 
 static constexpr size_t kInstanceRows = 10;
 static constexpr size_t kInstanceColumns = 10;
 static constexpr size_t kInstanceDepth = 10;
 static constexpr size_t kNumInstances = (kInstanceRows * kInstanceColumns * kInstanceDepth);
+static constexpr float kInstanceScale = 0.2f;
 static constexpr size_t kMaxFramesInFlight = 3;
 static constexpr uint32_t kTextureWidth = 128;
 static constexpr uint32_t kTextureHeight = 128;
+static constexpr int kTelemetryReportFrames = 600;
 
 
 #pragma region Declarations {
 
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b );
-    constexpr simd_float4x4 makeIdentity();
-    simd::float4x4 makePerspective();
-    simd::float4x4 makeXRotate( float angleRadians );
-    simd::float4x4 makeYRotate( float angleRadians );
-    simd::float4x4 makeZRotate( float angleRadians );
-    simd::float4x4 makeTranslate( const simd::float3& v );
-    simd::float4x4 makeScale( const simd::float3& v );
-    simd::float3x3 discardTranslation( const simd::float4x4& m );
-}
+namespace math = util::math;
 
 class Renderer
 {
@@ -62,7 +66,11 @@ class Renderer
         void buildTextures();
         void buildBuffers();
         void generateMandelbrotTexture();
-        void draw( MTK::View* pView );
+        // pDrawable is presented when not null.
+        void draw( MTL::RenderPassDescriptor* pRpd, MTL::Drawable* pDrawable );
+        // Blocks until every frame in flight has completed.
+        void waitIdle();
+        MTL::CommandQueue* commandQueue() const { return _pCommandQueue; }
 
     private:
         MTL::Device* _pDevice;
@@ -70,14 +78,25 @@ class Renderer
         MTL::Library* _pShaderLibrary;
         MTL::RenderPipelineState* _pPSO;
         MTL::ComputePipelineState* _pComputePSO;
+        util::PipelineCache* _pPipelineCache;
         MTL::DepthStencilState* _pDepthStencilState;
         MTL::Texture* _pTexture;
         MTL::Buffer* _pVertexDataBuffer;
         MTL::Buffer* _pInstanceDataBuffer[kMaxFramesInFlight];
-        MTL::Buffer* _pCameraDataBuffer[kMaxFramesInFlight];
+        util::UniformUploader* _pUniforms;
         MTL::Buffer* _pIndexBuffer;
+        // Instance inputs for util::buildInstanceTransforms(), one array per
+        // component. Spin factors scale _angle into per-instance y/z angles.
+        std::vector< float > _instancePosition[3];
+        std::vector< float > _instanceSpin[2];
+        std::vector< float > _instanceRotation[2];
+        std::vector< float > _instanceColor[3];
+        util::WorkStealingPool* _pInstancePool;
+        util::ParallelInstanceUpdater* _pInstanceUpdater;
         float _angle;
         int _frame;
+        int _framesSinceReport;
+        util::CommandBufferTelemetry _telemetry;
         dispatch_semaphore_t _semaphore;
         static const int kMaxFramesInFlight;
 };
@@ -114,10 +133,75 @@ class MyAppDelegate : public NS::ApplicationDelegate
 #pragma endregion Declarations }
 
 
+// Renders options.frames frames into offscreen textures the size of
+// options, then writes the last one to options.imagePath. Without a Metal
+// device it writes the CPU version of the compute kernel's texture instead.
+static int runHeadless( const util::HeadlessOptions& options )
+{
+    MTL::Device* pDevice = MTL::CreateSystemDefaultDevice();
+    if ( !pDevice )
+    {
+        __builtin_printf( "No Metal device, computing the Mandelbrot texture on the CPU\n" );
+        std::vector< uint32_t > iterations( (size_t)options.width * options.height );
+        util::mandelbrotImage( util::MandelbrotParams(), options.width, options.height, iterations.data(), nullptr,
+                               util::bestMandelbrotPath() );
+
+        util::Image image;
+        image.width = options.width;
+        image.height = options.height;
+        image.rgba.resize( iterations.size() * 4 );
+        util::mandelbrotColors( iterations.data(), iterations.size(), image.rgba.data() );
+        bool ok = image.writePpm( options.imagePath.c_str() );
+        if ( ok )
+        {
+            __builtin_printf( "Wrote %s\n", options.imagePath.c_str() );
+        }
+        return ok ? 0 : 1;
+    }
+
+    Renderer* pRenderer = new Renderer( pDevice );
+    util::OffscreenTarget* pTarget = new util::OffscreenTarget( pDevice, options.width, options.height,
+                                                                MTL::PixelFormat::PixelFormatBGRA8Unorm_sRGB,
+                                                                MTL::PixelFormat::PixelFormatDepth16Unorm,
+                                                                MTL::ClearColor::Make( 0.1, 0.1, 0.1, 1.0 ) );
+
+    util::HeadlessStats stats;
+    util::runHeadlessFrames( options.frames,
+                             [&]( uint32_t ){ pRenderer->draw( pTarget->renderPassDescriptor(), nullptr ); },
+                             [&](){ pRenderer->waitIdle(); },
+                             &stats );
+    util::printHeadlessStats( "08-compute", stats );
+
+    util::Image image;
+    bool ok = pTarget->readback( pRenderer->commandQueue(), &image ) && image.writePpm( options.imagePath.c_str() );
+    if ( ok )
+    {
+        __builtin_printf( "Wrote %s\n", options.imagePath.c_str() );
+    }
+
+    delete pTarget;
+    delete pRenderer;
+    pDevice->release();
+    return ok ? 0 : 1;
+}
+
 int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
+    // Set LEARN_METAL_HEADLESS to a frame count to render without a window.
+    util::HeadlessOptions headless;
+    if ( util::headlessOptionsFromEnv( "08-compute", &headless ) )
+    {
+        int result = runHeadless( headless );
+        pAutoreleasePool->release();
+        return result;
+    }
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -245,99 +329,12 @@ MyMTKViewDelegate::~MyMTKViewDelegate()
 
 void MyMTKViewDelegate::drawInMTKView( MTK::View* pView )
 {
-    _pRenderer->draw( pView );
+    _pRenderer->draw( pView->currentRenderPassDescriptor(), pView->currentDrawable() );
 }
 
 #pragma endregion ViewDelegate }
 
 
-#pragma mark - Math
-
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b )
-    {
-        return { a.x + b.x, a.y + b.y, a.z + b.z };
-    }
-
-    constexpr simd_float4x4 makeIdentity()
-    {
-        using simd::float4;
-        return (simd_float4x4){ (float4){ 1.f, 0.f, 0.f, 0.f },
-                                (float4){ 0.f, 1.f, 0.f, 0.f },
-                                (float4){ 0.f, 0.f, 1.f, 0.f },
-                                (float4){ 0.f, 0.f, 0.f, 1.f } };
-    }
-
-    simd::float4x4 makePerspective( float fovRadians, float aspect, float znear, float zfar )
-    {
-        using simd::float4;
-        float ys = 1.f / tanf(fovRadians * 0.5f);
-        float xs = ys / aspect;
-        float zs = zfar / ( znear - zfar );
-        return simd_matrix_from_rows((float4){ xs, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, ys, 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, zs, znear * zs },
-                                     (float4){ 0, 0, -1, 0 });
-    }
-
-    simd::float4x4 makeXRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ 1.0f, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, cosf( a ), sinf( a ), 0.0f },
-                                     (float4){ 0.0f, -sinf( a ), cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeYRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), 0.0f, sinf( a ), 0.0f },
-                                     (float4){ 0.0f, 1.0f, 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), 0.0f, cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeZRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), sinf( a ), 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), cosf( a ), 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 1.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeTranslate( const simd::float3& v )
-    {
-        using simd::float4;
-        const float4 col0 = { 1.0f, 0.0f, 0.0f, 0.0f };
-        const float4 col1 = { 0.0f, 1.0f, 0.0f, 0.0f };
-        const float4 col2 = { 0.0f, 0.0f, 1.0f, 0.0f };
-        const float4 col3 = { v.x, v.y, v.z, 1.0f };
-        return simd_matrix( col0, col1, col2, col3 );
-    }
-
-    simd::float4x4 makeScale( const simd::float3& v )
-    {
-        using simd::float4;
-        return simd_matrix((float4){ v.x, 0, 0, 0 },
-                           (float4){ 0, v.y, 0, 0 },
-                           (float4){ 0, 0, v.z, 0 },
-                           (float4){ 0, 0, 0, 1.0 });
-    }
-
-    simd::float3x3 discardTranslation( const simd::float4x4& m )
-    {
-        return simd_matrix( m.columns[0].xyz, m.columns[1].xyz, m.columns[2].xyz );
-    }
-
-}
-
-
 #pragma mark - Renderer
 #pragma region Renderer {
 
@@ -347,10 +344,14 @@ Renderer::Renderer( MTL::Device* pDevice )
 : _pDevice( pDevice->retain() )
 , _angle ( 0.f )
 , _frame( 0 )
+, _framesSinceReport( 0 )
 {
     _pCommandQueue = _pDevice->newCommandQueue();
+    // Compiled pipelines are kept in a binary archive so later launches skip compilation.
+    _pPipelineCache = new util::PipelineCache( _pDevice );
     buildShaders();
     buildComputePipeline();
+    _pPipelineCache->serialize();
     buildDepthStencilStates();
     buildTextures();
     buildBuffers();
@@ -369,44 +370,43 @@ Renderer::~Renderer()
     {
         _pInstanceDataBuffer[i]->release();
     }
-    for ( int i = 0; i < kMaxFramesInFlight; ++i )
-    {
-        _pCameraDataBuffer[i]->release();
-    }
+    delete _pUniforms;
+    delete _pInstanceUpdater;
+    delete _pInstancePool;
     _pIndexBuffer->release();
     _pComputePSO->release();
     _pPSO->release();
+    delete _pPipelineCache;
     _pCommandQueue->release();
     _pDevice->release();
 }
 
 namespace shader_types
 {
-    struct VertexData
-    {
-        simd::float3 position;
-        simd::float3 normal;
-        simd::float2 texcoord;
-    };
-
-    struct InstanceData
-    {
-        simd::float4x4 instanceTransform;
-        simd::float3x3 instanceNormalTransform;
-        simd::float4 instanceColor;
-    };
-
-    struct CameraData
-    {
-        simd::float4x4 perspectiveTransform;
-        simd::float4x4 worldTransform;
-        simd::float3x3 worldNormalTransform;
-    };
+    #define VERTEX_DATA_FIELDS( FIELD, ARRAY ) \
+        FIELD( float3, position ) \
+        FIELD( float3, normal ) \
+        FIELD( float2, texcoord )
+    LEARN_METAL_SHADER_STRUCT( VertexData, VERTEX_DATA_FIELDS )
+
+    // Packed to 96 bytes: affine transform and normal transform columns as
+    // packed_float3, colour without alpha.
+    #define INSTANCE_DATA_FIELDS( FIELD, ARRAY ) \
+        ARRAY( packed_float3, instanceTransform, 4 ) \
+        ARRAY( packed_float3, instanceNormalTransform, 3 ) \
+        FIELD( packed_float3, instanceColor )
+    LEARN_METAL_SHADER_STRUCT( InstanceData, INSTANCE_DATA_FIELDS )
+
+    #define CAMERA_DATA_FIELDS( FIELD, ARRAY ) \
+        FIELD( float4x4, perspectiveTransform ) \
+        FIELD( float4x4, worldTransform ) \
+        FIELD( float3x3, worldNormalTransform )
+    LEARN_METAL_SHADER_STRUCT( CameraData, CAMERA_DATA_FIELDS )
 }
 
 void Renderer::buildShaders()
 {
-    using NS::StringEncoding::UTF8StringEncoding;
+    LEARN_METAL_ZONE( "buildShaders" );
 
     const char* shaderSrc = R"(
         #include <metal_stdlib>
@@ -420,48 +420,34 @@ void Renderer::buildShaders()
             float2 texcoord;
         };
 
-        struct VertexData
-        {
-            float3 position;
-            float3 normal;
-            float2 texcoord;
-        };
-
-        struct InstanceData
-        {
-            float4x4 instanceTransform;
-            float3x3 instanceNormalTransform;
-            float4 instanceColor;
-        };
-
-        struct CameraData
-        {
-            float4x4 perspectiveTransform;
-            float4x4 worldTransform;
-            float3x3 worldNormalTransform;
-        };
+        #include "shader_types.h"
 
         v2f vertex vertexMain( device const VertexData* vertexData [[buffer(0)]],
                                device const InstanceData* instanceData [[buffer(1)]],
-                               device const CameraData& cameraData [[buffer(2)]],
+                               constant CameraData& cameraData [[buffer(2)]],
                                uint vertexId [[vertex_id]],
                                uint instanceId [[instance_id]] )
         {
             v2f o;
 
             const device VertexData& vd = vertexData[ vertexId ];
-            float4 pos = float4( vd.position, 1.0 );
-            pos = instanceData[ instanceId ].instanceTransform * pos;
-            pos = cameraData.perspectiveTransform * cameraData.worldTransform * pos;
+            const device InstanceData& inst = instanceData[ instanceId ];
+            float3 p = vd.position;
+            float3 world = float3( inst.instanceTransform[ 0 ] ) * p.x + float3( inst.instanceTransform[ 1 ] ) * p.y
+                         + float3( inst.instanceTransform[ 2 ] ) * p.z + float3( inst.instanceTransform[ 3 ] );
+            float4 pos = cameraData.perspectiveTransform * cameraData.worldTransform * float4( world, 1.0 );
             o.position = pos;
 
-            float3 normal = instanceData[ instanceId ].instanceNormalTransform * vd.normal;
+            float3x3 instanceNormalTransform = float3x3( float3( inst.instanceNormalTransform[ 0 ] ),
+                                                         float3( inst.instanceNormalTransform[ 1 ] ),
+                                                         float3( inst.instanceNormalTransform[ 2 ] ) );
+            float3 normal = instanceNormalTransform * vd.normal;
             normal = cameraData.worldNormalTransform * normal;
             o.normal = normal;
 
             o.texcoord = vd.texcoord.xy;
 
-            o.color = half3( instanceData[ instanceId ].instanceColor.rgb );
+            o.color = half3( float3( inst.instanceColor ) );
             return o;
         }
 
@@ -482,15 +468,15 @@ void Renderer::buildShaders()
     )";
 
     NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pLibrary = _pPipelineCache->newLibrary( shaderSrc, &pError );
     if ( !pLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
         assert( false );
     }
 
-    MTL::Function* pVertexFn = pLibrary->newFunction( NS::String::string("vertexMain", UTF8StringEncoding) );
-    MTL::Function* pFragFn = pLibrary->newFunction( NS::String::string("fragmentMain", UTF8StringEncoding) );
+    MTL::Function* pVertexFn = _pPipelineCache->newFunction( pLibrary, "vertexMain" );
+    MTL::Function* pFragFn = _pPipelineCache->newFunction( pLibrary, "fragmentMain" );
 
     MTL::RenderPipelineDescriptor* pDesc = MTL::RenderPipelineDescriptor::alloc()->init();
     pDesc->setVertexFunction( pVertexFn );
@@ -498,7 +484,7 @@ void Renderer::buildShaders()
     pDesc->colorAttachments()->object(0)->setPixelFormat( MTL::PixelFormat::PixelFormatBGRA8Unorm_sRGB );
     pDesc->setDepthAttachmentPixelFormat( MTL::PixelFormat::PixelFormatDepth16Unorm );
 
-    _pPSO = _pDevice->newRenderPipelineState( pDesc, &pError );
+    _pPSO = _pPipelineCache->newRenderPipelineState( pDesc, &pError );
     if ( !_pPSO )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -517,19 +503,27 @@ void Renderer::buildComputePipeline()
         #include <metal_stdlib>
         using namespace metal;
 
+        // Specialized by the host; unspecialized builds use the defaults.
+        constant int max_iteration_value [[function_constant(0)]];
+        constant float scale_x_value [[function_constant(1)]];
+        constant float scale_y_value [[function_constant(2)]];
+
+        constant uint max_iteration = is_function_constant_defined(max_iteration_value) ? max_iteration_value : 1000;
+        constant float2 mandelbrot_scale = float2(is_function_constant_defined(scale_x_value) ? scale_x_value : 2.0,
+                                                  is_function_constant_defined(scale_y_value) ? scale_y_value : 2.0);
+
         kernel void mandelbrot_set(texture2d< half, access::write > tex [[texture(0)]],
                                    uint2 index [[thread_position_in_grid]],
                                    uint2 gridSize [[threads_per_grid]])
         {
             // Scale
-            float x0 = 2.0 * index.x / gridSize.x - 1.5;
-            float y0 = 2.0 * index.y / gridSize.y - 1.0;
+            float x0 = mandelbrot_scale.x * index.x / gridSize.x - 1.5;
+            float y0 = mandelbrot_scale.y * index.y / gridSize.y - 1.0;
 
             // Implement Mandelbrot set
             float x = 0.0;
             float y = 0.0;
             uint iteration = 0;
-            uint max_iteration = 1000;
             float xtmp = 0.0;
             while(x * x + y * y <= 4 && iteration < max_iteration)
             {
@@ -545,15 +539,15 @@ void Renderer::buildComputePipeline()
         })";
     NS::Error* pError = nullptr;
 
-    MTL::Library* pComputeLibrary = _pDevice->newLibrary( NS::String::string(kernelSrc, NS::UTF8StringEncoding), nullptr, &pError );
+    MTL::Library* pComputeLibrary = _pPipelineCache->newLibrary( kernelSrc, &pError, util::ShaderMath::Precise );
     if ( !pComputeLibrary )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
         assert(false);
     }
 
-    MTL::Function* pMandelbrotFn = pComputeLibrary->newFunction( NS::String::string("mandelbrot_set", NS::UTF8StringEncoding) );
-    _pComputePSO = _pDevice->newComputePipelineState( pMandelbrotFn, &pError );
+    MTL::Function* pMandelbrotFn = _pPipelineCache->newFunction( pComputeLibrary, "mandelbrot_set" );
+    _pComputePSO = _pPipelineCache->newComputePipelineState( pMandelbrotFn, &pError );
     if ( !_pComputePSO )
     {
         __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
@@ -593,8 +587,10 @@ void Renderer::buildTextures()
 
 void Renderer::buildBuffers()
 {
-    using simd::float2;
-    using simd::float3;
+    LEARN_METAL_ZONE( "buildBuffers" );
+
+    using math::float2;
+    using math::float3;
 
     const float s = 0.5f;
 
@@ -662,10 +658,51 @@ void Renderer::buildBuffers()
         _pInstanceDataBuffer[ i ] = _pDevice->newBuffer( instanceDataSize, MTL::ResourceStorageModeManaged );
     }
 
-    const size_t cameraDataSize = kMaxFramesInFlight * sizeof( shader_types::CameraData );
-    for ( size_t i = 0; i < kMaxFramesInFlight; ++i )
+    // Camera data is small enough to go through setVertexBytes(); no per-frame buffers needed.
+    _pUniforms = new util::UniformUploader( _pDevice, kMaxFramesInFlight );
+
+    // Instances are updated in parallel, one cache-line-aligned chunk per task.
+    _pInstancePool = new util::WorkStealingPool();
+    _pInstanceUpdater = new util::ParallelInstanceUpdater( _pInstancePool, sizeof( shader_types::InstanceData ) );
+
+    // Everything about an instance but its angles is fixed, so compute it once.
+    const float scl = kInstanceScale;
+    const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+    for ( std::vector< float >* pArray : { &_instancePosition[0], &_instancePosition[1], &_instancePosition[2],
+                                           &_instanceSpin[0], &_instanceSpin[1], &_instanceRotation[0], &_instanceRotation[1],
+                                           &_instanceColor[0], &_instanceColor[1], &_instanceColor[2] } )
+    {
+        pArray->resize( kNumInstances );
+    }
+
+    size_t ix = 0;
+    size_t iy = 0;
+    size_t iz = 0;
+    for ( size_t i = 0; i < kNumInstances; ++i )
     {
-        _pCameraDataBuffer[ i ] = _pDevice->newBuffer( cameraDataSize, MTL::ResourceStorageModeManaged );
+        if ( ix == kInstanceRows )
+        {
+            ix = 0;
+            iy += 1;
+        }
+        if ( iy == kInstanceRows )
+        {
+            iy = 0;
+            iz += 1;
+        }
+
+        _instancePosition[0][i] = objectPosition.x + ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
+        _instancePosition[1][i] = objectPosition.y + ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
+        _instancePosition[2][i] = objectPosition.z + ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
+        _instanceSpin[0][i] = cosf((float)iy);
+        _instanceSpin[1][i] = sinf((float)ix);
+
+        float iDivNumInstances = i / (float)kNumInstances;
+        _instanceColor[0][i] = iDivNumInstances;
+        _instanceColor[1][i] = 1.0f - iDivNumInstances;
+        _instanceColor[2][i] = sinf( M_PI * 2.0f * iDivNumInstances );
+
+        ix += 1;
     }
 }
 
@@ -688,30 +725,46 @@ void Renderer::generateMandelbrotTexture()
 
     pComputeEncoder->endEncoding();
 
+    _telemetry.track( pCommandBuffer );
     pCommandBuffer->commit();
 }
 
-void Renderer::draw( MTK::View* pView )
+void Renderer::waitIdle()
+{
+    for ( int i = 0; i < kMaxFramesInFlight; ++i )
+    {
+        dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
+    }
+    for ( int i = 0; i < kMaxFramesInFlight; ++i )
+    {
+        dispatch_semaphore_signal( _semaphore );
+    }
+}
+
+void Renderer::draw( MTL::RenderPassDescriptor* pRpd, MTL::Drawable* pDrawable )
 {
-    using simd::float3;
-    using simd::float4;
-    using simd::float4x4;
+    using math::float3;
+    using math::float4;
+    using math::float4x4;
 
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
+    _pUniforms->beginFrame( _frame );
     MTL::Buffer* pInstanceDataBuffer = _pInstanceDataBuffer[ _frame ];
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
     _angle += 0.002f;
 
-    const float scl = 0.2f;
     shader_types::InstanceData* pInstanceData = reinterpret_cast< shader_types::InstanceData *>( pInstanceDataBuffer->contents() );
 
     float3 objectPosition = { 0.f, 0.f, -10.f };
@@ -722,56 +775,44 @@ void Renderer::draw( MTK::View* pView )
     float4x4 rtInv = math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
     float4x4 fullObjectRot = rt * rr1 * rr0 * rtInv;
 
-    size_t ix = 0;
-    size_t iy = 0;
-    size_t iz = 0;
-    for ( size_t i = 0; i < kNumInstances; ++i )
-    {
-        if ( ix == kInstanceRows )
-        {
-            ix = 0;
-            iy += 1;
-        }
-        if ( iy == kInstanceRows )
+    // fullObjectRot * translate * yrot * zrot * scale, composed in closed form
+    util::InstanceTransformInputs instanceInputs;
+    instanceInputs.pPositionX = _instancePosition[0].data();
+    instanceInputs.pPositionY = _instancePosition[1].data();
+    instanceInputs.pPositionZ = _instancePosition[2].data();
+    instanceInputs.pRotationY = _instanceRotation[0].data();
+    instanceInputs.pRotationZ = _instanceRotation[1].data();
+    instanceInputs.uniformScale = kInstanceScale;
+    instanceInputs.pColorR = _instanceColor[0].data();
+    instanceInputs.pColorG = _instanceColor[1].data();
+    instanceInputs.pColorB = _instanceColor[2].data();
+
+    static_assert( sizeof( shader_types::InstanceData ) == sizeof( util::PackedInstanceRecord ), "InstanceData layout mismatch" );
+    _pInstanceUpdater->update( kNumInstances, [&]( size_t first, size_t count, unsigned ){
+        for ( size_t i = first; i < first + count; ++i )
         {
-            iy = 0;
-            iz += 1;
+            _instanceRotation[0][i] = _angle * _instanceSpin[0][i];
+            _instanceRotation[1][i] = _angle * _instanceSpin[1][i];
         }
-
-        float4x4 scale = math::makeScale( (float3){ scl, scl, scl } );
-        float4x4 zrot = math::makeZRotate( _angle * sinf((float)ix) );
-        float4x4 yrot = math::makeYRotate( _angle * cosf((float)iy));
-
-        float x = ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
-        float y = ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
-        float z = ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
-        float4x4 translate = math::makeTranslate( math::add( objectPosition, { x, y, z } ) );
-
-        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
-        pInstanceData[ i ].instanceNormalTransform = math::discardTranslation( pInstanceData[ i ].instanceTransform );
-
-        float iDivNumInstances = i / (float)kNumInstances;
-        float r = iDivNumInstances;
-        float g = 1.0f - r;
-        float b = sinf( M_PI * 2.0f * iDivNumInstances );
-        pInstanceData[ i ].instanceColor = (float4){ r, g, b, 1.0f };
-
-        ix += 1;
+        util::buildInstanceTransforms( instanceInputs, first, count, reinterpret_cast< const float* >( &fullObjectRot ),
+                                       reinterpret_cast< util::PackedInstanceRecord* >( pInstanceData ) );
+        return true;
+    });
+    for ( const util::DirtyRange& range : _pInstanceUpdater->dirtyRanges() )
+    {
+        pInstanceDataBuffer->didModifyRange( NS::Range::Make( range.offset, range.length ) );
     }
-    pInstanceDataBuffer->didModifyRange( NS::Range::Make( 0, pInstanceDataBuffer->length() ) );
 
     // Update camera state:
 
-    MTL::Buffer* pCameraDataBuffer = _pCameraDataBuffer[ _frame ];
-    shader_types::CameraData* pCameraData = reinterpret_cast< shader_types::CameraData *>( pCameraDataBuffer->contents() );
-    pCameraData->perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
-    pCameraData->worldTransform = math::makeIdentity();
-    pCameraData->worldNormalTransform = math::discardTranslation( pCameraData->worldTransform );
-    pCameraDataBuffer->didModifyRange( NS::Range::Make( 0, sizeof( shader_types::CameraData ) ) );
+    shader_types::CameraData cameraData;
+    cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
+    cameraData.worldTransform = math::makeIdentity();
+    cameraData.worldNormalTransform = math::discardTranslation( cameraData.worldTransform );
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     // Begin render pass:
 
-    MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
     pEnc->setRenderPipelineState( _pPSO );
@@ -779,7 +820,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->setVertexBuffer( _pVertexDataBuffer, /* offset */ 0, /* index */ 0 );
     pEnc->setVertexBuffer( pInstanceDataBuffer, /* offset */ 0, /* index */ 1 );
-    pEnc->setVertexBuffer( pCameraDataBuffer, /* offset */ 0, /* index */ 2 );
+    _pUniforms->setVertexUniforms( pEnc, &cameraData, sizeof( cameraData ), /* index */ 2 );
 
     pEnc->setFragmentTexture( _pTexture, /* index */ 0 );
 
@@ -793,9 +834,21 @@ void Renderer::draw( MTK::View* pView )
                                 kNumInstances );
 
     pEnc->endEncoding();
-    pCmd->presentDrawable( pView->currentDrawable() );
+    _pUniforms->endFrame();
+    if ( pDrawable )
+    {
+        pCmd->presentDrawable( pDrawable );
+    }
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
+    _telemetry.track( pCmd );
     pCmd->commit();
 
+    if ( ++_framesSinceReport == kTelemetryReportFrames )
+    {
+        _telemetry.report( "08-compute" );
+        _framesSinceReport = 0;
+    }
+
     pPool->release();
 }
 
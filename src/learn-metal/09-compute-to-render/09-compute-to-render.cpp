@@ -25,58 +25,68 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
-#include <simd/simd.h>
+#include <common/AsyncPipelineBuilder.hpp>
+#include <common/CpuZones.hpp>
+#include <common/GpuProfiler.hpp>
+#include <common/InstanceTransforms.hpp>
+#include <common/Math.hpp>
+#include <common/ProgressiveTileScheduler.hpp>
+#include <common/ShaderLayout.hpp>
+#include <common/UniformUploader.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
 
 static constexpr size_t kInstanceRows = 10;
 static constexpr size_t kInstanceColumns = 10;
 static constexpr size_t kInstanceDepth = 10;
 static constexpr size_t kNumInstances = (kInstanceRows * kInstanceColumns * kInstanceDepth);
+static constexpr float kInstanceScale = 0.2f;
 static constexpr size_t kMaxFramesInFlight = 3;
 static constexpr uint32_t kTextureWidth = 128;
 static constexpr uint32_t kTextureHeight = 128;
+static constexpr uint32_t kTextureTileSize = 32;
+static constexpr uint64_t kComputePixelBudget = kTextureWidth * kTextureHeight / 4;
 
 
 #pragma region Declarations {
 
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b );
-    constexpr simd_float4x4 makeIdentity();
-    simd::float4x4 makePerspective();
-    simd::float4x4 makeXRotate( float angleRadians );
-    simd::float4x4 makeYRotate( float angleRadians );
-    simd::float4x4 makeZRotate( float angleRadians );
-    simd::float4x4 makeTranslate( const simd::float3& v );
-    simd::float4x4 makeScale( const simd::float3& v );
-    simd::float3x3 discardTranslation( const simd::float4x4& m );
-}
+namespace math = util::math;
 
 class Renderer
 {
     public:
         Renderer( MTL::Device* pDevice );
         ~Renderer();
-        void buildShaders();
-        void buildComputePipeline();
+        void buildShaders( util::AsyncPipelineBuilder& pipelines );
+        void buildComputePipeline( util::AsyncPipelineBuilder& pipelines );
         void buildDepthStencilStates();
         void buildTextures();
         void buildBuffers();
         void generateMandelbrotTexture( MTL::CommandBuffer* pCommandBuffer );
         void draw( MTK::View* pView );
+        // Blocks until every frame in flight has completed.
+        void waitIdle();
 
     private:
         MTL::Device* _pDevice;
         MTL::CommandQueue* _pCommandQueue;
-        MTL::Library* _pShaderLibrary;
         MTL::RenderPipelineState* _pPSO;
         MTL::ComputePipelineState* _pComputePSO;
         MTL::DepthStencilState* _pDepthStencilState;
         MTL::Texture* _pTexture;
         MTL::Buffer* _pVertexDataBuffer;
         MTL::Buffer* _pInstanceDataBuffer[kMaxFramesInFlight];
-        MTL::Buffer* _pCameraDataBuffer[kMaxFramesInFlight];
+        util::UniformUploader* _pUniforms;
         MTL::Buffer* _pIndexBuffer;
-        MTL::Buffer* _pTextureAnimationBuffer;
+        util::GpuProfiler* _pProfiler;
+        util::ProgressiveTileScheduler _tileScheduler;
+        std::vector< util::TileDispatch > _tileDispatches;
+        std::vector< float > _instancePosition[3];
+        std::vector< float > _instanceSpin[2];
+        std::vector< float > _instanceRotation[2];
+        std::vector< float > _instanceColor[3];
         float _angle;
         int _frame;
         dispatch_semaphore_t _semaphore;
@@ -120,6 +130,10 @@ int main( int argc, char* argv[] )
 {
     NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
+    // Set LEARN_METAL_ZONE_TRACE to a path to get a Chrome trace of the
+    // CPU zones; needs the LEARN_METAL_ZONES build option.
+    LEARN_METAL_ZONE_WRITER( getenv( "LEARN_METAL_ZONE_TRACE" ) );
+
     MyAppDelegate del;
 
     NS::Application* pSharedApplication = NS::Application::sharedApplication();
@@ -253,93 +267,6 @@ void MyMTKViewDelegate::drawInMTKView( MTK::View* pView )
 #pragma endregion ViewDelegate }
 
 
-#pragma mark - Math
-
-namespace math
-{
-    constexpr simd::float3 add( const simd::float3& a, const simd::float3& b )
-    {
-        return { a.x + b.x, a.y + b.y, a.z + b.z };
-    }
-
-    constexpr simd_float4x4 makeIdentity()
-    {
-        using simd::float4;
-        return (simd_float4x4){ (float4){ 1.f, 0.f, 0.f, 0.f },
-                                (float4){ 0.f, 1.f, 0.f, 0.f },
-                                (float4){ 0.f, 0.f, 1.f, 0.f },
-                                (float4){ 0.f, 0.f, 0.f, 1.f } };
-    }
-
-    simd::float4x4 makePerspective( float fovRadians, float aspect, float znear, float zfar )
-    {
-        using simd::float4;
-        float ys = 1.f / tanf(fovRadians * 0.5f);
-        float xs = ys / aspect;
-        float zs = zfar / ( znear - zfar );
-        return simd_matrix_from_rows((float4){ xs, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, ys, 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, zs, znear * zs },
-                                     (float4){ 0, 0, -1, 0 });
-    }
-
-    simd::float4x4 makeXRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ 1.0f, 0.0f, 0.0f, 0.0f },
-                                     (float4){ 0.0f, cosf( a ), sinf( a ), 0.0f },
-                                     (float4){ 0.0f, -sinf( a ), cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeYRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), 0.0f, sinf( a ), 0.0f },
-                                     (float4){ 0.0f, 1.0f, 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), 0.0f, cosf( a ), 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeZRotate( float angleRadians )
-    {
-        using simd::float4;
-        const float a = angleRadians;
-        return simd_matrix_from_rows((float4){ cosf( a ), sinf( a ), 0.0f, 0.0f },
-                                     (float4){ -sinf( a ), cosf( a ), 0.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 1.0f, 0.0f },
-                                     (float4){ 0.0f, 0.0f, 0.0f, 1.0f });
-    }
-
-    simd::float4x4 makeTranslate( const simd::float3& v )
-    {
-        using simd::float4;
-        const float4 col0 = { 1.0f, 0.0f, 0.0f, 0.0f };
-        const float4 col1 = { 0.0f, 1.0f, 0.0f, 0.0f };
-        const float4 col2 = { 0.0f, 0.0f, 1.0f, 0.0f };
-        const float4 col3 = { v.x, v.y, v.z, 1.0f };
-        return simd_matrix( col0, col1, col2, col3 );
-    }
-
-    simd::float4x4 makeScale( const simd::float3& v )
-    {
-        using simd::float4;
-        return simd_matrix((float4){ v.x, 0, 0, 0 },
-                           (float4){ 0, v.y, 0, 0 },
-                           (float4){ 0, 0, v.z, 0 },
-                           (float4){ 0, 0, 0, 1.0 });
-    }
-
-    simd::float3x3 discardTranslation( const simd::float4x4& m )
-    {
-        return simd_matrix( m.columns[0].xyz, m.columns[1].xyz, m.columns[2].xyz );
-    }
-
-}
-
-
 #pragma mark - Renderer
 #pragma region Renderer {
 
@@ -347,35 +274,54 @@ const int Renderer::kMaxFramesInFlight = 3;
 
 Renderer::Renderer( MTL::Device* pDevice )
 : _pDevice( pDevice->retain() )
+, _tileScheduler( kTextureWidth, kTextureHeight, kTextureTileSize, kComputePixelBudget )
 , _angle ( 0.f )
 , _frame( 0 )
 , _animationIndex(0)
 {
     _pCommandQueue = _pDevice->newCommandQueue();
-    buildShaders();
-    buildComputePipeline();
+
+    // Render and compute pipelines compile concurrently and are joined
+    // before the first frame.
+    util::AsyncPipelineBuilder pipelines( _pDevice );
+    buildShaders( pipelines );
+    buildComputePipeline( pipelines );
+    if ( !pipelines.build() )
+    {
+        assert( false );
+    }
+
     buildDepthStencilStates();
     buildTextures();
     buildBuffers();
 
+    // One more sample buffer than frames in flight, so the oldest has
+    // usually completed by the time the ring comes back to it.
+    _pProfiler = new util::GpuProfiler( _pDevice, kMaxFramesInFlight + 1 );
+
     _semaphore = dispatch_semaphore_create( Renderer::kMaxFramesInFlight );
 }
 
 Renderer::~Renderer()
 {
-    _pTextureAnimationBuffer->release();
+    // The profiler's completed handlers write into its slots, and the trace
+    // should include the last frames.
+    waitIdle();
+
+    // Set LEARN_METAL_GPU_TRACE to a path to get a Chrome trace of the run.
+    if ( const char* pTracePath = getenv( "LEARN_METAL_GPU_TRACE" ) )
+    {
+        _pProfiler->writeTrace( pTracePath );
+    }
+    delete _pProfiler;
     _pTexture->release();
-    _pShaderLibrary->release();
     _pDepthStencilState->release();
     _pVertexDataBuffer->release();
     for ( int i = 0; i < kMaxFramesInFlight; ++i )
     {
         _pInstanceDataBuffer[i]->release();
     }
-    for ( int i = 0; i < kMaxFramesInFlight; ++i )
-    {
-        _pCameraDataBuffer[i]->release();
-    }
+    delete _pUniforms;
     _pIndexBuffer->release();
     _pComputePSO->release();
     _pPSO->release();
@@ -385,31 +331,41 @@ Renderer::~Renderer()
 
 namespace shader_types
 {
-    struct VertexData
-    {
-        simd::float3 position;
-        simd::float3 normal;
-        simd::float2 texcoord;
-    };
-
-    struct InstanceData
-    {
-        simd::float4x4 instanceTransform;
-        simd::float3x3 instanceNormalTransform;
-        simd::float4 instanceColor;
-    };
-
-    struct CameraData
-    {
-        simd::float4x4 perspectiveTransform;
-        simd::float4x4 worldTransform;
-        simd::float3x3 worldNormalTransform;
-    };
+    #define VERTEX_DATA_FIELDS( FIELD, ARRAY ) \
+        FIELD( float3, position ) \
+        FIELD( float3, normal ) \
+        FIELD( float2, texcoord )
+    LEARN_METAL_SHADER_STRUCT( VertexData, VERTEX_DATA_FIELDS )
+
+    // Compact 28-byte instance: position, uniform scale, rotation quaternion
+    // as four snorm16 and RGBA8 colour. The object rotation moved to
+    // CameraData::worldTransform.
+    #define INSTANCE_DATA_FIELDS( FIELD, ARRAY ) \
+        FIELD( packed_float3, position ) \
+        FIELD( float, scale ) \
+        ARRAY( uint, rotation, 2 ) \
+        FIELD( uint, color )
+    LEARN_METAL_SHADER_STRUCT( InstanceData, INSTANCE_DATA_FIELDS )
+
+    #define CAMERA_DATA_FIELDS( FIELD, ARRAY ) \
+        FIELD( float4x4, perspectiveTransform ) \
+        FIELD( float4x4, worldTransform ) \
+        FIELD( float3x3, worldNormalTransform )
+    LEARN_METAL_SHADER_STRUCT( CameraData, CAMERA_DATA_FIELDS )
+
+    #define MANDELBROT_TILE_FIELDS( FIELD, ARRAY ) \
+        FIELD( uint2, origin ) \
+        FIELD( uint2, size ) \
+        FIELD( uint, stride ) \
+        FIELD( uint, maxIterations ) \
+        FIELD( float, zoom ) \
+        FIELD( float2, center )
+    LEARN_METAL_SHADER_STRUCT( MandelbrotTile, MANDELBROT_TILE_FIELDS )
 }
 
-void Renderer::buildShaders()
+void Renderer::buildShaders( util::AsyncPipelineBuilder& pipelines )
 {
-    using NS::StringEncoding::UTF8StringEncoding;
+    LEARN_METAL_ZONE( "buildShaders" );
 
     const char* shaderSrc = R"(
         #include <metal_stdlib>
@@ -423,48 +379,50 @@ void Renderer::buildShaders()
             float2 texcoord;
         };
 
-        struct VertexData
-        {
-            float3 position;
-            float3 normal;
-            float2 texcoord;
-        };
+        #include "shader_types.h"
 
-        struct InstanceData
+        // Rotation matrix of a unit quaternion ( x, y, z, w ).
+        float3x3 quaternionToMatrix( float4 q )
         {
-            float4x4 instanceTransform;
-            float3x3 instanceNormalTransform;
-            float4 instanceColor;
-        };
+            float3 q2 = q.xyz * 2.0;
+            float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+            float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+            float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+            return float3x3( float3( 1.0 - ( yy + zz ), xy + wz, xz - wy ),
+                             float3( xy - wz, 1.0 - ( xx + zz ), yz + wx ),
+                             float3( xz + wy, yz - wx, 1.0 - ( xx + yy ) ) );
+        }
 
-        struct CameraData
+        float4 decodeRotation( const device InstanceData& inst )
         {
-            float4x4 perspectiveTransform;
-            float4x4 worldTransform;
-            float3x3 worldNormalTransform;
-        };
+            return normalize( float4( unpack_snorm2x16_to_float( inst.rotation[ 0 ] ),
+                                      unpack_snorm2x16_to_float( inst.rotation[ 1 ] ) ) );
+        }
 
         v2f vertex vertexMain( device const VertexData* vertexData [[buffer(0)]],
                                device const InstanceData* instanceData [[buffer(1)]],
-                               device const CameraData& cameraData [[buffer(2)]],
+                               constant CameraData& cameraData [[buffer(2)]],
                                uint vertexId [[vertex_id]],
                                uint instanceId [[instance_id]] )
         {
             v2f o;
 
             const device VertexData& vd = vertexData[ vertexId ];
-            float4 pos = float4( vd.position, 1.0 );
-            pos = instanceData[ instanceId ].instanceTransform * pos;
-            pos = cameraData.perspectiveTransform * cameraData.worldTransform * pos;
+            const device InstanceData& inst = instanceData[ instanceId ];
+            float3x3 rotation = quaternionToMatrix( decodeRotation( inst ) );
+            float3 world = rotation * ( vd.position * inst.scale ) + float3( inst.position );
+            float4 pos = cameraData.perspectiveTransform * cameraData.worldTransform * float4( world, 1.0 );
             o.position = pos;
 
-            float3 normal = instanceData[ instanceId ].instanceNormalTransform * vd.normal;
+            // Uniform scale only changes the length, which the fragment
+            // shader normalizes away.
+            float3 normal = rotation * vd.normal;
             normal = cameraData.worldNormalTransform * normal;
             o.normal = normal;
 
             o.texcoord = vd.texcoord.xy;
 
-            o.color = half3( instanceData[ instanceId ].instanceColor.rgb );
+            o.color = half3( unpack_unorm4x8_to_float( inst.color ).rgb );
             return o;
         }
 
@@ -484,72 +442,63 @@ void Renderer::buildShaders()
         }
     )";
 
-    NS::Error* pError = nullptr;
-    MTL::Library* pLibrary = _pDevice->newLibrary( NS::String::string(shaderSrc, UTF8StringEncoding), nullptr, &pError );
-    if ( !pLibrary )
-    {
-        __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
-        assert( false );
-    }
-
-    MTL::Function* pVertexFn = pLibrary->newFunction( NS::String::string("vertexMain", UTF8StringEncoding) );
-    MTL::Function* pFragFn = pLibrary->newFunction( NS::String::string("fragmentMain", UTF8StringEncoding) );
+    util::AsyncPipelineBuilder::JobId library = pipelines.addLibrary( "render library", shaderSrc );
+    util::AsyncPipelineBuilder::JobId vertexFn = pipelines.addFunction( library, "vertexMain" );
+    util::AsyncPipelineBuilder::JobId fragFn = pipelines.addFunction( library, "fragmentMain" );
 
     MTL::RenderPipelineDescriptor* pDesc = MTL::RenderPipelineDescriptor::alloc()->init();
-    pDesc->setVertexFunction( pVertexFn );
-    pDesc->setFragmentFunction( pFragFn );
     pDesc->colorAttachments()->object(0)->setPixelFormat( MTL::PixelFormat::PixelFormatBGRA8Unorm_sRGB );
     pDesc->setDepthAttachmentPixelFormat( MTL::PixelFormat::PixelFormatDepth16Unorm );
 
-    _pPSO = _pDevice->newRenderPipelineState( pDesc, &pError );
-    if ( !_pPSO )
-    {
-        __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
-        assert( false );
-    }
+    pipelines.addRenderPipeline( "render PSO", pDesc, vertexFn, fragFn, &_pPSO );
 
-    pVertexFn->release();
-    pFragFn->release();
     pDesc->release();
-    _pShaderLibrary = pLibrary;
 }
 
-void Renderer::buildComputePipeline()
+void Renderer::buildComputePipeline( util::AsyncPipelineBuilder& pipelines )
 {
     const char* kernelSrc = R"(
         #include <metal_stdlib>
         using namespace metal;
 
+        // Specialized by the host; unspecialized builds use the defaults.
+        constant int max_iteration_value [[function_constant(0)]];
+        constant float scale_x_value [[function_constant(1)]];
+        constant float scale_y_value [[function_constant(2)]];
+
+        constant uint max_iteration = is_function_constant_defined(max_iteration_value) ? max_iteration_value : 1000;
+        constant float2 mandelbrot_scale = float2(is_function_constant_defined(scale_x_value) ? scale_x_value : 2.2,
+                                                  is_function_constant_defined(scale_y_value) ? scale_y_value : 2.0);
+
+        #include "shader_types.h"
+
+        // Evaluates every tile.stride-th pixel of one tile and fills the
+        // stride x stride block it stands for.
         kernel void mandelbrot_set(texture2d< half, access::write > tex [[texture(0)]],
                                    uint2 index [[thread_position_in_grid]],
-                                   uint2 gridSize [[threads_per_grid]],
-                                   device const uint* frame [[buffer(0)]])
+                                   constant MandelbrotTile& tile [[buffer(0)]])
         {
-            constexpr float kAnimationFrequency = 0.01;
-            constexpr float kAnimationSpeed = 4;
-            constexpr float kAnimationScaleLow = 0.62;
-            constexpr float kAnimationScale = 0.38;
-
             constexpr float2 kMandelbrotPixelOffset = {-0.2, -0.35};
-            constexpr float2 kMandelbrotOrigin = {-1.2, -0.32};
-            constexpr float2 kMandelbrotScale = {2.2, 2.0};
 
-            // Map time to zoom value in [kAnimationScaleLow, 1]
-            float zoom = kAnimationScaleLow + kAnimationScale * cos(kAnimationFrequency * *frame);
-            // Speed up zooming
-            zoom = pow(zoom, kAnimationSpeed);
+            uint2 pixel = tile.origin + index * tile.stride;
+            uint2 tileEnd = tile.origin + tile.size;
+            if (pixel.x >= tileEnd.x || pixel.y >= tileEnd.y)
+            {
+                return;
+            }
+            uint2 gridSize = uint2(tex.get_width(), tex.get_height());
 
             //Scale
-            float x0 = zoom * kMandelbrotScale.x * ((float)index.x / gridSize.x + kMandelbrotPixelOffset.x) + kMandelbrotOrigin.x;
-            float y0 = zoom * kMandelbrotScale.y * ((float)index.y / gridSize.y + kMandelbrotPixelOffset.y) + kMandelbrotOrigin.y;
+            float x0 = tile.zoom * mandelbrot_scale.x * ((float)pixel.x / gridSize.x + kMandelbrotPixelOffset.x) + tile.center.x;
+            float y0 = tile.zoom * mandelbrot_scale.y * ((float)pixel.y / gridSize.y + kMandelbrotPixelOffset.y) + tile.center.y;
 
             // Implement Mandelbrot set
             float x = 0.0;
             float y = 0.0;
             uint iteration = 0;
-            uint max_iteration = 1000;
+            uint limit = min(max_iteration, tile.maxIterations);
             float xtmp = 0.0;
-            while(x * x + y * y <= 4 && iteration < max_iteration)
+            while(x * x + y * y <= 4 && iteration < limit)
             {
                 xtmp = x * x - y * y + x0;
                 y = 2 * x * y + y0;
@@ -559,27 +508,21 @@ void Renderer::buildComputePipeline()
 
             // Convert iteration result to colors
             half color = (0.5 + 0.5 * cos(3.0 + iteration * 0.15));
-            tex.write(half4(color, color, color, 1.0), index, 0);
-        })";
-    NS::Error* pError = nullptr;
-
-    MTL::Library* pComputeLibrary = _pDevice->newLibrary( NS::String::string(kernelSrc, NS::UTF8StringEncoding), nullptr, &pError );
-    if ( !pComputeLibrary )
-    {
-        __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
-        assert(false);
-    }
+            half4 value = half4(color, color, color, 1.0);
 
-    MTL::Function* pMandelbrotFn = pComputeLibrary->newFunction( NS::String::string("mandelbrot_set", NS::UTF8StringEncoding) );
-    _pComputePSO = _pDevice->newComputePipelineState( pMandelbrotFn, &pError );
-    if ( !_pComputePSO )
-    {
-        __builtin_printf( "%s", pError->localizedDescription()->utf8String() );
-        assert(false);
-    }
+            uint2 blockEnd = min(pixel + tile.stride, tileEnd);
+            for (uint py = pixel.y; py < blockEnd.y; ++py)
+            {
+                for (uint px = pixel.x; px < blockEnd.x; ++px)
+                {
+                    tex.write(value, uint2(px, py), 0);
+                }
+            }
+        })";
 
-    pMandelbrotFn->release();
-    pComputeLibrary->release();
+    util::AsyncPipelineBuilder::JobId library = pipelines.addLibrary( "compute library", kernelSrc, util::ShaderMath::Precise );
+    util::AsyncPipelineBuilder::JobId mandelbrotFn = pipelines.addFunction( library, "mandelbrot_set" );
+    pipelines.addComputePipeline( "mandelbrot PSO", mandelbrotFn, &_pComputePSO );
 }
 
 void Renderer::buildDepthStencilStates()
@@ -611,8 +554,10 @@ void Renderer::buildTextures()
 
 void Renderer::buildBuffers()
 {
-    using simd::float2;
-    using simd::float3;
+    LEARN_METAL_ZONE( "buildBuffers" );
+
+    using math::float2;
+    using math::float3;
 
     const float s = 0.5f;
 
@@ -680,60 +625,147 @@ void Renderer::buildBuffers()
         _pInstanceDataBuffer[ i ] = _pDevice->newBuffer( instanceDataSize, MTL::ResourceStorageModeManaged );
     }
 
-    const size_t cameraDataSize = kMaxFramesInFlight * sizeof( shader_types::CameraData );
-    for ( size_t i = 0; i < kMaxFramesInFlight; ++i )
+    // Camera data is small enough to go through setVertexBytes(); no per-frame buffers needed.
+    _pUniforms = new util::UniformUploader( _pDevice, kMaxFramesInFlight );
+
+    // Everything about an instance but its angles is fixed, so compute it once.
+    const float scl = kInstanceScale;
+    const math::float3 objectPosition = { 0.f, 0.f, -10.f };
+    for ( std::vector< float >* pArray : { &_instancePosition[0], &_instancePosition[1], &_instancePosition[2],
+                                           &_instanceSpin[0], &_instanceSpin[1], &_instanceRotation[0], &_instanceRotation[1],
+                                           &_instanceColor[0], &_instanceColor[1], &_instanceColor[2] } )
     {
-        _pCameraDataBuffer[ i ] = _pDevice->newBuffer( cameraDataSize, MTL::ResourceStorageModeManaged );
+        pArray->resize( kNumInstances );
     }
 
-    _pTextureAnimationBuffer = _pDevice->newBuffer( sizeof(uint), MTL::ResourceStorageModeManaged );
+    size_t ix = 0;
+    size_t iy = 0;
+    size_t iz = 0;
+    for ( size_t i = 0; i < kNumInstances; ++i )
+    {
+        if ( ix == kInstanceRows )
+        {
+            ix = 0;
+            iy += 1;
+        }
+        if ( iy == kInstanceRows )
+        {
+            iy = 0;
+            iz += 1;
+        }
+
+        _instancePosition[0][i] = objectPosition.x + ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
+        _instancePosition[1][i] = objectPosition.y + ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
+        _instancePosition[2][i] = objectPosition.z + ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
+        _instanceSpin[0][i] = cosf((float)iy);
+        _instanceSpin[1][i] = sinf((float)ix);
+
+        float iDivNumInstances = i / (float)kNumInstances;
+        _instanceColor[0][i] = iDivNumInstances;
+        _instanceColor[1][i] = 1.0f - iDivNumInstances;
+        _instanceColor[2][i] = sinf( M_PI * 2.0f * iDivNumInstances );
+
+        ix += 1;
+    }
 }
 
 void Renderer::generateMandelbrotTexture( MTL::CommandBuffer* pCommandBuffer )
 {
     assert(pCommandBuffer);
 
-    uint* ptr = reinterpret_cast<uint*>(_pTextureAnimationBuffer->contents());
-    *ptr = (_animationIndex++) % 5000;
-    _pTextureAnimationBuffer->didModifyRange(NS::Range::Make(0, sizeof(uint)));
+    constexpr float kAnimationFrequency = 0.01f;
+    constexpr float kAnimationSpeed = 4.0f;
+    constexpr float kAnimationScaleLow = 0.62f;
+    constexpr float kAnimationScale = 0.38f;
 
-    MTL::ComputeCommandEncoder* pComputeEncoder = pCommandBuffer->computeCommandEncoder();
+    uint frame = (_animationIndex++) % 5000;
+
+    // Map time to zoom value in [kAnimationScaleLow, 1], then speed up zooming
+    float zoom = kAnimationScaleLow + kAnimationScale * cosf( kAnimationFrequency * frame );
+
+    util::MandelbrotView view;
+    view.zoom = powf( zoom, kAnimationSpeed );
+    view.centerX = -1.2f;
+    view.centerY = -0.32f;
+    view.maxIterations = 1000;
+
+    // A new zoom restarts refinement from the coarsest level: every frame
+    // covers the whole image at 1/16 resolution and spends the rest of the
+    // budget on full-resolution tiles from the centre out.
+    _tileScheduler.setView( view );
+
+    _tileScheduler.nextFrame( &_tileDispatches );
+    if ( _tileDispatches.empty() )
+    {
+        return;
+    }
+
+    MTL::ComputePassDescriptor* pComputePass = MTL::ComputePassDescriptor::computePassDescriptor();
+    _pProfiler->attach( pComputePass, "mandelbrot" );
+    MTL::ComputeCommandEncoder* pComputeEncoder = pCommandBuffer->computeCommandEncoder( pComputePass );
 
     pComputeEncoder->setComputePipelineState( _pComputePSO );
     pComputeEncoder->setTexture( _pTexture, 0 );
-    pComputeEncoder->setBuffer(_pTextureAnimationBuffer, 0, 0);
 
-    MTL::Size gridSize = MTL::Size( kTextureWidth, kTextureHeight, 1 );
+    MTL::Size threadgroupSize( 8, 8, 1 );
 
-    NS::UInteger threadGroupSize = _pComputePSO->maxTotalThreadsPerThreadgroup();
-    MTL::Size threadgroupSize( threadGroupSize, 1, 1 );
-
-    pComputeEncoder->dispatchThreads( gridSize, threadgroupSize );
+    for ( const util::TileDispatch& d : _tileDispatches )
+    {
+        shader_types::MandelbrotTile tile;
+        tile.origin = math::uint2{ d.x, d.y };
+        tile.size = math::uint2{ d.width, d.height };
+        tile.stride = d.stride;
+        tile.maxIterations = view.maxIterations;
+        tile.zoom = view.zoom;
+        tile.center = math::float2{ view.centerX, view.centerY };
+        pComputeEncoder->setBytes( &tile, sizeof( tile ), 0 );
+
+        MTL::Size gridSize = MTL::Size( ( d.width + d.stride - 1 ) / d.stride, ( d.height + d.stride - 1 ) / d.stride, 1 );
+        pComputeEncoder->dispatchThreads( gridSize, threadgroupSize );
+    }
 
     pComputeEncoder->endEncoding();
 }
 
+void Renderer::waitIdle()
+{
+    for ( int i = 0; i < kMaxFramesInFlight; ++i )
+    {
+        dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
+    }
+    for ( int i = 0; i < kMaxFramesInFlight; ++i )
+    {
+        dispatch_semaphore_signal( _semaphore );
+    }
+}
+
 void Renderer::draw( MTK::View* pView )
 {
-    using simd::float3;
-    using simd::float4;
-    using simd::float4x4;
+    using math::float3;
+    using math::float4x4;
 
     NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+    LEARN_METAL_ZONE( "draw" );
+    uint64_t encodeStart = util::traceClockNs();
 
     _frame = (_frame + 1) % Renderer::kMaxFramesInFlight;
+    _pUniforms->beginFrame( _frame );
     MTL::Buffer* pInstanceDataBuffer = _pInstanceDataBuffer[ _frame ];
 
     MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+    LEARN_METAL_ZONE_SEQUENCE( phases, "wait" );
     dispatch_semaphore_wait( _semaphore, DISPATCH_TIME_FOREVER );
+    _pProfiler->beginFrame( pCmd );
+    // Registered after the profiler's handler, so a signalled frame has
+    // finished writing its timestamps.
     Renderer* pRenderer = this;
     pCmd->addCompletedHandler( ^void( MTL::CommandBuffer* pCmd ){
         dispatch_semaphore_signal( pRenderer->_semaphore );
     });
+    LEARN_METAL_ZONE_NEXT( phases, "update" );
 
     _angle += 0.002f;
 
-    const float scl = 0.2f;
     shader_types::InstanceData* pInstanceData = reinterpret_cast< shader_types::InstanceData *>( pInstanceDataBuffer->contents() );
 
     float3 objectPosition = { 0.f, 0.f, -10.f };
@@ -744,53 +776,37 @@ void Renderer::draw( MTK::View* pView )
     float4x4 rtInv = math::makeTranslate( { -objectPosition.x, -objectPosition.y, -objectPosition.z } );
     float4x4 fullObjectRot = rt * rr1 * rr0 * rtInv;
 
-    size_t ix = 0;
-    size_t iy = 0;
-    size_t iz = 0;
+    // translate * yrot * zrot * scale per instance; fullObjectRot is applied
+    // through the camera's world transform.
+    util::InstanceTransformInputs instanceInputs;
+    instanceInputs.pPositionX = _instancePosition[0].data();
+    instanceInputs.pPositionY = _instancePosition[1].data();
+    instanceInputs.pPositionZ = _instancePosition[2].data();
+    instanceInputs.pRotationY = _instanceRotation[0].data();
+    instanceInputs.pRotationZ = _instanceRotation[1].data();
+    instanceInputs.uniformScale = kInstanceScale;
+    instanceInputs.pColorR = _instanceColor[0].data();
+    instanceInputs.pColorG = _instanceColor[1].data();
+    instanceInputs.pColorB = _instanceColor[2].data();
+
     for ( size_t i = 0; i < kNumInstances; ++i )
     {
-        if ( ix == kInstanceRows )
-        {
-            ix = 0;
-            iy += 1;
-        }
-        if ( iy == kInstanceRows )
-        {
-            iy = 0;
-            iz += 1;
-        }
-
-        float4x4 scale = math::makeScale( (float3){ scl, scl, scl } );
-        float4x4 zrot = math::makeZRotate( _angle * sinf((float)ix) );
-        float4x4 yrot = math::makeYRotate( _angle * cosf((float)iy));
-
-        float x = ((float)ix - (float)kInstanceRows/2.f) * (2.f * scl) + scl;
-        float y = ((float)iy - (float)kInstanceColumns/2.f) * (2.f * scl) + scl;
-        float z = ((float)iz - (float)kInstanceDepth/2.f) * (2.f * scl);
-        float4x4 translate = math::makeTranslate( math::add( objectPosition, { x, y, z } ) );
-
-        pInstanceData[ i ].instanceTransform = fullObjectRot * translate * yrot * zrot * scale;
-        pInstanceData[ i ].instanceNormalTransform = math::discardTranslation( pInstanceData[ i ].instanceTransform );
-
-        float iDivNumInstances = i / (float)kNumInstances;
-        float r = iDivNumInstances;
-        float g = 1.0f - r;
-        float b = sinf( M_PI * 2.0f * iDivNumInstances );
-        pInstanceData[ i ].instanceColor = (float4){ r, g, b, 1.0f };
-
-        ix += 1;
+        _instanceRotation[0][i] = _angle * _instanceSpin[0][i];
+        _instanceRotation[1][i] = _angle * _instanceSpin[1][i];
     }
-    pInstanceDataBuffer->didModifyRange( NS::Range::Make( 0, pInstanceDataBuffer->length() ) );
+
+    static_assert( sizeof( shader_types::InstanceData ) == sizeof( util::CompactInstanceRecord ), "InstanceData layout mismatch" );
+    util::encodeCompactInstances( instanceInputs, 0, kNumInstances, reinterpret_cast< util::CompactInstanceRecord* >( pInstanceData ) );
+    pInstanceDataBuffer->didModifyRange( NS::Range::Make( 0, kNumInstances * sizeof( shader_types::InstanceData ) ) );
 
     // Update camera state:
 
-    MTL::Buffer* pCameraDataBuffer = _pCameraDataBuffer[ _frame ];
-    shader_types::CameraData* pCameraData = reinterpret_cast< shader_types::CameraData *>( pCameraDataBuffer->contents() );
-    pCameraData->perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
-    pCameraData->worldTransform = math::makeIdentity();
-    pCameraData->worldNormalTransform = math::discardTranslation( pCameraData->worldTransform );
-    pCameraDataBuffer->didModifyRange( NS::Range::Make( 0, sizeof( shader_types::CameraData ) ) );
+    shader_types::CameraData cameraData;
+    cameraData.perspectiveTransform = math::makePerspective( 45.f * M_PI / 180.f, 1.f, 0.03f, 500.0f ) ;
+    cameraData.worldTransform = fullObjectRot;
+    cameraData.worldNormalTransform = math::discardTranslation( cameraData.worldTransform );
 
+    LEARN_METAL_ZONE_NEXT( phases, "encode" );
     // Update texture:
 
     generateMandelbrotTexture( pCmd );
@@ -798,6 +814,7 @@ void Renderer::draw( MTK::View* pView )
     // Begin render pass:
 
     MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
+    _pProfiler->attach( pRpd, "render" );
     MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder( pRpd );
 
     pEnc->setRenderPipelineState( _pPSO );
@@ -805,7 +822,7 @@ void Renderer::draw( MTK::View* pView )
 
     pEnc->setVertexBuffer( _pVertexDataBuffer, /* offset */ 0, /* index */ 0 );
     pEnc->setVertexBuffer( pInstanceDataBuffer, /* offset */ 0, /* index */ 1 );
-    pEnc->setVertexBuffer( pCameraDataBuffer, /* offset */ 0, /* index */ 2 );
+    _pUniforms->setVertexUniforms( pEnc, &cameraData, sizeof( cameraData ), /* index */ 2 );
 
     pEnc->setFragmentTexture( _pTexture, /* index */ 0 );
 
@@ -819,8 +836,11 @@ void Renderer::draw( MTK::View* pView )
                                 kNumInstances );
 
     pEnc->endEncoding();
+    _pUniforms->endFrame();
     pCmd->presentDrawable( pView->currentDrawable() );
+    LEARN_METAL_ZONE_NEXT( phases, "commit" );
     pCmd->commit();
+    _pProfiler->addCpuEvent( "encode", encodeStart, util::traceClockNs() );
 
     pPool->release();
 }